@@ -0,0 +1,301 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file Corpus.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Deterministic generator of synthetic Dargon source.
+*
+*****************************************************************/
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Corpus.h"
+
+static const char* const _words[] = {
+    "dragon", "hoard", "gold", "scale", "wing", "fire", "cave", "knight",
+    "config", "value", "table", "entry", "limit", "buffer", "retry", "timeout",
+    "the", "a", "of", "to", "and", "is", "when", "for", "with", "this"
+};
+#define DRG_CORPUS_WORDS (sizeof(_words) / sizeof(_words[0]))
+
+/*****************************************************************
+* Utils
+*****************************************************************/
+
+static uint32_t D_CorpusRandom(D_Corpus* corpus) {
+    // xorshift32
+    uint32_t x = corpus->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    corpus->rng = x;
+    return x;
+}
+
+static uint32_t D_CorpusBelow(D_Corpus* corpus, uint32_t bound) {
+    return D_CorpusRandom(corpus) % bound;
+}
+
+static void D_CorpusReserve(D_Corpus* corpus, size_t extra) {
+    if(corpus->length + extra + 1 <= corpus->capacity) {
+        return;
+    }
+    size_t capacity = corpus->capacity ? corpus->capacity : 4096;
+    while(corpus->length + extra + 1 > capacity) {
+        capacity *= 2;
+    }
+    char* data = (char*)realloc(corpus->data, capacity);
+    if(NULL == data) {
+        perror("D_CorpusReserve: realloc() failed!");
+        exit(EXIT_FAILURE);
+    }
+    corpus->data = data;
+    corpus->capacity = capacity;
+}
+
+static void D_CorpusPrintf(D_Corpus* corpus, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    va_list copy;
+    va_copy(copy, args);
+    int needed = vsnprintf(NULL, 0, fmt, copy);
+    va_end(copy);
+    D_CorpusReserve(corpus, (size_t)needed);
+    vsnprintf(corpus->data + corpus->length, (size_t)needed + 1, fmt, args);
+    va_end(args);
+    for(int i = 0; i < needed; i++) {
+        if(corpus->data[corpus->length + i] == '\n') corpus->lines++;
+    }
+    corpus->length += (size_t)needed;
+}
+
+static void D_CorpusStartProgram(D_Corpus* corpus) {
+    if(corpus->programCount == corpus->programCapacity) {
+        corpus->programCapacity = corpus->programCapacity ? corpus->programCapacity * 2 : 64;
+        corpus->programs = (size_t*)realloc(corpus->programs, sizeof(size_t) * (size_t)corpus->programCapacity);
+        if(NULL == corpus->programs) {
+            perror("D_CorpusStartProgram: realloc() failed!");
+            exit(EXIT_FAILURE);
+        }
+    }
+    corpus->programs[corpus->programCount++] = corpus->length;
+}
+
+static void D_CorpusWords(D_Corpus* corpus, int count) {
+    for(int i = 0; i < count; i++) {
+        D_CorpusPrintf(corpus, i ? " %s" : "%s", _words[D_CorpusBelow(corpus, DRG_CORPUS_WORDS)]);
+    }
+}
+
+/*****************************************************************
+* Constructs
+*****************************************************************/
+
+typedef struct {
+    int ints;       // i0..i<ints-1> are declared ints
+    int reals;      // r0..r<reals-1> are declared reals
+    int others;     // counter for every other name
+} D_CorpusNames;
+
+// An int expression over literals and already declared ints.
+static void D_CorpusIntExpr(D_Corpus* corpus, D_CorpusNames* names, int depth) {
+    static const char* const ops[] = { "+", "-", "*" };
+    if(depth <= 0 || D_CorpusBelow(corpus, 3) == 0) {
+        if(names->ints > 0 && D_CorpusBelow(corpus, 2) == 0) {
+            D_CorpusPrintf(corpus, "i%d", (int)D_CorpusBelow(corpus, (uint32_t)names->ints));
+        }
+        else {
+            D_CorpusPrintf(corpus, "%u", D_CorpusBelow(corpus, 1000));
+        }
+        return;
+    }
+    bool group = D_CorpusBelow(corpus, 4) == 0;
+    if(group) D_CorpusPrintf(corpus, "(");
+    D_CorpusIntExpr(corpus, names, depth - 1);
+    D_CorpusPrintf(corpus, " %s ", ops[D_CorpusBelow(corpus, 3)]);
+    D_CorpusIntExpr(corpus, names, depth - 1);
+    if(group) D_CorpusPrintf(corpus, ")");
+}
+
+static void D_CorpusDeclaration(D_Corpus* corpus, D_CorpusNames* names) {
+    const char* mutability = D_CorpusBelow(corpus, 4) == 0 ? "var " : "";
+    switch(D_CorpusBelow(corpus, 4)) {
+        case 0:
+            D_CorpusPrintf(corpus, "%sreal r%d = %u.%02u * %u.5\n", mutability, names->reals++,
+                D_CorpusBelow(corpus, 100), D_CorpusBelow(corpus, 100), D_CorpusBelow(corpus, 10));
+            break;
+        case 1:
+            D_CorpusPrintf(corpus, "%sbool b%d = %s\n", mutability, names->others++,
+                D_CorpusBelow(corpus, 2) ? "true" : "false");
+            break;
+        default:
+            D_CorpusPrintf(corpus, "%sint i%d = ", mutability, names->ints);
+            D_CorpusIntExpr(corpus, names, 3);
+            D_CorpusPrintf(corpus, "\n");
+            names->ints++;
+            break;
+    }
+}
+
+static void D_CorpusStruct(D_Corpus* corpus, D_CorpusNames* names) {
+    D_CorpusPrintf(corpus, "struct Record%d {\n", names->others++);
+    int fields = 2 + (int)D_CorpusBelow(corpus, 5);
+    for(int f = 0; f < fields; f++) {
+        static const char* const access[] = { "", "readonly ", "private " };
+        const char* prefix = access[D_CorpusBelow(corpus, 3)];
+        switch(D_CorpusBelow(corpus, 3)) {
+            case 0: D_CorpusPrintf(corpus, "    %sstring field%d = \"N/A\"\n", prefix, f); break;
+            case 1: D_CorpusPrintf(corpus, "    %sint field%d = %u\n", prefix, f, D_CorpusBelow(corpus, 10000)); break;
+            default: D_CorpusPrintf(corpus, "    %sreal field%d = %u.25\n", prefix, f, D_CorpusBelow(corpus, 100)); break;
+        }
+    }
+    D_CorpusPrintf(corpus, "}\n");
+}
+
+static void D_CorpusFunction(D_Corpus* corpus, D_CorpusNames* names) {
+    D_CorpusPrintf(corpus, "fun compute%d(int a, int b : int) {\n", names->others++);
+    int statements = 1 + (int)D_CorpusBelow(corpus, 6);
+    for(int s = 0; s < statements; s++) {
+        D_CorpusPrintf(corpus, "    int t%d = a %s b * %u\n", s,
+            D_CorpusBelow(corpus, 2) ? "+" : "-", D_CorpusBelow(corpus, 100));
+    }
+    D_CorpusPrintf(corpus, "    return t%d\n}\n", statements - 1);
+}
+
+static void D_CorpusComment(D_Corpus* corpus) {
+    if(D_CorpusBelow(corpus, 3) == 0) {
+        D_CorpusPrintf(corpus, "(#\n");
+        int lines = 2 + (int)D_CorpusBelow(corpus, 8);
+        for(int l = 0; l < lines; l++) {
+            D_CorpusPrintf(corpus, "    ");
+            D_CorpusWords(corpus, 4 + (int)D_CorpusBelow(corpus, 12));
+            D_CorpusPrintf(corpus, "\n");
+        }
+        D_CorpusPrintf(corpus, "#)\n");
+    }
+    else {
+        D_CorpusPrintf(corpus, "# ");
+        D_CorpusWords(corpus, 3 + (int)D_CorpusBelow(corpus, 14));
+        D_CorpusPrintf(corpus, "\n");
+    }
+}
+
+static void D_CorpusString(D_Corpus* corpus, D_CorpusNames* names) {
+    D_CorpusPrintf(corpus, "string s%d = \"", names->others++);
+    int words = 10 + (int)D_CorpusBelow(corpus, 150);
+    for(int w = 0; w < words; w++) {
+        D_CorpusWords(corpus, 1);
+        D_CorpusPrintf(corpus, (D_CorpusBelow(corpus, 25) == 0) ? "\n" : " ");
+    }
+    D_CorpusPrintf(corpus, "\"\n");
+}
+
+// Caps the number of globals, later statements reuse them.
+#define DRG_CORPUS_ARITH_NAMES 4096
+
+// Declarations, assignments and prints over ints and reals only,
+// so the whole corpus compiles in register form too.
+static void D_CorpusArithmetic(D_Corpus* corpus, D_CorpusNames* names, bool quiet) {
+    uint32_t pick = D_CorpusBelow(corpus, 8);
+    bool full = names->ints + names->reals >= DRG_CORPUS_ARITH_NAMES;
+    if(names->ints == 0 || (!full && pick < 3)) {
+        D_CorpusPrintf(corpus, "var int i%d = ", names->ints);
+        D_CorpusIntExpr(corpus, names, 3);
+        D_CorpusPrintf(corpus, "\n");
+        names->ints++;
+    }
+    else if(!full && pick == 3) {
+        if(names->reals > 0) {
+            D_CorpusPrintf(corpus, "real r%d = r%d * %u.5 - %u.25\n", names->reals,
+                (int)D_CorpusBelow(corpus, (uint32_t)names->reals),
+                D_CorpusBelow(corpus, 10), D_CorpusBelow(corpus, 100));
+        }
+        else {
+            D_CorpusPrintf(corpus, "real r0 = %u.%02u\n",
+                D_CorpusBelow(corpus, 100), D_CorpusBelow(corpus, 100));
+        }
+        names->reals++;
+    }
+    else if(pick == 7 && !quiet) {
+        D_CorpusPrintf(corpus, "print(");
+        D_CorpusIntExpr(corpus, names, 2);
+        D_CorpusPrintf(corpus, ")\n");
+    }
+    else {
+        D_CorpusPrintf(corpus, "i%d = ", (int)D_CorpusBelow(corpus, (uint32_t)names->ints));
+        D_CorpusIntExpr(corpus, names, 3);
+        D_CorpusPrintf(corpus, "\n");
+    }
+}
+
+/*****************************************************************
+* Generator
+*****************************************************************/
+
+// Mixed kinds start a new program past this size, or once this
+// many structs, functions and such are named, since a compile only
+// takes so many structs.
+#define DRG_CORPUS_PROGRAM_BYTES (32 * 1024)
+#define DRG_CORPUS_PROGRAM_NAMES 64
+
+void D_CorpusGenerate(D_Corpus* corpus, size_t targetBytes, uint32_t seed, unsigned kinds) {
+    corpus->data = NULL;
+    corpus->length = 0;
+    corpus->capacity = 0;
+    corpus->lines = 0;
+    corpus->programs = NULL;
+    corpus->programCount = 0;
+    corpus->programCapacity = 0;
+    corpus->rng = seed ? seed : 1; // xorshift can't leave 0
+    D_CorpusReserve(corpus, targetBytes + 4096);
+    corpus->data[0] = '\0';
+
+    D_CorpusNames names = { 0, 0, 0 };
+    D_CorpusStartProgram(corpus);
+    if(kinds & D_CorpusKind_ARITHMETIC) {
+        while(corpus->length < targetBytes) {
+            D_CorpusArithmetic(corpus, &names, (kinds & D_CorpusKind_QUIET) != 0);
+        }
+        return;
+    }
+    if(0 == (kinds & D_CorpusKind_ALL)) {
+        kinds = D_CorpusKind_ALL;
+    }
+    while(corpus->length < targetBytes) {
+        D_CorpusKind kind = (D_CorpusKind)(1u << D_CorpusBelow(corpus, 5));
+        if(0 == (kinds & kind)) {
+            continue;
+        }
+        if(corpus->length - corpus->programs[corpus->programCount - 1] >= DRG_CORPUS_PROGRAM_BYTES ||
+            names.others >= DRG_CORPUS_PROGRAM_NAMES) {
+            D_CorpusStartProgram(corpus);
+            names = (D_CorpusNames){ 0, 0, 0 };
+        }
+        switch(kind) {
+            case D_CorpusKind_DECLARATIONS: D_CorpusDeclaration(corpus, &names); break;
+            case D_CorpusKind_STRUCTS:      D_CorpusStruct(corpus, &names); break;
+            case D_CorpusKind_FUNCTIONS:    D_CorpusFunction(corpus, &names); break;
+            case D_CorpusKind_COMMENTS:     D_CorpusComment(corpus); break;
+            case D_CorpusKind_STRINGS:      D_CorpusString(corpus, &names); break;
+            default: break;
+        }
+    }
+}
+
+void D_CorpusFree(D_Corpus* corpus) {
+    free(corpus->data);
+    free(corpus->programs);
+    corpus->data = NULL;
+    corpus->length = 0;
+    corpus->capacity = 0;
+    corpus->programs = NULL;
+    corpus->programCount = 0;
+    corpus->programCapacity = 0;
+}
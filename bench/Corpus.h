@@ -0,0 +1,61 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file Corpus.h
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Deterministic generator of synthetic Dargon source, used to
+* benchmark the front end. The same seed and size always give
+* the same bytes.
+*
+*****************************************************************/
+
+#ifndef DRG_H_CORPUS
+#define DRG_H_CORPUS
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Constructs the generator can emit (bit flags).
+typedef enum {
+    D_CorpusKind_DECLARATIONS = 1 << 0, // int a = 1 + 2 * b
+    D_CorpusKind_STRUCTS      = 1 << 1, // struct P { readonly string s }
+    D_CorpusKind_FUNCTIONS    = 1 << 2, // fun f(int a : int) { ... }
+    D_CorpusKind_COMMENTS     = 1 << 3, // # ... and (# ... #)
+    D_CorpusKind_STRINGS      = 1 << 4, // string s = "<long literal>"
+    D_CorpusKind_ALL          = (1 << 5) - 1,
+    // Only what the register form compiles; overrides the others
+    D_CorpusKind_ARITHMETIC   = 1 << 5, // var int i = i0 * 3, print(i)
+    D_CorpusKind_QUIET        = 1 << 6  // with ARITHMETIC: no print()
+} D_CorpusKind;
+
+/// @brief A generated source.
+typedef struct {
+    char* data;         // malloc'd, null-terminated
+    size_t length;      // bytes, excluding the terminator
+    size_t capacity;
+    int lines;
+    size_t* programs;   // offset each independent program starts at
+    int programCount;
+    int programCapacity;
+    uint32_t rng;       // generator state
+} D_Corpus;
+
+/// @brief Generates at least 'targetBytes' of source. Mixed kinds
+/// come as a run of independent programs, each declaring its own
+/// names, so a compiler can take them one at a time without any
+/// one program outgrowing its limits.
+/// @param corpus Output, release with D_CorpusFree().
+/// @param targetBytes Approximate size, stops after the
+/// construct that crosses it.
+/// @param seed Any value; equal seeds give equal output.
+/// @param kinds OR'd D_CorpusKind flags, at least one.
+void D_CorpusGenerate(D_Corpus* corpus, size_t targetBytes, uint32_t seed, unsigned kinds);
+
+/// @brief Frees a generated corpus.
+/// @param corpus 
+void D_CorpusFree(D_Corpus* corpus);
+
+#endif // DRG_H_CORPUS
@@ -0,0 +1,357 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file bench.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Front-end throughput benchmark. Generates a synthetic corpus,
+* runs each front-end stage over it a few times, and prints the
+* best run of each as JSON on stdout.
+*
+* Usage: dargon-bench [--size MB] [--seed N] [--iterations N]
+*                     [--kinds decl,struct,fun,comment,string,arith]
+*                     [--dump PATH]
+*
+* The scanner and compiler stages run over the corpus picked by
+* --kinds, the compiler one program of it at a time. The vm stages
+* run an arithmetic corpus of the same size, without print(),
+* compiled to the stack form, the stack form with -O, and the
+* register form, side by side.
+*
+*****************************************************************/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Corpus.h"
+#include "compiler/Compiler.h"
+#include "scanner/Scanner.h"
+#include "scanner/ScannerSimd.h"
+#include "util/Version.h"
+#include "vm/VM.h"
+
+typedef struct {
+    double sizeMB;
+    uint32_t seed;
+    int iterations;
+    unsigned kinds;
+    const char* dumpPath;
+} D_BenchOptions;
+
+// Best run of one stage.
+typedef struct {
+    const char* name;
+    const D_Corpus* corpus;
+    double seconds;
+    long tokens;        // or whatever 'unit' says was processed
+    const char* unit;
+} D_BenchResult;
+
+// A corpus compiled ahead of time, for the vm stages.
+typedef struct {
+    int count;
+    drgNugget* nuggets;
+    int* globalCounts;  // globals each nugget was compiled against
+    long instructions;  // per run; the code has no branches
+} D_BenchProgram;
+
+// The vm stages' input is cut into pieces this big (at a newline),
+// each compiled into its own nugget against shared globals, as a
+// REPL would, and keeps what they repeat small.
+#define DRG_BENCH_COMPILE_PIECE 512
+
+// Each piece is run this many times in a row, so the vm stages
+// measure dispatch rather than fetching cold bytecode.
+#define DRG_BENCH_VM_REPEAT 16
+
+/*****************************************************************
+* Stages
+*****************************************************************/
+
+static double D_Now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// One token at a time through D_ScannerNext().
+static long D_BenchScannerNext(const void* input) {
+    const D_Corpus* corpus = (const D_Corpus*)input;
+    D_ScannerCtx ctx;
+    D_ScannerInit(&ctx, corpus->data, corpus->length);
+    long tokens = 0;
+    for(;;) {
+        D_Token token = D_ScannerNext(&ctx);
+        tokens++;
+        if(token.type == D_TokenType_EOF) {
+            return tokens;
+        }
+    }
+}
+
+// Whole source into a packed D_TokenStream.
+static long D_BenchTokenizeAll(const void* input) {
+    const D_Corpus* corpus = (const D_Corpus*)input;
+    D_TokenStream stream;
+    D_TokenStreamInit(&stream);
+    long tokens = D_TokenizeAll(corpus->data, corpus->length, &stream);
+    D_TokenStreamFree(&stream);
+    return tokens;
+}
+
+// End of the vm piece starting at 'at'.
+static const char* D_BenchPieceEnd(const char* at, const char* end) {
+    const char* cut = at + DRG_BENCH_COMPILE_PIECE;
+    if(cut >= end) {
+        return end;
+    }
+    while(cut < end && *cut != '\n') cut++;
+    return cut;
+}
+
+// Source to bytecode, each program of the corpus on its own.
+// Returns the bytes of bytecode emitted, -1 if anything failed to
+// compile.
+static long D_BenchCompile(const void* input) {
+    const D_Corpus* corpus = (const D_Corpus*)input;
+    long emitted = 0;
+    for(int i = 0; i < corpus->programCount; i++) {
+        size_t start = corpus->programs[i];
+        size_t end = i + 1 < corpus->programCount ? corpus->programs[i + 1] : corpus->length;
+        D_GlobalTable globals;
+        D_GlobalTableInit(&globals);
+        drgNugget nugget;
+        drgNuggetInit(&nugget);
+        bool ok = D_Compile(corpus->data + start, end - start, &globals, &nugget, D_CompileFlag_NONE);
+        emitted += nugget.count;
+        drgNuggetFree(&nugget);
+        D_GlobalTableFree(&globals);
+        if(!ok) {
+            return -1;
+        }
+    }
+    return emitted;
+}
+
+static bool D_BenchProgramCompile(D_BenchProgram* program, const D_Corpus* corpus, unsigned flags) {
+    program->count = 0;
+    program->nuggets = NULL;
+    program->globalCounts = NULL;
+    program->instructions = 0;
+    int capacity = 0;
+    D_GlobalTable globals;
+    D_GlobalTableInit(&globals);
+    bool ok = true;
+    const char* at = corpus->data;
+    const char* end = corpus->data + corpus->length;
+    while(ok && at < end) {
+        const char* cut = D_BenchPieceEnd(at, end);
+        if(program->count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            program->nuggets = (drgNugget*)realloc(program->nuggets, sizeof(drgNugget) * (size_t)capacity);
+            program->globalCounts = (int*)realloc(program->globalCounts, sizeof(int) * (size_t)capacity);
+            if(NULL == program->nuggets || NULL == program->globalCounts) {
+                perror("D_BenchProgramCompile: realloc() failed!");
+                exit(EXIT_FAILURE);
+            }
+        }
+        drgNugget* nugget = &program->nuggets[program->count];
+        drgNuggetInit(nugget);
+        ok = D_Compile(at, (size_t)(cut - at), &globals, nugget, flags);
+        program->globalCounts[program->count++] = globals.count;
+        for(int offset = 0; offset < nugget->count; offset += drgInstructionLength(nugget->bytecode[offset])) {
+            program->instructions++;
+        }
+        at = cut;
+    }
+    D_GlobalTableFree(&globals);
+    return ok;
+}
+
+static void D_BenchProgramFree(D_BenchProgram* program) {
+    for(int i = 0; i < program->count; i++) {
+        drgNuggetFree(&program->nuggets[i]);
+    }
+    free(program->nuggets);
+    free(program->globalCounts);
+}
+
+// Runs every nugget of a compiled program. Returns the number of
+// instructions dispatched, -1 on a runtime error.
+static long D_BenchRun(const void* input) {
+    const D_BenchProgram* program = (const D_BenchProgram*)input;
+    for(int i = 0; i < program->count; i++) {
+        for(int r = 0; r < DRG_BENCH_VM_REPEAT; r++) {
+            if(D_Result_OK != D_RunNugget(&program->nuggets[i], program->globalCounts[i])) {
+                return -1;
+            }
+        }
+    }
+    return program->instructions * DRG_BENCH_VM_REPEAT;
+}
+
+typedef long (*D_BenchStage)(const void* input);
+
+static D_BenchResult D_RunStage(const char* name, D_BenchStage stage, const void* input,
+    const D_Corpus* corpus, int iterations) {
+    D_BenchResult result = { name, corpus, 0.0, 0, "tokens" };
+    for(int i = 0; i < iterations; i++) {
+        double start = D_Now();
+        long tokens = stage(input);
+        double elapsed = D_Now() - start;
+        if(0 == i || elapsed < result.seconds) {
+            result.seconds = elapsed;
+        }
+        result.tokens = tokens;
+    }
+    return result;
+}
+
+/*****************************************************************
+* Options
+*****************************************************************/
+
+static unsigned D_ParseKinds(const char* list) {
+    static const struct { const char* name; D_CorpusKind kind; } names[] = {
+        { "decl", D_CorpusKind_DECLARATIONS },
+        { "struct", D_CorpusKind_STRUCTS },
+        { "fun", D_CorpusKind_FUNCTIONS },
+        { "comment", D_CorpusKind_COMMENTS },
+        { "string", D_CorpusKind_STRINGS },
+        { "arith", D_CorpusKind_ARITHMETIC },
+    };
+    unsigned kinds = 0;
+    for(size_t n = 0; n < sizeof(names) / sizeof(names[0]); n++) {
+        if(strstr(list, names[n].name)) {
+            kinds |= names[n].kind;
+        }
+    }
+    return kinds;
+}
+
+static void D_BenchUsage(void) {
+    fprintf(stderr,
+        "Usage: dargon-bench [--size MB] [--seed N] [--iterations N]\n"
+        "                    [--kinds decl,struct,fun,comment,string,arith]\n"
+        "                    [--dump PATH]\n");
+}
+
+static bool D_ParseOptions(int argc, const char* argv[], D_BenchOptions* options) {
+    options->sizeMB = 16.0;
+    options->seed = 1;
+    options->iterations = 5;
+    options->kinds = D_CorpusKind_ALL;
+    options->dumpPath = NULL;
+    for(int i = 1; i < argc; i++) {
+        if(i + 1 >= argc) {
+            return false;
+        }
+        const char* value = argv[++i];
+        if(0 == strcmp(argv[i - 1], "--size")) options->sizeMB = atof(value);
+        else if(0 == strcmp(argv[i - 1], "--seed")) options->seed = (uint32_t)strtoul(value, NULL, 10);
+        else if(0 == strcmp(argv[i - 1], "--iterations")) options->iterations = atoi(value);
+        else if(0 == strcmp(argv[i - 1], "--kinds")) options->kinds = D_ParseKinds(value);
+        else if(0 == strcmp(argv[i - 1], "--dump")) options->dumpPath = value;
+        else return false;
+    }
+    return options->sizeMB > 0.0 && options->iterations > 0 && options->kinds != 0;
+}
+
+/*****************************************************************
+* Main
+*****************************************************************/
+
+static void D_PrintResult(const D_BenchResult* result, bool last) {
+    double seconds = result->seconds > 0.0 ? result->seconds : 1e-9;
+    printf("    {\"name\": \"%s\", \"seconds\": %.6f, \"%s\": %ld, "
+        "\"mb_per_s\": %.2f, \"%s_per_s\": %.0f}%s\n",
+        result->name, result->seconds, result->unit, result->tokens,
+        (double)result->corpus->length / (1024.0 * 1024.0) / seconds,
+        result->unit, (double)result->tokens / seconds, last ? "" : ",");
+}
+
+int main(int argc, const char* argv[]) {
+    D_BenchOptions options;
+    if(!D_ParseOptions(argc, argv, &options)) {
+        D_BenchUsage();
+        return EXIT_FAILURE;
+    }
+
+    D_Corpus corpus;
+    D_CorpusGenerate(&corpus, (size_t)(options.sizeMB * 1024.0 * 1024.0), options.seed, options.kinds);
+
+    if(NULL != options.dumpPath) {
+        FILE* out = fopen(options.dumpPath, "wb");
+        if(NULL == out) {
+            fprintf(stderr, "dargon-bench: could not write \"%s\"\n", options.dumpPath);
+            D_CorpusFree(&corpus);
+            return EXIT_FAILURE;
+        }
+        fwrite(corpus.data, 1, corpus.length, out);
+        fclose(out);
+        D_CorpusFree(&corpus);
+        return EXIT_SUCCESS;
+    }
+
+    D_Corpus quiet;
+    D_CorpusGenerate(&quiet, corpus.length, options.seed, D_CorpusKind_ARITHMETIC | D_CorpusKind_QUIET);
+
+    D_InitVirtualMachine();
+    D_BenchProgram stackProgram;
+    D_BenchProgram optimizedProgram;
+    D_BenchProgram registerProgram;
+    bool compiled = D_BenchProgramCompile(&stackProgram, &quiet, D_CompileFlag_NONE);
+    compiled = D_BenchProgramCompile(&optimizedProgram, &quiet, D_CompileFlag_OPTIMIZE) && compiled;
+    compiled = D_BenchProgramCompile(&registerProgram, &quiet, D_CompileFlag_REGISTERS) && compiled;
+    // Credited with the unoptimized instructions it does the work
+    // of, so its rate compares with vm.stack's
+    optimizedProgram.instructions = stackProgram.instructions;
+
+    D_BenchResult results[] = {
+        D_RunStage("scanner.next", D_BenchScannerNext, &corpus, &corpus, options.iterations),
+        D_RunStage("scanner.tokenize_all", D_BenchTokenizeAll, &corpus, &corpus, options.iterations),
+        D_RunStage("compiler", D_BenchCompile, &corpus, &corpus, options.iterations),
+        D_RunStage("vm.stack", D_BenchRun, &stackProgram, &quiet, options.iterations),
+        D_RunStage("vm.optimized", D_BenchRun, &optimizedProgram, &quiet, options.iterations),
+        D_RunStage("vm.register", D_BenchRun, &registerProgram, &quiet, options.iterations),
+    };
+    int resultCount = (int)(sizeof(results) / sizeof(results[0]));
+    bool failed = !compiled || results[2].tokens < 0 || results[3].tokens < 0 || results[4].tokens < 0 ||
+        results[5].tokens < 0;
+    D_BenchProgramFree(&stackProgram);
+    D_BenchProgramFree(&optimizedProgram);
+    D_BenchProgramFree(&registerProgram);
+    D_FreeVirtualMachine();
+    if(failed) {
+        fprintf(stderr, "dargon-bench: the corpus failed to compile or run\n");
+        D_CorpusFree(&quiet);
+        D_CorpusFree(&corpus);
+        return EXIT_FAILURE;
+    }
+    // The compiler reports bytecode size, count what it consumed instead
+    results[2].tokens = results[0].tokens;
+    results[3].unit = "instructions";
+    results[4].unit = "instructions";
+    results[5].unit = "instructions";
+
+    printf("{\n");
+    printf("  \"program\": \"%s\",\n", DRG_PROGRAM_NAME);
+    printf("  \"scan_kernels\": \"%s\",\n", D_GetScanKernelsName());
+    printf("  \"iterations\": %d,\n", options.iterations);
+    printf("  \"corpus\": {\"bytes\": %zu, \"lines\": %d, \"seed\": %u, \"kinds\": %u},\n",
+        corpus.length, corpus.lines, options.seed, options.kinds);
+    printf("  \"results\": [\n");
+    for(int i = 0; i < resultCount; i++) {
+        D_PrintResult(&results[i], i == resultCount - 1);
+    }
+    printf("  ]\n}\n");
+
+    D_CorpusFree(&quiet);
+    D_CorpusFree(&corpus);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,283 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file keywordBench.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Microbenchmark: the generated keyword perfect hash against the
+* hand-written switch trie the scanner used before it.
+*
+* Usage: dargon-keyword-bench [lookups]
+*
+*****************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scanner/Token.h"
+#include "KeywordTable.h"
+
+/*****************************************************************
+* The old trie, kept verbatim (bugs included) as the baseline
+*****************************************************************/
+
+typedef struct {
+    const char* start;
+    const char* current;
+} TrieScanner;
+
+static TrieScanner scanner;
+
+static D_TokenType D_CompareWithKeyword(int start, int length, const char* rest, D_TokenType type) {
+    if(scanner.current - scanner.start == start + length && 0 == memcmp(scanner.start + start, rest, length)) {
+        return type;
+    }
+    return D_TokenType_IDENTIFIER;
+}
+
+static D_TokenType D_CheckIfKeywordTrie(void) {
+    switch(scanner.start[0]) {
+        case 'a': {
+            if(scanner.current - scanner.start > 1) {
+                switch(scanner.start[1]) {
+                    case 'l': return D_CompareWithKeyword(2, 3, "ias", D_TokenType_KW_alias);
+                    case 'n': return D_CompareWithKeyword(2, 1, "d", D_TokenType_KW_and);
+                }
+            }
+            break;
+        }
+        case 'b': return D_CompareWithKeyword(1, 3, "ool", D_TokenType_KW_bool);
+        case 'c': return D_CompareWithKeyword(1, 3, "opy", D_TokenType_KW_copy);
+        case 'd': return D_CompareWithKeyword(1, 4, "efer", D_TokenType_KW_defer);
+        case 'e': {
+            if(scanner.current - scanner.start > 1) {
+                switch(scanner.start[1]) {
+                    case 'l': return D_CompareWithKeyword(2, 2, "se", D_TokenType_KW_else);
+                    case 'q': return D_TokenType_KW_eq;
+                    case 'x': {
+                        if(scanner.current - scanner.start > 2) {
+                            switch(scanner.start[2]) {
+                                case 'i': return D_CompareWithKeyword(3, 3, "sts", D_TokenType_KW_exists);
+                                case 'p': return D_CompareWithKeyword(3, 3, "ort", D_TokenType_KW_export);
+                            }
+                        }
+                        break;
+                    }
+                }
+            }
+            break;
+        }
+        case 'f': {
+            if(scanner.current - scanner.start > 1) {
+                switch(scanner.start[1]) {
+                    case 'a': return D_CompareWithKeyword(2, 3, "lse", D_TokenType_KW_false);
+                    case 'u': return D_CompareWithKeyword(2, 1, "n", D_TokenType_KW_fun);
+                }
+            }
+            break;
+        }
+        case 'i': {
+            if(scanner.current - scanner.start > 1) {
+                switch(scanner.start[1]) {
+                    case 'f': return D_TokenType_KW_if;
+                    case 'n': return D_CompareWithKeyword(2, 1, "t", D_TokenType_KW_int);
+                    case 's': return D_TokenType_KW_is;
+                }
+            }
+            break;
+        }
+        case 'l': return D_CompareWithKeyword(1, 3, "oop", D_TokenType_KW_loop);
+        case 'm': return D_CompareWithKeyword(1, 5, "odule", D_TokenType_KW_module);
+        case 'n': {
+            if(scanner.current - scanner.start > 1) {
+                switch(scanner.start[1]) {
+                    case 'e': return D_CompareWithKeyword(2, 1, "q", D_TokenType_KW_neq);
+                    case 'o': return D_CompareWithKeyword(2, 1, "t", D_TokenType_KW_not);
+                }
+            }
+            break;
+        }
+        case 'o': return D_CompareWithKeyword(1, 1, "r", D_TokenType_KW_or);
+        case 'p': return D_CompareWithKeyword(1, 6, "rivate", D_TokenType_KW_private);
+        case 'r': {
+            if(scanner.current - scanner.start > 2 && scanner.start[1] == 'e') {
+                switch(scanner.start[2]) {
+                    case 'a': {
+                        if(scanner.current - scanner.start > 3) {
+                            switch(scanner.start[3]) {
+                                case 'd': return D_CompareWithKeyword(4, 4, "only", D_TokenType_KW_readonly);
+                                case 'l': return D_TokenType_KW_real;
+                            }
+                        }
+                        break;
+                    }
+                }
+            }
+            break;
+        }
+        case 's': {
+            if(scanner.current - scanner.start > 3 && scanner.start[1] == 't' && scanner.start[2] == 'r') {
+                switch(scanner.start[3]) {
+                    case 'i': return D_CompareWithKeyword(4, 2, "ng", D_TokenType_KW_string);
+                    case 'u': return D_CompareWithKeyword(4, 2, "ct", D_TokenType_KW_struct);
+                }
+            }
+            break;
+        }
+        case 't': {
+            if(scanner.current - scanner.start > 1) {
+                switch(scanner.start[1]) {
+                    case 'h': return D_CompareWithKeyword(2, 2, "en", D_TokenType_KW_then);
+                    case 'r': {
+                        if(scanner.current - scanner.start > 2) {
+                            switch(scanner.start[2]) {
+                                case 'u': return D_CompareWithKeyword(2, 1, "e", D_TokenType_KW_true);
+                                case 'y': return D_TokenType_KW_try;
+                            }
+                        }
+                    }
+                }
+            }
+            break;
+        }
+        case 'v': {
+            if(scanner.current - scanner.start > 1) {
+                switch(scanner.start[1]) {
+                    case 'a': return D_CompareWithKeyword(2, 1, "r", D_TokenType_KW_var);
+                    case 'm': return D_TokenType_KW_vm;
+                }
+            }
+            break;
+        }
+        case 'w': return D_CompareWithKeyword(1, 3, "hen", D_TokenType_KW_when);
+        case 'x': return D_CompareWithKeyword(1, 2, "or", D_TokenType_KW_xor);
+    }
+    return D_TokenType_IDENTIFIER;
+}
+
+static D_TokenType D_LookupTrie(const char* start, int length) {
+    scanner.start = start;
+    scanner.current = start + length;
+    return D_CheckIfKeywordTrie();
+}
+
+/*****************************************************************
+* Corpus
+*****************************************************************/
+
+#define DRG_BENCH_WORDS 4096
+
+typedef struct {
+    const char* start;
+    int length;
+} Word;
+
+static char wordText[DRG_BENCH_WORDS * 16];
+static Word words[DRG_BENCH_WORDS];
+
+static uint32_t rngState = 0x9E3779B9u;
+static uint32_t nextRandom(void) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+// Roughly a quarter keywords, the rest identifiers (some of them
+// sharing a keyword's prefix), as in typical Dargon code.
+static void buildCorpus(void) {
+    static const char* prefixed[] = { "island", "integer", "realm", "vmx", "iffy", "eqn", "truest", "format" };
+    static const char alnum[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789";
+    char* at = wordText;
+    for(int i = 0; i < DRG_BENCH_WORDS; i++) {
+        uint32_t pick = nextRandom() % 8;
+        const char* text;
+        int length;
+        char generated[16];
+        if(pick < 2) {
+            const D_KeywordEntry* entry = &D_KeywordTable[nextRandom() % DRG_KW_COUNT];
+            text = entry->text;
+            length = entry->length;
+        }
+        else if(pick < 3) {
+            text = prefixed[nextRandom() % (sizeof(prefixed) / sizeof(prefixed[0]))];
+            length = (int)strlen(text);
+        }
+        else {
+            length = 1 + (int)(nextRandom() % 12);
+            generated[0] = alnum[nextRandom() % 53]; // no leading digit
+            for(int c = 1; c < length; c++) {
+                generated[c] = alnum[nextRandom() % (sizeof(alnum) - 1)];
+            }
+            text = generated;
+        }
+        memcpy(at, text, (size_t)length);
+        words[i].start = at;
+        words[i].length = length;
+        at += length;
+    }
+}
+
+/*****************************************************************
+* Main
+*****************************************************************/
+
+static double nowSeconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+typedef D_TokenType (*LookupFn)(const char*, int);
+
+static double timeLookups(LookupFn lookup, long lookups, long* checksum) {
+    long sum = 0;
+    double start = nowSeconds();
+    for(long i = 0; i < lookups; i++) {
+        const Word* w = &words[i & (DRG_BENCH_WORDS - 1)];
+        sum += lookup(w->start, w->length);
+    }
+    double elapsed = nowSeconds() - start;
+    *checksum = sum;
+    return elapsed;
+}
+
+int main(int argc, const char* argv[]) {
+    long lookups = (argc > 1) ? atol(argv[1]) : 50000000L;
+    if(lookups <= 0) {
+        fprintf(stderr, "Usage: dargon-keyword-bench [lookups]\n");
+        return EXIT_FAILURE;
+    }
+    buildCorpus();
+
+    // The hash must get every keyword right, and only keywords
+    for(int i = 0; i < DRG_KW_COUNT; i++) {
+        const D_KeywordEntry* entry = &D_KeywordTable[i];
+        if(D_LookupKeyword(entry->text, entry->length) != entry->type) {
+            fprintf(stderr, "FAIL: keyword '%s' not recognized\n", entry->text);
+            return EXIT_FAILURE;
+        }
+    }
+    int disagreements = 0;
+    for(int i = 0; i < DRG_BENCH_WORDS; i++) {
+        if(D_LookupTrie(words[i].start, words[i].length) != D_LookupKeyword(words[i].start, words[i].length)) {
+            disagreements++;
+        }
+    }
+
+    long trieSum, hashSum;
+    double trieTime = timeLookups(D_LookupTrie, lookups, &trieSum);
+    double hashTime = timeLookups(D_LookupKeyword, lookups, &hashSum);
+
+    printf("lookups:       %ld\n", lookups);
+    printf("trie:          %.2f ns/lookup (checksum %ld)\n", trieTime * 1e9 / (double)lookups, trieSum);
+    printf("perfect hash:  %.2f ns/lookup (checksum %ld)\n", hashTime * 1e9 / (double)lookups, hashSum);
+    printf("speedup:       %.2fx\n", trieTime / hashTime);
+    printf("disagreements: %d of %d corpus words (trie bugs)\n", disagreements, DRG_BENCH_WORDS);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,2831 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file Compiler.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Single-pass Pratt compiler. Each expression is parsed by the
+* function registered for its leading token (prefix), and
+* operators are folded in by precedence (infix), emitting
+* bytecode as soon as each piece is recognized.
+*
+*****************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Compiler.h"
+#include "Optimizer.h"
+#include "../scanner/Scanner.h"
+#include "../util/Arena.h"
+#include "../util/Log.h"
+#include "../util/drgMemUtil.h"
+#include "../vm/drgArray.h"
+#include "../vm/drgMap.h"
+#include "../vm/drgIntern.h"
+#include "../vm/drgObject.h"
+#include "../vm/drgStruct.h"
+
+// Operands that index globals are 2 bytes wide
+#define DRG_GLOBALS_MAX (UINT16_MAX + 1)
+// Deepest expression the register form can track
+#define DRG_OPERANDS_MAX 256
+// Local slots and argument counts are 1 byte wide
+#define DRG_LOCALS_MAX (UINT8_MAX + 1)
+#define DRG_ARGS_MAX UINT8_MAX
+// Deepest nesting of expressions and blocks, well short of
+// running out of C stack
+#define DRG_PARSE_DEPTH_MAX 4096
+// Longest dotted name, e.g. of a module
+#define DRG_NAME_MAX 256
+// Struct types, and the struct array types after them
+#define DRG_STRUCTS_MAX DRG_STRUCT_TYPES
+// Constants pushed in a row that folding keeps track of
+#define DRG_FOLD_DEPTH 16
+
+/*****************************************************************
+* Types
+*****************************************************************/
+
+typedef struct {
+    drgString* name;    // interned, NULL for slot 0
+    D_TypeSpec type;
+    bool isMutable;
+    int depth;          // scope depth it was declared at
+} D_Local;
+
+// The function being compiled. Its locals live in its call frame,
+// slot 0 being the function itself.
+typedef struct D_FunctionState {
+    struct D_FunctionState* enclosing;
+    drgFunction* function;  // NULL for the top-level code
+    drgNugget* nugget;
+    bool hasReturnType;
+    D_TypeSpec returnType;
+    D_Local locals[DRG_LOCALS_MAX];
+    int localCount;
+    int scopeDepth;     // 0 is the top level, where names are globals
+    int stackDepth;     // values on the stack at this point
+    int lastTarget;     // offset the latest jump lands on
+} D_FunctionState;
+
+// A constant pushed by the code at [start, end), with the line
+// table as it was before, so folding can take it back out.
+typedef struct {
+    drgVal value;
+    int start;
+    int end;
+    drgLineTable lines; // only the count and the newest entry matter
+} D_Constant;
+
+typedef struct {
+    D_ScannerCtx scanner;
+    D_Token current;
+    D_Token previous;
+    bool hadError;
+    bool panicMode;     // suppresses errors until the next statement
+    int nesting;        // open parens; newlines inside them are ignored
+    int parseDepth;     // recursion of the parse functions
+    D_GlobalTable* globals;
+    D_FunctionState* fn;
+    drgNugget* nugget;  // c->fn->nugget
+    D_Arena arena;      // whatever only lives as long as the compile
+    unsigned flags;     // D_CompileFlag
+    drgType type;       // of the value the last expression left
+    int callee;         // the global function it is, if that's known
+                        // and the type is DRG_TYPE_FUN, else -1
+    bool isConstant;    // it's a variable declared without 'var'
+    bool returns;       // the last statement never goes on past its end
+    D_TypeSpec expect;  // what the expression being parsed is going
+                        // to be, for an array literal to take after
+    int markLine;       // position of 'previous' when last recorded,
+    int markColumn;     // -1 to record the next one regardless
+    // Register form only
+    uint16_t operands[DRG_OPERANDS_MAX]; // slots of the pending values
+    int operandCount;
+    int tempCount;      // temporaries in use
+    int lastDst;        // offset of the last dst operand, -1 if none
+    // D_CompileFlag_OPTIMIZE only
+    D_Constant pushes[DRG_FOLD_DEPTH]; // the run of constants just
+    int pushCount;                     // pushed, newest last
+} D_Compiler;
+
+typedef enum {
+    D_Prec_NONE,
+    D_Prec_ASSIGNMENT,  // =
+    D_Prec_OR,          // or
+    D_Prec_AND,         // and
+    D_Prec_EQUALITY,    // eq neq
+    D_Prec_COMPARISON,  // < > <= >=
+    D_Prec_TERM,        // + -
+    D_Prec_FACTOR,      // * /
+    D_Prec_UNARY,       // - not
+    D_Prec_CALL,        // ()
+    D_Prec_PRIMARY
+} D_Precedence;
+
+typedef void (*D_ParseFn)(D_Compiler* c, bool canAssign);
+
+typedef struct {
+    D_ParseFn prefix;
+    D_ParseFn infix;
+    D_Precedence precedence;
+} D_ParseRule;
+
+/*****************************************************************
+* Global Table
+*****************************************************************/
+
+void D_GlobalTableInit(D_GlobalTable* globals) {
+    globals->count = 0;
+    globals->capacity = 0;
+    globals->symbols = NULL;
+    globals->indexCapacity = 0;
+    globals->index = NULL;
+    globals->moduleName = NULL;
+    globals->includeCount = 0;
+    globals->includeCapacity = 0;
+    globals->includes = NULL;
+    globals->paramCount = 0;
+    globals->paramCapacity = 0;
+    globals->params = NULL;
+    globals->structCount = 0;
+    globals->structCapacity = 0;
+    globals->structs = NULL;
+    globals->fieldCount = 0;
+    globals->fieldCapacity = 0;
+    globals->structFields = NULL;
+}
+
+void D_GlobalTableFree(D_GlobalTable* globals) {
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_COMPILER, D_GlobalSymbol, globals->symbols, globals->capacity);
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_COMPILER, int, globals->index, globals->indexCapacity);
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_COMPILER, drgModule*, globals->includes, globals->includeCapacity);
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_COMPILER, D_Param, globals->params, globals->paramCapacity);
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_COMPILER, D_StructDecl, globals->structs, globals->structCapacity);
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_COMPILER, D_StructField, globals->structFields, globals->fieldCapacity);
+    D_GlobalTableInit(globals);
+}
+
+// Names are interned, so a match is the same pointer.
+static int D_GlobalTableFind(D_GlobalTable* globals, const drgString* name) {
+    if(0 == globals->indexCapacity) {
+        return -1;
+    }
+    uint32_t mask = (uint32_t)globals->indexCapacity - 1;
+    for(uint32_t i = name->hash & mask;; i = (i + 1) & mask) {
+        int slot = globals->index[i];
+        if(slot < 0) {
+            return -1;
+        }
+        if(globals->symbols[slot].name == name) {
+            return slot;
+        }
+    }
+}
+
+static void D_GlobalTableIndex(D_GlobalTable* globals, int slot) {
+    uint32_t mask = (uint32_t)globals->indexCapacity - 1;
+    uint32_t i = globals->symbols[slot].name->hash & mask;
+    while(globals->index[i] >= 0) {
+        i = (i + 1) & mask;
+    }
+    globals->index[i] = slot;
+}
+
+static int D_GlobalTableAdd(D_GlobalTable* globals, const D_GlobalSymbol* symbol) {
+    if(globals->capacity < globals->count + 1) {
+        int capacity = DRG_MEM_GROW_CAPACITY(globals->capacity);
+        globals->symbols = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_COMPILER, D_GlobalSymbol, globals->symbols, globals->capacity, capacity);
+        globals->capacity = capacity;
+    }
+    int slot = globals->count++;
+    globals->symbols[slot] = *symbol;
+
+    // Keep the index at most half full
+    if(globals->indexCapacity < globals->count * 2) {
+        int capacity = (globals->indexCapacity < 16) ? 16 : globals->indexCapacity * 2;
+        globals->index = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_COMPILER, int, globals->index, globals->indexCapacity, capacity);
+        globals->indexCapacity = capacity;
+        memset(globals->index, -1, sizeof(int) * (size_t)globals->indexCapacity);
+        for(int i = 0; i < globals->count; i++) {
+            D_GlobalTableIndex(globals, i);
+        }
+    }
+    else {
+        D_GlobalTableIndex(globals, slot);
+    }
+    return slot;
+}
+
+D_GlobalMark D_GlobalTableMark(const D_GlobalTable* globals) {
+    D_GlobalMark mark = { globals->count, globals->includeCount,
+        globals->paramCount, globals->structCount, globals->fieldCount, globals->moduleName };
+    return mark;
+}
+
+void D_GlobalTableRollback(D_GlobalTable* globals, D_GlobalMark mark) {
+    if(mark.count < globals->count) {
+        globals->count = mark.count;
+        // Linear probing can't delete, so index what's left anew
+        memset(globals->index, -1, sizeof(int) * (size_t)globals->indexCapacity);
+        for(int i = 0; i < globals->count; i++) {
+            D_GlobalTableIndex(globals, i);
+        }
+    }
+    globals->includeCount = mark.includeCount;
+    globals->paramCount = mark.paramCount;
+    globals->structCount = mark.structCount;
+    globals->fieldCount = mark.fieldCount;
+    globals->moduleName = mark.moduleName;
+}
+
+static void D_GlobalTableAddParam(D_GlobalTable* globals, D_TypeSpec type, bool isMutable) {
+    if(globals->paramCapacity < globals->paramCount + 1) {
+        int capacity = DRG_MEM_GROW_CAPACITY(globals->paramCapacity);
+        globals->params = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_COMPILER, D_Param, globals->params, globals->paramCapacity, capacity);
+        globals->paramCapacity = capacity;
+    }
+    D_Param param = { type, isMutable };
+    globals->params[globals->paramCount++] = param;
+}
+
+static void D_GlobalTableAddField(D_GlobalTable* globals, const D_StructField* field) {
+    if(globals->fieldCapacity < globals->fieldCount + 1) {
+        int capacity = DRG_MEM_GROW_CAPACITY(globals->fieldCapacity);
+        globals->structFields = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_COMPILER, D_StructField, globals->structFields, globals->fieldCapacity, capacity);
+        globals->fieldCapacity = capacity;
+    }
+    globals->structFields[globals->fieldCount++] = *field;
+}
+
+static void D_GlobalTableAddStruct(D_GlobalTable* globals, const D_StructDecl* decl) {
+    if(globals->structCapacity < globals->structCount + 1) {
+        int capacity = DRG_MEM_GROW_CAPACITY(globals->structCapacity);
+        globals->structs = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_COMPILER, D_StructDecl, globals->structs, globals->structCapacity, capacity);
+        globals->structCapacity = capacity;
+    }
+    globals->structs[globals->structCount++] = *decl;
+}
+
+// There are few enough structs to go through them all.
+static int D_GlobalTableFindStruct(const D_GlobalTable* globals, const drgString* name) {
+    for(int i = 0; i < globals->structCount; i++) {
+        if(globals->structs[i].name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*****************************************************************
+* Types
+*****************************************************************/
+
+static drgType D_TypeOfToken(D_TokenType type) {
+    switch(type) {
+        case D_TokenType_KW_int:    return DRG_TYPE_INT;
+        case D_TokenType_KW_real:   return DRG_TYPE_REAL;
+        case D_TokenType_KW_bool:   return DRG_TYPE_BOOL;
+        case D_TokenType_KW_string: return DRG_TYPE_STRING;
+        case D_TokenType_KW_fun:    return DRG_TYPE_FUN;
+        default:                    return DRG_TYPE_NONE;
+    }
+}
+
+static drgType D_TypeOfValue(drgVal value) {
+    if(drgValIsInt(value)) return DRG_TYPE_INT;
+    if(drgValIsReal(value)) return DRG_TYPE_REAL;
+    if(drgValIsBool(value)) return DRG_TYPE_BOOL;
+    if(drgValIsObjType(value, DRG_OBJ_STRING)) return DRG_TYPE_STRING;
+    if(drgValIsObjType(value, DRG_OBJ_FUNCTION)) return DRG_TYPE_FUN;
+    return DRG_TYPE_NONE;
+}
+
+static const char* D_TypeName(D_Compiler* c, drgType type) {
+    switch(type) {
+        case DRG_TYPE_INT:    return "int";
+        case DRG_TYPE_REAL:   return "real";
+        case DRG_TYPE_BOOL:   return "bool";
+        case DRG_TYPE_STRING: return "string";
+        case DRG_TYPE_FUN:    return "fun";
+        case DRG_TYPE_NONE:   return "none";
+        case DRG_TYPE_INT_ARRAY:    return "int[]";
+        case DRG_TYPE_REAL_ARRAY:   return "real[]";
+        case DRG_TYPE_BOOL_ARRAY:   return "bool[]";
+        case DRG_TYPE_STRING_ARRAY: return "string[]";
+        case DRG_TYPE_ANY:    return "any";
+        default: {
+            if(type >= DRG_TYPE_STRUCT_ARRAY) {
+                // A message may name two
+                static char names[2][DRG_NAME_MAX + 3];
+                static int next;
+                char* name = names[next];
+                next = 1 - next;
+                snprintf(name, sizeof(names[0]), "%s[]",
+                    c->globals->structs[type - DRG_TYPE_STRUCT_ARRAY].name->chars);
+                return name;
+            }
+            if(type >= DRG_TYPE_STRUCT) {
+                return c->globals->structs[type - DRG_TYPE_STRUCT].name->chars;
+            }
+            static const char* const maps[16] = {
+                "[int:int]", "[int:real]", "[int:bool]", "[int:string]",
+                "[real:int]", "[real:real]", "[real:bool]", "[real:string]",
+                "[bool:int]", "[bool:real]", "[bool:bool]", "[bool:string]",
+                "[string:int]", "[string:real]", "[string:bool]", "[string:string]"
+            };
+            return maps[type - DRG_TYPE_MAP];
+        }
+    }
+}
+
+static bool D_IsNumberType(drgType type) {
+    return type == DRG_TYPE_INT || type == DRG_TYPE_REAL;
+}
+
+static bool D_IsArrayType(drgType type) {
+    return (type >= DRG_TYPE_INT_ARRAY && type <= DRG_TYPE_STRING_ARRAY) || type >= DRG_TYPE_STRUCT_ARRAY;
+}
+
+// Array types are in the order of their element types, and so are
+// the drgArrayKind values they're stored as. Struct arrays are in
+// the order of the structs.
+static drgType D_ArrayOf(drgType element) {
+    return (drgType)((element >= DRG_TYPE_STRUCT) ? element + DRG_STRUCT_TYPES : DRG_TYPE_INT_ARRAY + element);
+}
+
+static drgType D_ElementOf(drgType array) {
+    return (drgType)((array >= DRG_TYPE_STRUCT_ARRAY) ? array - DRG_STRUCT_TYPES : array - DRG_TYPE_INT_ARRAY);
+}
+
+static bool D_IsMapType(drgType type) {
+    return type >= DRG_TYPE_MAP && type < DRG_TYPE_STRUCT;
+}
+
+static drgType D_MapOf(drgType key, drgType value) {
+    return (drgType)(DRG_TYPE_MAP + key * 4 + value);
+}
+
+static drgType D_KeyOf(drgType map) {
+    return (drgType)((map - DRG_TYPE_MAP) / 4);
+}
+
+static drgType D_ValueOf(drgType map) {
+    return (drgType)((map - DRG_TYPE_MAP) % 4);
+}
+
+static bool D_IsStructType(drgType type) {
+    return type >= DRG_TYPE_STRUCT && type < DRG_TYPE_STRUCT_ARRAY;
+}
+
+static const D_StructDecl* D_StructOf(D_Compiler* c, drgType type) {
+    return &c->globals->structs[type - DRG_TYPE_STRUCT];
+}
+
+static const D_StructField* D_FieldOf(D_Compiler* c, const D_StructDecl* decl, int offset) {
+    return &c->globals->structFields[decl->fields + offset];
+}
+
+// The struct a type name is, or -1 if it's some other name.
+static int D_StructIndex(D_Compiler* c, const D_Token* name) {
+    if(name->type != D_TokenType_IDENTIFIER || 0 == c->globals->structCount) {
+        return -1;
+    }
+    return D_GlobalTableFindStruct(c->globals, drgIntern(name->start, name->length));
+}
+
+static D_TypeSpec D_Spec(drgType type) {
+    D_TypeSpec spec = { type, 0 };
+    return spec;
+}
+
+/*****************************************************************
+* Errors
+*****************************************************************/
+
+static void D_ErrorAt(D_Compiler* c, D_Token* token, const char* message) {
+    if(c->panicMode) return;
+    c->panicMode = true;
+    c->hadError = true;
+    if(token->type == D_TokenType_EOF) {
+        D_LogError("[%d:%d] Error at end: %s", token->line, token->column, message);
+    }
+    else if(token->type == D_TokenType_NEWLINE) {
+        D_LogError("[%d:%d] Error at end of line: %s", token->line, token->column, message);
+    }
+    else {
+        D_LogError("[%d:%d] Error at '%.*s': %s", token->line, token->column,
+            token->length, token->start, message);
+    }
+}
+
+static void D_Error(D_Compiler* c, const char* message) {
+    D_ErrorAt(c, &c->previous, message);
+}
+
+static void D_ErrorAtCurrent(D_Compiler* c, const char* message) {
+    D_ErrorAt(c, &c->current, message);
+}
+
+/*****************************************************************
+* Token Handling
+*****************************************************************/
+
+static void D_Advance(D_Compiler* c) {
+    c->previous = c->current;
+    for(;;) {
+        c->current = D_ScannerNext(&c->scanner);
+        if(c->current.type == D_TokenType_NEWLINE && c->nesting > 0) {
+            continue;
+        }
+        if(c->current.type >= 0) {
+            break;
+        }
+        D_ErrorAtCurrent(c, c->current.type == D_TokenType_INVALID
+            ? "Unterminated string." : "Unexpected character.");
+    }
+}
+
+static bool D_Check(D_Compiler* c, D_TokenType type) {
+    return c->current.type == type;
+}
+
+static bool D_Match(D_Compiler* c, D_TokenType type) {
+    if(!D_Check(c, type)) return false;
+    D_Advance(c);
+    return true;
+}
+
+static void D_Expect(D_Compiler* c, D_TokenType type, const char* message) {
+    if(D_Check(c, type)) {
+        D_Advance(c);
+        return;
+    }
+    D_ErrorAtCurrent(c, message);
+}
+
+static void D_SkipNewlines(D_Compiler* c) {
+    while(D_Check(c, D_TokenType_NEWLINE)) {
+        D_Advance(c);
+    }
+}
+
+static bool D_TokenIs(const D_Token* token, const char* text) {
+    size_t length = strlen(text);
+    return (size_t)token->length == length && 0 == memcmp(token->start, text, length);
+}
+
+/*****************************************************************
+* Emitting
+*****************************************************************/
+
+// Bytecode is attributed to the token just consumed, unless
+// D_MarkPosition() has said otherwise since.
+static void D_TrackPosition(D_Compiler* c) {
+    if(c->previous.line != c->markLine || c->previous.column != c->markColumn) {
+        c->markLine = c->previous.line;
+        c->markColumn = c->previous.column;
+        drgNuggetAddPosition(c->nugget, c->markLine, c->markColumn);
+    }
+}
+
+// Attributes what's emitted next to 'token', e.g. the operator
+// of an expression whose operands were compiled in between.
+static void D_MarkPosition(D_Compiler* c, const D_Token* token) {
+    drgNuggetAddPosition(c->nugget, token->line, token->column);
+    c->markLine = c->previous.line;
+    c->markColumn = c->previous.column;
+}
+
+static void D_Emit(D_Compiler* c, drgByte byte) {
+    drgNugget* nugget = c->nugget;
+    D_TrackPosition(c);
+    if(NULL == c->fn->function) {
+        drgNuggetAdd(nugget, byte);
+        return;
+    }
+    // A function body is built in the arena, and copied out at its
+    // final size once complete (see D_EndFunction()).
+    if(nugget->capacity < nugget->count + 1) {
+        int capacity = DRG_MEM_GROW_CAPACITY(nugget->capacity);
+        nugget->bytecode = (drgByte*)D_ArenaGrow(&c->arena, nugget->bytecode,
+            (size_t)nugget->capacity, (size_t)capacity);
+        nugget->capacity = capacity;
+    }
+    nugget->bytecode[nugget->count++] = byte;
+}
+
+static void D_Emit2(D_Compiler* c, drgByte a, drgByte b) {
+    D_Emit(c, a);
+    D_Emit(c, b);
+}
+
+static void D_EmitShortOperand(D_Compiler* c, int operand) {
+    D_Emit(c, (drgByte)((operand >> 8) & 0xFF));
+    D_Emit(c, (drgByte)(operand & 0xFF));
+}
+
+static void D_EmitShort(D_Compiler* c, drgByte op, int operand) {
+    D_Emit(c, op);
+    D_EmitShortOperand(c, operand);
+}
+
+static int D_CheckLiteral(D_Compiler* c, int index) {
+    if(index >= DRG_NUGGET_LITERALS_MAX) {
+        D_Error(c, "Too many literals in one nugget.");
+        return 0;
+    }
+    return index;
+}
+
+// Identical literals share one constant.
+static int D_AddLiteral(D_Compiler* c, drgVal value) {
+    return D_CheckLiteral(c, drgNuggetAddLiteral(c->nugget, value));
+}
+
+// Keeps count of the values on the stack as instructions are
+// emitted, so each nugget records the deepest its frame gets and
+// the VM only has to make room once per call.
+static void D_StackEffect(D_Compiler* c, int delta) {
+    c->fn->stackDepth += delta;
+    if(c->fn->stackDepth > c->nugget->maxStack) {
+        c->nugget->maxStack = c->fn->stackDepth;
+    }
+}
+
+/*****************************************************************
+* Emitting (Registers)
+*
+* With D_CompileFlag_REGISTERS, the parser's stack operations are
+* turned into three-address instructions instead. Each pushed value
+* is tracked here as the frame slot holding it, rather than being
+* pushed at runtime: a global is used in place, everything else
+* gets a temporary. Temporaries are marked with DRG_REG_TEMP until
+* the whole nugget is compiled, since they go after the globals
+* and more globals may still be declared.
+*
+* The register form only covers straight-line code so far, so only
+* dargon-bench compiles to it; 'run' always uses the stack form.
+*****************************************************************/
+
+#define DRG_REG_TEMP 0x8000
+
+static void D_PushOperand(D_Compiler* c, int slot) {
+    if(c->operandCount >= DRG_OPERANDS_MAX) {
+        D_Error(c, "Expression is too complex.");
+        return;
+    }
+    c->operands[c->operandCount++] = (uint16_t)slot;
+}
+
+static int D_PopOperand(D_Compiler* c) {
+    // Only empty after an error, which stops the output anyway
+    if(c->operandCount == 0) return DRG_REG_TEMP;
+    int slot = c->operands[--c->operandCount];
+    if(slot & DRG_REG_TEMP) {
+        c->tempCount--; // temps are freed in reverse order
+    }
+    return slot;
+}
+
+static int D_NewTemp(D_Compiler* c) {
+    int temp = c->tempCount++;
+    if(c->tempCount > c->nugget->registers) {
+        c->nugget->registers = c->tempCount;
+    }
+    return DRG_REG_TEMP | temp;
+}
+
+// Starts an instruction whose first operand is the slot it writes.
+static void D_EmitRegDst(D_Compiler* c, drgOpcode op, int dst) {
+    D_Emit(c, (drgByte)op);
+    c->lastDst = c->nugget->count;
+    D_EmitShortOperand(c, dst);
+}
+
+static drgOpcode D_RegisterOpcode(drgOpcode op) {
+    switch(op) {
+        case DRG_OC_NEGATE: return DRG_OC_R_NEGATE;
+        case DRG_OC_NOT:    return DRG_OC_R_NOT;
+        case DRG_OC_INT_TO_REAL: return DRG_OC_R_INT_TO_REAL;
+        case DRG_OC_ADD:    return DRG_OC_R_ADD;
+        case DRG_OC_SUB:    return DRG_OC_R_SUB;
+        case DRG_OC_MULT:   return DRG_OC_R_MULT;
+        case DRG_OC_DIV:    return DRG_OC_R_DIV;
+        case DRG_OC_EQ:     return DRG_OC_R_EQ;
+        case DRG_OC_NEQ:    return DRG_OC_R_NEQ;
+        case DRG_OC_GT:     return DRG_OC_R_GT;
+        case DRG_OC_GTE:    return DRG_OC_R_GTE;
+        case DRG_OC_LT:     return DRG_OC_R_LT;
+        case DRG_OC_LTE:    return DRG_OC_R_LTE;
+        default:            return op;
+    }
+}
+
+static void D_EmitRegOp(D_Compiler* c, drgOpcode op) {
+    switch(op) {
+        case DRG_OC_TRUE:
+        case DRG_OC_FALSE: {
+            int dst = D_NewTemp(c);
+            D_EmitRegDst(c, op == DRG_OC_TRUE ? DRG_OC_R_LOADTRUE : DRG_OC_R_LOADFALSE, dst);
+            D_PushOperand(c, dst);
+            break;
+        }
+        case DRG_OC_NEGATE:
+        case DRG_OC_NOT:
+        case DRG_OC_INT_TO_REAL: {
+            int a = D_PopOperand(c);
+            int dst = D_NewTemp(c);
+            D_EmitRegDst(c, D_RegisterOpcode(op), dst);
+            D_EmitShortOperand(c, a);
+            D_PushOperand(c, dst);
+            break;
+        }
+        case DRG_OC_PRINT: {
+            int a = D_PopOperand(c);
+            D_EmitShort(c, DRG_OC_R_PRINT, a);
+            c->lastDst = -1;
+            break;
+        }
+        case DRG_OC_POP:
+            D_PopOperand(c);
+            break;
+        default: {
+            // Binary; the result can reuse the left operand's temp
+            int b = D_PopOperand(c);
+            int a = D_PopOperand(c);
+            int dst = D_NewTemp(c);
+            D_EmitRegDst(c, D_RegisterOpcode(op), dst);
+            D_EmitShortOperand(c, a);
+            D_EmitShortOperand(c, b);
+            D_PushOperand(c, dst);
+            break;
+        }
+    }
+}
+
+// Stores the top operand into a global, either by pointing the
+// instruction that computed it straight at the global, or with a
+// MOVE.
+static void D_EmitRegStore(D_Compiler* c, int slot) {
+    int src = D_PopOperand(c);
+    int end = c->nugget->count;
+    drgByte* code = c->nugget->bytecode;
+    bool retarget = (src & DRG_REG_TEMP) && c->lastDst >= 0 &&
+        (((code[c->lastDst] << 8) | code[c->lastDst + 1]) == src) &&
+        c->lastDst - 1 + drgInstructionLength(code[c->lastDst - 1]) == end;
+    if(retarget) {
+        code[c->lastDst] = (drgByte)((slot >> 8) & 0xFF);
+        code[c->lastDst + 1] = (drgByte)(slot & 0xFF);
+    }
+    else {
+        D_EmitRegDst(c, DRG_OC_R_MOVE, slot);
+        D_EmitShortOperand(c, src);
+    }
+    c->lastDst = -1;
+}
+
+static void D_EmitRegGlobal(D_Compiler* c, drgOpcode op, int slot) {
+    switch(op) {
+        case DRG_OC_GET_GLOBAL:
+            D_PushOperand(c, slot);
+            break;
+        case DRG_OC_SET_GLOBAL:
+            // Assignment is an expression, its value is the global
+            D_EmitRegStore(c, slot);
+            D_PushOperand(c, slot);
+            break;
+        default:
+            D_EmitRegStore(c, slot);
+            break;
+    }
+}
+
+// Resolves the temporaries of everything emitted since 'from' to
+// the slots right after the globals.
+static void D_PatchTemps(D_Compiler* c, int from) {
+    int base = c->globals->count;
+    if(base + c->nugget->registers > DRG_REG_TEMP) {
+        D_Error(c, "Too many globals and temporaries for register mode.");
+        return;
+    }
+    drgByte* code = c->nugget->bytecode;
+    for(int offset = from; offset < c->nugget->count;) {
+        int end = offset + drgInstructionLength(code[offset]);
+        // Every operand is a slot, except LOADK's trailing index
+        int last = end;
+        if(code[offset] == DRG_OC_R_LOADK) {
+            last = end - 1;
+        }
+        else if(code[offset] == DRG_OC_R_LOADK_LONG) {
+            last = end - 3;
+        }
+        for(int at = offset + 1; at < last; at += 2) {
+            int slot = (code[at] << 8) | code[at + 1];
+            if(slot & DRG_REG_TEMP) {
+                slot = base + (slot & ~DRG_REG_TEMP);
+                code[at] = (drgByte)((slot >> 8) & 0xFF);
+                code[at + 1] = (drgByte)(slot & 0xFF);
+            }
+        }
+        offset = end;
+    }
+}
+
+/*****************************************************************
+* Emitting (Either Mode)
+*****************************************************************/
+
+static bool D_RegisterMode(D_Compiler* c) {
+    return (c->flags & D_CompileFlag_REGISTERS) != 0;
+}
+
+/*****************************************************************
+* Constant Folding
+*
+* With D_CompileFlag_OPTIMIZE, each constant push is remembered
+* along with where it starts, and an operator emitted right after
+* its constant operands takes them back out and pushes the result
+* instead. Folding as the code is emitted, rather than afterwards,
+* means a folded result can be an operand of the next operator,
+* and a constant declared with a constant value is known wherever
+* it's used.
+*****************************************************************/
+
+static bool D_Optimizing(D_Compiler* c) {
+    return (c->flags & D_CompileFlag_OPTIMIZE) && !D_RegisterMode(c);
+}
+
+static void D_BeginConstant(D_Compiler* c, D_Constant* constant) {
+    constant->start = c->nugget->count;
+    constant->lines = c->nugget->lines;
+}
+
+static void D_EndConstant(D_Compiler* c, D_Constant* constant, drgVal value) {
+    constant->value = value;
+    constant->end = c->nugget->count;
+    // Only a run of constants with nothing in between can fold
+    if(c->pushCount > 0 && c->pushes[c->pushCount - 1].end != constant->start) {
+        c->pushCount = 0;
+    }
+    if(c->pushCount == DRG_FOLD_DEPTH) {
+        memmove(c->pushes, c->pushes + 1, sizeof(D_Constant) * (DRG_FOLD_DEPTH - 1));
+        c->pushCount--;
+    }
+    c->pushes[c->pushCount++] = *constant;
+}
+
+// The constant the code emitted so far ends in, if it starts at
+// 'start' or later.
+static const D_Constant* D_LastConstant(D_Compiler* c, int start) {
+    if(0 == c->pushCount) {
+        return NULL;
+    }
+    const D_Constant* last = &c->pushes[c->pushCount - 1];
+    return (last->end == c->nugget->count && last->start >= start) ? last : NULL;
+}
+
+static void D_EmitValue(D_Compiler* c, drgVal value);
+
+// Replaces the constant operands of 'op' with its result, if they
+// were the last thing emitted and no jump lands among them.
+static bool D_Fold(D_Compiler* c, drgOpcode op) {
+    int operands;
+    switch(op) {
+        case DRG_OC_NEGATE:
+        case DRG_OC_NOT:
+        case DRG_OC_INT_TO_REAL:
+            operands = 1;
+            break;
+        case DRG_OC_ADD: case DRG_OC_SUB: case DRG_OC_MULT: case DRG_OC_DIV:
+        case DRG_OC_EQ: case DRG_OC_NEQ:
+        case DRG_OC_GT: case DRG_OC_GTE: case DRG_OC_LT: case DRG_OC_LTE:
+            operands = 2;
+            break;
+        default:
+            return false;
+    }
+    if(c->pushCount < operands || NULL == D_LastConstant(c, 0)) {
+        return false;
+    }
+    const D_Constant* first = &c->pushes[c->pushCount - operands];
+    if(first->start < c->fn->lastTarget) {
+        return false;
+    }
+    drgVal result;
+    if(!D_FoldConstant(op, first->value, c->pushes[c->pushCount - 1].value, &result)) {
+        return false;
+    }
+    // Back to before the first operand, code and positions both
+    drgNugget* nugget = c->nugget;
+    nugget->count = first->start;
+    nugget->lines.count = first->lines.count;
+    nugget->lines.offset = first->lines.offset;
+    nugget->lines.line = first->lines.line;
+    nugget->lines.column = first->lines.column;
+    c->markLine = -1;
+    c->pushCount -= operands;
+    D_StackEffect(c, -operands);
+    D_EmitValue(c, result);
+    return true;
+}
+
+// The first 256 constants fit a one byte index, the rest take the
+// *_LONG form and three.
+static void D_EmitConstantIndex(D_Compiler* c, int index) {
+    if(index > UINT8_MAX) {
+        D_Emit(c, (drgByte)((index >> 16) & 0xFF));
+        D_Emit(c, (drgByte)((index >> 8) & 0xFF));
+    }
+    D_Emit(c, (drgByte)(index & 0xFF));
+}
+
+static void D_EmitConstant(D_Compiler* c, int index) {
+    bool wide = index > UINT8_MAX;
+    c->type = D_TypeOfValue(c->nugget->constantPool.values[index]);
+    if(D_RegisterMode(c)) {
+        int dst = D_NewTemp(c);
+        D_EmitRegDst(c, wide ? DRG_OC_R_LOADK_LONG : DRG_OC_R_LOADK, dst);
+        D_EmitConstantIndex(c, index);
+        D_PushOperand(c, dst);
+        return;
+    }
+    D_Constant constant;
+    D_BeginConstant(c, &constant);
+    D_Emit(c, wide ? DRG_OC_NUM_LIT_LONG : DRG_OC_NUM_LIT);
+    D_EmitConstantIndex(c, index);
+    D_StackEffect(c, 1);
+    if(D_Optimizing(c)) {
+        D_EndConstant(c, &constant, c->nugget->constantPool.values[index]);
+    }
+}
+
+static void D_EmitLiteral(D_Compiler* c, drgVal value) {
+    D_EmitConstant(c, D_AddLiteral(c, value));
+}
+
+// An operation on the values the expression left on the stack.
+static void D_EmitOp(D_Compiler* c, drgOpcode op) {
+    if(op == DRG_OC_TRUE || op == DRG_OC_FALSE) {
+        c->type = DRG_TYPE_BOOL;
+    }
+    if(D_RegisterMode(c)) {
+        D_EmitRegOp(c, op);
+        return;
+    }
+    if(D_Optimizing(c) && D_Fold(c, op)) {
+        return;
+    }
+    D_Constant constant;
+    D_BeginConstant(c, &constant);
+    D_Emit(c, (drgByte)op);
+    D_StackEffect(c, drgStackEffect((drgByte)op, 0));
+    if(D_Optimizing(c) && (op == DRG_OC_TRUE || op == DRG_OC_FALSE)) {
+        D_EndConstant(c, &constant, drgValFromBool(op == DRG_OC_TRUE));
+    }
+}
+
+static void D_EmitValue(D_Compiler* c, drgVal value) {
+    if(drgValIsBool(value)) {
+        D_EmitOp(c, drgValAsBool(value) ? DRG_OC_TRUE : DRG_OC_FALSE);
+    }
+    else {
+        D_EmitLiteral(c, value);
+    }
+}
+
+static void D_EmitGlobal(D_Compiler* c, drgOpcode op, int slot) {
+    if(D_RegisterMode(c)) {
+        D_EmitRegGlobal(c, op, slot);
+        return;
+    }
+    D_EmitShort(c, (drgByte)op, slot);
+    D_StackEffect(c, drgStackEffect((drgByte)op, 0));
+}
+
+// Returns 'none' from the frame. Written out by hand since the
+// register form ends its code this way too.
+static void D_EmitReturnNone(D_Compiler* c) {
+    D_Emit2(c, DRG_OC_NONE, DRG_OC_RETURN);
+    D_StackEffect(c, 1);
+    D_StackEffect(c, -1);
+}
+
+/*****************************************************************
+* Emitting (Stack Only)
+*
+* Locals, jumps and calls have no register form yet. The parse
+* functions that need them refuse to run in register mode first.
+*****************************************************************/
+
+static bool D_CheckStackMode(D_Compiler* c) {
+    if(D_RegisterMode(c)) {
+        D_Error(c, "Only declarations, assignments and print() are supported in register mode so far.");
+        return false;
+    }
+    return true;
+}
+
+static void D_EmitLocal(D_Compiler* c, drgOpcode op, int slot) {
+    D_Emit2(c, (drgByte)op, (drgByte)slot);
+    D_StackEffect(c, drgStackEffect((drgByte)op, 0));
+}
+
+// Emits a forward jump to be patched later.
+// Returns the offset of its operand.
+static int D_EmitJump(D_Compiler* c, drgOpcode op) {
+    D_EmitShort(c, (drgByte)op, 0xFFFF);
+    return c->nugget->count - 2;
+}
+
+// Points a forward jump at the next instruction.
+static void D_PatchJump(D_Compiler* c, int at) {
+    int jump = c->nugget->count - (at + 2);
+    if(jump > UINT16_MAX) {
+        D_Error(c, "Too much code to jump over.");
+        return;
+    }
+    c->nugget->bytecode[at] = (drgByte)((jump >> 8) & 0xFF);
+    c->nugget->bytecode[at + 1] = (drgByte)(jump & 0xFF);
+    c->fn->lastTarget = c->nugget->count;
+}
+
+static void D_EmitLoop(D_Compiler* c, int start) {
+    int jump = c->nugget->count + 3 - start;
+    if(jump > UINT16_MAX) {
+        D_Error(c, "Loop body is too large.");
+        return;
+    }
+    D_EmitShort(c, DRG_OC_LOOP, jump);
+}
+
+static void D_EmitCall(D_Compiler* c, int argc) {
+    D_Emit2(c, DRG_OC_CALL, (drgByte)argc);
+    D_StackEffect(c, drgStackEffect(DRG_OC_CALL, argc));
+}
+
+static void D_EmitDefault(D_Compiler* c, D_TypeSpec spec);
+
+// DRG_OC_ARRAY of 'count' elements, or DRG_OC_NEW_ARRAY, making
+// an array of 'element' that's resizable if 'size' says so.
+static void D_EmitArray(D_Compiler* c, drgOpcode op, drgType element, int size, int count) {
+    // A struct array takes its row width from a struct going in, so
+    // an empty one is made by NEW_ARRAY, as no copies of a default
+    if(op == DRG_OC_ARRAY && 0 == count && D_IsStructType(element)) {
+        D_EmitLiteral(c, drgValFromInt(0));
+        D_EmitDefault(c, D_Spec(element));
+        op = DRG_OC_NEW_ARRAY;
+    }
+    int operand = (int)element | ((size == DRG_SIZE_RESIZABLE) ? DRG_ARRAY_RESIZABLE : 0);
+    D_Emit2(c, (drgByte)op, (drgByte)operand);
+    if(op == DRG_OC_ARRAY) {
+        D_EmitShortOperand(c, count);
+    }
+    D_StackEffect(c, drgStackEffect((drgByte)op, count));
+    c->type = D_ArrayOf(element);
+}
+
+// A map literal of 'count' entries, its keys and values already
+// pushed in turn.
+static void D_EmitMap(D_Compiler* c, drgType map, int count) {
+    D_Emit2(c, DRG_OC_MAP, (drgByte)(map - DRG_TYPE_MAP));
+    D_EmitShortOperand(c, count);
+    D_StackEffect(c, drgStackEffect(DRG_OC_MAP, count));
+    c->type = map;
+}
+
+// A struct literal, its fields already pushed in order.
+static void D_EmitStruct(D_Compiler* c, drgType type) {
+    int count = D_StructOf(c, type)->fieldCount;
+    D_Emit2(c, DRG_OC_STRUCT, (drgByte)type);
+    D_Emit(c, (drgByte)count);
+    D_StackEffect(c, drgStackEffect(DRG_OC_STRUCT, count));
+    c->type = type;
+}
+
+// DRG_OC_GET_FIELD or DRG_OC_SET_FIELD of the field at 'offset', or
+// the same of a struct array's row.
+static void D_EmitField(D_Compiler* c, drgOpcode op, int offset) {
+    D_Emit2(c, (drgByte)op, (drgByte)offset);
+    D_StackEffect(c, drgStackEffect((drgByte)op, 0));
+}
+
+/*****************************************************************
+* Locals
+*****************************************************************/
+
+static drgString* D_InternName(const D_Token* name) {
+    return drgIntern(name->start, name->length);
+}
+
+// The value is already on the stack, in the slot the local gets.
+static void D_AddLocal(D_Compiler* c, drgString* name, D_TypeSpec type, bool isMutable) {
+    D_FunctionState* fn = c->fn;
+    if(fn->localCount == DRG_LOCALS_MAX) {
+        D_Error(c, "Too many local variables in one function.");
+        return;
+    }
+    D_Local* local = &fn->locals[fn->localCount++];
+    local->name = name;
+    local->type = type;
+    local->isMutable = isMutable;
+    local->depth = fn->scopeDepth;
+}
+
+// Returns the slot of the innermost local named 'name', -1 if
+// there is none.
+static int D_ResolveLocal(D_FunctionState* fn, const drgString* name) {
+    for(int i = fn->localCount - 1; i > 0; i--) {
+        if(fn->locals[i].name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void D_BeginScope(D_Compiler* c) {
+    c->fn->scopeDepth++;
+}
+
+static void D_EndScope(D_Compiler* c) {
+    D_FunctionState* fn = c->fn;
+    fn->scopeDepth--;
+    while(fn->localCount > 0 && fn->locals[fn->localCount - 1].depth > fn->scopeDepth) {
+        D_EmitOp(c, DRG_OC_POP);
+        fn->localCount--;
+    }
+}
+
+/*****************************************************************
+* Type Checking
+*
+* Every expression leaves the static type of its value in c->type,
+* so operators whose operand types are known get the typed opcode,
+* and a declared type is met by an explicit conversion or not at
+* all. What isn't known until runtime, a module function's result,
+* is DRG_TYPE_ANY: it takes the generic opcodes, and is checked
+* with DRG_OC_CHECK_TYPE where it meets a declared type.
+*****************************************************************/
+
+// The typed forms of the generic operators, by operand type;
+// DRG_OC_RETURN (0) where there's none
+static const drgByte D_TypedOps[DRG_OC_LTE + 1][DRG_TYPE_STRING + 1] = {
+    //                  int                real                 bool  string
+    [DRG_OC_NEGATE] = { DRG_OC_NEGATE_INT, DRG_OC_NEGATE_REAL },
+    [DRG_OC_ADD]    = { DRG_OC_ADD_INT,    DRG_OC_ADD_REAL,     0,    DRG_OC_ADD_STRING },
+    [DRG_OC_SUB]    = { DRG_OC_SUB_INT,    DRG_OC_SUB_REAL },
+    [DRG_OC_MULT]   = { DRG_OC_MULT_INT,   DRG_OC_MULT_REAL },
+    [DRG_OC_DIV]    = { DRG_OC_DIV_INT,    DRG_OC_DIV_REAL },
+    [DRG_OC_EQ]     = { DRG_OC_EQ_INT,     DRG_OC_EQ_REAL,      0,    DRG_OC_EQ_STRING },
+    [DRG_OC_NEQ]    = { DRG_OC_NEQ_INT,    DRG_OC_NEQ_REAL,     0,    DRG_OC_NEQ_STRING },
+    [DRG_OC_GT]     = { DRG_OC_GT_INT,     DRG_OC_GT_REAL },
+    [DRG_OC_GTE]    = { DRG_OC_GTE_INT,    DRG_OC_GTE_REAL },
+    [DRG_OC_LT]     = { DRG_OC_LT_INT,     DRG_OC_LT_REAL },
+    [DRG_OC_LTE]    = { DRG_OC_LTE_INT,    DRG_OC_LTE_REAL },
+};
+
+static drgOpcode D_TypedOpcode(D_Compiler* c, drgOpcode op, drgType type) {
+    // The register form has no typed opcodes yet
+    if(D_RegisterMode(c) || type > DRG_TYPE_STRING || 0 == D_TypedOps[op][type]) {
+        return op;
+    }
+    return (drgOpcode)D_TypedOps[op][type];
+}
+
+static void D_TypeMismatch(D_Compiler* c, drgType want, drgType have) {
+    char message[2 * DRG_NAME_MAX + 64];
+    snprintf(message, sizeof(message), "Expected a value of type %s, not %s.",
+        D_TypeName(c, want), D_TypeName(c, have));
+    D_Error(c, message);
+}
+
+// Makes the value the last expression left fit a declared type.
+static void D_Coerce(D_Compiler* c, drgType want) {
+    drgType have = c->type;
+    if(have == want) {
+        return;
+    }
+    if(have == DRG_TYPE_INT && want == DRG_TYPE_REAL) {
+        D_EmitOp(c, DRG_OC_INT_TO_REAL);
+    }
+    else if(have == DRG_TYPE_ANY) {
+        // Only a call makes one, and calls are stack form only
+        if(!D_RegisterMode(c)) {
+            D_Emit2(c, DRG_OC_CHECK_TYPE, (drgByte)want);
+        }
+    }
+    else {
+        D_TypeMismatch(c, want, have);
+    }
+    c->type = want;
+}
+
+// Structs, arrays and maps are held by reference, so one stored
+// where it can be changed can be changed through there.
+static bool D_IsReferenceType(drgType type) {
+    return D_IsStructType(type) || D_IsArrayType(type) || D_IsMapType(type);
+}
+
+// Whether the value the last expression left is a constant that
+// would no longer be if it was stored where it can be changed.
+static bool D_IsSharedConstant(D_Compiler* c) {
+    return c->isConstant && D_IsReferenceType(c->type);
+}
+
+// Errors if the value about to be stored where it can be changed
+// is a constant held by reference.
+static void D_CheckShared(D_Compiler* c) {
+    if(D_IsSharedConstant(c)) {
+        D_Error(c, "A constant struct, array or map cannot be stored where it can be changed.");
+    }
+}
+
+// Conditions, and the operands of 'and' and 'or'.
+static void D_CheckCondition(D_Compiler* c) {
+    if(c->type != DRG_TYPE_BOOL && c->type != DRG_TYPE_ANY) {
+        D_Error(c, "Condition must be a bool.");
+    }
+}
+
+static void D_EmitUnary(D_Compiler* c, drgOpcode op) {
+    drgType type = c->type;
+    if(type == DRG_TYPE_ANY) {
+        D_EmitOp(c, op);
+        return;
+    }
+    if(op == DRG_OC_NOT ? type != DRG_TYPE_BOOL : !D_IsNumberType(type)) {
+        D_Error(c, op == DRG_OC_NOT ? "Operand must be a bool." : "Operand must be a number.");
+        return;
+    }
+    drgOpcode typed = D_TypedOpcode(c, op, type);
+    if(typed == op || !D_Optimizing(c) || !D_Fold(c, op)) {
+        D_EmitOp(c, typed);
+    }
+    c->type = type;
+}
+
+// An int operand meeting a real one is converted first, so the
+// typed opcode sees two of a kind.
+static void D_EmitBinary(D_Compiler* c, drgOpcode op, drgType left, drgType right) {
+    bool isArith = op >= DRG_OC_ADD && op <= DRG_OC_DIV;
+    bool isEquality = op == DRG_OC_EQ || op == DRG_OC_NEQ;
+    drgType type = DRG_TYPE_ANY;
+    if(left != DRG_TYPE_ANY && right != DRG_TYPE_ANY) {
+        if(D_IsNumberType(left) && D_IsNumberType(right)) {
+            type = (left == right) ? left : DRG_TYPE_REAL;
+        }
+        else if(op == DRG_OC_ADD && left == DRG_TYPE_STRING && right == DRG_TYPE_STRING) {
+            type = DRG_TYPE_STRING;
+        }
+        else if(!isEquality) {
+            D_Error(c, op == DRG_OC_ADD ? "Operands must be two numbers or two strings." : "Operands must be numbers.");
+            return;
+        }
+        else if(left == right) {
+            type = left;
+        }
+    }
+    drgOpcode typed = D_TypedOpcode(c, op, type);
+    // Constants fold as they are, conversions included
+    if(typed == op || !D_Optimizing(c) || !D_Fold(c, op)) {
+        if(typed != op && left != type) {
+            D_EmitOp(c, DRG_OC_INT_TO_REAL_UNDER);
+        }
+        if(typed != op && right != type) {
+            D_EmitOp(c, DRG_OC_INT_TO_REAL);
+        }
+        D_EmitOp(c, typed);
+    }
+    c->type = isArith ? type : DRG_TYPE_BOOL;
+}
+
+/*****************************************************************
+* Expressions
+*****************************************************************/
+
+static void D_Expression(D_Compiler* c);
+static void D_ExpressionOf(D_Compiler* c, D_TypeSpec type);
+static void D_StructBody(D_Compiler* c, D_Token* brace, drgType type);
+static void D_FieldAccess(D_Compiler* c, bool canAssign, const D_Token* at, drgOpcode get, drgOpcode set);
+static const D_ParseRule* D_GetRule(D_TokenType type);
+static void D_ParsePrecedence(D_Compiler* c, D_Precedence precedence);
+
+// The value of the number literal just consumed. False after an
+// error.
+static bool D_NumberValue(D_Compiler* c, drgVal* value) {
+    // Lexemes aren't null-terminated, so strtod() gets a copy
+    char buf[64];
+    if(c->previous.length >= (int)sizeof(buf)) {
+        D_Error(c, "Numeric literal is too long.");
+        return false;
+    }
+    memcpy(buf, c->previous.start, (size_t)c->previous.length);
+    buf[c->previous.length] = '\0';
+    if(c->previous.type == D_TokenType_REAL_LITERAL) {
+        *value = drgValFromReal(strtod(buf, NULL));
+        return true;
+    }
+    errno = 0;
+    long long number = strtoll(buf, NULL, 10);
+    if(errno == ERANGE || number > DRG_INT_MAX) {
+        D_Error(c, "Integer literal is too large.");
+        return false;
+    }
+    *value = drgValFromInt(number);
+    return true;
+}
+
+static void D_Number(D_Compiler* c, bool canAssign) {
+    drgVal value;
+    if(D_NumberValue(c, &value)) {
+        D_EmitLiteral(c, value);
+    }
+}
+
+static void D_String(D_Compiler* c, bool canAssign) {
+    // Without the quotes
+    drgString* string = drgIntern(c->previous.start + 1, c->previous.length - 2);
+    D_EmitLiteral(c, drgValFromObj(string));
+}
+
+static void D_Literal(D_Compiler* c, bool canAssign) {
+    switch(c->previous.type) {
+        case D_TokenType_KW_true:  D_EmitOp(c, DRG_OC_TRUE); break;
+        case D_TokenType_KW_false: D_EmitOp(c, DRG_OC_FALSE); break;
+        default: return; // unreachable
+    }
+}
+
+static void D_Grouping(D_Compiler* c, bool canAssign) {
+    c->nesting++;
+    D_SkipNewlines(c);
+    D_Expression(c);
+    c->nesting--;
+    D_Expect(c, D_TokenType_RPAREN, "Expected ')' after expression.");
+}
+
+static void D_Unary(D_Compiler* c, bool canAssign) {
+    D_Token operator = c->previous;
+    D_TokenType op = operator.type;
+    D_ParsePrecedence(c, D_Prec_UNARY);
+    D_MarkPosition(c, &operator);
+    switch(op) {
+        case D_TokenType_MINUS:  D_EmitUnary(c, DRG_OC_NEGATE); break;
+        case D_TokenType_KW_not: D_EmitUnary(c, DRG_OC_NOT); break;
+        default: return; // unreachable
+    }
+}
+
+static void D_Binary(D_Compiler* c, bool canAssign) {
+    D_Token operator = c->previous;
+    D_TokenType op = operator.type;
+    const D_ParseRule* rule = D_GetRule(op);
+    drgType left = c->type;
+    // An operator at the end of a line continues onto the next
+    D_SkipNewlines(c);
+    D_ParsePrecedence(c, (D_Precedence)(rule->precedence + 1));
+    drgType right = c->type;
+    // Errors point at the operator rather than the right operand
+    D_MarkPosition(c, &operator);
+    switch(op) {
+        case D_TokenType_PLUS:  D_EmitBinary(c, DRG_OC_ADD, left, right); break;
+        case D_TokenType_MINUS: D_EmitBinary(c, DRG_OC_SUB, left, right); break;
+        case D_TokenType_STAR:  D_EmitBinary(c, DRG_OC_MULT, left, right); break;
+        case D_TokenType_SLASH: D_EmitBinary(c, DRG_OC_DIV, left, right); break;
+        case D_TokenType_KW_eq:  D_EmitBinary(c, DRG_OC_EQ, left, right); break;
+        case D_TokenType_KW_neq: D_EmitBinary(c, DRG_OC_NEQ, left, right); break;
+        case D_TokenType_GT:    D_EmitBinary(c, DRG_OC_GT, left, right); break;
+        case D_TokenType_GTE:   D_EmitBinary(c, DRG_OC_GTE, left, right); break;
+        case D_TokenType_LT:    D_EmitBinary(c, DRG_OC_LT, left, right); break;
+        case D_TokenType_LTE:   D_EmitBinary(c, DRG_OC_LTE, left, right); break;
+        default: return; // unreachable
+    }
+}
+
+// Adds the name just consumed to a dotted name being read.
+static bool D_AppendName(D_Compiler* c, char* buffer, int* length) {
+    int dot = (*length > 0) ? 1 : 0;
+    if(*length + dot + c->previous.length > DRG_NAME_MAX) {
+        D_Error(c, "Name is too long.");
+        return false;
+    }
+    if(dot) {
+        buffer[(*length)++] = '.';
+    }
+    memcpy(buffer + *length, c->previous.start, (size_t)c->previous.length);
+    *length += c->previous.length;
+    return true;
+}
+
+// name {'.' name}, the first name just consumed. Returns its
+// length, 0 after an error.
+static int D_DottedName(D_Compiler* c, char* buffer) {
+    int length = 0;
+    if(!D_AppendName(c, buffer, &length)) return 0;
+    while(D_Match(c, D_TokenType_DOT)) {
+        D_Expect(c, D_TokenType_IDENTIFIER, "Expected a name after '.'.");
+        if(c->previous.type != D_TokenType_IDENTIFIER || !D_AppendName(c, buffer, &length)) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+static drgModule* D_FindInclude(D_Compiler* c, const char* name, int length) {
+    for(int i = 0; i < c->globals->includeCount; i++) {
+        drgModule* module = c->globals->includes[i];
+        if(module->name->length == length && 0 == memcmp(module->name->chars, name, (size_t)length)) {
+            return module;
+        }
+    }
+    return NULL;
+}
+
+// module '.' name, the module's first name just consumed. An
+// exported function is a constant, so it's used as one rather than
+// through a global.
+static void D_ModuleMember(D_Compiler* c) {
+    D_Token first = c->previous;
+    char name[DRG_NAME_MAX];
+    int length = 0;
+    if(!D_AppendName(c, name, &length)) return;
+    for(;;) {
+        drgModule* module = D_FindInclude(c, name, length);
+        if(!D_Match(c, D_TokenType_DOT)) {
+            D_ErrorAt(c, &first, "Undeclared name.");
+            return;
+        }
+        D_Expect(c, D_TokenType_IDENTIFIER, "Expected a name after '.'.");
+        if(c->previous.type != D_TokenType_IDENTIFIER) return;
+        if(NULL != module) {
+            drgFunction* function = drgModuleFind(module, c->previous.start, c->previous.length);
+            if(NULL == function) {
+                D_Error(c, "The module exports nothing by this name.");
+                return;
+            }
+            // Its signature isn't in the module, so calls are checked
+            // by the function itself
+            D_EmitLiteral(c, drgValFromObj(function));
+            c->callee = -1;
+            return;
+        }
+        if(!D_AppendName(c, name, &length)) return;
+    }
+}
+
+// arrayAdd(array, element), arrayRem(array, index) or
+// arrayLen(array), its name just consumed. False if it's none of
+// them.
+static bool D_ArrayBuiltin(D_Compiler* c, const D_Token* name) {
+    drgOpcode op;
+    if(D_TokenIs(name, "arrayAdd")) op = DRG_OC_ARRAY_ADD;
+    else if(D_TokenIs(name, "arrayRem")) op = DRG_OC_ARRAY_REM;
+    else if(D_TokenIs(name, "arrayLen")) op = DRG_OC_ARRAY_LEN;
+    else return false;
+    if(!D_CheckStackMode(c)) return true;
+    D_Expect(c, D_TokenType_LPAREN, "Expected '(' after the function name.");
+    c->nesting++;
+    D_SkipNewlines(c);
+    D_Expression(c);
+    drgType array = c->type;
+    if(!D_IsArrayType(array) && array != DRG_TYPE_ANY) {
+        D_Error(c, "Expected an array.");
+    }
+    else if(op != DRG_OC_ARRAY_LEN && c->isConstant) {
+        D_Error(c, "Cannot resize a constant; declare it with 'var'.");
+    }
+    if(op != DRG_OC_ARRAY_LEN) {
+        D_Expect(c, D_TokenType_COMMA, "Expected ',' after the array.");
+        D_SkipNewlines(c);
+        if(op == DRG_OC_ARRAY_REM) {
+            D_ExpressionOf(c, D_Spec(DRG_TYPE_INT));
+        }
+        else {
+            D_ExpressionOf(c, D_Spec(D_IsArrayType(array) ? D_ElementOf(array) : DRG_TYPE_ANY));
+            D_CheckShared(c);
+        }
+    }
+    c->nesting--;
+    D_Expect(c, D_TokenType_RPAREN, "Expected ')' after arguments.");
+    D_MarkPosition(c, name);
+    D_EmitOp(c, op);
+    c->type = (op == DRG_OC_ARRAY_LEN) ? DRG_TYPE_INT : DRG_TYPE_NONE;
+    c->isConstant = false;
+    return true;
+}
+
+// mapHas(map, key), mapRem(map, key), mapLen(map), mapKeys(map)
+// or mapReserve(map, count), its name just consumed. False if it's
+// none of them.
+static bool D_MapBuiltin(D_Compiler* c, const D_Token* name) {
+    drgOpcode op;
+    if(D_TokenIs(name, "mapHas")) op = DRG_OC_MAP_HAS;
+    else if(D_TokenIs(name, "mapRem")) op = DRG_OC_MAP_REM;
+    else if(D_TokenIs(name, "mapLen")) op = DRG_OC_MAP_LEN;
+    else if(D_TokenIs(name, "mapKeys")) op = DRG_OC_MAP_KEYS;
+    else if(D_TokenIs(name, "mapReserve")) op = DRG_OC_MAP_RESERVE;
+    else return false;
+    if(!D_CheckStackMode(c)) return true;
+    D_Expect(c, D_TokenType_LPAREN, "Expected '(' after the function name.");
+    c->nesting++;
+    D_SkipNewlines(c);
+    D_Expression(c);
+    drgType map = c->type;
+    if(!D_IsMapType(map) && map != DRG_TYPE_ANY) {
+        D_Error(c, "Expected a map.");
+    }
+    else if(op == DRG_OC_MAP_REM && c->isConstant) {
+        D_Error(c, "Cannot remove from a constant; declare it with 'var'.");
+    }
+    if(op == DRG_OC_MAP_HAS || op == DRG_OC_MAP_REM || op == DRG_OC_MAP_RESERVE) {
+        D_Expect(c, D_TokenType_COMMA, "Expected ',' after the map.");
+        D_SkipNewlines(c);
+        if(op == DRG_OC_MAP_RESERVE) {
+            D_ExpressionOf(c, D_Spec(DRG_TYPE_INT));
+        }
+        else {
+            D_ExpressionOf(c, D_Spec(D_IsMapType(map) ? D_KeyOf(map) : DRG_TYPE_ANY));
+        }
+    }
+    c->nesting--;
+    D_Expect(c, D_TokenType_RPAREN, "Expected ')' after arguments.");
+    D_MarkPosition(c, name);
+    D_EmitOp(c, op);
+    switch(op) {
+        case DRG_OC_MAP_HAS: c->type = DRG_TYPE_BOOL; break;
+        case DRG_OC_MAP_LEN: c->type = DRG_TYPE_INT; break;
+        case DRG_OC_MAP_KEYS: c->type = D_IsMapType(map) ? D_ArrayOf(D_KeyOf(map)) : DRG_TYPE_ANY; break;
+        default:             c->type = DRG_TYPE_NONE; break;
+    }
+    c->isConstant = false;
+    return true;
+}
+
+static void D_Variable(D_Compiler* c, bool canAssign) {
+    D_Token name = c->previous;
+    drgString* interned = D_InternName(&name);
+    // A struct's name starts a literal of it
+    int index = D_GlobalTableFindStruct(c->globals, interned);
+    if(index >= 0) {
+        D_Expect(c, D_TokenType_LBRACE, "Expected '{' after the struct name.");
+        if(c->previous.type == D_TokenType_LBRACE) {
+            D_StructBody(c, &c->previous, (drgType)(DRG_TYPE_STRUCT + index));
+        }
+        return;
+    }
+    int local = D_ResolveLocal(c->fn, interned);
+    for(D_FunctionState* fn = c->fn->enclosing; local < 0 && fn != NULL; fn = fn->enclosing) {
+        if(D_ResolveLocal(fn, interned) >= 0) {
+            D_Error(c, "Cannot use a local of the enclosing code inside a function.");
+            return;
+        }
+    }
+    int slot = -1;
+    bool isMutable;
+    D_TypeSpec type;
+    if(local >= 0) {
+        isMutable = c->fn->locals[local].isMutable;
+        type = c->fn->locals[local].type;
+    }
+    else {
+        slot = D_GlobalTableFind(c->globals, interned);
+        if(slot < 0 && D_Check(c, D_TokenType_DOT)) {
+            D_ModuleMember(c);
+            return;
+        }
+        if(slot < 0 && (D_ArrayBuiltin(c, &name) || D_MapBuiltin(c, &name))) {
+            return;
+        }
+        if(slot < 0) {
+            D_Error(c, "Undeclared name.");
+            return;
+        }
+        isMutable = c->globals->symbols[slot].isMutable;
+        type = c->globals->symbols[slot].type;
+    }
+    if(canAssign && D_Match(c, D_TokenType_ASSIGN)) {
+        if(!isMutable) {
+            D_ErrorAt(c, &name, "Cannot assign to a constant; declare it with 'var'.");
+            return;
+        }
+        D_SkipNewlines(c);
+        D_ExpressionOf(c, type);
+        D_CheckShared(c);
+        if(local >= 0) D_EmitLocal(c, DRG_OC_SET_LOCAL, local);
+        else D_EmitGlobal(c, DRG_OC_SET_GLOBAL, slot);
+        c->isConstant = false;
+        return;
+    }
+    else if(local >= 0) {
+        D_EmitLocal(c, DRG_OC_GET_LOCAL, local);
+    }
+    else if(c->globals->symbols[slot].hasValue) {
+        D_EmitValue(c, c->globals->symbols[slot].value);
+    }
+    else {
+        D_EmitGlobal(c, DRG_OC_GET_GLOBAL, slot);
+    }
+    c->type = type.type;
+    c->callee = slot;
+    c->isConstant = !isMutable;
+}
+
+static void D_Call(D_Compiler* c, bool canAssign) {
+    if(!D_CheckStackMode(c)) return;
+    D_Token paren = c->previous;
+    if(c->type != DRG_TYPE_FUN && c->type != DRG_TYPE_ANY) {
+        D_Error(c, "Can only call functions.");
+        return;
+    }
+    // A global function's signature is known, anything else's
+    // arguments are checked when it's called
+    int callee = (c->type == DRG_TYPE_FUN) ? c->callee : -1;
+    int argc = 0;
+    c->nesting++;
+    D_SkipNewlines(c);
+    if(!D_Check(c, D_TokenType_RPAREN)) {
+        do {
+            D_SkipNewlines(c);
+            if(callee >= 0 && argc < c->globals->symbols[callee].arity) {
+                const D_Param* param = &c->globals->params[c->globals->symbols[callee].params + argc];
+                D_ExpressionOf(c, param->type);
+                if(param->isMutable) {
+                    D_CheckShared(c);
+                }
+            }
+            else {
+                D_Expression(c);
+            }
+            if(argc == DRG_ARGS_MAX) {
+                D_Error(c, "Too many arguments.");
+            }
+            argc++;
+        } while(D_Match(c, D_TokenType_COMMA));
+    }
+    c->nesting--;
+    D_Expect(c, D_TokenType_RPAREN, "Expected ')' after arguments.");
+    if(callee >= 0 && argc != c->globals->symbols[callee].arity) {
+        char message[64];
+        snprintf(message, sizeof(message), "Wrong number of arguments: expected %d, got %d.",
+            c->globals->symbols[callee].arity, argc);
+        D_Error(c, message);
+        return;
+    }
+    D_MarkPosition(c, &paren);
+    D_EmitCall(c, argc);
+    c->type = (callee >= 0) ? c->globals->symbols[callee].returnType.type : DRG_TYPE_ANY;
+    c->isConstant = false;
+}
+
+// The rest of a '[' key ':' value {',' key ':' value} ']' literal,
+// or of an empty '[' ':' ']', from inside the brackets. 'hasKey'
+// if the first key has been compiled already. The keys and values
+// are of the types the literal is expected to have, else of the
+// first entry's.
+static void D_MapLiteral(D_Compiler* c, D_Token* bracket, drgType map, bool hasKey) {
+    drgType key = D_IsMapType(map) ? D_KeyOf(map) : DRG_TYPE_ANY;
+    drgType value = D_IsMapType(map) ? D_ValueOf(map) : DRG_TYPE_ANY;
+    int count = 0;
+    bool isEmpty = !hasKey && (D_Match(c, D_TokenType_COLON) || D_Check(c, D_TokenType_RBRACK));
+    while(!isEmpty) {
+        if(!hasKey) {
+            D_SkipNewlines(c);
+            D_Expression(c);
+        }
+        hasKey = false;
+        if(key == DRG_TYPE_ANY) {
+            key = c->type;
+            if(key != DRG_TYPE_INT && key != DRG_TYPE_REAL && key != DRG_TYPE_STRING) {
+                D_Error(c, "Map keys can only be ints, reals and strings.");
+                c->nesting--;
+                return;
+            }
+        }
+        D_Coerce(c, key);
+        D_Expect(c, D_TokenType_COLON, "Expected ':' after the key.");
+        D_SkipNewlines(c);
+        D_Expression(c);
+        if(value == DRG_TYPE_ANY) {
+            value = c->type;
+            if(value > DRG_TYPE_STRING) {
+                D_Error(c, "Map values can only be ints, reals, bools and strings.");
+                c->nesting--;
+                return;
+            }
+        }
+        D_Coerce(c, value);
+        if(++count > UINT16_MAX) {
+            D_Error(c, "Too many entries in one map literal.");
+        }
+        isEmpty = !D_Match(c, D_TokenType_COMMA);
+    }
+    c->nesting--;
+    D_Expect(c, D_TokenType_RBRACK, "Expected ']' after the entries.");
+    if(key == DRG_TYPE_ANY) {
+        D_ErrorAt(c, bracket, "An empty map needs a declared type.");
+        return;
+    }
+    D_MarkPosition(c, bracket);
+    D_EmitMap(c, D_MapOf(key, value), count);
+    c->isConstant = false;
+}
+
+// '[' [expression {',' expression}] ']'. The elements are of the
+// type the literal is expected to be, else of the first one.
+// Starting with a key and a ':' makes it a map instead.
+static void D_ArrayLiteral(D_Compiler* c, bool canAssign) {
+    if(!D_CheckStackMode(c)) return;
+    D_Token bracket = c->previous;
+    D_TypeSpec expect = c->expect;
+    c->expect = D_Spec(DRG_TYPE_ANY);
+    drgType element = D_IsArrayType(expect.type) ? D_ElementOf(expect.type) : DRG_TYPE_ANY;
+    int count = 0;
+    bool holdsConstant = false;
+    c->nesting++;
+    D_SkipNewlines(c);
+    if(D_IsMapType(expect.type) || D_Check(c, D_TokenType_COLON)) {
+        D_MapLiteral(c, &bracket, expect.type, false);
+        return;
+    }
+    if(!D_Check(c, D_TokenType_RBRACK)) {
+        do {
+            D_SkipNewlines(c);
+            // Known, the elements can be bare struct literals
+            c->expect = D_Spec(element);
+            D_Expression(c);
+            c->expect = D_Spec(DRG_TYPE_ANY);
+            // A ':' after the first one makes it a map's key
+            if(count == 0 && element == DRG_TYPE_ANY && D_Check(c, D_TokenType_COLON)) {
+                D_MapLiteral(c, &bracket, DRG_TYPE_ANY, true);
+                return;
+            }
+            if(element == DRG_TYPE_ANY) {
+                element = c->type;
+                if(element > DRG_TYPE_STRING && !D_IsStructType(element)) {
+                    D_Error(c, "Arrays can only hold ints, reals, bools, strings and structs.");
+                    c->nesting--;
+                    return;
+                }
+            }
+            D_Coerce(c, element);
+            holdsConstant = holdsConstant || D_IsSharedConstant(c);
+            if(++count > UINT16_MAX) {
+                D_Error(c, "Too many elements in one array literal.");
+            }
+        } while(D_Match(c, D_TokenType_COMMA));
+    }
+    c->nesting--;
+    D_Expect(c, D_TokenType_RBRACK, "Expected ']' after the elements.");
+    if(element == DRG_TYPE_ANY) {
+        D_ErrorAt(c, &bracket, "An empty array needs a declared type.");
+        return;
+    }
+    if(expect.size > 0 && count != expect.size) {
+        char message[64];
+        snprintf(message, sizeof(message), "Expected %d elements, not %d.", expect.size, count);
+        D_ErrorAt(c, &bracket, message);
+        return;
+    }
+    // Only a [*] can be resized, though with nothing to go on it's
+    // taken to be one
+    int size = D_IsArrayType(expect.type) ? expect.size : DRG_SIZE_RESIZABLE;
+    D_MarkPosition(c, &bracket);
+    D_EmitArray(c, DRG_OC_ARRAY, element, size, count);
+    // A struct's row is a copy, but what its fields refer to isn't
+    c->isConstant = holdsConstant;
+}
+
+// array '[' index ']' ['=' expression], or the same with a map and
+// a key
+static void D_Index(D_Compiler* c, bool canAssign) {
+    if(!D_CheckStackMode(c)) return;
+    D_Token bracket = c->previous;
+    drgType container = c->type;
+    bool isConstant = c->isConstant;
+    bool isMap = D_IsMapType(container);
+    if(!D_IsArrayType(container) && !isMap && container != DRG_TYPE_ANY) {
+        D_Error(c, "Can only index arrays and maps.");
+        return;
+    }
+    c->nesting++;
+    D_SkipNewlines(c);
+    if(isMap) {
+        D_ExpressionOf(c, D_Spec(D_KeyOf(container)));
+    }
+    else if(container != DRG_TYPE_ANY) {
+        D_ExpressionOf(c, D_Spec(DRG_TYPE_INT));
+    }
+    else {
+        D_Expression(c); // an index or a key, found out at runtime
+    }
+    c->nesting--;
+    D_Expect(c, D_TokenType_RBRACK, isMap ? "Expected ']' after the key." : "Expected ']' after the index.");
+    drgType element = DRG_TYPE_ANY;
+    if(isMap) element = D_ValueOf(container);
+    else if(D_IsArrayType(container)) element = D_ElementOf(container);
+    // A field of a struct array's row is reached in the row, rather
+    // than in a copy of it
+    if(D_IsStructType(element) && D_Match(c, D_TokenType_DOT)) {
+        c->type = element;
+        c->isConstant = isConstant;
+        D_FieldAccess(c, canAssign, &bracket, DRG_OC_GET_ROW_FIELD, DRG_OC_SET_ROW_FIELD);
+        return;
+    }
+    // Typed forms when the elements are unboxed ints, reals or bools
+    bool typed = !isMap && element <= DRG_TYPE_BOOL;
+    if(canAssign && D_Match(c, D_TokenType_ASSIGN)) {
+        if(isConstant) {
+            D_ErrorAt(c, &bracket, "Cannot assign to an element of a constant; declare it with 'var'.");
+            return;
+        }
+        D_SkipNewlines(c);
+        D_ExpressionOf(c, D_Spec(element));
+        D_CheckShared(c);
+        D_MarkPosition(c, &bracket);
+        if(isMap) D_EmitOp(c, DRG_OC_SET_MAP);
+        else D_EmitOp(c, typed ? (drgOpcode)(DRG_OC_SET_INDEX_INT + element) : DRG_OC_SET_INDEX);
+    }
+    else {
+        D_MarkPosition(c, &bracket);
+        if(isMap) {
+            // A lookup of its own for each type of key
+            drgType key = D_KeyOf(container);
+            D_EmitOp(c, key == DRG_TYPE_INT ? DRG_OC_GET_MAP_INT
+                : key == DRG_TYPE_REAL ? DRG_OC_GET_MAP_REAL : DRG_OC_GET_MAP_STRING);
+        }
+        else {
+            D_EmitOp(c, typed ? (drgOpcode)(DRG_OC_GET_INDEX_INT + element) : DRG_OC_GET_INDEX);
+        }
+    }
+    c->type = element;
+    c->isConstant = false;
+}
+
+// A field left out of a struct literal.
+static void D_EmitFieldDefault(D_Compiler* c, const D_StructField* field) {
+    if(field->hasDefault) {
+        D_EmitValue(c, field->value);
+    }
+    else {
+        D_EmitDefault(c, field->type);
+    }
+}
+
+// The field of struct 'decl' named by the token just consumed, or
+// -1 after an error.
+static int D_FindField(D_Compiler* c, const D_StructDecl* decl) {
+    drgString* name = D_InternName(&c->previous);
+    for(int i = 0; i < decl->fieldCount; i++) {
+        if(D_FieldOf(c, decl, i)->name == name) {
+            return i;
+        }
+    }
+    D_Error(c, "The struct has no field by this name.");
+    return -1;
+}
+
+// The rest of a '{' [name '=' expression {',' name '=' expression}]
+// '}' literal of struct 'type', from inside the braces. The fields
+// given have to be in the order they're declared, so each value is
+// computed straight into its place; the ones left out take their
+// defaults.
+static void D_StructBody(D_Compiler* c, D_Token* brace, drgType type) {
+    if(!D_CheckStackMode(c)) return;
+    D_Token at = *brace;
+    const D_StructDecl* decl = D_StructOf(c, type);
+    int next = 0; // the first field not pushed yet
+    bool holdsConstant = false;
+    c->nesting++;
+    D_SkipNewlines(c);
+    if(!D_Check(c, D_TokenType_RBRACE)) {
+        do {
+            D_Expect(c, D_TokenType_IDENTIFIER, "Expected a field name.");
+            int field = (c->previous.type == D_TokenType_IDENTIFIER) ? D_FindField(c, decl) : -1;
+            if(field < 0) {
+                c->nesting--;
+                return;
+            }
+            if(field < next) {
+                D_Error(c, "Fields must be given once each, in the order they're declared.");
+                c->nesting--;
+                return;
+            }
+            D_Expect(c, D_TokenType_ASSIGN, "Expected '=' after the field name.");
+            while(next < field) {
+                D_EmitFieldDefault(c, D_FieldOf(c, decl, next++));
+            }
+            D_ExpressionOf(c, D_FieldOf(c, decl, field)->type);
+            holdsConstant = holdsConstant || D_IsSharedConstant(c);
+            next++;
+        } while(D_Match(c, D_TokenType_COMMA));
+    }
+    c->nesting--;
+    D_Expect(c, D_TokenType_RBRACE, "Expected '}' after the fields.");
+    while(next < decl->fieldCount) {
+        D_EmitFieldDefault(c, D_FieldOf(c, decl, next++));
+    }
+    D_MarkPosition(c, &at);
+    D_EmitStruct(c, type);
+    // Holding a constant by reference, it has to be one itself
+    c->isConstant = holdsConstant;
+}
+
+// '{' fields '}' where a struct is expected, e.g. the value of a
+// declaration of one.
+static void D_StructLiteral(D_Compiler* c, bool canAssign) {
+    D_Token brace = c->previous;
+    drgType type = c->expect.type;
+    c->expect = D_Spec(DRG_TYPE_ANY);
+    if(!D_IsStructType(type)) {
+        D_Error(c, "A struct literal needs a declared type, or the struct's name before the '{'.");
+        return;
+    }
+    D_StructBody(c, &brace, type);
+}
+
+// The field named after the '.' just consumed, of the struct the
+// last expression left, got or set with 'get' or 'set': a struct's
+// own ops, or those of a row of a struct array. Runtime errors are
+// reported at 'at'.
+static void D_FieldAccess(D_Compiler* c, bool canAssign, const D_Token* at, drgOpcode get, drgOpcode set) {
+    drgType type = c->type;
+    bool isConstant = c->isConstant;
+    D_Expect(c, D_TokenType_IDENTIFIER, "Expected a field name after '.'.");
+    if(c->previous.type != D_TokenType_IDENTIFIER) return;
+    D_Token name = c->previous;
+    if(!D_IsStructType(type)) {
+        D_Error(c, "Only structs have fields.");
+        return;
+    }
+    const D_StructDecl* decl = D_StructOf(c, type);
+    int offset = D_FindField(c, decl);
+    if(offset < 0) return;
+    const D_StructField* field = D_FieldOf(c, decl, offset);
+    if(field->isPrivate) {
+        D_Error(c, "A private field can only be set by a struct literal.");
+        return;
+    }
+    if(canAssign && D_Match(c, D_TokenType_ASSIGN)) {
+        if(field->isReadonly) {
+            D_ErrorAt(c, &name, "Cannot assign to a readonly field.");
+            return;
+        }
+        if(isConstant) {
+            D_ErrorAt(c, &name, "Cannot assign to a field of a constant; declare it with 'var'.");
+            return;
+        }
+        D_SkipNewlines(c);
+        D_ExpressionOf(c, field->type);
+        D_CheckShared(c);
+        D_MarkPosition(c, at);
+        D_EmitField(c, set, offset);
+        c->isConstant = false;
+    }
+    else {
+        D_MarkPosition(c, at);
+        D_EmitField(c, get, offset);
+        // What's in a constant or a readonly field is too
+        c->isConstant = isConstant || field->isReadonly;
+    }
+    c->type = field->type.type;
+}
+
+// struct '.' field ['=' expression]. Fields are at offsets known
+// now, so there's no lookup at runtime; 'readonly' and 'private'
+// are only checked here.
+static void D_Field(D_Compiler* c, bool canAssign) {
+    if(!D_CheckStackMode(c)) return;
+    D_Token dot = c->previous;
+    D_FieldAccess(c, canAssign, &dot, DRG_OC_GET_FIELD, DRG_OC_SET_FIELD);
+}
+
+// Short-circuits: the right side only runs if the left is true.
+static void D_And(D_Compiler* c, bool canAssign) {
+    if(!D_CheckStackMode(c)) return;
+    D_CheckCondition(c);
+    int endJump = D_EmitJump(c, DRG_OC_JUMP_IF_FALSE);
+    D_EmitOp(c, DRG_OC_POP);
+    D_SkipNewlines(c);
+    D_ParsePrecedence(c, D_Prec_AND);
+    D_CheckCondition(c);
+    D_PatchJump(c, endJump);
+}
+
+// Short-circuits: the right side only runs if the left is false.
+static void D_Or(D_Compiler* c, bool canAssign) {
+    if(!D_CheckStackMode(c)) return;
+    D_CheckCondition(c);
+    int elseJump = D_EmitJump(c, DRG_OC_JUMP_IF_FALSE);
+    int endJump = D_EmitJump(c, DRG_OC_JUMP);
+    D_PatchJump(c, elseJump);
+    D_EmitOp(c, DRG_OC_POP);
+    D_SkipNewlines(c);
+    D_ParsePrecedence(c, D_Prec_OR);
+    D_CheckCondition(c);
+    D_PatchJump(c, endJump);
+}
+
+static const D_ParseRule D_Rules[D_TokenType_Count] = {
+    [D_TokenType_LPAREN]          = { D_Grouping, D_Call,   D_Prec_CALL },
+    [D_TokenType_LBRACK]          = { D_ArrayLiteral, D_Index, D_Prec_CALL },
+    [D_TokenType_LBRACE]          = { D_StructLiteral, NULL, D_Prec_NONE },
+    [D_TokenType_DOT]             = { NULL,       D_Field,  D_Prec_CALL },
+    [D_TokenType_MINUS]           = { D_Unary,    D_Binary, D_Prec_TERM },
+    [D_TokenType_PLUS]            = { NULL,       D_Binary, D_Prec_TERM },
+    [D_TokenType_SLASH]           = { NULL,       D_Binary, D_Prec_FACTOR },
+    [D_TokenType_STAR]            = { NULL,       D_Binary, D_Prec_FACTOR },
+    [D_TokenType_GT]              = { NULL,       D_Binary, D_Prec_COMPARISON },
+    [D_TokenType_GTE]             = { NULL,       D_Binary, D_Prec_COMPARISON },
+    [D_TokenType_LT]              = { NULL,       D_Binary, D_Prec_COMPARISON },
+    [D_TokenType_LTE]             = { NULL,       D_Binary, D_Prec_COMPARISON },
+    [D_TokenType_KW_eq]           = { NULL,       D_Binary, D_Prec_EQUALITY },
+    [D_TokenType_KW_neq]          = { NULL,       D_Binary, D_Prec_EQUALITY },
+    [D_TokenType_KW_not]          = { D_Unary,    NULL,     D_Prec_NONE },
+    [D_TokenType_KW_and]          = { NULL,       D_And,    D_Prec_AND },
+    [D_TokenType_KW_or]           = { NULL,       D_Or,     D_Prec_OR },
+    [D_TokenType_KW_true]         = { D_Literal,  NULL,     D_Prec_NONE },
+    [D_TokenType_KW_false]        = { D_Literal,  NULL,     D_Prec_NONE },
+    [D_TokenType_INTEGER_LITERAL] = { D_Number,   NULL,     D_Prec_NONE },
+    [D_TokenType_REAL_LITERAL]    = { D_Number,   NULL,     D_Prec_NONE },
+    [D_TokenType_STRING_LITERAL]  = { D_String,   NULL,     D_Prec_NONE },
+    [D_TokenType_IDENTIFIER]      = { D_Variable, NULL,     D_Prec_NONE },
+};
+
+static const D_ParseRule* D_GetRule(D_TokenType type) {
+    static const D_ParseRule none = { NULL, NULL, D_Prec_NONE };
+    return (type >= 0) ? &D_Rules[type] : &none;
+}
+
+// Guards the recursive parse functions. Pair with D_Ascend().
+static bool D_Descend(D_Compiler* c) {
+    if(++c->parseDepth > DRG_PARSE_DEPTH_MAX) {
+        D_ErrorAtCurrent(c, "Code is nested too deeply.");
+        return false;
+    }
+    return true;
+}
+
+static void D_Ascend(D_Compiler* c) {
+    c->parseDepth--;
+}
+
+static void D_ParsePrecedence(D_Compiler* c, D_Precedence precedence) {
+    if(!D_Descend(c)) {
+        D_Ascend(c);
+        return;
+    }
+    D_Advance(c);
+    D_ParseFn prefix = D_GetRule(c->previous.type)->prefix;
+    if(NULL == prefix) {
+        D_Error(c, "Expected an expression.");
+        D_Ascend(c);
+        return;
+    }
+    bool canAssign = precedence <= D_Prec_ASSIGNMENT;
+    prefix(c, canAssign);
+    // Only the leading operand is what's expected
+    c->expect = D_Spec(DRG_TYPE_ANY);
+
+    while(precedence <= D_GetRule(c->current.type)->precedence) {
+        D_Advance(c);
+        D_GetRule(c->previous.type)->infix(c, canAssign);
+    }
+
+    if(canAssign && D_Check(c, D_TokenType_ASSIGN)) {
+        D_ErrorAtCurrent(c, "Invalid assignment target.");
+    }
+    D_Ascend(c);
+}
+
+static void D_Expression(D_Compiler* c) {
+    D_ParsePrecedence(c, D_Prec_ASSIGNMENT);
+}
+
+// An expression that's to be of 'type', which array literals
+// take their element type and size from.
+static void D_ExpressionOf(D_Compiler* c, D_TypeSpec type) {
+    c->expect = type;
+    D_Expression(c);
+    c->expect = D_Spec(DRG_TYPE_ANY);
+    D_Coerce(c, type.type);
+}
+
+/*****************************************************************
+* Statements
+*****************************************************************/
+
+static bool D_IsTypeName(D_TokenType type) {
+    switch(type) {
+        case D_TokenType_KW_int:
+        case D_TokenType_KW_real:
+        case D_TokenType_KW_bool:
+        case D_TokenType_KW_string:
+        case D_TokenType_LBRACK: // a map type
+            return true;
+        default:
+            return false;
+    }
+}
+
+// A type name is coming up, a struct's included.
+static bool D_AtTypeName(D_Compiler* c) {
+    return D_IsTypeName(c->current.type) || D_StructIndex(c, &c->current) >= 0;
+}
+
+// Every statement ends at a newline (or the end of the source, or
+// of the block it's in).
+static void D_EndStatement(D_Compiler* c) {
+    if(D_Check(c, D_TokenType_EOF) || D_Check(c, D_TokenType_RBRACE)) return;
+    D_Expect(c, D_TokenType_NEWLINE, "Expected a newline after statement.");
+}
+
+// The int, real, bool or string type name coming up, or
+// DRG_TYPE_ANY if it isn't one.
+static drgType D_ParseElementType(D_Compiler* c, const char* message) {
+    if(!D_IsTypeName(c->current.type) || D_Check(c, D_TokenType_LBRACK)) {
+        D_ErrorAtCurrent(c, message);
+        return DRG_TYPE_ANY;
+    }
+    D_Advance(c);
+    return D_TypeOfToken(c->previous.type);
+}
+
+// '[' key ':' value ']', the '[' just consumed
+static D_TypeSpec D_ParseMapType(D_Compiler* c) {
+    D_TypeSpec spec = D_Spec(DRG_TYPE_ANY);
+    drgType key = D_ParseElementType(c, "Expected a key type.");
+    if(key == DRG_TYPE_BOOL) {
+        D_Error(c, "Map keys can only be ints, reals and strings.");
+        return spec;
+    }
+    D_Expect(c, D_TokenType_COLON, "Expected ':' after the key type.");
+    drgType value = D_ParseElementType(c, "Expected a value type.");
+    D_Expect(c, D_TokenType_RBRACK, "Expected ']' after the value type.");
+    if(key != DRG_TYPE_ANY && value != DRG_TYPE_ANY) {
+        spec.type = D_MapOf(key, value);
+    }
+    return spec;
+}
+
+// type ['[' [size | '*'] ']'], a map type or a struct's name, the
+// type name (or the map's '[') just consumed
+static D_TypeSpec D_ParseTypeSpec(D_Compiler* c) {
+    if(c->previous.type == D_TokenType_LBRACK) {
+        return D_ParseMapType(c);
+    }
+    int index = D_StructIndex(c, &c->previous);
+    D_TypeSpec spec = D_Spec((index >= 0) ? (drgType)(DRG_TYPE_STRUCT + index) : D_TypeOfToken(c->previous.type));
+    if(!D_Match(c, D_TokenType_LBRACK)) {
+        return spec;
+    }
+    if(spec.type > DRG_TYPE_STRING && !D_IsStructType(spec.type)) {
+        D_Error(c, "Arrays can only hold ints, reals, bools, strings and structs.");
+        return spec;
+    }
+    spec.type = D_ArrayOf(spec.type);
+    spec.size = 0;
+    if(D_Match(c, D_TokenType_STAR)) {
+        spec.size = DRG_SIZE_RESIZABLE;
+    }
+    else if(D_Match(c, D_TokenType_INTEGER_LITERAL)) {
+        long long size = strtoll(c->previous.start, NULL, 10);
+        if(size < 1 || size > DRG_ARRAY_MAX) {
+            D_Error(c, "Array size out of range.");
+        }
+        else {
+            spec.size = (int)size;
+        }
+    }
+    D_Expect(c, D_TokenType_RBRACK, "Expected ']' after the array size.");
+    return spec;
+}
+
+// The default value of a declaration without an initializer
+static void D_EmitDefault(D_Compiler* c, D_TypeSpec spec) {
+    switch(spec.type) {
+        case DRG_TYPE_REAL:   D_EmitLiteral(c, drgValFromReal(0.0)); return;
+        case DRG_TYPE_BOOL:   D_EmitOp(c, DRG_OC_FALSE); return;
+        case DRG_TYPE_STRING: D_EmitLiteral(c, drgValFromObj(drgIntern("", 0))); return;
+        case DRG_TYPE_INT:    D_EmitLiteral(c, drgValFromInt(0)); return;
+        case DRG_TYPE_ANY:    return; // a type that didn't parse
+        default:              break;
+    }
+    if(!D_CheckStackMode(c)) return;
+    // Maps start empty
+    if(D_IsMapType(spec.type)) {
+        D_EmitMap(c, spec.type, 0);
+        return;
+    }
+    // Structs start with every field's default
+    if(D_IsStructType(spec.type)) {
+        const D_StructDecl* decl = D_StructOf(c, spec.type);
+        for(int i = 0; i < decl->fieldCount; i++) {
+            D_EmitFieldDefault(c, D_FieldOf(c, decl, i));
+        }
+        D_EmitStruct(c, spec.type);
+        return;
+    }
+    // Arrays: sized ones start full of their element's default,
+    // [*] ones empty
+    if(spec.size == DRG_SIZE_RESIZABLE) {
+        D_EmitArray(c, DRG_OC_ARRAY, D_ElementOf(spec.type), spec.size, 0);
+    }
+    else if(spec.size > 0) {
+        D_EmitLiteral(c, drgValFromInt(spec.size));
+        D_EmitDefault(c, D_Spec(D_ElementOf(spec.type)));
+        D_EmitArray(c, DRG_OC_NEW_ARRAY, D_ElementOf(spec.type), spec.size, 0);
+    }
+    else {
+        D_Error(c, "An array of no size needs a value.");
+    }
+}
+
+// ['var'] type name ['=' expression]
+static void D_Declaration(D_Compiler* c, bool isMutable) {
+    D_Advance(c); // type
+    D_TypeSpec spec = D_ParseTypeSpec(c);
+    D_Expect(c, D_TokenType_IDENTIFIER, "Expected a name after the type.");
+    drgString* name = D_InternName(&c->previous);
+    // Inside a block it's a local, at the top level a global
+    bool isLocal = c->fn->scopeDepth > 0;
+    if(D_GlobalTableFindStruct(c->globals, name) >= 0) {
+        D_Error(c, "A struct with this name is already declared.");
+        return;
+    }
+    if(isLocal) {
+        for(int i = c->fn->localCount - 1; i > 0 && c->fn->locals[i].depth == c->fn->scopeDepth; i--) {
+            if(c->fn->locals[i].name == name) {
+                D_Error(c, "A name with this identifier is already declared in this scope.");
+                return;
+            }
+        }
+    }
+    else if(D_GlobalTableFind(c->globals, name) >= 0) {
+        D_Error(c, "A name with this identifier is already declared.");
+        return;
+    }
+    else if(c->globals->count >= DRG_GLOBALS_MAX) {
+        D_Error(c, "Too many global declarations.");
+        return;
+    }
+
+    // The initializer can't see the name being declared, so it is
+    // only added once the value has been compiled.
+    int start = c->nugget->count;
+    if(D_Match(c, D_TokenType_ASSIGN)) {
+        D_SkipNewlines(c);
+        D_ExpressionOf(c, spec);
+        if(isMutable) {
+            D_CheckShared(c);
+        }
+    }
+    else {
+        // Everything starts at its type's default
+        D_EmitDefault(c, spec);
+    }
+    if(isLocal) {
+        D_AddLocal(c, name, spec, isMutable);
+        return;
+    }
+    D_GlobalSymbol symbol = { name, spec, isMutable, false, false, drgValNone(), 0, 0, D_Spec(DRG_TYPE_NONE) };
+    // A constant that's folded down to one is used as one
+    const D_Constant* value = D_LastConstant(c, start);
+    if(!isMutable && D_Optimizing(c) && NULL != value && value->start == start) {
+        symbol.hasValue = true;
+        symbol.value = value->value;
+    }
+    D_EmitGlobal(c, DRG_OC_DEFINE_GLOBAL, D_GlobalTableAdd(c->globals, &symbol));
+}
+
+// print(expression) - built in until functions exist
+static void D_PrintStatement(D_Compiler* c) {
+    D_Advance(c); // print
+    D_Expect(c, D_TokenType_LPAREN, "Expected '(' after 'print'.");
+    c->nesting++;
+    D_SkipNewlines(c);
+    D_Expression(c);
+    c->nesting--;
+    D_Expect(c, D_TokenType_RPAREN, "Expected ')' after value.");
+    D_EmitOp(c, DRG_OC_PRINT);
+}
+
+static void D_Statement(D_Compiler* c);
+
+// Statements up to the closing brace, the opening one already
+// consumed.
+static void D_Block(D_Compiler* c) {
+    if(!D_Descend(c)) {
+        D_Ascend(c);
+        c->returns = false;
+        return;
+    }
+    // Whatever follows a statement that returns is never run
+    bool returns = false;
+    for(;;) {
+        D_SkipNewlines(c);
+        if(D_Check(c, D_TokenType_RBRACE) || D_Check(c, D_TokenType_EOF)) {
+            break;
+        }
+        D_Statement(c);
+        returns = returns || c->returns;
+    }
+    D_Expect(c, D_TokenType_RBRACE, "Expected '}' after block.");
+    D_Ascend(c);
+    c->returns = returns;
+}
+
+// '{' statements '}', with its own scope
+static void D_ScopedBlock(D_Compiler* c) {
+    D_Expect(c, D_TokenType_LBRACE, "Expected '{' before block.");
+    D_BeginScope(c);
+    D_Block(c);
+    D_EndScope(c);
+}
+
+// 'if' condition block ['else' ('if' ... | block)]
+static void D_IfStatement(D_Compiler* c) {
+    D_Expression(c);
+    D_CheckCondition(c);
+    int thenJump = D_EmitJump(c, DRG_OC_JUMP_IF_FALSE);
+    D_EmitOp(c, DRG_OC_POP);
+    D_ScopedBlock(c);
+    bool thenReturns = c->returns;
+    int elseJump = D_EmitJump(c, DRG_OC_JUMP);
+
+    D_PatchJump(c, thenJump);
+    // The condition is still on the stack when the branch is taken
+    D_StackEffect(c, 1);
+    D_EmitOp(c, DRG_OC_POP);
+    // 'else' may start the next line
+    D_SkipNewlines(c);
+    bool elseReturns = false;
+    if(D_Match(c, D_TokenType_KW_else)) {
+        if(D_Match(c, D_TokenType_KW_if)) {
+            D_IfStatement(c);
+        }
+        else {
+            D_ScopedBlock(c);
+        }
+        elseReturns = c->returns;
+    }
+    D_PatchJump(c, elseJump);
+    c->returns = thenReturns && elseReturns;
+}
+
+// Leaves the loop if the condition on the stack is false,
+// otherwise jumps back to 'start'.
+static void D_LoopCondition(D_Compiler* c, int start, bool atEnd) {
+    int exitJump = D_EmitJump(c, DRG_OC_JUMP_IF_FALSE);
+    D_EmitOp(c, DRG_OC_POP);
+    if(!atEnd) {
+        D_ScopedBlock(c);
+    }
+    D_EmitLoop(c, start);
+    D_PatchJump(c, exitJump);
+    D_StackEffect(c, 1);
+    D_EmitOp(c, DRG_OC_POP);
+}
+
+// 'loop' 'if' condition block - while
+// 'loop' block 'if' condition - do-while, 'if' on the same line
+// 'loop' block                - forever
+static void D_LoopStatement(D_Compiler* c) {
+    int start = c->nugget->count;
+    c->fn->lastTarget = start;
+    if(D_Match(c, D_TokenType_KW_if)) {
+        D_Expression(c);
+        D_CheckCondition(c);
+        D_LoopCondition(c, start, false);
+        // The body may never run
+        c->returns = false;
+        return;
+    }
+    D_ScopedBlock(c);
+    // The body runs at least once, and there's no 'break', so only
+    // returning gets out of a loop forever
+    bool returns = c->returns;
+    if(D_Match(c, D_TokenType_KW_if)) {
+        D_Expression(c);
+        D_CheckCondition(c);
+        D_LoopCondition(c, start, true);
+        c->returns = returns;
+        return;
+    }
+    D_EmitLoop(c, start);
+    c->returns = true;
+}
+
+// 'return' [expression]
+static void D_ReturnStatement(D_Compiler* c) {
+    if(NULL == c->fn->function) {
+        D_Error(c, "Cannot return from top-level code.");
+        return;
+    }
+    bool hasValue = !D_Check(c, D_TokenType_NEWLINE) && !D_Check(c, D_TokenType_RBRACE) &&
+        !D_Check(c, D_TokenType_EOF);
+    if(hasValue != c->fn->hasReturnType) {
+        D_Error(c, hasValue ? "Function has no return type, so cannot return a value."
+            : "Expected a value to return.");
+        return;
+    }
+    if(hasValue) {
+        // The caller can change what it's given
+        D_ExpressionOf(c, c->fn->returnType);
+        D_CheckShared(c);
+        D_EmitOp(c, DRG_OC_RETURN);
+    }
+    else {
+        D_EmitReturnNone(c);
+    }
+    c->returns = true;
+}
+
+// ['var'] type name, of the function in global 'slot'
+static void D_Parameter(D_Compiler* c, int slot) {
+    bool isMutable = D_Match(c, D_TokenType_KW_var);
+    if(!D_AtTypeName(c)) {
+        D_ErrorAtCurrent(c, "Expected a parameter type.");
+        return;
+    }
+    D_Advance(c);
+    D_TypeSpec type = D_ParseTypeSpec(c);
+    D_Expect(c, D_TokenType_IDENTIFIER, "Expected a parameter name.");
+    drgString* name = D_InternName(&c->previous);
+    if(D_GlobalTableFindStruct(c->globals, name) >= 0) {
+        D_Error(c, "A struct with this name is already declared.");
+        return;
+    }
+    if(++c->fn->function->arity > DRG_ARGS_MAX) {
+        D_Error(c, "Too many parameters.");
+        return;
+    }
+    // The caller pushed it
+    D_StackEffect(c, 1);
+    D_AddLocal(c, name, type, isMutable);
+    D_GlobalTableAddParam(c->globals, type, isMutable);
+    c->globals->symbols[slot].arity++;
+}
+
+static D_FunctionState* D_BeginFunction(D_Compiler* c, drgFunction* function, drgNugget* nugget) {
+    D_FunctionState* fn = (D_FunctionState*)D_ArenaAlloc(&c->arena, sizeof(D_FunctionState));
+    fn->enclosing = c->fn;
+    fn->function = function;
+    fn->nugget = nugget;
+    fn->hasReturnType = false;
+    fn->returnType = D_Spec(DRG_TYPE_NONE);
+    fn->localCount = 0;
+    fn->scopeDepth = (NULL == function) ? 0 : 1;
+    fn->stackDepth = 0;
+    fn->lastTarget = 0;
+    c->fn = fn;
+    c->nugget = nugget;
+    c->markLine = -1;
+    c->pushCount = 0;
+    // Slot 0 holds the function being run
+    D_AddLocal(c, NULL, D_Spec(DRG_TYPE_FUN), false);
+    D_StackEffect(c, 1);
+    return fn;
+}
+
+static void D_EndFunction(D_Compiler* c) {
+    if(D_Optimizing(c) && !c->hadError) {
+        D_Optimize(c->nugget, &c->arena);
+    }
+    if(NULL != c->fn->function) {
+        drgNugget* nugget = c->nugget;
+        drgByte* code = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_BYTECODE, drgByte, NULL, 0, nugget->count);
+        memcpy(code, nugget->bytecode, (size_t)nugget->count);
+        nugget->bytecode = code;
+        nugget->capacity = nugget->count;
+    }
+    c->fn = c->fn->enclosing;
+    c->nugget = (NULL == c->fn) ? NULL : c->fn->nugget;
+    c->markLine = -1;
+    c->pushCount = 0;
+}
+
+// Other programs call an exported function without knowing its
+// parameter types, so it checks its arguments itself.
+static void D_CheckArguments(D_Compiler* c) {
+    for(int slot = 1; slot < c->fn->localCount; slot++) {
+        drgType type = c->fn->locals[slot].type.type;
+        D_EmitLocal(c, DRG_OC_GET_LOCAL, slot);
+        D_Emit2(c, DRG_OC_CHECK_TYPE, (drgByte)type);
+        if(type == DRG_TYPE_REAL) {
+            D_EmitLocal(c, DRG_OC_SET_LOCAL, slot);
+        }
+        D_EmitOp(c, DRG_OC_POP);
+    }
+}
+
+// ['export'] 'fun' name ['(' [parameter {',' parameter}] [':' type] ')'] block
+static void D_FunDeclaration(D_Compiler* c, bool isExported) {
+    if(!D_CheckStackMode(c)) return;
+    if(c->fn->function != NULL || c->fn->scopeDepth > 0) {
+        D_Error(c, "Functions can only be declared at the top level.");
+        return;
+    }
+    D_Expect(c, D_TokenType_IDENTIFIER, "Expected a function name.");
+    drgString* name = D_InternName(&c->previous);
+    if(D_GlobalTableFind(c->globals, name) >= 0 || D_GlobalTableFindStruct(c->globals, name) >= 0) {
+        D_Error(c, "A name with this identifier is already declared.");
+        return;
+    }
+    if(c->globals->count >= DRG_GLOBALS_MAX) {
+        D_Error(c, "Too many global declarations.");
+        return;
+    }
+    // Declared before the body, so the function can call itself
+    D_GlobalSymbol symbol = { name, D_Spec(DRG_TYPE_FUN), false, isExported, false, drgValNone(),
+        0, c->globals->paramCount, D_Spec(DRG_TYPE_NONE) };
+    int slot = D_GlobalTableAdd(c->globals, &symbol);
+
+    // Into the constant pool straight away, so it's freed with the
+    // nugget however compiling it goes. The slot is taken first, as
+    // growing the pool may run out of memory.
+    drgValArray* pool = &c->nugget->constantPool;
+    int index = D_CheckLiteral(c, drgNuggetAppendLiteral(c->nugget, drgValNone()));
+    drgFunction* function = drgNewFunction();
+    function->name = name;
+    pool->values[pool->count - 1] = drgValFromObj(function);
+
+    D_FunctionState* fn = D_BeginFunction(c, function, &function->nugget);
+    if(D_Match(c, D_TokenType_LPAREN)) {
+        c->nesting++;
+        D_SkipNewlines(c);
+        if(!D_Check(c, D_TokenType_RPAREN) && !D_Check(c, D_TokenType_COLON)) {
+            do {
+                D_Parameter(c, slot);
+            } while(D_Match(c, D_TokenType_COMMA));
+        }
+        if(D_Match(c, D_TokenType_COLON)) {
+            if(!D_AtTypeName(c)) {
+                D_ErrorAtCurrent(c, "Expected a return type after ':'.");
+            }
+            else {
+                D_Advance(c);
+                fn->hasReturnType = true;
+                fn->returnType = D_ParseTypeSpec(c);
+                c->globals->symbols[slot].returnType = fn->returnType;
+            }
+        }
+        c->nesting--;
+        D_Expect(c, D_TokenType_RPAREN, "Expected ')' after parameters.");
+    }
+    D_Expect(c, D_TokenType_LBRACE, "Expected '{' before function body.");
+    if(isExported) {
+        D_CheckArguments(c);
+    }
+    D_Block(c);
+    // Only a function without a return type may fall off its end,
+    // which returns 'none'
+    if(fn->hasReturnType && !c->returns) {
+        D_Error(c, "Function can reach its end without returning a value.");
+    }
+    D_EmitReturnNone(c);
+    D_EndFunction(c);
+    c->returns = false;
+
+    D_EmitConstant(c, index);
+    D_EmitGlobal(c, DRG_OC_DEFINE_GLOBAL, slot);
+}
+
+static bool D_CheckTopLevel(D_Compiler* c, const char* message) {
+    if(c->fn->function != NULL || c->fn->scopeDepth > 0) {
+        D_Error(c, message);
+        return false;
+    }
+    return true;
+}
+
+// 'module' name {'.' name}
+static void D_ModuleStatement(D_Compiler* c) {
+    if(!D_CheckTopLevel(c, "A module can only be declared at the top level.")) return;
+    if(NULL != c->globals->moduleName) {
+        D_Error(c, "A file can only declare one module.");
+        return;
+    }
+    D_Expect(c, D_TokenType_IDENTIFIER, "Expected a module name.");
+    char name[DRG_NAME_MAX];
+    int length = D_DottedName(c, name);
+    if(length > 0) {
+        c->globals->moduleName = drgIntern(name, length);
+    }
+}
+
+// 'include' name {'.' name}
+static void D_IncludeStatement(D_Compiler* c) {
+    D_Advance(c); // include
+    if(!D_CheckTopLevel(c, "Modules can only be included at the top level.")) return;
+    if(c->flags & D_CompileFlag_MODULE) {
+        D_Error(c, "A module cannot include other modules yet.");
+        return;
+    }
+    D_Expect(c, D_TokenType_IDENTIFIER, "Expected a module name.");
+    char name[DRG_NAME_MAX];
+    int length = D_DottedName(c, name);
+    if(0 == length || NULL != D_FindInclude(c, name, length)) return;
+    drgModule* module = drgModuleInclude(name, length);
+    if(NULL == module) {
+        D_Error(c, "Could not find a module by this name.");
+        return;
+    }
+    D_GlobalTable* globals = c->globals;
+    if(globals->includeCapacity < globals->includeCount + 1) {
+        int capacity = DRG_MEM_GROW_CAPACITY(globals->includeCapacity);
+        globals->includes = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_COMPILER, drgModule*, globals->includes, globals->includeCapacity, capacity);
+        globals->includeCapacity = capacity;
+    }
+    globals->includes[globals->includeCount++] = module;
+}
+
+// Skips to the start of the next statement after an error.
+static void D_Synchronize(D_Compiler* c) {
+    c->nesting = 0;
+    c->operandCount = 0;
+    c->tempCount = 0;
+    c->lastDst = -1;
+    while(!D_Check(c, D_TokenType_EOF) && !D_Check(c, D_TokenType_RBRACE) &&
+        c->previous.type != D_TokenType_NEWLINE) {
+        D_Advance(c);
+    }
+    c->panicMode = false;
+}
+
+// The default of a field, which has to be a literal, as every
+// struct literal that leaves the field out pushes it again.
+static bool D_FieldDefault(D_Compiler* c, drgType type, drgVal* value) {
+    bool isNegative = D_Match(c, D_TokenType_MINUS);
+    D_Advance(c);
+    D_TokenType literal = c->previous.type;
+    if(literal == D_TokenType_INTEGER_LITERAL || literal == D_TokenType_REAL_LITERAL) {
+        if(!D_NumberValue(c, value)) return false;
+        if(isNegative) {
+            *value = drgValIsInt(*value) ? drgValFromInt(-drgValAsInt(*value))
+                : drgValFromReal(-drgValAsReal(*value));
+        }
+    }
+    else if(isNegative) {
+        D_Error(c, "Expected a number after '-'.");
+        return false;
+    }
+    else if(literal == D_TokenType_STRING_LITERAL) {
+        *value = drgValFromObj(drgIntern(c->previous.start + 1, c->previous.length - 2));
+    }
+    else if(literal == D_TokenType_KW_true || literal == D_TokenType_KW_false) {
+        *value = drgValFromBool(literal == D_TokenType_KW_true);
+    }
+    else {
+        D_Error(c, "A field's default must be a literal.");
+        return false;
+    }
+    drgType have = D_TypeOfValue(*value);
+    if(have == DRG_TYPE_INT && type == DRG_TYPE_REAL) {
+        *value = drgValFromReal((double)drgValAsInt(*value));
+    }
+    else if(have != type) {
+        D_TypeMismatch(c, type, have);
+        return false;
+    }
+    return true;
+}
+
+// {'readonly' | 'private'} type name ['=' literal], a field of the
+// struct being declared, which is at the end of the field table.
+static void D_FieldDeclaration(D_Compiler* c, D_StructDecl* decl) {
+    D_StructField field = { NULL, D_Spec(DRG_TYPE_ANY), false, false, false, drgValNone() };
+    for(;;) {
+        if(D_Match(c, D_TokenType_KW_readonly)) field.isReadonly = true;
+        else if(D_Match(c, D_TokenType_KW_private)) field.isPrivate = true;
+        else break;
+    }
+    if(!D_AtTypeName(c)) {
+        bool isItself = D_Check(c, D_TokenType_IDENTIFIER) && D_InternName(&c->current) == decl->name;
+        D_ErrorAtCurrent(c, isItself ? "A struct cannot hold one of its own." : "Expected a field type.");
+        // Past it, or D_Synchronize could stop right before it again
+        if(!D_Check(c, D_TokenType_RBRACE) && !D_Check(c, D_TokenType_EOF)) {
+            D_Advance(c);
+        }
+        return;
+    }
+    D_Advance(c);
+    field.type = D_ParseTypeSpec(c);
+    D_Expect(c, D_TokenType_IDENTIFIER, "Expected a field name after the type.");
+    if(c->previous.type != D_TokenType_IDENTIFIER) return;
+    field.name = D_InternName(&c->previous);
+    for(int i = 0; i < decl->fieldCount; i++) {
+        if(c->globals->structFields[decl->fields + i].name == field.name) {
+            D_Error(c, "A field with this name is already declared.");
+            return;
+        }
+    }
+    if(decl->fieldCount == DRG_STRUCT_FIELDS_MAX) {
+        D_Error(c, "Too many fields in one struct.");
+        return;
+    }
+    if(D_Match(c, D_TokenType_ASSIGN)) {
+        if(field.type.type > DRG_TYPE_STRING) {
+            D_Error(c, "Only int, real, bool and string fields can have a default.");
+            return;
+        }
+        field.hasDefault = D_FieldDefault(c, field.type.type, &field.value);
+    }
+    else if(D_IsArrayType(field.type.type) && 0 == field.type.size) {
+        D_Error(c, "An array field needs a size, or to be a [*].");
+        return;
+    }
+    D_GlobalTableAddField(c->globals, &field);
+    decl->fieldCount++;
+}
+
+// 'struct' name '{' {field} '}'. The fields are laid out in the
+// order they're declared, each at the offset of its place.
+static void D_StructDeclaration(D_Compiler* c) {
+    if(!D_CheckTopLevel(c, "Structs can only be declared at the top level.")) return;
+    D_Expect(c, D_TokenType_IDENTIFIER, "Expected a struct name.");
+    if(c->previous.type != D_TokenType_IDENTIFIER) return;
+    drgString* name = D_InternName(&c->previous);
+    if(D_GlobalTableFind(c->globals, name) >= 0 || D_GlobalTableFindStruct(c->globals, name) >= 0) {
+        D_Error(c, "A name with this identifier is already declared.");
+        return;
+    }
+    if(c->globals->structCount == DRG_STRUCTS_MAX) {
+        D_Error(c, "Too many struct declarations.");
+        return;
+    }
+    D_Expect(c, D_TokenType_LBRACE, "Expected '{' before the fields.");
+    // Declared once its fields are, so none can be of its own type
+    D_StructDecl decl = { name, c->globals->fieldCount, 0 };
+    for(;;) {
+        D_SkipNewlines(c);
+        if(D_Check(c, D_TokenType_RBRACE) || D_Check(c, D_TokenType_EOF)) {
+            break;
+        }
+        D_FieldDeclaration(c, &decl);
+        if(!c->panicMode && !D_Match(c, D_TokenType_COMMA) && !D_Check(c, D_TokenType_RBRACE)) {
+            D_Expect(c, D_TokenType_NEWLINE, "Expected a newline after the field.");
+        }
+        if(c->panicMode) {
+            D_Synchronize(c);
+        }
+    }
+    D_Expect(c, D_TokenType_RBRACE, "Expected '}' after the fields.");
+    D_GlobalTableAddStruct(c->globals, &decl);
+}
+
+static void D_Statement(D_Compiler* c) {
+    // Statements ending in a block need no newline after it
+    bool endsInBlock = false;
+    // The ones that can return set this again
+    c->returns = false;
+    bool moduleTop = (c->flags & D_CompileFlag_MODULE) && NULL == c->fn->function;
+    if(moduleTop && !D_Check(c, D_TokenType_KW_module) && !D_Check(c, D_TokenType_KW_fun) &&
+        !D_Check(c, D_TokenType_KW_export)) {
+        D_Advance(c);
+        D_Error(c, "A module can only declare functions.");
+    }
+    else if(D_Match(c, D_TokenType_KW_var)) {
+        if(!D_AtTypeName(c)) {
+            D_ErrorAtCurrent(c, "Expected a type after 'var'.");
+        }
+        else {
+            D_Declaration(c, true);
+        }
+    }
+    else if(D_AtTypeName(c)) {
+        D_Declaration(c, false);
+    }
+    else if(D_Check(c, D_TokenType_IDENTIFIER) && D_TokenIs(&c->current, "print")) {
+        D_PrintStatement(c);
+    }
+    else if(D_Check(c, D_TokenType_IDENTIFIER) && D_TokenIs(&c->current, "include")) {
+        D_IncludeStatement(c);
+    }
+    else if(D_Match(c, D_TokenType_KW_module)) {
+        D_ModuleStatement(c);
+    }
+    else if(D_Match(c, D_TokenType_KW_fun)) {
+        D_FunDeclaration(c, false);
+        endsInBlock = true;
+    }
+    else if(D_Match(c, D_TokenType_KW_struct)) {
+        D_StructDeclaration(c);
+        endsInBlock = true;
+    }
+    else if(D_Match(c, D_TokenType_KW_export)) {
+        D_Expect(c, D_TokenType_KW_fun, "Only functions can be exported so far.");
+        if(!c->panicMode) D_FunDeclaration(c, true);
+        endsInBlock = true;
+    }
+    else if(D_Match(c, D_TokenType_KW_if)) {
+        if(D_CheckStackMode(c)) D_IfStatement(c);
+        endsInBlock = true;
+    }
+    else if(D_Match(c, D_TokenType_KW_loop)) {
+        if(D_CheckStackMode(c)) D_LoopStatement(c);
+        endsInBlock = true;
+    }
+    else if(D_Check(c, D_TokenType_LBRACE)) {
+        if(D_CheckStackMode(c)) D_ScopedBlock(c);
+        endsInBlock = true;
+    }
+    else if(D_Match(c, D_TokenType_KW_return)) {
+        D_ReturnStatement(c);
+    }
+    else {
+        D_Expression(c);
+        D_EmitOp(c, DRG_OC_POP);
+    }
+    if(!c->panicMode && !endsInBlock) {
+        D_EndStatement(c);
+    }
+    if(c->panicMode) {
+        D_Synchronize(c);
+    }
+}
+
+/*****************************************************************
+* Compiler
+*****************************************************************/
+
+// Drops the arena bytecode of every function still being compiled
+// when an allocation failed, they are already in a constant pool.
+static void D_AbandonFunctions(D_Compiler* c) {
+    for(D_FunctionState* fn = c->fn; fn != NULL; fn = fn->enclosing) {
+        if(NULL != fn->function) {
+            fn->nugget->bytecode = NULL;
+            fn->nugget->count = 0;
+            fn->nugget->capacity = 0;
+        }
+    }
+}
+
+bool D_Compile(const char* source, size_t length, D_GlobalTable* globals, drgNugget* nugget, unsigned flags) {
+    // On the heap, so it's still valid after a failed allocation
+    // longjmps back here.
+    D_Compiler* c = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_COMPILER, D_Compiler, NULL, 0, 1);
+    D_ArenaInit(&c->arena, 0);
+    c->arena.category = DRG_MEM_CAT_COMPILER;
+    c->fn = NULL;
+    drgMemGuard guard;
+    if(setjmp(guard.env)) {
+        drgMemPopGuard(&guard);
+        D_AbandonFunctions(c);
+        D_ArenaFree(&c->arena);
+        DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_COMPILER, D_Compiler, c, 1);
+        D_LogError("Out of memory while compiling (limit %zu bytes).", drgMemGetLimit());
+        return false;
+    }
+    drgMemPushGuard(&guard);
+
+    D_ScannerInit(&c->scanner, source, length);
+    c->hadError = false;
+    c->panicMode = false;
+    c->nesting = 0;
+    c->parseDepth = 0;
+    c->globals = globals;
+    c->flags = flags;
+    c->type = DRG_TYPE_NONE;
+    c->expect = D_Spec(DRG_TYPE_ANY);
+    c->isConstant = false;
+    c->returns = false;
+    c->callee = -1;
+    c->operandCount = 0;
+    c->tempCount = 0;
+    c->lastDst = -1;
+    int start = nugget->count;
+    D_BeginFunction(c, NULL, nugget);
+
+    D_Advance(c);
+    for(;;) {
+        D_SkipNewlines(c);
+        if(D_Check(c, D_TokenType_EOF)) {
+            break;
+        }
+        if(D_Match(c, D_TokenType_RBRACE)) {
+            D_Error(c, "Unexpected '}'.");
+            D_Synchronize(c);
+            continue;
+        }
+        D_Statement(c);
+    }
+    if((flags & D_CompileFlag_MODULE) && NULL == globals->moduleName) {
+        D_ErrorAtCurrent(c, "Expected a 'module' statement.");
+    }
+    D_EmitReturnNone(c);
+    if(D_RegisterMode(c) && !c->hadError) {
+        D_PatchTemps(c, start);
+    }
+    D_EndFunction(c);
+
+    drgMemPopGuard(&guard);
+    bool ok = !c->hadError;
+    D_ArenaFree(&c->arena);
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_COMPILER, D_Compiler, c, 1);
+    return ok;
+}
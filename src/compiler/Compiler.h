@@ -0,0 +1,151 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file Compiler.h
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Single-pass compiler: pulls tokens straight from the scanner
+* and writes bytecode into a nugget, with no syntax tree in
+* between.
+*
+*****************************************************************/
+
+#ifndef DRG_H_COMPILER
+#define DRG_H_COMPILER
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../scanner/Token.h"
+#include "../vm/drgNugget.h"
+#include "../vm/drgModule.h"
+#include "../vm/drgObject.h"
+
+/// @brief Size of a [*] array type.
+#define DRG_SIZE_RESIZABLE (-1)
+
+/// @brief A type as declared. An array type also says how many
+/// elements it holds: a count, DRG_SIZE_RESIZABLE, or 0 for [],
+/// as many as its initializer has.
+typedef struct {
+    drgType type;
+    int size;
+} D_TypeSpec;
+
+/// @brief A name declared at the top level of a program.
+typedef struct {
+    drgString* name;        // interned
+    D_TypeSpec type;        // DRG_TYPE_FUN for functions
+    bool isMutable;         // declared with 'var'
+    bool isExported;        // declared with 'export'
+    bool hasValue;          // a constant whose value is known while
+    drgVal value;           // compiling (D_CompileFlag_OPTIMIZE)
+    int arity;              // functions only: parameter count,
+    int params;             // where they start in 'params',
+    D_TypeSpec returnType;  // DRG_TYPE_NONE if there's none
+} D_GlobalSymbol;
+
+/// @brief A parameter of a global function.
+typedef struct {
+    D_TypeSpec type;
+    bool isMutable;         // declared with 'var'
+} D_Param;
+
+/// @brief A field of a struct, at the offset of its place in the
+/// declaration.
+typedef struct {
+    drgString* name;        // interned
+    D_TypeSpec type;
+    bool isReadonly;        // only a struct literal sets it
+    bool isPrivate;         // only a struct literal sets it, and
+                            // nothing reads it
+    bool hasDefault;        // a literal that leaves it out pushes
+    drgVal value;           // this, else its type's default
+} D_StructField;
+
+/// @brief A struct declared at the top level, of type
+/// DRG_TYPE_STRUCT + its index.
+typedef struct {
+    drgString* name;        // interned
+    int fields;             // where they start in 'structFields'
+    int fieldCount;
+} D_StructDecl;
+
+/// @brief Top-level names, each resolved to a global slot at
+/// compile time so the VM never looks a name up.
+typedef struct {
+    int count;              // globals declared so far == slots needed
+    int capacity;
+    D_GlobalSymbol* symbols;
+    int indexCapacity;      // power of two
+    int* index;             // open addressing into 'symbols', -1 = empty
+    drgString* moduleName;  // from a 'module' statement, or NULL
+    int includeCount;       // modules brought in by 'include'
+    int includeCapacity;
+    drgModule** includes;
+    int paramCount;         // parameters of every function
+    int paramCapacity;
+    D_Param* params;
+    int structCount;        // structs declared so far
+    int structCapacity;
+    D_StructDecl* structs;
+    int fieldCount;         // fields of every struct
+    int fieldCapacity;
+    D_StructField* structFields;
+} D_GlobalTable;
+
+/// @brief How big a global table was at some point, to go back to
+/// if what was compiled after it doesn't make it.
+typedef struct {
+    int count;
+    int includeCount;
+    int paramCount;
+    int structCount;
+    int fieldCount;
+    drgString* moduleName;
+} D_GlobalMark;
+
+/// @brief Options for D_Compile() (bit flags).
+typedef enum {
+    D_CompileFlag_NONE      = 0,
+    D_CompileFlag_REGISTERS = 1 << 0, // three-address register form
+    D_CompileFlag_MODULE    = 1 << 1, // functions only, for 'export'
+    D_CompileFlag_OPTIMIZE  = 1 << 2  // fold constants, peephole pass
+                                      // (stack form only)
+} D_CompileFlag;
+
+/// @brief Initializes an empty global table.
+/// @param globals
+void D_GlobalTableInit(D_GlobalTable* globals);
+
+/// @brief Frees the dynamic memory of a global table.
+/// @param globals
+void D_GlobalTableFree(D_GlobalTable* globals);
+
+/// @brief Notes the current size of a global table.
+/// @param globals
+/// @return The mark, for D_GlobalTableRollback().
+D_GlobalMark D_GlobalTableMark(const D_GlobalTable* globals);
+
+/// @brief Forgets everything declared or included since 'mark'
+/// was taken, e.g. by a source that failed to compile.
+/// @param globals
+/// @param mark From D_GlobalTableMark() on the same table.
+void D_GlobalTableRollback(D_GlobalTable* globals, D_GlobalMark mark);
+
+/// @brief Compiles a whole source into 'nugget'. Errors are
+/// logged as they're found, and compiling carries on to the
+/// next line so they're all reported at once.
+/// @param source Source text, need not be null-terminated.
+/// @param length Number of chars in 'source'.
+/// @param globals Globals visible to the source; new
+/// declarations get added.
+/// @param nugget An initialized nugget to append to.
+/// @param flags OR'd D_CompileFlag values.
+/// @return False if there was any error.
+bool D_Compile(const char* source, size_t length, D_GlobalTable* globals, drgNugget* nugget, unsigned flags);
+
+#endif // DRG_H_COMPILER
@@ -0,0 +1,393 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file Optimizer.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Constant folding and the peephole pass. The pass copies each
+* instruction to the end of the output, then keeps rewriting the
+* last few for as long as a rule matches, so a rewrite can enable
+* the next one. The output never gets ahead of the input, so it
+* shares its buffer.
+*
+*****************************************************************/
+
+#include <string.h>
+
+#include "Optimizer.h"
+#include "../vm/drgIntern.h"
+
+/*****************************************************************
+* Constant Folding
+*****************************************************************/
+
+static bool D_IsNumber(drgVal value) {
+    return drgValIsInt(value) || drgValIsReal(value);
+}
+
+// Mirrors the VM's DRG_ARITH, DRG_COMPARE, DRG_EQUALS and friends:
+// two ints stay an int (wrapping at 48 bits), an int with a real
+// becomes a real, 1 eq 1.0, and two strings added are joined.
+bool D_FoldConstant(drgOpcode op, drgVal a, drgVal b, drgVal* result) {
+    switch(op) {
+        case DRG_OC_NEGATE:
+            if(drgValIsInt(a)) *result = drgValFromInt((int64_t)(0 - (uint64_t)drgValAsInt(a)));
+            else if(drgValIsReal(a)) *result = drgValFromReal(-drgValAsReal(a));
+            else return false;
+            return true;
+        case DRG_OC_NOT:
+            if(!drgValIsBool(a)) return false;
+            *result = drgValFromBool(!drgValAsBool(a));
+            return true;
+        case DRG_OC_INT_TO_REAL:
+            if(!drgValIsInt(a)) return false;
+            *result = drgValFromReal((double)drgValAsInt(a));
+            return true;
+        case DRG_OC_EQ:
+        case DRG_OC_NEQ: {
+            bool equal = (D_IsNumber(a) && D_IsNumber(b) && drgValIsInt(a) != drgValIsInt(b))
+                ? drgValAsNumber(a) == drgValAsNumber(b) : drgValEquals(a, b);
+            *result = drgValFromBool(equal == (op == DRG_OC_EQ));
+            return true;
+        }
+        case DRG_OC_ADD:
+            // Constants are never ropes
+            if(drgValIsObjType(a, DRG_OBJ_STRING) && drgValIsObjType(b, DRG_OBJ_STRING)) {
+                *result = drgValFromObj(drgInternConcat(drgValAsString(a), drgValAsString(b)));
+                return true;
+            }
+            break;
+        default:
+            break;
+    }
+    // Anything else is a runtime error, left for the VM to report
+    if(!D_IsNumber(a) || !D_IsNumber(b)) {
+        return false;
+    }
+    if(drgValIsInt(a) && drgValIsInt(b)) {
+        int64_t x = drgValAsInt(a);
+        int64_t y = drgValAsInt(b);
+        switch(op) {
+            case DRG_OC_ADD:  *result = drgValFromInt((int64_t)((uint64_t)x + (uint64_t)y)); return true;
+            case DRG_OC_SUB:  *result = drgValFromInt((int64_t)((uint64_t)x - (uint64_t)y)); return true;
+            case DRG_OC_MULT: *result = drgValFromInt((int64_t)((uint64_t)x * (uint64_t)y)); return true;
+            case DRG_OC_DIV:
+                if(0 == y) return false;
+                *result = drgValFromInt(x / y);
+                return true;
+            case DRG_OC_GT:   *result = drgValFromBool(x > y); return true;
+            case DRG_OC_GTE:  *result = drgValFromBool(x >= y); return true;
+            case DRG_OC_LT:   *result = drgValFromBool(x < y); return true;
+            case DRG_OC_LTE:  *result = drgValFromBool(x <= y); return true;
+            default:          return false;
+        }
+    }
+    double x = drgValAsNumber(a);
+    double y = drgValAsNumber(b);
+    switch(op) {
+        case DRG_OC_ADD:  *result = drgValFromReal(x + y); return true;
+        case DRG_OC_SUB:  *result = drgValFromReal(x - y); return true;
+        case DRG_OC_MULT: *result = drgValFromReal(x * y); return true;
+        case DRG_OC_DIV:  *result = drgValFromReal(x / y); return true;
+        case DRG_OC_GT:   *result = drgValFromBool(x > y); return true;
+        case DRG_OC_GTE:  *result = drgValFromBool(x >= y); return true;
+        case DRG_OC_LT:   *result = drgValFromBool(x < y); return true;
+        case DRG_OC_LTE:  *result = drgValFromBool(x <= y); return true;
+        default:          return false;
+    }
+}
+
+/*****************************************************************
+* Peephole
+*****************************************************************/
+
+// An instruction in the output.
+typedef struct {
+    int start;          // its offset in the output
+    int origin;         // input offset whose source position it keeps
+    int target;         // input offset it jumps to, -1 if none
+    bool isTarget;      // something jumps to it
+} D_Inst;
+
+typedef struct {
+    drgByte* code;      // the input, overwritten by the output
+    D_Inst* insts;
+    int count;
+    int end;            // bytes of output
+    bool carryTarget;   // a jump target was dropped, so the next
+                        // instruction is where it lands now
+} D_Peephole;
+
+static void D_Append(D_Peephole* p, const drgByte* bytes, int length, int origin, int target, bool isTarget);
+
+static drgByte D_Op(const D_Peephole* p, int i) {
+    return p->code[p->insts[i].start];
+}
+
+static int D_Operand(const D_Peephole* p, int i) {
+    return p->code[p->insts[i].start + 1];
+}
+
+static int D_ShortOperand(const D_Peephole* p, int i) {
+    const drgByte* at = p->code + p->insts[i].start + 1;
+    return (at[0] << 8) | at[1];
+}
+
+// Pushes one value and does nothing else.
+static bool D_IsPush(drgByte op) {
+    switch(op) {
+        case DRG_OC_NUM_LIT:
+        case DRG_OC_NUM_LIT_LONG:
+        case DRG_OC_TRUE:
+        case DRG_OC_FALSE:
+        case DRG_OC_NONE:
+        case DRG_OC_GET_GLOBAL:
+        case DRG_OC_GET_LOCAL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static int D_JumpTarget(const drgByte* code, int offset) {
+    switch(code[offset]) {
+        case DRG_OC_JUMP:
+        case DRG_OC_JUMP_IF_FALSE:
+            return offset + 3 + ((code[offset + 1] << 8) | code[offset + 2]);
+        case DRG_OC_LOOP:
+            return offset + 3 - ((code[offset + 1] << 8) | code[offset + 2]);
+        default:
+            return -1;
+    }
+}
+
+// Whether the last 'n' instructions can only be run one after the
+// other: nothing jumps into the middle of them.
+static bool D_Straight(const D_Peephole* p, int n) {
+    if(p->count < n) {
+        return false;
+    }
+    for(int i = p->count - n + 1; i < p->count; i++) {
+        if(p->insts[i].isTarget) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Drops the last 'n' instructions.
+static void D_Drop(D_Peephole* p, int n) {
+    const D_Inst* first = &p->insts[p->count - n];
+    p->end = first->start;
+    p->carryTarget = p->carryTarget || first->isTarget;
+    p->count -= n;
+}
+
+// Makes one instruction of the last 'n': the first, as 'op' with
+// the same operand. 'atLast' keeps the last one's position, for a
+// superinstruction whose errors are the last one's.
+static void D_Fuse(D_Peephole* p, int n, drgOpcode op, bool atLast) {
+    D_Inst* first = &p->insts[p->count - n];
+    if(atLast) {
+        first->origin = p->insts[p->count - 1].origin;
+    }
+    p->code[first->start] = (drgByte)op;
+    p->end = first->start + drgInstructionLength((drgByte)op);
+    p->count -= n - 1;
+}
+
+// [POP_LOCAL n][push][POP_LOCAL n]: the first store is overwritten
+// before anything reads it, so its value is just dropped. The POP
+// goes in on its own, in case it cancels the push before it.
+static void D_DropDeadStore(D_Peephole* p) {
+    D_Inst store = p->insts[p->count - 3];
+    D_Inst push = p->insts[p->count - 2];
+    D_Inst last = p->insts[p->count - 1];
+    drgByte pushCode[4];
+    drgByte lastCode[2];
+    int pushLength = last.start - push.start;
+    memcpy(pushCode, p->code + push.start, (size_t)pushLength);
+    memcpy(lastCode, p->code + last.start, sizeof(lastCode));
+    D_Drop(p, 3);
+    drgByte pop = DRG_OC_POP;
+    D_Append(p, &pop, 1, store.origin, -1, false);
+    D_Append(p, pushCode, pushLength, push.origin, -1, false);
+    D_Append(p, lastCode, sizeof(lastCode), last.origin, -1, false);
+}
+
+// The generic operator a typed one is a form of. The
+// superinstructions are generic, and take typed operands as well.
+static drgByte D_Untyped(drgByte op) {
+    switch(op) {
+        case DRG_OC_ADD_INT: case DRG_OC_ADD_REAL: case DRG_OC_ADD_STRING: return DRG_OC_ADD;
+        case DRG_OC_SUB_INT: case DRG_OC_SUB_REAL: return DRG_OC_SUB;
+        case DRG_OC_LT_INT:  case DRG_OC_LT_REAL:  return DRG_OC_LT;
+        case DRG_OC_EQ_INT:  case DRG_OC_EQ_REAL:  case DRG_OC_EQ_STRING: return DRG_OC_EQ;
+        default:             return op;
+    }
+}
+
+// Applies the first rule that matches the end of the output.
+static bool D_Reduce(D_Peephole* p) {
+    if(!D_Straight(p, 2)) {
+        return false;
+    }
+    int x = p->count - 1;
+    int w = x - 1;
+    drgByte last = D_Untyped(D_Op(p, x));
+    drgByte prev = D_Op(p, w);
+    switch(last) {
+        case DRG_OC_POP:
+            // Pushed only to be popped
+            if(D_IsPush(prev)) {
+                D_Drop(p, 2);
+                return true;
+            }
+            // Assignment statements
+            if(prev == DRG_OC_SET_LOCAL) {
+                D_Fuse(p, 2, DRG_OC_POP_LOCAL, false);
+                return true;
+            }
+            if(prev == DRG_OC_SET_GLOBAL) {
+                D_Fuse(p, 2, DRG_OC_DEFINE_GLOBAL, false);
+                return true;
+            }
+            return false;
+        case DRG_OC_POP_LOCAL:
+            // x = x
+            if(prev == DRG_OC_GET_LOCAL && D_Operand(p, w) == D_Operand(p, x)) {
+                D_Drop(p, 2);
+                return true;
+            }
+            // The same value stored twice
+            if(prev == DRG_OC_SET_LOCAL && D_Operand(p, w) == D_Operand(p, x)) {
+                D_Fuse(p, 2, DRG_OC_POP_LOCAL, false);
+                return true;
+            }
+            if(D_Straight(p, 3) && D_Op(p, w - 1) == DRG_OC_POP_LOCAL && D_Operand(p, w - 1) == D_Operand(p, x) &&
+                D_IsPush(prev) && !(prev == DRG_OC_GET_LOCAL && D_Operand(p, w) == D_Operand(p, x))) {
+                D_DropDeadStore(p);
+                return true;
+            }
+            return false;
+        case DRG_OC_DEFINE_GLOBAL:
+            // x = x
+            if(prev == DRG_OC_GET_GLOBAL && D_ShortOperand(p, w) == D_ShortOperand(p, x)) {
+                D_Drop(p, 2);
+                return true;
+            }
+            if(prev == DRG_OC_SET_GLOBAL && D_ShortOperand(p, w) == D_ShortOperand(p, x)) {
+                D_Fuse(p, 2, DRG_OC_DEFINE_GLOBAL, false);
+                return true;
+            }
+            return false;
+        case DRG_OC_GET_LOCAL:
+            // Stored, then read straight back
+            if(prev == DRG_OC_POP_LOCAL && D_Operand(p, w) == D_Operand(p, x)) {
+                D_Fuse(p, 2, DRG_OC_SET_LOCAL, false);
+                return true;
+            }
+            return false;
+        case DRG_OC_GET_GLOBAL:
+            if(prev == DRG_OC_DEFINE_GLOBAL && D_ShortOperand(p, w) == D_ShortOperand(p, x)) {
+                D_Fuse(p, 2, DRG_OC_SET_GLOBAL, false);
+                return true;
+            }
+            return false;
+        case DRG_OC_ADD:
+            if(prev == DRG_OC_NUM_LIT) {
+                D_Fuse(p, 2, DRG_OC_LIT_ADD, true);
+                return true;
+            }
+            if(prev == DRG_OC_GET_LOCAL) {
+                D_Fuse(p, 2, DRG_OC_GET_LOCAL_ADD, true);
+                return true;
+            }
+            return false;
+        case DRG_OC_SUB:
+        case DRG_OC_LT:
+        case DRG_OC_EQ:
+            if(prev == DRG_OC_NUM_LIT) {
+                drgOpcode fused = (last == DRG_OC_SUB) ? DRG_OC_LIT_SUB
+                    : (last == DRG_OC_LT) ? DRG_OC_LIT_LT : DRG_OC_LIT_EQ;
+                D_Fuse(p, 2, fused, true);
+                return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+// Copies an instruction to the end of the output, and rewrites
+// the end for as long as it can.
+static void D_Append(D_Peephole* p, const drgByte* bytes, int length, int origin, int target, bool isTarget) {
+    D_Inst* inst = &p->insts[p->count++];
+    inst->start = p->end;
+    inst->origin = origin;
+    inst->target = target;
+    inst->isTarget = isTarget || p->carryTarget;
+    p->carryTarget = false;
+    memmove(p->code + p->end, bytes, (size_t)length);
+    p->end += length;
+    while(D_Reduce(p)) {}
+}
+
+void D_Optimize(drgNugget* nugget, D_Arena* scratch) {
+    int count = nugget->count;
+    drgByte* code = nugget->bytecode;
+    bool* isTarget = (bool*)D_ArenaAlloc(scratch, sizeof(bool) * (size_t)(count + 1));
+    int* newOffset = (int*)D_ArenaAlloc(scratch, sizeof(int) * (size_t)(count + 1));
+    D_Inst* insts = (D_Inst*)D_ArenaAlloc(scratch, sizeof(D_Inst) * (size_t)(count + 1));
+    // Positions are per byte of input, until the table is rebuilt
+    int* lines = NULL;
+    int* columns = NULL;
+    if(nugget->lines.count > 0) {
+        lines = (int*)D_ArenaAlloc(scratch, sizeof(int) * (size_t)count);
+        columns = (int*)D_ArenaAlloc(scratch, sizeof(int) * (size_t)count);
+        drgNuggetGetPositions(nugget, lines, columns);
+    }
+
+    memset(isTarget, 0, sizeof(bool) * (size_t)(count + 1));
+    for(int offset = 0; offset < count; offset += drgInstructionLength(code[offset])) {
+        int target = D_JumpTarget(code, offset);
+        if(target >= 0 && target <= count) {
+            isTarget[target] = true;
+        }
+    }
+
+    D_Peephole p = { code, insts, 0, 0, false };
+    for(int offset = 0; offset < count;) {
+        int length = drgInstructionLength(code[offset]);
+        newOffset[offset] = p.end;
+        D_Append(&p, code + offset, length, offset, D_JumpTarget(code, offset), isTarget[offset]);
+        offset += length;
+    }
+    newOffset[count] = p.end;
+
+    // Jumps only get shorter, so they still fit
+    for(int i = 0; i < p.count; i++) {
+        if(insts[i].target < 0) {
+            continue;
+        }
+        int at = insts[i].start;
+        int to = newOffset[insts[i].target];
+        int jump = (code[at] == DRG_OC_LOOP) ? at + 3 - to : to - (at + 3);
+        code[at + 1] = (drgByte)((jump >> 8) & 0xFF);
+        code[at + 2] = (drgByte)(jump & 0xFF);
+    }
+    nugget->count = p.end;
+
+    if(NULL != lines) {
+        drgLineTable* table = &nugget->lines;
+        table->count = 0;
+        table->offset = 0;
+        table->line = 0;
+        table->column = 0;
+        for(int i = 0; i < p.count; i++) {
+            drgLineTableMark(table, insts[i].start, lines[insts[i].origin], columns[insts[i].origin]);
+        }
+    }
+}
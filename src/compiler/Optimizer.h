@@ -0,0 +1,45 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file Optimizer.h
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* What D_CompileFlag_OPTIMIZE does to stack form bytecode.
+* Constant expressions are folded by the compiler as they're
+* emitted, with D_FoldConstant(); once a nugget is complete,
+* D_Optimize() rewrites short runs of its instructions into fewer
+* or cheaper ones.
+*
+*****************************************************************/
+
+#ifndef DRG_H_OPTIMIZER
+#define DRG_H_OPTIMIZER
+
+#include <stdbool.h>
+
+#include "../util/Arena.h"
+#include "../vm/drgNugget.h"
+
+/// @brief Works out an operator on constants, exactly as the VM
+/// would at runtime.
+/// @param op DRG_OC_NEGATE through DRG_OC_LTE, or
+/// DRG_OC_INT_TO_REAL.
+/// @param a The left operand, or the only one.
+/// @param b The right operand, ignored by unary operators.
+/// @param result Output.
+/// @return False if it has to be left to the VM, e.g. because it
+/// would be a runtime error.
+bool D_FoldConstant(drgOpcode op, drgVal a, drgVal b, drgVal* result);
+
+/// @brief Peephole pass over a complete nugget: drops values that
+/// are pushed only to be popped and stores that change nothing,
+/// and fuses common pairs into superinstructions. Jumps and the
+/// line table are rewritten to match, and the code only shrinks,
+/// so it's done in place.
+/// @param nugget Stack form bytecode.
+/// @param scratch Where the working memory comes from.
+void D_Optimize(drgNugget* nugget, D_Arena* scratch);
+
+#endif // DRG_H_OPTIMIZER
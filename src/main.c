@@ -11,21 +11,36 @@
 *****************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "util/File.h"
 #include "util/Log.h"
 #include "util/Toolbox.h"
 #include "util/Version.h"
+#include "util/drgMemUtil.h"
+#include "compiler/Compiler.h"
+#include "scanner/ProjectLexer.h"
+#include "scanner/Scanner.h"
 #include "vm/VM.h"
+#include "vm/drgModule.h"
 
 void D_Repl(void);
 void D_ReplHelp(void);
 void D_Help(void);
-char* D_ReadFile(const char* path);
+void D_RunProject(const char* root);
+bool D_ParseSize(const char* text, size_t* bytes);
+const char* D_CacheDirectory(void);
+const char* D_ModulePath(const char* input);
 
 int main(int argc, const char* argv[]) {
     // Initialize the virtual machine
     D_InitVirtualMachine();
+    bool memStats = false;
+
+    // Modules are looked for on the path, and next to the input once
+    // the command's options are parsed and it's known
+    drgModuleSetPath(D_ModulePath(NULL));
 
     // Print version info
     D_ClearConsole();
@@ -44,26 +59,97 @@ int main(int argc, const char* argv[]) {
             D_Log("init is not implemented.");
         }
         else if(0 == strcmp(commandIn, "run")) {
-            // Get the next input
-            if(argc < 3) {
+            // Options may come before or after the input
+            const char* runInput = NULL;
+            bool useCache = true;
+            unsigned compileFlags = D_CompileFlag_NONE;
+            for(int i = 2; i < argc; i++) {
+                if(0 == strcmp(argv[i], "--trace")) {
+                    if(!D_SetTrace(true)) {
+                        D_LogWarning("--trace needs a build with DRG_DEBUG.");
+                    }
+                }
+                else if(0 == strcmp(argv[i], "-O")) {
+                    compileFlags |= D_CompileFlag_OPTIMIZE;
+                }
+                else if(0 == strcmp(argv[i], "--no-cache")) {
+                    useCache = false;
+                }
+                else if(0 == strcmp(argv[i], "--mem-stats")) {
+                    memStats = true;
+                }
+                else if(0 == strcmp(argv[i], "--mem-limit")) {
+                    size_t limit;
+                    if(i + 1 < argc && D_ParseSize(argv[i + 1], &limit)) {
+                        drgMemSetLimit(limit);
+                        i++;
+                    }
+                    else {
+                        D_LogWarning("--mem-limit needs a size, e.g. 64M.");
+                    }
+                }
+                else if(argv[i][0] == '-' && argv[i][1] == '-') {
+                    D_LogWarning("Unknown option '%s' ignored.", argv[i]);
+                }
+                else {
+                    runInput = argv[i];
+                }
+            }
+            D_SetCompileFlags(compileFlags);
+            drgModuleSetPath(D_ModulePath(runInput));
+            if(NULL == runInput) {
                 D_LogWarning("No input given to 'run' command! Running interpreter.");
                 D_Repl();
             }
+            else if(D_IsDirectory(runInput)) {
+                D_RunProject(runInput);
+            }
             else {
-                const char* runInput = argv[2];
-                char* source = D_ReadFile(runInput);
-                if(NULL != source) {
-                    D_Result result = D_Interpret(source);
+                D_SourceBuffer source;
+                // Sources from stdin are rarely run twice
+                if(useCache && 0 != strcmp(runInput, "-")) {
+                    D_SetCacheDirectory(D_CacheDirectory());
+                }
+                if(D_SourceOpen(runInput, &source)) {
+                    D_Result result = D_InterpretCached(source.data, source.length);
                     // TODO: Do something with result
-                    D_Free(source);
+                    D_SourceClose(&source);
                 }
                 else {
-                    // TODO: Handle
+                    D_LogError("Could not open file \"%s\".", runInput);
                 }
             }
         }
         else if(0 == strcmp(commandIn, "export")) {
-            D_Log("export is not implemented.");
+            // dargon export <file> [-o <output>] [-O]
+            const char* exportInput = NULL;
+            const char* exportOutput = NULL;
+            for(int i = 2; i < argc; i++) {
+                if(0 == strcmp(argv[i], "-o") && i + 1 < argc) {
+                    exportOutput = argv[++i];
+                }
+                else if(0 == strcmp(argv[i], "-O")) {
+                    D_SetCompileFlags(D_CompileFlag_OPTIMIZE);
+                }
+                else {
+                    exportInput = argv[i];
+                }
+            }
+            drgModuleSetPath(D_ModulePath(exportInput));
+            D_SourceBuffer source;
+            if(NULL == exportInput) {
+                D_LogError("No input given to 'export' command!");
+            }
+            else if(D_IsDirectory(exportInput)) {
+                D_LogError("Exporting a whole project is not implemented; export its files one by one.");
+            }
+            else if(D_SourceOpen(exportInput, &source)) {
+                D_ExportModule(source.data, source.length, exportOutput);
+                D_SourceClose(&source);
+            }
+            else {
+                D_LogError("Could not open file \"%s\".", exportInput);
+            }
         }
         else if(0 == strcmp(commandIn, "help")) {
             D_Help();
@@ -75,6 +161,10 @@ int main(int argc, const char* argv[]) {
     }
     
     D_FreeVirtualMachine();
+    // After freeing, so anything still live is a leak
+    if(memStats) {
+        drgMemPrintStats();
+    }
     return EXIT_SUCCESS;
 }
 
@@ -89,53 +179,113 @@ typedef enum {
     D_ReplState_STOP      // Stop
 } D_ReplState;
 
-// Read-Eval-Print-Loop
+// Appends one line of stdin, of any length, to 'buf'.
+// False at the end of input.
+static bool D_ReplReadLine(char** buf, size_t* length, size_t* capacity) {
+    size_t start = *length;
+    for(;;) {
+        if(*capacity - *length < 256) {
+            size_t grown = (*capacity < 1024) ? 1024 : *capacity * 2;
+            *buf = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_GENERAL, char, *buf, *capacity, grown);
+            *capacity = grown;
+        }
+        if(!fgets(*buf + *length, (int)(*capacity - *length), stdin)) {
+            return *length > start;
+        }
+        *length += strlen(*buf + *length);
+        if((*buf)[*length - 1] == '\n') {
+            return true;
+        }
+    }
+}
+
+// Whether an input so far ends inside a block, brackets or a
+// string, and so carries on on the next line.
+static bool D_ReplContinues(const char* source, size_t length) {
+    D_ScannerCtx scanner;
+    D_ScannerInit(&scanner, source, length);
+    int depth = 0;
+    for(;;) {
+        D_Token token = D_ScannerNext(&scanner);
+        switch(token.type) {
+            case D_TokenType_EOF:
+                return depth > 0;
+            case D_TokenType_LPAREN:
+            case D_TokenType_LBRACE:
+            case D_TokenType_LBRACK:
+                depth++;
+                break;
+            case D_TokenType_RPAREN:
+            case D_TokenType_RBRACE:
+            case D_TokenType_RBRACK:
+                depth--;
+                break;
+            case D_TokenType_INVALID:
+                // Only an unterminated string runs to the end
+                if(token.start[0] == '"' && token.start + token.length == source + length) {
+                    return true;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Read-Eval-Print-Loop. Inputs share one session, so what one
+// declares the next can use.
 void D_Repl(void) {
     D_ReplState state = D_ReplState_READLINE;
-    char buf[1024];
+    D_Session session;
+    D_SessionInit(&session);
+    char* buf = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
     printf("*** Type 'help for help.\n");
     while(state != D_ReplState_STOP) {
         switch(state) {
             case D_ReplState_READLINE: {
-                printf("@: ");
+                printf((length == 0) ? "@: " : "..: ");
+                fflush(stdout);
                 // Read user input
-                if(!fgets(buf, sizeof(buf), stdin)) {
-                    D_LogError("Well, that's an unexpected error from reading your input!");
+                if(!D_ReplReadLine(&buf, &length, &capacity)) {
+                    if(ferror(stdin)) {
+                        D_LogError("Well, that's an unexpected error from reading your input!");
+                    }
+                    printf("\n");
                     state = D_ReplState_STOP;
                     break;
                 }
-                // If there's no newline character, only a partial line was read.
-                if(!strchr(buf, '\n')) {
-                    D_LogError("Lines longer than 1024 characters just aren't my thing...");
-                    state = D_ReplState_STOP;
-                    break;
-                }
-                state = D_ReplState_CHECK;
+                state = D_ReplContinues(buf, length)
+                    ? D_ReplState_READLINE : D_ReplState_CHECK;
                 break;
             }
             case D_ReplState_CHECK: {
-                if(0 == strcmp(buf, "help\n")) {
+                char* source = D_TrimString(buf);
+                if(0 == strcmp(source, "help")) {
                     D_ReplHelp();
                     state = D_ReplState_READLINE;
                 }
-                else if(0 == strcmp(buf, "exit\n")) {
+                else if(0 == strcmp(source, "exit")) {
                     state = D_ReplState_STOP;
                 }
-                else if(0 == strcmp(buf, "clear\n")) {
+                else if(0 == strcmp(source, "clear")) {
                     D_ClearConsole();
                     state = D_ReplState_READLINE;
                 }
                 else {
-                    // TODO: Line continuation!
                     state = D_ReplState_INTERP;
+                    break;
                 }
+                length = 0;
                 break;
             }
             case D_ReplState_INTERP: {
                 // Trim and run it
                 char* source = D_TrimString(buf);
-                D_Result result = D_Interpret(source);
+                D_Result result = D_SessionInterpret(&session, source, strlen(source));
                 // TODO: Do something with result
+                length = 0;
                 state = D_ReplState_READLINE;
                 break;
             }
@@ -144,6 +294,8 @@ void D_Repl(void) {
                 break;
         }
     }
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_GENERAL, char, buf, capacity);
+    D_SessionFree(&session);
 }
 
 void D_ReplHelp(void) {
@@ -157,41 +309,122 @@ void D_ReplHelp(void) {
 
 // Print help info to console
 void D_Help(void) {
-    printf("Usage: dargon <command> <input>\n\n");
+    printf("Usage: dargon <command> <input> [options]\n\n");
     printf("Commands:\n");
     printf("* (no arguments): Runs an interactive interpreter.\n");
     printf("*           init: Initializes a Dargon project in this directory.\n");
-    printf("*            run: Runs a Dargon file or project.\n");
-    printf("*         export: Exports a Dargon project to a module.\n");
+    printf("*            run: Runs a Dargon file or project ('-' reads stdin).\n");
+    printf("*         export: Exports a module file to a .dgm ('-o <file>' to name it).\n");
     printf("*           help: Prints this dialogue.\n");
+    printf("\nOptions:\n");
+    printf("*        --trace: ('run') Prints each instruction as it runs.\n");
+    printf("*             -O: ('run', 'export') Optimizes the bytecode: folds constants,\n");
+    printf("*                 drops needless pushes and stores, fuses common pairs.\n");
+    printf("*    --mem-stats: ('run') Prints the memory used, by category.\n");
+    printf("*  --mem-limit N: ('run') Fails cleanly past N bytes (K/M/G suffix).\n");
+    printf("*     --no-cache: ('run') Neither reads nor writes compiled .dgc files.\n");
+    printf("\nCompiled files are cached in $DARGON_CACHE_DIR, else $XDG_CACHE_HOME/dargon,\n");
+    printf("else ~/.cache/dargon.\n");
+    printf("'include' looks for .dgm files next to the input, then in $DARGON_MODULE_PATH.\n");
+}
+
+// The module search path: the directory of 'input' (if it's a
+// file), then $DARGON_MODULE_PATH.
+const char* D_ModulePath(const char* input) {
+    static char path[8192];
+    const char* extra = getenv("DARGON_MODULE_PATH");
+    int directoryLength = 0;
+    if(NULL == input) {
+        input = "";
+    }
+    else if(0 != strcmp(input, "-")) {
+        const char* slash = strrchr(input, '/');
+        #if defined(_WIN32) || defined(_WIN64)
+        const char* backslash = strrchr(input, '\\');
+        if(NULL == slash || (NULL != backslash && backslash > slash)) slash = backslash;
+        #endif
+        directoryLength = (NULL == slash) ? 0 : (int)(slash - input);
+    }
+    #if defined(_WIN32) || defined(_WIN64)
+    const char separator = ';';
+    #else
+    const char separator = ':';
+    #endif
+    int written = (NULL == extra || extra[0] == '\0')
+        ? snprintf(path, sizeof(path), "%.*s", directoryLength, input)
+        : snprintf(path, sizeof(path), "%.*s%c%s", directoryLength, input, separator, extra);
+    return (written < 0 || (size_t)written >= sizeof(path)) ? NULL : path;
 }
 
-/// @brief Reads a file at the location 'path' and returns its
-/// including null-termination. This should be free'd after use.
-/// @param path  
-/// @return Malloc'd contents, NULL on error.
-char* D_ReadFile(const char* path) {
-    // Try to open file
-    FILE* file = fopen(path, "rb");
-    if(NULL == file) {
-        D_LogError("Could not open file \"%s\".\n", path);
+// Where 'run' caches compiled files, created if need be, or NULL
+// if there's nowhere to put them.
+const char* D_CacheDirectory(void) {
+    static char directory[4096];
+    const char* path = getenv("DARGON_CACHE_DIR");
+    int written = -1;
+    if(NULL != path && path[0] != '\0') {
+        written = snprintf(directory, sizeof(directory), "%s", path);
+    }
+    else if(NULL != (path = getenv("XDG_CACHE_HOME")) && path[0] != '\0') {
+        written = snprintf(directory, sizeof(directory), "%s/dargon", path);
+    }
+    else if(NULL != (path = getenv("HOME")) && path[0] != '\0') {
+        written = snprintf(directory, sizeof(directory), "%s/.cache/dargon", path);
+    }
+    if(written < 0 || (size_t)written >= sizeof(directory) || !D_MakeDirectories(directory)) {
         return NULL;
     }
-    
-    // Get size of file
-    fseek(file, 0L, SEEK_END);
-    size_t fileSize = ftell(file);
-    rewind(file);
-
-    // Allocate buffer (null-terminate it)
-    char* fileOut = (char*)malloc(fileSize+1);
-    if(!fileOut) {
-        D_LogError("D_ReadFile: malloc() failed!");
-        exit(EXIT_FAILURE); // nothing we can do
-    }
-    size_t bytesRead = fread(fileOut, sizeof(char), fileSize, file);
-    fileOut[bytesRead] = '\0';
-
-    fclose(file);
-    return fileOut;
-}
\ No newline at end of file
+    return directory;
+}
+
+// Parses a byte count such as "4096", "64K" or "2M".
+bool D_ParseSize(const char* text, size_t* bytes) {
+    char* end;
+    unsigned long long value = strtoull(text, &end, 10);
+    if(end == text) {
+        return false;
+    }
+    switch(*end) {
+        case 'K': case 'k': value <<= 10; end++; break;
+        case 'M': case 'm': value <<= 20; end++; break;
+        case 'G': case 'g': value <<= 30; end++; break;
+        default: break;
+    }
+    if(*end != '\0') {
+        return false;
+    }
+    *bytes = (size_t)value;
+    return true;
+}
+
+// Lexes every source file of a project directory on all cores,
+// and reports anything the scanner didn't understand.
+void D_RunProject(const char* root) {
+    D_LexedProject project;
+    D_LexedProjectInit(&project);
+    int found = D_LexProject(root, 0, &project);
+    if(found < 0) {
+        D_LogError("Could not open project directory \"%s\".", root);
+    }
+    else {
+        long tokenCount = 0;
+        for(int i = 0; i < project.count; i++) {
+            D_LexedFile* file = &project.files[i];
+            if(!file->loaded) {
+                D_LogError("Could not open file \"%s\".", file->path);
+                continue;
+            }
+            tokenCount += file->tokens.count;
+            for(int t = 0; file->errorCount > 0 && t < file->tokens.count; t++) {
+                if(file->tokens.types[t] < 0) {
+                    D_Token token = D_TokenStreamGet(&file->tokens, t);
+                    D_LogError("%s:%d:%d: Unexpected '%.*s'", file->path,
+                        token.line, token.column, token.length, token.start);
+                }
+            }
+        }
+        D_Log("Lexed %d file(s), %ld token(s).", found, tokenCount);
+        D_LogWarning("Running projects is not implemented.");
+    }
+    D_LexedProjectFree(&project);
+}
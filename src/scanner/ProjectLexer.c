@@ -0,0 +1,283 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file ProjectLexer.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Lexes every source file of a project, in parallel.
+*
+*****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#endif
+
+#include "ProjectLexer.h"
+#include "../util/File.h"
+#include "../util/drgMemUtil.h"
+
+/*****************************************************************
+* Project
+*****************************************************************/
+
+void D_LexedProjectInit(D_LexedProject* project) {
+    project->count = 0;
+    project->capacity = 0;
+    project->files = NULL;
+}
+
+void D_LexedProjectFree(D_LexedProject* project) {
+    for(int i = 0; i < project->count; i++) {
+        DRG_MEM_FREE(project->files[i].path);
+        if(project->files[i].loaded) {
+            D_SourceClose(&project->files[i].source);
+        }
+        D_TokenStreamFree(&project->files[i].tokens);
+    }
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_COMPILER, D_LexedFile, project->files, project->capacity);
+    D_LexedProjectInit(project);
+}
+
+// Takes ownership of 'path'.
+static void D_LexedProjectAdd(D_LexedProject* project, char* path) {
+    if(project->capacity < project->count + 1) {
+        int prevCapacity = project->capacity;
+        project->capacity = DRG_MEM_GROW_CAPACITY(prevCapacity);
+        project->files = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_COMPILER, D_LexedFile, project->files, prevCapacity, project->capacity);
+    }
+    D_LexedFile* file = &project->files[project->count++];
+    struct stat info;
+    file->path = path;
+    file->loaded = false;
+    file->size = (0 == stat(path, &info)) ? (long)info.st_size : 0;
+    D_TokenStreamInit(&file->tokens);
+    file->errorCount = 0;
+}
+
+/*****************************************************************
+* Directory Walk
+*****************************************************************/
+
+static char* D_JoinPath(const char* dir, const char* name) {
+    size_t dirLength = strlen(dir);
+    size_t nameLength = strlen(name);
+    char* path = (char*)malloc(dirLength + nameLength + 2);
+    if(NULL == path) {
+        perror("D_JoinPath: malloc() failed!");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(path, dir, dirLength);
+    path[dirLength] = '/';
+    memcpy(path + dirLength + 1, name, nameLength + 1);
+    return path;
+}
+
+static bool D_IsSourceFile(const char* name) {
+    size_t length = strlen(name);
+    return length > 3 && 0 == strcmp(name + length - 3, ".dg");
+}
+
+static bool D_IsHiddenOrDot(const char* name) {
+    return name[0] == '.';
+}
+
+// Appends every source file under 'dir' to the project. Linked
+// directories are skipped: one pointing back up the tree would
+// otherwise be walked forever.
+static bool D_CollectSources(const char* dir, D_LexedProject* project) {
+    #if defined(_WIN32) || defined(_WIN64)
+    char* pattern = D_JoinPath(dir, "*");
+    WIN32_FIND_DATAA entry;
+    HANDLE handle = FindFirstFileA(pattern, &entry);
+    free(pattern);
+    if(INVALID_HANDLE_VALUE == handle) {
+        return false;
+    }
+    do {
+        if(D_IsHiddenOrDot(entry.cFileName)) continue;
+        char* path = D_JoinPath(dir, entry.cFileName);
+        if(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            if(!(entry.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+                D_CollectSources(path, project);
+            }
+            free(path);
+        }
+        else if(D_IsSourceFile(entry.cFileName)) {
+            D_LexedProjectAdd(project, path);
+        }
+        else {
+            free(path);
+        }
+    } while(FindNextFileA(handle, &entry));
+    FindClose(handle);
+    return true;
+    #else
+    DIR* handle = opendir(dir);
+    if(NULL == handle) {
+        return false;
+    }
+    struct dirent* entry;
+    while(NULL != (entry = readdir(handle))) {
+        if(D_IsHiddenOrDot(entry->d_name)) continue;
+        char* path = D_JoinPath(dir, entry->d_name);
+        struct stat info;
+        bool isLink = 0 == lstat(path, &info) && S_ISLNK(info.st_mode);
+        if(D_IsDirectory(path)) {
+            if(!isLink) {
+                D_CollectSources(path, project);
+            }
+            free(path);
+        }
+        else if(D_IsSourceFile(entry->d_name)) {
+            D_LexedProjectAdd(project, path);
+        }
+        else {
+            free(path);
+        }
+    }
+    closedir(handle);
+    return true;
+    #endif
+}
+
+// Biggest files first, so a huge file picked up last can't leave
+// every other worker idle while it finishes.
+static int D_CompareBySizeDesc(const void* a, const void* b) {
+    long sizeA = ((const D_LexedFile*)a)->size;
+    long sizeB = ((const D_LexedFile*)b)->size;
+    return (sizeA < sizeB) - (sizeA > sizeB);
+}
+
+/*****************************************************************
+* Workers
+*****************************************************************/
+
+static void D_LexFile(D_LexedFile* file) {
+    file->loaded = D_SourceOpen(file->path, &file->source);
+    if(!file->loaded) {
+        return;
+    }
+    D_TokenizeAll(file->source.data, file->source.length, &file->tokens);
+    for(int i = 0; i < file->tokens.count; i++) {
+        if(file->tokens.types[i] < 0) {
+            file->errorCount++;
+        }
+    }
+}
+
+typedef struct {
+    D_LexedProject* project;
+    #if defined(_WIN32) || defined(_WIN64)
+    volatile LONG next;     // index of the next file to hand out
+    #else
+    atomic_int next;        // index of the next file to hand out
+    #endif
+} D_LexQueue;
+
+static void D_LexQueued(D_LexQueue* queue) {
+    for(;;) {
+        #if defined(_WIN32) || defined(_WIN64)
+        int index = (int)InterlockedIncrement(&queue->next) - 1;
+        #else
+        int index = atomic_fetch_add(&queue->next, 1);
+        #endif
+        if(index >= queue->project->count) {
+            return;
+        }
+        D_LexFile(&queue->project->files[index]);
+    }
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+static DWORD WINAPI D_LexWorker(LPVOID arg) {
+    D_LexQueued((D_LexQueue*)arg);
+    return 0;
+}
+#else
+static void* D_LexWorker(void* arg) {
+    D_LexQueued((D_LexQueue*)arg);
+    return NULL;
+}
+#endif
+
+int D_GetCoreCount(void) {
+    #if defined(_WIN32) || defined(_WIN64)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+    #else
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+    #endif
+}
+
+int D_LexProject(const char* root, int threadCount, D_LexedProject* project) {
+    int first = project->count;
+    if(!D_CollectSources(root, project)) {
+        return -1;
+    }
+    int found = project->count - first;
+    qsort(project->files + first, (size_t)found, sizeof(D_LexedFile), D_CompareBySizeDesc);
+
+    if(threadCount <= 0) {
+        threadCount = D_GetCoreCount();
+    }
+    if(threadCount > found) {
+        threadCount = found;
+    }
+
+    D_LexQueue queue;
+    queue.project = project;
+    #if defined(_WIN32) || defined(_WIN64)
+    queue.next = first;
+    typedef HANDLE D_Thread;
+    #else
+    atomic_init(&queue.next, first);
+    typedef pthread_t D_Thread;
+    #endif
+
+    // The calling thread is worker 0
+    D_Thread* workers = (D_Thread*)malloc(sizeof(D_Thread) * (size_t)(threadCount > 1 ? threadCount : 1));
+    if(NULL == workers) {
+        perror("D_LexProject: malloc() failed!");
+        exit(EXIT_FAILURE);
+    }
+    int started = 0;
+    for(int i = 1; i < threadCount; i++) {
+        #if defined(_WIN32) || defined(_WIN64)
+        workers[started] = CreateThread(NULL, 0, D_LexWorker, &queue, 0, NULL);
+        if(NULL == workers[started]) {
+            break; // the remaining workers pick up the slack
+        }
+        #else
+        if(0 != pthread_create(&workers[started], NULL, D_LexWorker, &queue)) {
+            break; // the remaining workers pick up the slack
+        }
+        #endif
+        started++;
+    }
+    D_LexQueued(&queue);
+    for(int i = 0; i < started; i++) {
+        #if defined(_WIN32) || defined(_WIN64)
+        WaitForSingleObject(workers[i], INFINITE);
+        CloseHandle(workers[i]);
+        #else
+        pthread_join(workers[i], NULL);
+        #endif
+    }
+    free(workers);
+
+    return found;
+}
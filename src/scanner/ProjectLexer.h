@@ -0,0 +1,57 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file ProjectLexer.h
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Lexes every source file of a project, in parallel.
+*
+*****************************************************************/
+
+#ifndef DRG_H_PROJECT_LEXER
+#define DRG_H_PROJECT_LEXER
+
+#include "Scanner.h"
+#include "../util/File.h"
+
+/// @brief One lexed source file of a project.
+typedef struct {
+    char* path;             // malloc'd path of the file
+    D_SourceBuffer source;  // mapped contents, if 'loaded'
+    bool loaded;            // false if the file couldn't be read
+    long size;              // size on disk, used to schedule big files first
+    D_TokenStream tokens;   // every token of 'source'
+    int errorCount;         // number of INVALID/UNKNOWN tokens
+} D_LexedFile;
+
+/// @brief Every lexed source file of a project.
+typedef struct {
+    int count;
+    int capacity;
+    D_LexedFile* files;
+} D_LexedProject;
+
+/// @brief Initializes an empty project.
+/// @param project
+void D_LexedProjectInit(D_LexedProject* project);
+
+/// @brief Frees every file of the project, including sources.
+/// @param project
+void D_LexedProjectFree(D_LexedProject* project);
+
+/// @brief Finds every '.dg' file under 'root' (recursively) and
+/// lexes them on a pool of worker threads, each with its own
+/// D_ScannerCtx. Larger files are handed out first.
+/// @param root Project directory.
+/// @param threadCount Number of workers, 0 for one per core.
+/// @param project An initialized project, files get appended.
+/// @return The number of files found, -1 if 'root' can't be read.
+int D_LexProject(const char* root, int threadCount, D_LexedProject* project);
+
+/// @brief Number of cores available to this process.
+/// @return At least 1.
+int D_GetCoreCount(void);
+
+#endif // DRG_H_PROJECT_LEXER
@@ -13,26 +13,23 @@
 #include <stdbool.h>
 #include <string.h>
 #include "Scanner.h"
+#include "ScannerSimd.h"
+#include "KeywordTable.h"
+#include "../util/drgMemUtil.h"
 
 /*****************************************************************
 * Types
 *****************************************************************/
 
-typedef struct {
-    const char* start;      // ptr to start of lexeme
-    const char* current;    // 
-    int line;               // line number
-    int column;             // column in line
-} D_Scanner;
-
-static D_Scanner scanner;
+// Scanner behind D_InitScanner() / D_GetNextToken()
+static D_ScannerCtx scanner;
 
 /*****************************************************************
 * Utils
 *****************************************************************/
 
-inline static bool D_AtEnd(void) {
-    return *scanner.current == '\0';
+inline static bool D_AtEnd(D_ScannerCtx* s) {
+    return s->current >= s->end;
 }
 
 inline static bool D_IsDigit(char c) {
@@ -45,13 +42,13 @@ inline static bool D_IsAlpha(char c) {
         (c == '_');
 }
 
-inline static D_Token D_NewToken(D_TokenType type) {
+inline static D_Token D_NewToken(D_ScannerCtx* s, D_TokenType type) {
     D_Token token;
     token.type = type;
-    token.start = scanner.start;
-    token.length = (int)(scanner.current - scanner.start);
-    token.line = scanner.line;
-    token.column = scanner.column;
+    token.start = s->start;
+    token.length = (int)(s->current - s->start);
+    token.line = s->line;
+    token.column = s->column;
     return token;
 }
 
@@ -59,48 +56,68 @@ inline static D_Token D_NewToken(D_TokenType type) {
 * Consume Functions
 *****************************************************************/
 
-inline static char D_Peek(void) {
-    return *scanner.current;
+inline static char D_Peek(D_ScannerCtx* s) {
+    if(D_AtEnd(s)) return '\0';
+    return *s->current;
 }
 
-inline static char D_PeekNext(void) {
-    if(D_AtEnd()) return '\0';
-    return scanner.current[1];
+inline static char D_PeekNext(D_ScannerCtx* s) {
+    if(s->end - s->current < 2) return '\0';
+    return s->current[1];
 }
 
-inline static char D_Consume(void) {
+inline static char D_Consume(D_ScannerCtx* s) {
     // Increment pointer
-    scanner.current++;
-    scanner.column++;
+    s->current++;
+    s->column++;
     // Return previous char
-    return scanner.current[-1];
+    return s->current[-1];
+}
+
+// Consumes everything up to (not including) 'to', which must be
+// on the current line.
+inline static void D_ConsumeUntil(D_ScannerCtx* s, const char* to) {
+    s->column += (int)(to - s->current);
+    s->current = to;
 }
 
-inline static bool D_ConsumeIfMatch(char expected) {
-    if(D_AtEnd()) return false;
-    if(*scanner.current != expected) return false;
-    scanner.current++;
+inline static bool D_ConsumeIfMatch(D_ScannerCtx* s, char expected) {
+    if(D_AtEnd(s)) return false;
+    if(*s->current != expected) return false;
+    s->current++;
     return true;
 }
 
-inline static void D_ConsumeWhitespaces(void) {
+inline static void D_ConsumeWhitespaces(D_ScannerCtx* s) {
     for(;;) {
-        switch(D_Peek()) {
+        switch(D_Peek(s)) {
             case '(': {
-                if(D_PeekNext() == '#') {
+                if(D_PeekNext(s) == '#') {
                     // Consume the '(' and '#'
-                    D_Consume();
-                    D_Consume();
+                    D_Consume(s);
+                    D_Consume(s);
                     // Block comment ends when '#)' is found
                     // (# test #)
-                    while(!D_AtEnd()) {
-                        if(D_Peek() == '#' && D_PeekNext() == ')') {
+                    while(!D_AtEnd(s)) {
+                        // Jump straight to the next '#' or newline
+                        D_ConsumeUntil(s, s->kernels->findBlockStop(s->current, s->end));
+                        if(D_AtEnd(s)) {
+                            break;
+                        }
+                        if(D_Peek(s) == '\n') {
+                            D_Consume(s);
+                            s->line++;
+                            s->column = 0;
+                        }
+                        else if(D_PeekNext(s) == ')') {
                             // Consume both and exit
-                            D_Consume();
-                            D_Consume();
+                            D_Consume(s);
+                            D_Consume(s);
                             break;
                         }
-                        D_Consume();
+                        else {
+                            D_Consume(s);
+                        }
                     }
                     // If we were at the end, it means we never found a matching
                     // closing brace
@@ -111,17 +128,15 @@ inline static void D_ConsumeWhitespaces(void) {
                 break;
             }
             case '#': {
-                if(D_Peek() == '!') {
+                if(D_Peek(s) == '!') {
                     // TODO-style comment
                 }
                 // Comment goes till end of line
-                while(D_Peek() != '\n' && !D_AtEnd()) {
-                    D_Consume();
-                }
+                D_ConsumeUntil(s, s->kernels->findLineEnd(s->current, s->end));
                 break;
             }
             case ' ': case '\r': case '\t':
-                D_Consume();
+                D_ConsumeUntil(s, s->kernels->skipBlanks(s->current, s->end));
                 break;
             default:
                 return;
@@ -129,174 +144,41 @@ inline static void D_ConsumeWhitespaces(void) {
     }
 }
 
-inline static D_TokenType D_CompareWithKeyword(int start, int length, const char* rest, D_TokenType type) {
-    if(scanner.current - scanner.start == start + length && 0 == memcmp(scanner.start + start, rest, length)) {
-        return type;
-    }
-    return D_TokenType_IDENTIFIER;
-}
-
-inline static D_TokenType D_CheckIfKeyword(void) {
-    switch(scanner.start[0]) {
-        case 'a': {
-            if(scanner.current - scanner.start > 1) {
-                switch(scanner.start[1]) {
-                    case 'l': return D_CompareWithKeyword(2, 3, "ias", D_TokenType_KW_alias);
-                    case 'n': return D_CompareWithKeyword(2, 1, "d", D_TokenType_KW_and);
-                }
-            }
-            break;
-        }
-        case 'b': return D_CompareWithKeyword(1, 3, "ool", D_TokenType_KW_bool);
-        case 'c': return D_CompareWithKeyword(1, 3, "opy", D_TokenType_KW_copy);
-        case 'd': return D_CompareWithKeyword(1, 4, "efer", D_TokenType_KW_defer);
-        case 'e': {
-            if(scanner.current - scanner.start > 1) {
-                switch(scanner.start[1]) {
-                    case 'l': return D_CompareWithKeyword(2, 2, "se", D_TokenType_KW_else);
-                    case 'q': return D_TokenType_KW_eq;
-                    case 'x': {
-                        if(scanner.current - scanner.start > 2) {
-                            switch(scanner.start[2]) {
-                                case 'i': return D_CompareWithKeyword(3, 3, "sts", D_TokenType_KW_exists);
-                                case 'p': return D_CompareWithKeyword(3, 3, "ort", D_TokenType_KW_export);
-                            }
-                        }
-                        break;
-                    }
-                }
-            }
-            break;
-        }
-        case 'f': {
-            if(scanner.current - scanner.start > 1) {
-                switch(scanner.start[1]) {
-                    case 'a': return D_CompareWithKeyword(2, 3, "lse", D_TokenType_KW_false);
-                    case 'u': return D_CompareWithKeyword(2, 1, "n", D_TokenType_KW_fun);
-                }
-            }
-            break;
-        }
-        case 'i': {
-            if(scanner.current - scanner.start > 1) {
-                switch(scanner.start[1]) {
-                    case 'f': return D_TokenType_KW_if;
-                    case 'n': return D_CompareWithKeyword(2, 1, "t", D_TokenType_KW_int);
-                    case 's': return D_TokenType_KW_is;
-                }
-            }
-            break;
-        }
-        case 'l': return D_CompareWithKeyword(1, 3, "oop", D_TokenType_KW_loop);
-        case 'm': return D_CompareWithKeyword(1, 5, "odule", D_TokenType_KW_module);
-        case 'n': {
-            if(scanner.current - scanner.start > 1) {
-                switch(scanner.start[1]) {
-                    case 'e': return D_CompareWithKeyword(2, 1, "q", D_TokenType_KW_neq);
-                    case 'o': return D_CompareWithKeyword(2, 1, "t", D_TokenType_KW_not);
-                }
-            }
-            break;
-        }
-        case 'o': return D_CompareWithKeyword(1, 1, "r", D_TokenType_KW_or);
-        case 'p': return D_CompareWithKeyword(1, 6, "rivate", D_TokenType_KW_private);
-        case 'r': {
-            // rea   donly
-            // rea   l
-            // ref
-            if(scanner.current - scanner.start > 2 && scanner.start[1] == 'e') {
-                switch(scanner.start[2]) {
-                    case 'a': {
-                        if(scanner.current - scanner.start > 3) {
-                            switch(scanner.start[3]) {
-                                case 'd': return D_CompareWithKeyword(4, 4, "only", D_TokenType_KW_readonly);
-                                case 'l': return D_TokenType_KW_real;
-                            }
-                        }
-                        break;
-                    }
-                }
-            }
-            break;
-        }
-        case 's': {
-            // str  ing
-            // str  uct
-            if(scanner.current - scanner.start > 3 && scanner.start[1] == 't' && scanner.start[2] == 'r') {
-                switch(scanner.start[3]) {
-                    case 'i': return D_CompareWithKeyword(4, 2, "ng", D_TokenType_KW_string);
-                    case 'u': return D_CompareWithKeyword(4, 2, "ct", D_TokenType_KW_struct);
-                }
-            }
-            break;
-        }
-        case 't': {
-            if(scanner.current - scanner.start > 1) {
-                switch(scanner.start[1]) {
-                    case 'h': return D_CompareWithKeyword(2, 2, "en", D_TokenType_KW_then);
-                    case 'r': {
-                        if(scanner.current - scanner.start > 2) {
-                            switch(scanner.start[2]) {
-                                case 'u': return D_CompareWithKeyword(2, 1, "e", D_TokenType_KW_true);
-                                case 'y': return D_TokenType_KW_try;
-                            }
-                        }
-                    }
-                }
-            }
-            break;
-        }
-        case 'v': {
-            if(scanner.current - scanner.start > 1) {
-                switch(scanner.start[1]) {
-                    case 'a': return D_CompareWithKeyword(2, 1, "r", D_TokenType_KW_var);
-                    case 'm': return D_TokenType_KW_vm;
-                }
-            }
-            break;
-        }
-        case 'w': return D_CompareWithKeyword(1, 3, "hen", D_TokenType_KW_when);
-        case 'x': return D_CompareWithKeyword(1, 2, "or", D_TokenType_KW_xor);
-    }
-    return D_TokenType_IDENTIFIER;
+// The keyword table is a perfect hash generated from Token.h at
+// build time (see tools/genKeywords.c).
+inline static D_TokenType D_CheckIfKeyword(D_ScannerCtx* s) {
+    return D_LookupKeyword(s->start, (int)(s->current - s->start));
 }
 
 /*****************************************************************
 * Scanner
 *****************************************************************/
 
-void D_InitScanner(const char* const source) {
-    scanner.start = source;
-    scanner.current = source;
-    scanner.line = 1;
-    scanner.column = 0;
+void D_ScannerInit(D_ScannerCtx* s, const char* const source, size_t length) {
+    s->start = source;
+    s->current = source;
+    s->end = source + length;
+    s->line = 1;
+    s->column = 0;
+    s->kernels = D_GetScanKernels();
 }
 
-D_Token D_GetNextToken(void) {
-    // Ignore all whitespace
-    D_ConsumeWhitespaces();
-
-    // Each call scans a complete token, so we set
-    // 'start' to point to the current char so we
-    // remember where the lexeme we're about to 
-    // scan starts.
-    scanner.start = scanner.current;
-
+// Scans the lexeme starting at s->start and returns its type,
+// leaving s->current one past its last char.
+static D_TokenType D_ScanToken(D_ScannerCtx* s) {
     // If we're at the end, return EOF token
-    if(D_AtEnd()) {
-        return D_NewToken(D_TokenType_EOF);
+    if(D_AtEnd(s)) {
+        return D_TokenType_EOF;
     }
 
     // Get the current character
-    char currentChar = D_Consume();
+    char currentChar = D_Consume(s);
 
     // Check for identifiers
     if(D_IsAlpha(currentChar)) {
         // Consume all alphanumerics
-        while(D_IsAlpha(D_Peek()) || D_IsDigit(D_Peek())) {
-            D_Consume();
-        }
-        return D_NewToken(D_CheckIfKeyword());
+        D_ConsumeUntil(s, s->kernels->skipIdentifier(s->current, s->end));
+        return D_CheckIfKeyword(s);
     }
 
     // Check for numeric literals
@@ -304,66 +186,226 @@ D_Token D_GetNextToken(void) {
         // Is an integer unless there's a fractional part
         D_TokenType type = D_TokenType_INTEGER_LITERAL;
         // Consume all digits
-        while(D_IsDigit(D_Peek())) D_Consume();
+        while(D_IsDigit(D_Peek(s))) D_Consume(s);
         // If there's a fractional part...
-        if(D_Peek() == '.' && D_IsDigit(D_PeekNext())) {
+        if(D_Peek(s) == '.' && D_IsDigit(D_PeekNext(s))) {
             type = D_TokenType_REAL_LITERAL;
             // Consume the period
-            D_Consume();
+            D_Consume(s);
             // Get all the digits after the period
-            while(D_IsDigit(D_Peek())) D_Consume();
+            while(D_IsDigit(D_Peek(s))) D_Consume(s);
         }
-        return D_NewToken(type);
+        return type;
     }
 
     // Everything else
     switch(currentChar) {
         case '\n': {
-            scanner.line++;
-            D_Token ret = D_NewToken(D_TokenType_NEWLINE);
-            scanner.column = 0;
-            return ret;
+            s->line++;
+            return D_TokenType_NEWLINE;
         }
         case '(': {
-            if(D_Peek() == '#') {
+            if(D_Peek(s) == '#') {
                 // Multi-line comment, (# ... #)
             }
-            return D_NewToken(D_TokenType_LPAREN);
+            return D_TokenType_LPAREN;
         }
-        case '=': return D_NewToken(D_TokenType_ASSIGN);
-        case ')': return D_NewToken(D_TokenType_RPAREN);
-        case '{': return D_NewToken(D_TokenType_LBRACE);
-        case '}': return D_NewToken(D_TokenType_RBRACE);
-        case '-': return D_NewToken(D_TokenType_MINUS);
-        case '+': return D_NewToken(D_TokenType_PLUS);
-        case '/': return D_NewToken(D_TokenType_SLASH);
-        case '*': return D_NewToken(D_TokenType_STAR);
+        case '=': return D_TokenType_ASSIGN;
+        case ')': return D_TokenType_RPAREN;
+        case '{': return D_TokenType_LBRACE;
+        case '}': return D_TokenType_RBRACE;
+        case '[': return D_TokenType_LBRACK;
+        case ']': return D_TokenType_RBRACK;
+        case ',': return D_TokenType_COMMA;
+        case ':': return D_TokenType_COLON;
+        case '.': return D_TokenType_DOT;
+        case '-': return D_TokenType_MINUS;
+        case '+': return D_TokenType_PLUS;
+        case '/': return D_TokenType_SLASH;
+        case '*': return D_TokenType_STAR;
         // -- 2 chars
         case '<':
-            return D_NewToken(D_ConsumeIfMatch('=')
-                ? D_TokenType_LTE : D_TokenType_LT);
+            return D_ConsumeIfMatch(s, '=')
+                ? D_TokenType_LTE : D_TokenType_LT;
         case '>':
-            return D_NewToken(D_ConsumeIfMatch('=')
-                ? D_TokenType_GTE : D_TokenType_GT);
+            return D_ConsumeIfMatch(s, '=')
+                ? D_TokenType_GTE : D_TokenType_GT;
         // -- Literals (could be any # chars)
         case '"': {
             // While we're within the string and not at end...
-            while(D_Peek() != '"' && !D_AtEnd()) {
-                if(D_Peek() == '\n') {
-                    scanner.line++;
+            while(D_Peek(s) != '"' && !D_AtEnd(s)) {
+                if(D_Peek(s) == '\n') {
+                    s->line++;
                 }
-                D_Consume();
+                D_Consume(s);
             }
             // Unterminated
-            if(D_AtEnd()) {
-                return D_NewToken(D_TokenType_INVALID);
+            if(D_AtEnd(s)) {
+                return D_TokenType_INVALID;
             }
             // Closing quote
-            D_Consume();
-            return D_NewToken(D_TokenType_STRING_LITERAL);
+            D_Consume(s);
+            return D_TokenType_STRING_LITERAL;
         }
     }
 
     // Unknown token
-    return D_NewToken(D_TokenType_UNKNOWN);
-}
\ No newline at end of file
+    return D_TokenType_UNKNOWN;
+}
+
+D_Token D_ScannerNext(D_ScannerCtx* s) {
+    // Ignore all whitespace
+    D_ConsumeWhitespaces(s);
+
+    // Each call scans a complete token, so we set
+    // 'start' to point to the current char so we
+    // remember where the lexeme we're about to 
+    // scan starts.
+    s->start = s->current;
+    int line = s->line;
+    int column = s->column + 1;
+
+    // Tokens carry the (1-based) position of their first char,
+    // the same as D_TokenStreamPosition() reports.
+    D_TokenType type = D_ScanToken(s);
+    D_Token token = D_NewToken(s, type);
+    token.line = line;
+    token.column = column;
+    if(type == D_TokenType_NEWLINE) {
+        s->column = 0;
+    }
+    return token;
+}
+
+void D_InitScanner(const char* const source, size_t length) {
+    D_ScannerInit(&scanner, source, length);
+}
+
+D_Token D_GetNextToken(void) {
+    return D_ScannerNext(&scanner);
+}
+
+/*****************************************************************
+* Token Stream
+*****************************************************************/
+
+void D_TokenStreamInit(D_TokenStream* stream) {
+    stream->source = NULL;
+    stream->sourceLength = 0;
+    stream->count = 0;
+    stream->capacity = 0;
+    stream->types = NULL;
+    stream->offsets = NULL;
+    stream->lengths = NULL;
+    stream->lineCount = 0;
+    stream->lineStarts = NULL;
+}
+
+void D_TokenStreamFree(D_TokenStream* stream) {
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_COMPILER, int8_t, stream->types, stream->capacity);
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_COMPILER, uint32_t, stream->offsets, stream->capacity);
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_COMPILER, uint32_t, stream->lengths, stream->capacity);
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_COMPILER, uint32_t, stream->lineStarts, stream->lineCount);
+    D_TokenStreamInit(stream);
+}
+
+static void D_TokenStreamReserve(D_TokenStream* stream, int capacity) {
+    int prevCapacity = stream->capacity;
+    stream->capacity = capacity;
+    stream->types = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_COMPILER, int8_t, stream->types, prevCapacity, stream->capacity);
+    stream->offsets = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_COMPILER, uint32_t, stream->offsets, prevCapacity, stream->capacity);
+    stream->lengths = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_COMPILER, uint32_t, stream->lengths, prevCapacity, stream->capacity);
+}
+
+inline static void D_TokenStreamAdd(D_TokenStream* stream, D_TokenType type, uint32_t offset, uint32_t length) {
+    if(stream->capacity < stream->count + 1) {
+        D_TokenStreamReserve(stream, DRG_MEM_GROW_CAPACITY(stream->capacity));
+    }
+    stream->types[stream->count] = (int8_t)type;
+    stream->offsets[stream->count] = offset;
+    stream->lengths[stream->count] = length;
+    stream->count++;
+}
+
+int D_TokenizeAll(const char* const source, size_t length, D_TokenStream* stream) {
+    D_ScannerCtx ctx;
+    D_ScannerCtx* s = &ctx;
+    D_ScannerInit(s, source, length);
+    stream->source = source;
+    // Real code averages well over 8 bytes per token, so this
+    // guess saves most of the regrowing on big sources.
+    size_t guess = (size_t)stream->count + length / 8 + 1;
+    if(guess > (size_t)stream->capacity && guess < (size_t)INT32_MAX) {
+        D_TokenStreamReserve(stream, (int)guess);
+    }
+    // Tokens only need the scanner's pointers, so skip building
+    // full D_Tokens and write the three fields directly.
+    for(;;) {
+        D_ConsumeWhitespaces(s);
+        s->start = s->current;
+        D_TokenType type = D_ScanToken(s);
+        D_TokenStreamAdd(stream, type,
+            (uint32_t)(s->start - source),
+            (uint32_t)(s->current - s->start));
+        if(type == D_TokenType_EOF) {
+            break;
+        }
+    }
+    stream->sourceLength = (uint32_t)length;
+    return stream->count;
+}
+
+// Builds the line-start index with one pass over the source.
+static void D_TokenStreamIndexLines(D_TokenStream* stream) {
+    int capacity = 0;
+    uint32_t* starts = NULL;
+    int count = 0;
+    const char* at = stream->source;
+    const char* end = stream->source + stream->sourceLength;
+    for(;;) {
+        if(capacity < count + 1) {
+            int prevCapacity = capacity;
+            capacity = DRG_MEM_GROW_CAPACITY(prevCapacity);
+            starts = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_COMPILER, uint32_t, starts, prevCapacity, capacity);
+        }
+        starts[count++] = (uint32_t)(at - stream->source);
+        const char* newline = memchr(at, '\n', (size_t)(end - at));
+        if(NULL == newline) {
+            break;
+        }
+        at = newline + 1;
+    }
+    // Shrink so the stored count is also the allocated size
+    stream->lineStarts = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_COMPILER, uint32_t, starts, capacity, count);
+    stream->lineCount = count;
+}
+
+void D_TokenStreamPosition(D_TokenStream* stream, int index, int* line, int* column) {
+    if(0 == stream->lineCount) {
+        D_TokenStreamIndexLines(stream);
+    }
+    // Binary search for the last line starting at or before the token
+    uint32_t offset = stream->offsets[index];
+    int low = 0;
+    int high = stream->lineCount - 1;
+    while(low < high) {
+        int mid = low + (high - low + 1) / 2;
+        if(stream->lineStarts[mid] <= offset) {
+            low = mid;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+    *line = low + 1;
+    *column = (int)(offset - stream->lineStarts[low]) + 1;
+}
+
+D_Token D_TokenStreamGet(D_TokenStream* stream, int index) {
+    D_Token token;
+    token.type = (D_TokenType)stream->types[index];
+    token.start = stream->source + stream->offsets[index];
+    token.length = (int)stream->lengths[index];
+    D_TokenStreamPosition(stream, index, &token.line, &token.column);
+    return token;
+}
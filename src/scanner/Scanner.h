@@ -13,9 +13,90 @@
 #ifndef DRG_H_SCANNER
 #define DRG_H_SCANNER
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "Token.h"
+#include "ScannerSimd.h"
+
+/// @brief The state of one scan over one source. Contexts share
+/// nothing, so any number of sources can be scanned at once, one
+/// context per thread.
+typedef struct {
+    const char* start;      // ptr to start of lexeme
+    const char* current;    // ptr to the char about to be consumed
+    const char* end;        // one past the last char of the source
+    int line;               // line number
+    int column;             // column in line
+    const D_ScanKernels* kernels; // byte-skipping loops
+} D_ScannerCtx;
+
+/// @brief A whole source file's tokens, stored as a packed
+/// struct-of-arrays. Each token costs 9 bytes (type, byte
+/// offset, length) instead of a full D_Token; line and column
+/// are recovered on demand from a line-start index that is only
+/// built the first time a position is asked for.
+typedef struct {
+    const char* source;     // source the offsets point into
+    uint32_t sourceLength;  // bytes in 'source'
+    int count;              // number of tokens (incl. EOF)
+    int capacity;           // allocated slots in each array
+    int8_t* types;          // D_TokenType of each token
+    uint32_t* offsets;      // byte offset of each lexeme
+    uint32_t* lengths;      // byte length of each lexeme
+    int lineCount;          // 0 until the index is built
+    uint32_t* lineStarts;   // byte offset of each line start
+} D_TokenStream;
+
+/// @brief Points a scanner context at the start of a source.
+/// @param ctx 
+/// @param source Source text, must outlive the context. It does
+/// not need to be null-terminated.
+/// @param length Number of chars in 'source'.
+void D_ScannerInit(D_ScannerCtx* ctx, const char* const source, size_t length);
+
+/// @brief Scans the next token of the context's source.
+/// @param ctx 
+/// @return The token, EOF once the source is exhausted.
+D_Token D_ScannerNext(D_ScannerCtx* ctx);
+
+/// @brief D_ScannerInit() on a single, process-wide context.
+/// NOTE: not thread-safe, prefer D_ScannerInit().
+/// @param source 
+/// @param length 
+void D_InitScanner(const char* const source, size_t length);
 
-void D_InitScanner(const char* const source);
+/// @brief D_ScannerNext() on the process-wide context.
+/// @return 
 D_Token D_GetNextToken(void);
 
+/// @brief Initializes an empty token stream.
+/// @param stream 
+void D_TokenStreamInit(D_TokenStream* stream);
+
+/// @brief Frees the dynamic memory of a token stream.
+/// @param stream 
+void D_TokenStreamFree(D_TokenStream* stream);
+
+/// @brief Scans all of 'source' in one pass, appending every
+/// token (the last one being EOF) to 'stream'. Reentrant.
+/// @param source Source text, must outlive the stream.
+/// @param length Number of chars in 'source'.
+/// @param stream An initialized stream.
+/// @return The number of tokens scanned.
+int D_TokenizeAll(const char* const source, size_t length, D_TokenStream* stream);
+
+/// @brief Computes the 1-based line and column of a token.
+/// @param stream 
+/// @param index Token index, in [0, count).
+/// @param line Output line.
+/// @param column Output column of the first char of the lexeme.
+void D_TokenStreamPosition(D_TokenStream* stream, int index, int* line, int* column);
+
+/// @brief Expands a token of the stream into a full D_Token.
+/// @param stream 
+/// @param index Token index, in [0, count).
+/// @return The token, positions resolved.
+D_Token D_TokenStreamGet(D_TokenStream* stream, int index);
+
 #endif // DRG_H_SCANNER
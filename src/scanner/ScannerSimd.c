@@ -0,0 +1,267 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file ScannerSimd.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Byte-class skipping kernels used by the scanner's hot loops.
+*
+* The vector kernels only ever do aligned loads. An aligned block
+* never straddles a page, so reading the whole block that holds
+* the last char of the source can't fault even though some of its
+* bytes lie past 'end' (those are ignored, as are the bytes before
+* 'p' in the first block). This holds for heap buffers and for
+* memory-mapped files alike.
+*
+*****************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#endif
+
+#include "ScannerSimd.h"
+
+#if !defined(DRG_SCANNER_FORCE_SCALAR) && (defined(__x86_64__) || defined(_M_X64))
+#define DRG_SCANNER_X86 1
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define DRG_SCANNER_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+/*****************************************************************
+* Scalar
+*****************************************************************/
+
+static const char* D_FindLineEndScalar(const char* p, const char* end) {
+    while(p < end && *p != '\n') p++;
+    return p;
+}
+
+static const char* D_FindBlockStopScalar(const char* p, const char* end) {
+    while(p < end && *p != '#' && *p != '\n') p++;
+    return p;
+}
+
+static const char* D_SkipBlanksScalar(const char* p, const char* end) {
+    while(p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+static const char* D_SkipIdentifierScalar(const char* p, const char* end) {
+    for(; p < end; p++) {
+        char c = *p;
+        if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+            (c >= '0' && c <= '9') || c == '_') {
+            continue;
+        }
+        return p;
+    }
+    return end;
+}
+
+static const D_ScanKernels D_ScalarKernels = {
+    D_FindLineEndScalar,
+    D_FindBlockStopScalar,
+    D_SkipBlanksScalar,
+    D_SkipIdentifierScalar,
+    "scalar"
+};
+
+/*****************************************************************
+* SSE2 (16 bytes per step)
+*****************************************************************/
+
+#ifdef DRG_SCANNER_X86
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+static inline int D_Ctz(unsigned mask) {
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+}
+#else
+#define D_Ctz(mask) __builtin_ctz(mask)
+#endif
+
+// Each class function returns a byte mask with 0xFF where the
+// scan must stop.
+static inline __m128i D_StopLineEnd16(__m128i v) {
+    return _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+}
+
+static inline __m128i D_StopBlock16(__m128i v) {
+    return _mm_or_si128(D_StopLineEnd16(v),
+        _mm_cmpeq_epi8(v, _mm_set1_epi8('#')));
+}
+
+static inline __m128i D_KeepBlanks16(__m128i v) {
+    return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')),
+            _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+}
+
+static inline __m128i D_KeepIdentifier16(__m128i v) {
+    // Bytes >= 0x80 are negative as signed chars, so the signed
+    // range compares reject them for free.
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+        _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+        _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    return _mm_or_si128(alpha, _mm_or_si128(digit, under));
+}
+
+// Generates a 16-byte kernel. 'invert' is 1 when 'classFn' gives
+// the bytes to keep rather than the ones to stop on.
+#define DRG_SCAN_KERNEL_SSE2(name, classFn, invert) \
+    static const char* name(const char* p, const char* end) { \
+        if(p >= end) return end; \
+        unsigned misalign = (unsigned)((uintptr_t)p & 15); \
+        const char* block = p - misalign; \
+        __m128i v = _mm_load_si128((const __m128i*)block); \
+        unsigned mask = (unsigned)_mm_movemask_epi8(classFn(v)); \
+        if(invert) mask = ~mask & 0xFFFFu; \
+        mask &= 0xFFFFu << misalign; \
+        while(0 == mask) { \
+            block += 16; \
+            if(block >= end) return end; \
+            v = _mm_load_si128((const __m128i*)block); \
+            mask = (unsigned)_mm_movemask_epi8(classFn(v)); \
+            if(invert) mask = ~mask & 0xFFFFu; \
+        } \
+        const char* stop = block + D_Ctz(mask); \
+        return stop < end ? stop : end; \
+    }
+
+DRG_SCAN_KERNEL_SSE2(D_FindLineEndSse2, D_StopLineEnd16, 0)
+DRG_SCAN_KERNEL_SSE2(D_FindBlockStopSse2, D_StopBlock16, 0)
+DRG_SCAN_KERNEL_SSE2(D_SkipBlanksSse2, D_KeepBlanks16, 1)
+DRG_SCAN_KERNEL_SSE2(D_SkipIdentifierSse2, D_KeepIdentifier16, 1)
+
+static const D_ScanKernels D_Sse2Kernels = {
+    D_FindLineEndSse2,
+    D_FindBlockStopSse2,
+    D_SkipBlanksSse2,
+    D_SkipIdentifierSse2,
+    "sse2"
+};
+
+#endif // DRG_SCANNER_X86
+
+/*****************************************************************
+* AVX2 (32 bytes per step)
+*****************************************************************/
+
+#ifdef DRG_SCANNER_AVX2
+
+#define DRG_AVX2 __attribute__((target("avx2")))
+
+DRG_AVX2 static inline __m256i D_StopLineEnd32(__m256i v) {
+    return _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+}
+
+DRG_AVX2 static inline __m256i D_StopBlock32(__m256i v) {
+    return _mm256_or_si256(D_StopLineEnd32(v),
+        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('#')));
+}
+
+DRG_AVX2 static inline __m256i D_KeepBlanks32(__m256i v) {
+    return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')),
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+}
+
+DRG_AVX2 static inline __m256i D_KeepIdentifier32(__m256i v) {
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+    __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+    __m256i under = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+    return _mm256_or_si256(alpha, _mm256_or_si256(digit, under));
+}
+
+#define DRG_SCAN_KERNEL_AVX2(name, classFn, invert) \
+    DRG_AVX2 static const char* name(const char* p, const char* end) { \
+        if(p >= end) return end; \
+        unsigned misalign = (unsigned)((uintptr_t)p & 31); \
+        const char* block = p - misalign; \
+        __m256i v = _mm256_load_si256((const __m256i*)block); \
+        unsigned mask = (unsigned)_mm256_movemask_epi8(classFn(v)); \
+        if(invert) mask = ~mask; \
+        mask &= 0xFFFFFFFFu << misalign; \
+        while(0 == mask) { \
+            block += 32; \
+            if(block >= end) return end; \
+            v = _mm256_load_si256((const __m256i*)block); \
+            mask = (unsigned)_mm256_movemask_epi8(classFn(v)); \
+            if(invert) mask = ~mask; \
+        } \
+        const char* stop = block + D_Ctz(mask); \
+        return stop < end ? stop : end; \
+    }
+
+DRG_SCAN_KERNEL_AVX2(D_FindLineEndAvx2, D_StopLineEnd32, 0)
+DRG_SCAN_KERNEL_AVX2(D_FindBlockStopAvx2, D_StopBlock32, 0)
+DRG_SCAN_KERNEL_AVX2(D_SkipBlanksAvx2, D_KeepBlanks32, 1)
+DRG_SCAN_KERNEL_AVX2(D_SkipIdentifierAvx2, D_KeepIdentifier32, 1)
+
+static const D_ScanKernels D_Avx2Kernels = {
+    D_FindLineEndAvx2,
+    D_FindBlockStopAvx2,
+    D_SkipBlanksAvx2,
+    D_SkipIdentifierAvx2,
+    "avx2"
+};
+
+#endif // DRG_SCANNER_AVX2
+
+/*****************************************************************
+* Dispatch
+*****************************************************************/
+
+// The table is published with a single pointer store, so a thread
+// can never see a name that doesn't match its kernels. Racing
+// threads all pick the same table.
+#if defined(__STDC_NO_ATOMICS__)
+static const D_ScanKernels* volatile _kernels = NULL;
+#define D_LoadKernels() (_kernels)
+#define D_StoreKernels(kernels) (_kernels = (kernels))
+#else
+static _Atomic(const D_ScanKernels*) _kernels = NULL;
+#define D_LoadKernels() atomic_load_explicit(&_kernels, memory_order_acquire)
+#define D_StoreKernels(kernels) atomic_store_explicit(&_kernels, (kernels), memory_order_release)
+#endif
+
+static const D_ScanKernels* D_SelectScanKernels(void) {
+    const D_ScanKernels* kernels = &D_ScalarKernels;
+    #ifdef DRG_SCANNER_X86
+    // SSE2 is part of the x86-64 baseline
+    kernels = &D_Sse2Kernels;
+    #endif
+    #ifdef DRG_SCANNER_AVX2
+    if(__builtin_cpu_supports("avx2")) {
+        kernels = &D_Avx2Kernels;
+    }
+    #endif
+    D_StoreKernels(kernels);
+    return kernels;
+}
+
+const D_ScanKernels* D_GetScanKernels(void) {
+    const D_ScanKernels* kernels = D_LoadKernels();
+    return NULL != kernels ? kernels : D_SelectScanKernels();
+}
+
+const char* D_GetScanKernelsName(void) {
+    return D_GetScanKernels()->name;
+}
@@ -0,0 +1,40 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file ScannerSimd.h
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Byte-class skipping kernels used by the scanner's hot loops.
+* Each kernel has a scalar, SSE2 and AVX2 version, and the best
+* one for the running CPU is picked once at startup.
+*
+*****************************************************************/
+
+#ifndef DRG_H_SCANNER_SIMD
+#define DRG_H_SCANNER_SIMD
+
+/// @brief A kernel returns the first pointer in [p, end) whose
+/// byte is in its stop class, or 'end' if there is none.
+typedef const char* (*D_ScanKernel)(const char* p, const char* end);
+
+typedef struct {
+    D_ScanKernel findLineEnd;     // stops on '\n'
+    D_ScanKernel findBlockStop;   // stops on '#' or '\n'
+    D_ScanKernel skipBlanks;      // stops on anything but ' ', '\t', '\r'
+    D_ScanKernel skipIdentifier;  // stops on anything but [A-Za-z0-9_]
+    const char* name;             // instruction set they use
+} D_ScanKernels;
+
+/// @brief Kernels picked for this CPU. Selection happens on
+/// the first call, from any thread, and is fixed to the scalar
+/// versions when built with DRG_SCANNER_FORCE_SCALAR.
+/// @return The kernel table, never NULL.
+const D_ScanKernels* D_GetScanKernels(void);
+
+/// @brief Name of the instruction set the kernels use.
+/// @return "scalar", "sse2" or "avx2".
+const char* D_GetScanKernelsName(void);
+
+#endif // DRG_H_SCANNER_SIMD
@@ -24,6 +24,11 @@ typedef enum {
     D_TokenType_RPAREN,
     D_TokenType_LBRACE,
     D_TokenType_RBRACE,
+    D_TokenType_LBRACK,
+    D_TokenType_RBRACK,
+    D_TokenType_COMMA,
+    D_TokenType_COLON,
+    D_TokenType_DOT,
     D_TokenType_MINUS,
     D_TokenType_PLUS,
     D_TokenType_SLASH,
@@ -60,6 +65,7 @@ typedef enum {
     D_TokenType_KW_readonly,
     D_TokenType_KW_real,
     D_TokenType_KW_ref,
+    D_TokenType_KW_return,
     D_TokenType_KW_string,
     D_TokenType_KW_struct,
     D_TokenType_KW_then,
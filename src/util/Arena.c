@@ -0,0 +1,114 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file Arena.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Bump-pointer arena allocator.
+*
+*****************************************************************/
+
+#include <stdalign.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "Arena.h"
+
+#define DRG_ARENA_ALIGN alignof(max_align_t)
+#define DRG_ARENA_ROUND(size) (((size) + DRG_ARENA_ALIGN - 1) & ~(DRG_ARENA_ALIGN - 1))
+// Header rounded up, so chunk data starts aligned
+#define DRG_ARENA_HEADER DRG_ARENA_ROUND(sizeof(D_ArenaChunk))
+#define DRG_ARENA_DEFAULT_CHUNK (64 * 1024)
+
+static inline char* D_ChunkData(D_ArenaChunk* chunk) {
+    return (char*)chunk + DRG_ARENA_HEADER;
+}
+
+static void D_ChunkFree(D_Arena* arena, D_ArenaChunk* chunk) {
+    drgMemReallocate(arena->category, chunk, DRG_ARENA_HEADER + chunk->capacity, 0);
+}
+
+void D_ArenaInit(D_Arena* arena, size_t chunkSize) {
+    arena->head = NULL;
+    arena->chunkSize = DRG_ARENA_ROUND((chunkSize > 0) ? chunkSize : DRG_ARENA_DEFAULT_CHUNK);
+    arena->reserved = 0;
+    arena->limit = 0;
+    arena->category = DRG_MEM_CAT_GENERAL;
+}
+
+// Starts a new chunk with room for at least 'size' bytes.
+static D_ArenaChunk* D_ArenaAddChunk(D_Arena* arena, size_t size) {
+    size_t capacity = (size > arena->chunkSize) ? size : arena->chunkSize;
+    size_t bytes = DRG_ARENA_HEADER + capacity;
+    if(arena->limit > 0 && arena->reserved + bytes > arena->limit) {
+        return NULL;
+    }
+    D_ArenaChunk* chunk = (D_ArenaChunk*)drgMemReallocate(arena->category, NULL, 0, bytes);
+    chunk->prev = arena->head;
+    chunk->capacity = capacity;
+    chunk->used = 0;
+    arena->head = chunk;
+    arena->reserved += bytes;
+    return chunk;
+}
+
+void* D_ArenaAlloc(D_Arena* arena, size_t size) {
+    size = DRG_ARENA_ROUND(size);
+    D_ArenaChunk* chunk = arena->head;
+    if(NULL == chunk || chunk->capacity - chunk->used < size) {
+        chunk = D_ArenaAddChunk(arena, size);
+        if(NULL == chunk) {
+            return NULL;
+        }
+    }
+    void* result = D_ChunkData(chunk) + chunk->used;
+    chunk->used += size;
+    return result;
+}
+
+void* D_ArenaGrow(D_Arena* arena, void* ptr, size_t prevSize, size_t newSize) {
+    if(NULL == ptr) {
+        return D_ArenaAlloc(arena, newSize);
+    }
+    D_ArenaChunk* chunk = arena->head;
+    size_t prevRounded = DRG_ARENA_ROUND(prevSize);
+    size_t newRounded = DRG_ARENA_ROUND(newSize);
+    // The newest allocation can just move the bump pointer
+    if((char*)ptr + prevRounded == D_ChunkData(chunk) + chunk->used &&
+        chunk->used - prevRounded + newRounded <= chunk->capacity) {
+        chunk->used = chunk->used - prevRounded + newRounded;
+        return ptr;
+    }
+    void* result = D_ArenaAlloc(arena, newSize);
+    if(NULL != result) {
+        memcpy(result, ptr, (prevSize < newSize) ? prevSize : newSize);
+    }
+    return result;
+}
+
+void D_ArenaReset(D_Arena* arena) {
+    D_ArenaChunk* head = arena->head;
+    if(NULL == head) {
+        return;
+    }
+    for(D_ArenaChunk* chunk = head->prev; chunk != NULL;) {
+        D_ArenaChunk* prev = chunk->prev;
+        D_ChunkFree(arena, chunk);
+        chunk = prev;
+    }
+    head->prev = NULL;
+    head->used = 0;
+    arena->reserved = DRG_ARENA_HEADER + head->capacity;
+}
+
+void D_ArenaFree(D_Arena* arena) {
+    for(D_ArenaChunk* chunk = arena->head; chunk != NULL;) {
+        D_ArenaChunk* prev = chunk->prev;
+        D_ChunkFree(arena, chunk);
+        chunk = prev;
+    }
+    arena->head = NULL;
+    arena->reserved = 0;
+}
@@ -0,0 +1,72 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file Arena.h
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Bump-pointer arena for data that all dies at the same time,
+* such as everything a single compile needs. Allocations are
+* carved out of large chunks and never freed one by one; the
+* whole arena is released (or rewound) at once.
+*
+*****************************************************************/
+
+#ifndef DRG_H_ARENA
+#define DRG_H_ARENA
+
+#include <stddef.h>
+
+#include "drgMemUtil.h"
+
+/// @brief One block of arena memory, its data follows the header.
+typedef struct D_ArenaChunk {
+    struct D_ArenaChunk* prev;  // the chunk filled before this one
+    size_t capacity;            // bytes of data
+    size_t used;
+} D_ArenaChunk;
+
+/// @brief A chain of chunks, allocated from the newest.
+typedef struct {
+    D_ArenaChunk* head;
+    size_t chunkSize;   // data bytes of a new chunk, unless more is asked for
+    size_t reserved;    // bytes held in all chunks, headers included
+    size_t limit;       // max 'reserved', 0 for no limit
+    drgMemCategory category; // what the chunks are accounted as
+} D_Arena;
+
+/// @brief Initializes an empty arena, nothing is allocated yet.
+/// Set 'limit' afterwards to cap the memory it may hold, and
+/// 'category' to account it as something other than general.
+/// @param arena
+/// @param chunkSize Size of each chunk, 0 for the default.
+void D_ArenaInit(D_Arena* arena, size_t chunkSize);
+
+/// @brief Allocates 'size' bytes, aligned for any type.
+/// @param arena
+/// @param size
+/// @return The memory, valid until the arena is reset or freed.
+/// NULL only if it would take the arena past its limit.
+void* D_ArenaAlloc(D_Arena* arena, size_t size);
+
+/// @brief Resizes an arena allocation. The most recent one grows
+/// in place when its chunk has room, anything else is copied.
+/// @param arena
+/// @param ptr An allocation of 'arena', or NULL.
+/// @param prevSize Its current size.
+/// @param newSize
+/// @return The memory, NULL only if over the limit (in which case
+/// 'ptr' is left as it was).
+void* D_ArenaGrow(D_Arena* arena, void* ptr, size_t prevSize, size_t newSize);
+
+/// @brief Discards every allocation but keeps the newest chunk,
+/// so an arena reused in a loop settles at no allocations.
+/// @param arena
+void D_ArenaReset(D_Arena* arena);
+
+/// @brief Frees every chunk of an arena.
+/// @param arena
+void D_ArenaFree(D_Arena* arena);
+
+#endif // DRG_H_ARENA
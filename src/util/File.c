@@ -0,0 +1,200 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file File.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* File system utilities.
+*
+*****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <direct.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "File.h"
+#include "drgMemUtil.h"
+
+// Read size for sources that can't be mapped
+#define DRG_SOURCE_CHUNK (64 * 1024)
+
+/*****************************************************************
+* Source Buffers
+*****************************************************************/
+
+// Reads a stream of unknown size (e.g. a pipe) chunk by chunk.
+// The front end keeps slices of the source for the whole compile,
+// so the chunks land in one growing buffer rather than being
+// scanned and dropped.
+static bool D_SourceReadStream(FILE* file, D_SourceBuffer* source) {
+    size_t capacity = 0;
+    size_t length = 0;
+    char* data = NULL;
+    for(;;) {
+        if(capacity - length < DRG_SOURCE_CHUNK) {
+            size_t prevCapacity = capacity;
+            capacity = (capacity < DRG_SOURCE_CHUNK) ? DRG_SOURCE_CHUNK : capacity * 2;
+            data = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_GENERAL, char, data, prevCapacity, capacity);
+        }
+        size_t bytesRead = fread(data + length, sizeof(char), DRG_SOURCE_CHUNK, file);
+        length += bytesRead;
+        if(bytesRead < DRG_SOURCE_CHUNK) {
+            break;
+        }
+    }
+    if(ferror(file)) {
+        DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_GENERAL, char, data, capacity);
+        return false;
+    }
+    if(0 == length) {
+        DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_GENERAL, char, data, capacity);
+        source->data = "";
+        source->length = 0;
+        source->kind = D_SourceKind_EMPTY;
+        return true;
+    }
+    // Give back the slack of the last chunk
+    source->data = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_GENERAL, char, data, capacity, length);
+    source->length = length;
+    source->kind = D_SourceKind_HEAP;
+    return true;
+}
+
+bool D_SourceOpen(const char* path, D_SourceBuffer* source) {
+    if(0 == strcmp(path, "-")) {
+        return D_SourceReadStream(stdin, source);
+    }
+
+    #if defined(_WIN32) || defined(_WIN64)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(INVALID_HANDLE_VALUE == file) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if(GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(NULL != mapping) {
+            const char* view = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            // The view keeps the file alive on its own
+            CloseHandle(mapping);
+            if(NULL != view) {
+                CloseHandle(file);
+                source->data = view;
+                source->length = (size_t)size.QuadPart;
+                source->kind = D_SourceKind_MAPPED;
+                return true;
+            }
+        }
+    }
+    CloseHandle(file);
+    FILE* stream = fopen(path, "rb");
+    #else
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if(0 != fstat(fd, &info) || S_ISDIR(info.st_mode)) {
+        close(fd);
+        return false;
+    }
+    if(S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(MAP_FAILED != view) {
+            // The mapping keeps the file alive on its own
+            close(fd);
+            #ifdef MADV_SEQUENTIAL
+            madvise(view, (size_t)info.st_size, MADV_SEQUENTIAL);
+            #endif
+            source->data = (const char*)view;
+            source->length = (size_t)info.st_size;
+            source->kind = D_SourceKind_MAPPED;
+            return true;
+        }
+    }
+    FILE* stream = fdopen(fd, "rb");
+    if(NULL == stream) {
+        close(fd);
+    }
+    #endif
+
+    if(NULL == stream) {
+        return false;
+    }
+    bool ok = D_SourceReadStream(stream, source);
+    fclose(stream);
+    return ok;
+}
+
+void D_SourceClose(D_SourceBuffer* source) {
+    switch(source->kind) {
+        case D_SourceKind_MAPPED:
+            #if defined(_WIN32) || defined(_WIN64)
+            UnmapViewOfFile(source->data);
+            #else
+            munmap((void*)source->data, source->length);
+            #endif
+            break;
+        case D_SourceKind_HEAP:
+            DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_GENERAL, char, (char*)source->data, source->length);
+            break;
+        default:
+            break;
+    }
+    source->data = "";
+    source->length = 0;
+    source->kind = D_SourceKind_EMPTY;
+}
+
+/*****************************************************************
+* Paths
+*****************************************************************/
+
+bool D_IsDirectory(const char* path) {
+    struct stat info;
+    if(0 != stat(path, &info)) {
+        return false;
+    }
+    #if defined(_WIN32) || defined(_WIN64)
+    return (info.st_mode & _S_IFDIR) != 0;
+    #else
+    return S_ISDIR(info.st_mode);
+    #endif
+}
+
+bool D_MakeDirectories(const char* path) {
+    char partial[4096];
+    size_t length = strlen(path);
+    if(0 == length || length >= sizeof(partial)) {
+        return false;
+    }
+    memcpy(partial, path, length + 1);
+    // Each parent in turn; ones that already exist just fail
+    for(size_t i = 1; i <= length; i++) {
+        if(i < length && partial[i] != '/' && partial[i] != '\\') {
+            continue;
+        }
+        char separator = partial[i];
+        partial[i] = '\0';
+        #if defined(_WIN32) || defined(_WIN64)
+        _mkdir(partial);
+        #else
+        mkdir(partial, 0755);
+        #endif
+        partial[i] = separator;
+    }
+    return D_IsDirectory(path);
+}
@@ -0,0 +1,59 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file File.h
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* File system utilities.
+*
+*****************************************************************/
+
+#ifndef DRG_H_FILE
+#define DRG_H_FILE
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/// @brief How a source buffer's memory was obtained.
+typedef enum {
+    D_SourceKind_EMPTY,     // nothing to release
+    D_SourceKind_MAPPED,    // read-only mapping of the file
+    D_SourceKind_HEAP       // malloc'd copy (pipes, special files)
+} D_SourceKind;
+
+/// @brief The read-only text of a source file. It is NOT
+/// null-terminated, always use 'length'.
+typedef struct {
+    const char* data;
+    size_t length;
+    D_SourceKind kind;
+} D_SourceBuffer;
+
+/// @brief Loads a source file for scanning. Regular files are
+/// memory-mapped, so nothing is copied and untouched pages are
+/// never read; anything that can't be mapped (pipes, ttys) is
+/// read in chunks instead. A path of "-" reads stdin.
+/// Never logs, so it may be called from any thread.
+/// @param path 
+/// @param source Output buffer, release with D_SourceClose().
+/// @return False if the file couldn't be opened or read.
+bool D_SourceOpen(const char* path, D_SourceBuffer* source);
+
+/// @brief Releases a buffer filled by D_SourceOpen().
+/// @param source 
+void D_SourceClose(D_SourceBuffer* source);
+
+/// @brief Checks whether 'path' names a directory.
+/// @param path 
+/// @return True if it exists and is a directory.
+bool D_IsDirectory(const char* path);
+
+/// @brief Creates a directory and any missing parents, like
+/// 'mkdir -p'.
+/// @param path 
+/// @return True if it exists as a directory afterwards.
+bool D_MakeDirectories(const char* path);
+
+#endif // DRG_H_FILE
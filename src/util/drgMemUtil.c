@@ -10,18 +10,132 @@
 *
 *****************************************************************/
 
-//#include <stdio.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
 #include "drgMemUtil.h"
 
-void* drgMemReallocate(void* ptr, size_t prevSize, size_t newSize) {
+// Index DRG_MEM_CAT_Count holds the totals. Relaxed atomics, as
+// the project lexer allocates from several threads at once.
+typedef struct {
+    atomic_size_t allocated;
+    atomic_size_t live;
+    atomic_size_t peak;
+    atomic_size_t count;
+} drgMemCounters;
+
+static drgMemCounters drgMemAccounts[DRG_MEM_CAT_Count + 1];
+static atomic_size_t drgMemLimit;
+static _Thread_local drgMemGuard* drgMemGuards = NULL;
+
+static const char* const drgMemNames[DRG_MEM_CAT_Count + 1] = {
+    [DRG_MEM_CAT_GENERAL]   = "general",
+    [DRG_MEM_CAT_BYTECODE]  = "bytecode",
+    [DRG_MEM_CAT_CONSTANTS] = "constants",
+    [DRG_MEM_CAT_STRINGS]   = "strings",
+    [DRG_MEM_CAT_ARRAYS]    = "arrays",
+    [DRG_MEM_CAT_MAPS]      = "maps",
+    [DRG_MEM_CAT_STRUCTS]   = "structs",
+    [DRG_MEM_CAT_COMPILER]  = "compiler",
+    [DRG_MEM_CAT_VM]        = "vm",
+    [DRG_MEM_CAT_Count]     = "total"
+};
+
+static void drgMemRaisePeak(drgMemCounters* counters, size_t live) {
+    size_t peak = atomic_load_explicit(&counters->peak, memory_order_relaxed);
+    while(live > peak && !atomic_compare_exchange_weak_explicit(&counters->peak, &peak, live,
+        memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static void drgMemRecord(drgMemCounters* counters, size_t prevSize, size_t newSize) {
+    if(newSize > prevSize) {
+        size_t growth = newSize - prevSize;
+        atomic_fetch_add_explicit(&counters->allocated, growth, memory_order_relaxed);
+        size_t live = atomic_fetch_add_explicit(&counters->live, growth, memory_order_relaxed) + growth;
+        drgMemRaisePeak(counters, live);
+    }
+    else {
+        atomic_fetch_sub_explicit(&counters->live, prevSize - newSize, memory_order_relaxed);
+    }
+}
+
+_Noreturn static void drgMemFail(size_t newSize) {
+    if(NULL != drgMemGuards) {
+        longjmp(drgMemGuards->env, 1);
+    }
+    fprintf(stderr, "drgMemReallocate: out of memory allocating %zu bytes!\n", newSize);
+    exit(1);
+}
+
+void* drgMemReallocate(drgMemCategory category, void* ptr, size_t prevSize, size_t newSize) {
     if(0 == newSize) {
-        free(ptr);
+        if(ptr) {
+            free(ptr);
+            drgMemRecord(&drgMemAccounts[category], prevSize, 0);
+            drgMemRecord(&drgMemAccounts[DRG_MEM_CAT_Count], prevSize, 0);
+        }
         return NULL;
     }
+    size_t limit = atomic_load_explicit(&drgMemLimit, memory_order_relaxed);
+    if(limit > 0 && newSize > prevSize &&
+        atomic_load_explicit(&drgMemAccounts[DRG_MEM_CAT_Count].live, memory_order_relaxed)
+            + (newSize - prevSize) > limit) {
+        drgMemFail(newSize);
+    }
     void* result = realloc(ptr, newSize);
     if(result == NULL) {
-        //perror("drgMemReallocate: realloc() returned null!");
-        exit(1);
+        drgMemFail(newSize);
+    }
+    // A fresh allocation has nothing before it
+    if(NULL == ptr) {
+        prevSize = 0;
     }
+    atomic_fetch_add_explicit(&drgMemAccounts[category].count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&drgMemAccounts[DRG_MEM_CAT_Count].count, 1, memory_order_relaxed);
+    drgMemRecord(&drgMemAccounts[category], prevSize, newSize);
+    drgMemRecord(&drgMemAccounts[DRG_MEM_CAT_Count], prevSize, newSize);
     return result;
-}
\ No newline at end of file
+}
+
+void drgMemGetStats(drgMemCategory category, drgMemStats* stats) {
+    drgMemCounters* counters = &drgMemAccounts[category];
+    stats->allocated = atomic_load_explicit(&counters->allocated, memory_order_relaxed);
+    stats->live = atomic_load_explicit(&counters->live, memory_order_relaxed);
+    stats->peak = atomic_load_explicit(&counters->peak, memory_order_relaxed);
+    stats->count = atomic_load_explicit(&counters->count, memory_order_relaxed);
+}
+
+const char* drgMemCategoryName(drgMemCategory category) {
+    return drgMemNames[category];
+}
+
+void drgMemPrintStats(void) {
+    printf("%-10s %14s %14s %14s %10s\n", "memory", "allocated", "live", "peak", "count");
+    for(int i = 0; i <= DRG_MEM_CAT_Count; i++) {
+        drgMemStats stats;
+        drgMemGetStats((drgMemCategory)i, &stats);
+        if(0 == stats.count && i != DRG_MEM_CAT_Count) {
+            continue;
+        }
+        printf("%-10s %14zu %14zu %14zu %10zu\n", drgMemNames[i],
+            stats.allocated, stats.live, stats.peak, stats.count);
+    }
+}
+
+void drgMemSetLimit(size_t bytes) {
+    atomic_store_explicit(&drgMemLimit, bytes, memory_order_relaxed);
+}
+
+size_t drgMemGetLimit(void) {
+    return atomic_load_explicit(&drgMemLimit, memory_order_relaxed);
+}
+
+void drgMemPushGuard(drgMemGuard* guard) {
+    guard->prev = drgMemGuards;
+    drgMemGuards = guard;
+}
+
+void drgMemPopGuard(drgMemGuard* guard) {
+    drgMemGuards = guard->prev;
+}
@@ -13,9 +13,41 @@
 #ifndef DRG_H_MEM_UTIL
 #define DRG_H_MEM_UTIL
 
+#include <setjmp.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 
+/// @brief What an allocation is for, to break the accounting down.
+typedef enum {
+    DRG_MEM_CAT_GENERAL,    // source text and anything else
+    DRG_MEM_CAT_BYTECODE,   // nuggets and functions
+    DRG_MEM_CAT_CONSTANTS,  // constant pools
+    DRG_MEM_CAT_STRINGS,
+    DRG_MEM_CAT_ARRAYS,
+    DRG_MEM_CAT_MAPS,
+    DRG_MEM_CAT_STRUCTS,
+    DRG_MEM_CAT_COMPILER,   // tokens, symbols and compile arenas
+    DRG_MEM_CAT_VM,         // value stack, call frames and globals
+    DRG_MEM_CAT_Count
+} drgMemCategory;
+
+/// @brief Accounting of one category, or of all of them.
+typedef struct {
+    size_t allocated;   // bytes ever allocated (growth included)
+    size_t live;        // bytes held right now
+    size_t peak;        // most bytes ever held at once
+    size_t count;       // allocations and reallocations
+} drgMemStats;
+
+/// @brief A point to fall back to when an allocation fails, so
+/// the caller can report an error and carry on instead of the
+/// process exiting. Guards nest, per thread.
+typedef struct drgMemGuard {
+    jmp_buf env;
+    struct drgMemGuard* prev;
+} drgMemGuard;
+
 // Convenience macro for freeing memory
 // allocated via malloc().
 #define DRG_MEM_FREE(ptr) \
@@ -28,8 +60,43 @@
 
 // Wrapper around std realloc() that handles
 // cases where new size is 0 (freeing data), as
-// well as error handling.
-void* drgMemReallocate(void* ptr, size_t prevSize, size_t newSize);
+// well as error handling. Every byte is accounted
+// to 'category'. If it fails, or would go over the
+// limit, it jumps to the innermost drgMemGuard of
+// the thread, and exits if there is none.
+void* drgMemReallocate(drgMemCategory category, void* ptr, size_t prevSize, size_t newSize);
+
+/// @brief Reads the accounting of a category.
+/// @param category DRG_MEM_CAT_Count for the total.
+/// @param stats Output.
+void drgMemGetStats(drgMemCategory category, drgMemStats* stats);
+
+/// @brief Name of a category, e.g. "bytecode" ("total" for
+/// DRG_MEM_CAT_Count).
+const char* drgMemCategoryName(drgMemCategory category);
+
+/// @brief Prints the accounting of every category in use.
+void drgMemPrintStats(void);
+
+/// @brief Caps the bytes live across all categories.
+/// @param bytes 0 for no limit.
+void drgMemSetLimit(size_t bytes);
+
+/// @brief The limit set with drgMemSetLimit(), 0 if none.
+size_t drgMemGetLimit(void);
+
+/// @brief Makes 'guard' where failed allocations of this thread
+/// land. Use as:
+///     if(setjmp(guard.env)) { drgMemPopGuard(&guard); ...failed... }
+///     drgMemPushGuard(&guard);
+///     ...
+///     drgMemPopGuard(&guard);
+/// @param guard
+void drgMemPushGuard(drgMemGuard* guard);
+
+/// @brief Removes the innermost guard, which must be 'guard'.
+/// @param guard
+void drgMemPopGuard(drgMemGuard* guard);
 
 // Convenience macro for growing some
 // dynamic memory space with an arbitrary
@@ -41,13 +108,13 @@ void* drgMemReallocate(void* ptr, size_t prevSize, size_t newSize);
 
 // Convenience macro for growing a
 // dynamic memory space using drgMemReallocate().
-#define DRG_MEM_GROW_ARRAY(type, ptr, prevCount, newCount)\
-    (type*)drgMemReallocate(ptr, sizeof(type) * prevCount,\
+#define DRG_MEM_GROW_ARRAY(category, type, ptr, prevCount, newCount)\
+    (type*)drgMemReallocate(category, ptr, sizeof(type) * prevCount,\
         sizeof(type) * newCount)
 
 // Convenience macro for freeing a
 // dynamic memory space using drgMemReallocate().
-#define DRG_MEM_FREE_ARRAY(type, ptr, prevCount)\
-    drgMemReallocate(ptr, sizeof(type) * prevCount, 0)
+#define DRG_MEM_FREE_ARRAY(category, type, ptr, prevCount)\
+    drgMemReallocate(category, ptr, sizeof(type) * prevCount, 0)
 
 #endif // DRG_H_MEM_UTIL
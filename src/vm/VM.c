@@ -2,247 +2,1338 @@
 * Dargon Programming Language
 * (C) Kyle Morris 2025 - See LICENSE.txt for license information.
 *
-* @file drgVM.h
+* @file VM.c
 * @author Kyle Morris
 * @since v0.1
 * @section Description
 * The implementation of the stack-based virtual machine (VM).
 *
+* Instructions are dispatched with computed gotos ("threaded
+* code") on GCC and Clang: every handler ends in its own indirect
+* jump through a label table, so the branch predictor learns
+* which op tends to follow which. Elsewhere, or when built with
+* DRG_VM_SWITCH_DISPATCH, the loop is a plain switch.
+*
+* The value stack grows as needed. Every nugget knows the deepest
+* its frame can get, so room is made once per call and pushes
+* and pops never check.
+*
 *****************************************************************/
 
 #include <stdio.h>
 
 #include "VM.h"
-#include "../scanner/Scanner.h"
+#include "drgArray.h"
+#include "drgMap.h"
+#include "drgRope.h"
+#include "drgStruct.h"
+#include "drgCache.h"
+#include "drgDebug.h"
+#include "drgIntern.h"
+#include "drgModule.h"
+#include "drgNugget.h"
+#include "drgObject.h"
+#include "../compiler/Compiler.h"
+#include "../util/Log.h"
+#include "../util/drgMemUtil.h"
+#include "../util/Version.h"
+
+#if defined(__GNUC__) && !defined(DRG_VM_SWITCH_DISPATCH)
+#define DRG_VM_COMPUTED_GOTO
+#endif
+
+#define DRG_STACK_INITIAL 256
+// Past these, runaway recursion is a runtime error rather than
+// eating all the memory there is
+#define DRG_STACK_LIMIT (1 << 24)
+#define DRG_FRAMES_LIMIT (1 << 20)
 
+/// @brief A function call in progress.
+typedef struct {
+    drgNugget* nugget;
+    drgByte* ip;       // where to carry on once its callee returns
+    int base;          // stack index of its slot 0, the callee
+    drgVal* globals;   // vm.globals, or its module's
+} D_CallFrame;
+
+/// @brief The Dargon Virtual Machine (VM)
 typedef struct {
-    //drgNugget* nugget; // The nugget being interpreted
-    //drgByte* ip; // Instruction Pointer to the instr ABOUT to be executed
-    //drgVal stack[DRG_STACK_MAX];
-    //drgVal* stackTop;
+    drgVal* stack;     // moves as it grows, so frames hold indices
+    int stackCapacity;
+    drgVal* stackTop;
+    D_CallFrame* frames;
+    int frameCount;
+    int frameCapacity;
+    drgVal* globals;   // one slot per D_GlobalTable symbol
+    int globalCapacity;
+    bool trace;
+    unsigned compileFlags; // D_CompileFlag for D_Interpret()
+    const char* cacheDirectory; // for D_InterpretCached(), or NULL
 } D_VM;
 
-static D_VM vm;
+static D_VM vm; // The single VM instance.
 
-void D_InitVirtualMachine(void) {
-    
+static void D_ResetStack(void) {
+    vm.stackTop = vm.stack;
+    vm.frameCount = 0;
 }
 
-D_Result D_Interpret(const char* const source) {
-    // -- Initialize scanner
-    D_InitScanner(source);
-
-    // -- Temporary code to drive a "compiler"
-    int line = -1;
-    for(;;) {
-        D_Token token = D_GetNextToken();
-        printf("(%3d,%3d) ", token.line, token.column);
-        // For now just print the token
-        printf("%2d '%.*s'\n", token.type, token.length, token.start);
-        if(token.type == D_TokenType_EOF) {
-            break;
-        }
+// Makes room for 'count' values. Pointers into the stack are
+// invalid afterwards.
+static bool D_ReserveStack(int count) {
+    if(count <= vm.stackCapacity) {
+        return true;
     }
-
-    return D_Result_OK;
+    if(count > DRG_STACK_LIMIT) {
+        return false;
+    }
+    int top = (int)(vm.stackTop - vm.stack);
+    int capacity = (vm.stackCapacity < DRG_STACK_INITIAL) ? DRG_STACK_INITIAL : vm.stackCapacity;
+    while(capacity < count) {
+        capacity *= 2;
+    }
+    vm.stack = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_VM, drgVal, vm.stack, vm.stackCapacity, capacity);
+    vm.stackCapacity = capacity;
+    vm.stackTop = vm.stack + top;
+    return true;
 }
 
-void D_FreeVirtualMachine(void) {
+// Makes room for 'count' call frames.
+static bool D_ReserveFrames(int count) {
+    if(count <= vm.frameCapacity) {
+        return true;
+    }
+    if(count > DRG_FRAMES_LIMIT) {
+        return false;
+    }
+    int capacity = vm.frameCapacity;
+    while(capacity < count) {
+        capacity = DRG_MEM_GROW_CAPACITY(capacity);
+    }
+    vm.frames = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_VM, D_CallFrame, vm.frames, vm.frameCapacity, capacity);
+    vm.frameCapacity = capacity;
+    return true;
+}
 
+// Makes sure there's a slot for every global compiled so far.
+static void D_ReserveGlobals(int count) {
+    if(vm.globalCapacity < count) {
+        int capacity = vm.globalCapacity;
+        while(capacity < count) {
+            capacity = DRG_MEM_GROW_CAPACITY(capacity);
+        }
+        vm.globals = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_VM, drgVal, vm.globals, vm.globalCapacity, capacity);
+        vm.globalCapacity = capacity;
+    }
 }
 
-/* 
-// TODO: Dynamically modify stack
-#define DRG_STACK_MAX 256
+/*****************************************************************
+* Tracing
+*****************************************************************/
 
-/// @brief The Dargon Virtual Machine (VM)
-typedef struct {
-    drgNugget* nugget; // The nugget being interpreted
-    drgByte* ip; // Instruction Pointer to the instr ABOUT to be executed
-    drgVal stack[DRG_STACK_MAX];
-    drgVal* stackTop;
-} drgVM;
+#ifdef DRG_DEBUG
+// Prints the stack, then the instruction about to run. Reached
+// only through the tracing dispatch, never from the fast path.
+static void D_TraceInstruction(drgNugget* nugget, drgByte* ip, drgVal* stackTop) {
+    printf("          ");
+    for(drgVal* s = vm.stack; s < stackTop; s++) {
+        printf("[ ");
+        drgPrintVal(*s);
+        printf(" ]");
+    }
+    printf("\n");
+    drgDisassembleInstruction(nugget, (int)(ip - nugget->bytecode));
+}
+#endif
 
-static drgVM vm; // The single VM instance.
+bool D_SetTrace(bool enabled) {
+    #ifdef DRG_DEBUG
+    vm.trace = enabled;
+    return true;
+    #else
+    vm.trace = false;
+    return !enabled;
+    #endif
+}
 
-// -----------------------
+/*****************************************************************
+* Run Loop
+*****************************************************************/
 
-static int drgSimpleInst(const char* name, drgByte inst, int offset) {
-    printf("%-16s (0x%02X)\n", name, inst);
-    return offset + 1;
+static bool D_HasType(drgVal value, drgType type) {
+    switch(type) {
+        case DRG_TYPE_INT:    return drgValIsInt(value);
+        case DRG_TYPE_REAL:   return drgValIsReal(value);
+        case DRG_TYPE_BOOL:   return drgValIsBool(value);
+        case DRG_TYPE_STRING: return drgValIsString(value);
+        case DRG_TYPE_FUN:    return drgValIsObjType(value, DRG_OBJ_FUNCTION);
+        case DRG_TYPE_NONE:   return drgValIsNone(value);
+        case DRG_TYPE_ANY:    return true;
+        default:
+            if(type >= DRG_TYPE_STRUCT_ARRAY) {
+                return drgValIsObjType(value, DRG_OBJ_ARRAY) && drgValAsArray(value)->kind == DRG_ARRAY_STRUCT &&
+                    drgValAsArray(value)->rowType == type - DRG_STRUCT_TYPES;
+            }
+            if(type >= DRG_TYPE_STRUCT) {
+                return drgValIsObjType(value, DRG_OBJ_STRUCT) && drgValAsStruct(value)->type == type;
+            }
+            if(type >= DRG_TYPE_MAP) {
+                return drgValIsObjType(value, DRG_OBJ_MAP) &&
+                    drgValAsMap(value)->keyType * 4 + drgValAsMap(value)->valueType == type - DRG_TYPE_MAP;
+            }
+            // Array kinds are in the order of the element types
+            return drgValIsObjType(value, DRG_OBJ_ARRAY) &&
+                (int)drgValAsArray(value)->kind == (int)(type - DRG_TYPE_INT_ARRAY);
+    }
 }
 
-static int drgLitInst(const char* name, drgByte inst, drgNugget* nug, int offset) {
-    drgByte lit = nug->bytecode[offset + 1];
-    printf("%-16s (0x%02X) %2d' ", name, inst, lit);
-    drgPrintVal(nug->constantPool.values[lit]);
-    printf("'\n");
-    return offset + 2; // Consumes 2 spaces
+// An array of the element type operand of DRG_OC_ARRAY or
+// DRG_OC_NEW_ARRAY, with room for 'capacity'. A struct array takes
+// its row width from 'row', one of the structs going in.
+static drgArray* D_NewArray(int element, drgVal row, int capacity) {
+    bool isResizable = 0 != (element & DRG_ARRAY_RESIZABLE);
+    drgType type = (drgType)(element & ~DRG_ARRAY_RESIZABLE);
+    if(type >= DRG_TYPE_STRUCT) {
+        return drgNewStructArray(type, drgValAsStruct(row)->count, isResizable, capacity);
+    }
+    // The kinds are in the order of the element types
+    return drgNewArray((drgArrayKind)type, isResizable, capacity);
 }
 
-static void drgResetStack(void) {
-    vm.stackTop = vm.stack;
+static const char* D_TypeError(drgType type) {
+    switch(type) {
+        case DRG_TYPE_INT:    return "Expected an int.";
+        case DRG_TYPE_REAL:   return "Expected a real.";
+        case DRG_TYPE_BOOL:   return "Expected a bool.";
+        case DRG_TYPE_STRING: return "Expected a string.";
+        case DRG_TYPE_FUN:    return "Expected a function.";
+        case DRG_TYPE_INT_ARRAY:    return "Expected an int array.";
+        case DRG_TYPE_REAL_ARRAY:   return "Expected a real array.";
+        case DRG_TYPE_BOOL_ARRAY:   return "Expected a bool array.";
+        case DRG_TYPE_STRING_ARRAY: return "Expected a string array.";
+        case DRG_TYPE_NONE:   return "Expected no value.";
+        default:              return (type >= DRG_TYPE_STRUCT_ARRAY) ? "Expected another type of struct array."
+                                  : (type >= DRG_TYPE_STRUCT) ? "Expected another type of struct."
+                                  : "Expected another type of map.";
+    }
 }
 
-static void drgPushStack(drgVal val) {
-    // TODO: Make sure pushing would not
-    // go over the max!
-    *vm.stackTop = val;
-    vm.stackTop++;
-}
+// Runs from the top frame until it returns.
+static D_Result D_Run(void) {
+    // The hot state lives in locals so it can stay in registers
+    D_CallFrame* frame = &vm.frames[vm.frameCount - 1];
+    drgNugget* nugget = frame->nugget;
+    drgByte* ip = nugget->bytecode;
+    drgVal* sp = vm.stackTop;
+    drgVal* fp = vm.stack + frame->base; // the frame's slot 0
+    drgVal* globals = vm.globals;
+    drgVal* R = vm.globals; // register frame: globals, then temporaries
 
-static drgVal drgPopStack(void) {
-    vm.stackTop--;
-    return *vm.stackTop;
-}
+    #define DRG_READ_BYTE() (*ip++)
+    #define DRG_READ_SHORT() (ip += 2, (int)((ip[-2] << 8) | ip[-1]))
+    #define DRG_READ_LIT() (nugget->constantPool.values[DRG_READ_BYTE()])
+    #define DRG_READ_LIT_LONG() (ip += 3, nugget->constantPool.values[(ip[-3] << 16) | (ip[-2] << 8) | ip[-1]])
+    #define DRG_PUSH(val) (*sp++ = (val))
+    #define DRG_POP() (*--sp)
+    #define DRG_IS_NUMBER(val) (drgValIsInt(val) || drgValIsReal(val))
+    #define DRG_RUNTIME_ERROR(msg) \
+        do {\
+            error = msg;\
+            goto DRG_OP_ERROR;\
+        } while(0)
+    // The operations are written against value slots, so the stack
+    // and register forms share them. Two ints stay an int (wrapping
+    // at 48 bits), anything else with a real becomes a real.
+    #define DRG_ARITH(dst, x, y, op) \
+        do {\
+            drgVal a = (x);\
+            drgVal b = (y);\
+            if(drgValIsInt(a) && drgValIsInt(b)) {\
+                dst = drgValFromInt((int64_t)((uint64_t)drgValAsInt(a) op (uint64_t)drgValAsInt(b)));\
+            }\
+            else if(DRG_IS_NUMBER(a) && DRG_IS_NUMBER(b)) {\
+                dst = drgValFromReal(drgValAsNumber(a) op drgValAsNumber(b));\
+            }\
+            else DRG_RUNTIME_ERROR("Operands must be numbers.");\
+        } while(0)
+    // '+' also joins strings
+    #define DRG_ADD(dst, x, y) \
+        do {\
+            drgVal a = (x);\
+            drgVal b = (y);\
+            if(drgValIsInt(a) && drgValIsInt(b)) {\
+                dst = drgValFromInt((int64_t)((uint64_t)drgValAsInt(a) + (uint64_t)drgValAsInt(b)));\
+            }\
+            else if(DRG_IS_NUMBER(a) && DRG_IS_NUMBER(b)) {\
+                dst = drgValFromReal(drgValAsNumber(a) + drgValAsNumber(b));\
+            }\
+            else if(drgValIsString(a) && drgValIsString(b)) {\
+                DRG_CONCAT(dst, a, b);\
+            }\
+            else DRG_RUNTIME_ERROR("Operands must be two numbers or two strings.");\
+        } while(0)
+    #define DRG_CONCAT(dst, a, b) \
+        do {\
+            if((int64_t)drgStringLength(a) + drgStringLength(b) > DRG_STRING_MAX) {\
+                DRG_RUNTIME_ERROR("String is too long.");\
+            }\
+            dst = drgConcat(a, b);\
+        } while(0)
+    #define DRG_DIVIDE(dst, x, y) \
+        do {\
+            drgVal a = (x);\
+            drgVal b = (y);\
+            if(drgValIsInt(a) && drgValIsInt(b)) {\
+                if(0 == drgValAsInt(b)) DRG_RUNTIME_ERROR("Division by zero.");\
+                dst = drgValFromInt(drgValAsInt(a) / drgValAsInt(b));\
+            }\
+            else if(DRG_IS_NUMBER(a) && DRG_IS_NUMBER(b)) {\
+                dst = drgValFromReal(drgValAsNumber(a) / drgValAsNumber(b));\
+            }\
+            else DRG_RUNTIME_ERROR("Operands must be numbers.");\
+        } while(0)
+    #define DRG_COMPARE(dst, x, y, op) \
+        do {\
+            drgVal a = (x);\
+            drgVal b = (y);\
+            if(drgValIsInt(a) && drgValIsInt(b)) {\
+                dst = drgValFromBool(drgValAsInt(a) op drgValAsInt(b));\
+            }\
+            else if(DRG_IS_NUMBER(a) && DRG_IS_NUMBER(b)) {\
+                dst = drgValFromBool(drgValAsNumber(a) op drgValAsNumber(b));\
+            }\
+            else DRG_RUNTIME_ERROR("Operands must be numbers.");\
+        } while(0)
+    // 1 eq 1.0, like the other comparisons
+    // Ropes are flattened first, so equal strings are one object
+    #define DRG_EQUALS(dst, x, y, want) \
+        do {\
+            drgVal a = drgValFlat(x);\
+            drgVal b = drgValFlat(y);\
+            bool equal = (DRG_IS_NUMBER(a) && DRG_IS_NUMBER(b) && drgValIsInt(a) != drgValIsInt(b))\
+                ? drgValAsNumber(a) == drgValAsNumber(b) : drgValEquals(a, b);\
+            dst = drgValFromBool(equal == (want));\
+        } while(0)
+    #define DRG_NEGATE(dst, x) \
+        do {\
+            drgVal a = (x);\
+            if(drgValIsInt(a)) dst = drgValFromInt((int64_t)(0 - (uint64_t)drgValAsInt(a)));\
+            else if(drgValIsReal(a)) dst = drgValFromReal(-drgValAsReal(a));\
+            else DRG_RUNTIME_ERROR("Operand must be a number.");\
+        } while(0)
+    #define DRG_NOT(dst, x) \
+        do {\
+            drgVal a = (x);\
+            if(!drgValIsBool(a)) DRG_RUNTIME_ERROR("Operand must be a bool.");\
+            dst = drgValFromBool(!drgValAsBool(a));\
+        } while(0)
+    // Typed forms, the compiler having proven what the operands are
+    #define DRG_INT_ARITH(op) \
+        do {\
+            sp[-2] = drgValFromInt((int64_t)((uint64_t)drgValAsInt(sp[-2]) op (uint64_t)drgValAsInt(sp[-1])));\
+            sp--;\
+        } while(0)
+    #define DRG_REAL_ARITH(op) \
+        do {\
+            sp[-2] = drgValFromReal(drgValAsReal(sp[-2]) op drgValAsReal(sp[-1]));\
+            sp--;\
+        } while(0)
+    #define DRG_TYPED_COMPARE(as, op) \
+        do {\
+            sp[-2] = drgValFromBool(as(sp[-2]) op as(sp[-1]));\
+            sp--;\
+        } while(0)
+    #define DRG_INT_TO_REAL(dst, x) dst = drgValFromReal((double)drgValAsInt(x))
+    // The array 'back' values down the stack and the 1-based index
+    // above it, as a 0-based one
+    #define DRG_ARRAY_INDEX(array, index, back) \
+        do {\
+            array = drgValAsArray(sp[-(back)]);\
+            index = (uint64_t)drgValAsInt(sp[1 - (back)]) - 1;\
+            if(index >= (uint64_t)array->count) DRG_RUNTIME_ERROR("Index out of bounds.");\
+        } while(0)
+    // Arrays the compiler couldn't prove are arrays
+    #define DRG_CHECK_ARRAY(x) \
+        do {\
+            if(!drgValIsObjType(x, DRG_OBJ_ARRAY)) DRG_RUNTIME_ERROR("Expected an array.");\
+        } while(0)
+    #define DRG_CHECK_INDEX(x) \
+        do {\
+            if(!drgValIsInt(x)) DRG_RUNTIME_ERROR("Index must be an int.");\
+        } while(0)
+    // Maps and keys the compiler couldn't prove are maps and keys
+    #define DRG_CHECK_MAP(x) \
+        do {\
+            if(!drgValIsObjType(x, DRG_OBJ_MAP)) DRG_RUNTIME_ERROR("Expected a map.");\
+        } while(0)
+    #define DRG_CHECK_KEY(map, x) \
+        do {\
+            if(!drgMapKeyFits(map, x)) DRG_RUNTIME_ERROR("Wrong type of key for this map.");\
+        } while(0)
+    #define DRG_MAP_FOUND(value) \
+        do {\
+            if(NULL == (value)) DRG_RUNTIME_ERROR("Key not found.");\
+        } while(0)
+    // Register form: 'R' is the frame, read operands before writing
+    #define DRG_R_UNARY(OP) \
+        do {\
+            int d = DRG_READ_SHORT();\
+            int x = DRG_READ_SHORT();\
+            OP(R[d], R[x]);\
+        } while(0)
+    #define DRG_R_BINARY(OP, ...) \
+        do {\
+            int d = DRG_READ_SHORT();\
+            int x = DRG_READ_SHORT();\
+            int y = DRG_READ_SHORT();\
+            OP(R[d], R[x], R[y], __VA_ARGS__);\
+        } while(0)
+    #define DRG_R_DIVIDE() \
+        do {\
+            int d = DRG_READ_SHORT();\
+            int x = DRG_READ_SHORT();\
+            int y = DRG_READ_SHORT();\
+            DRG_DIVIDE(R[d], R[x], R[y]);\
+        } while(0)
+    #define DRG_R_ADD() \
+        do {\
+            int d = DRG_READ_SHORT();\
+            int x = DRG_READ_SHORT();\
+            int y = DRG_READ_SHORT();\
+            DRG_ADD(R[d], R[x], R[y]);\
+        } while(0)
+    const char* error = NULL;
 
-static char* drgReadFile(const char* path) {
-    FILE* file = fopen(path, "rb");
-    if(NULL == file) {
-        perror("Could not open file!");
-        exit(EXIT_FAILURE); // nothing more we can do
-    }
+    #ifdef DRG_VM_COMPUTED_GOTO
+    // Every byte value has an entry, so bad bytecode can't jump
+    // into the weeds.
+    static void* const dispatch[256] = {
+        [0 ... 255]          = &&DRG_OP_UNKNOWN,
+        [DRG_OC_RETURN]      = &&DRG_OP_RETURN,
+        [DRG_OC_NUM_LIT]     = &&DRG_OP_NUM_LIT,
+        [DRG_OC_NUM_LIT_LONG] = &&DRG_OP_NUM_LIT_LONG,
+        [DRG_OC_TRUE]        = &&DRG_OP_TRUE,
+        [DRG_OC_FALSE]       = &&DRG_OP_FALSE,
+        [DRG_OC_NONE]        = &&DRG_OP_NONE,
+        [DRG_OC_NEGATE]      = &&DRG_OP_NEGATE,
+        [DRG_OC_NOT]         = &&DRG_OP_NOT,
+        [DRG_OC_ADD]         = &&DRG_OP_ADD,
+        [DRG_OC_SUB]         = &&DRG_OP_SUB,
+        [DRG_OC_MULT]        = &&DRG_OP_MULT,
+        [DRG_OC_DIV]         = &&DRG_OP_DIV,
+        [DRG_OC_EQ]          = &&DRG_OP_EQ,
+        [DRG_OC_NEQ]         = &&DRG_OP_NEQ,
+        [DRG_OC_GT]          = &&DRG_OP_GT,
+        [DRG_OC_GTE]         = &&DRG_OP_GTE,
+        [DRG_OC_LT]          = &&DRG_OP_LT,
+        [DRG_OC_LTE]         = &&DRG_OP_LTE,
+        [DRG_OC_NEGATE_INT]  = &&DRG_OP_NEGATE_INT,
+        [DRG_OC_NEGATE_REAL] = &&DRG_OP_NEGATE_REAL,
+        [DRG_OC_ADD_INT]     = &&DRG_OP_ADD_INT,
+        [DRG_OC_ADD_REAL]    = &&DRG_OP_ADD_REAL,
+        [DRG_OC_ADD_STRING]  = &&DRG_OP_ADD_STRING,
+        [DRG_OC_SUB_INT]     = &&DRG_OP_SUB_INT,
+        [DRG_OC_SUB_REAL]    = &&DRG_OP_SUB_REAL,
+        [DRG_OC_MULT_INT]    = &&DRG_OP_MULT_INT,
+        [DRG_OC_MULT_REAL]   = &&DRG_OP_MULT_REAL,
+        [DRG_OC_DIV_INT]     = &&DRG_OP_DIV_INT,
+        [DRG_OC_DIV_REAL]    = &&DRG_OP_DIV_REAL,
+        [DRG_OC_EQ_INT]      = &&DRG_OP_EQ_INT,
+        [DRG_OC_EQ_REAL]     = &&DRG_OP_EQ_REAL,
+        [DRG_OC_EQ_STRING]   = &&DRG_OP_EQ_STRING,
+        [DRG_OC_NEQ_INT]     = &&DRG_OP_NEQ_INT,
+        [DRG_OC_NEQ_REAL]    = &&DRG_OP_NEQ_REAL,
+        [DRG_OC_NEQ_STRING]  = &&DRG_OP_NEQ_STRING,
+        [DRG_OC_GT_INT]      = &&DRG_OP_GT_INT,
+        [DRG_OC_GT_REAL]     = &&DRG_OP_GT_REAL,
+        [DRG_OC_GTE_INT]     = &&DRG_OP_GTE_INT,
+        [DRG_OC_GTE_REAL]    = &&DRG_OP_GTE_REAL,
+        [DRG_OC_LT_INT]      = &&DRG_OP_LT_INT,
+        [DRG_OC_LT_REAL]     = &&DRG_OP_LT_REAL,
+        [DRG_OC_LTE_INT]     = &&DRG_OP_LTE_INT,
+        [DRG_OC_LTE_REAL]    = &&DRG_OP_LTE_REAL,
+        [DRG_OC_INT_TO_REAL] = &&DRG_OP_INT_TO_REAL,
+        [DRG_OC_INT_TO_REAL_UNDER] = &&DRG_OP_INT_TO_REAL_UNDER,
+        [DRG_OC_CHECK_TYPE]  = &&DRG_OP_CHECK_TYPE,
+        [DRG_OC_DEFINE_GLOBAL] = &&DRG_OP_DEFINE_GLOBAL,
+        [DRG_OC_GET_GLOBAL]  = &&DRG_OP_GET_GLOBAL,
+        [DRG_OC_SET_GLOBAL]  = &&DRG_OP_SET_GLOBAL,
+        [DRG_OC_GET_LOCAL]   = &&DRG_OP_GET_LOCAL,
+        [DRG_OC_SET_LOCAL]   = &&DRG_OP_SET_LOCAL,
+        [DRG_OC_JUMP]        = &&DRG_OP_JUMP,
+        [DRG_OC_JUMP_IF_FALSE] = &&DRG_OP_JUMP_IF_FALSE,
+        [DRG_OC_LOOP]        = &&DRG_OP_LOOP,
+        [DRG_OC_CALL]        = &&DRG_OP_CALL,
+        [DRG_OC_ARRAY]       = &&DRG_OP_ARRAY,
+        [DRG_OC_NEW_ARRAY]   = &&DRG_OP_NEW_ARRAY,
+        [DRG_OC_GET_INDEX]   = &&DRG_OP_GET_INDEX,
+        [DRG_OC_GET_INDEX_INT] = &&DRG_OP_GET_INDEX_INT,
+        [DRG_OC_GET_INDEX_REAL] = &&DRG_OP_GET_INDEX_REAL,
+        [DRG_OC_GET_INDEX_BOOL] = &&DRG_OP_GET_INDEX_BOOL,
+        [DRG_OC_SET_INDEX]   = &&DRG_OP_SET_INDEX,
+        [DRG_OC_SET_INDEX_INT] = &&DRG_OP_SET_INDEX_INT,
+        [DRG_OC_SET_INDEX_REAL] = &&DRG_OP_SET_INDEX_REAL,
+        [DRG_OC_SET_INDEX_BOOL] = &&DRG_OP_SET_INDEX_BOOL,
+        [DRG_OC_ARRAY_ADD]   = &&DRG_OP_ARRAY_ADD,
+        [DRG_OC_ARRAY_REM]   = &&DRG_OP_ARRAY_REM,
+        [DRG_OC_ARRAY_LEN]   = &&DRG_OP_ARRAY_LEN,
+        [DRG_OC_MAP]         = &&DRG_OP_MAP,
+        [DRG_OC_GET_MAP_INT] = &&DRG_OP_GET_MAP_INT,
+        [DRG_OC_GET_MAP_REAL] = &&DRG_OP_GET_MAP_REAL,
+        [DRG_OC_GET_MAP_STRING] = &&DRG_OP_GET_MAP_STRING,
+        [DRG_OC_SET_MAP]     = &&DRG_OP_SET_MAP,
+        [DRG_OC_MAP_HAS]     = &&DRG_OP_MAP_HAS,
+        [DRG_OC_MAP_REM]     = &&DRG_OP_MAP_REM,
+        [DRG_OC_MAP_LEN]     = &&DRG_OP_MAP_LEN,
+        [DRG_OC_MAP_KEYS]    = &&DRG_OP_MAP_KEYS,
+        [DRG_OC_MAP_RESERVE] = &&DRG_OP_MAP_RESERVE,
+        [DRG_OC_STRUCT]      = &&DRG_OP_STRUCT,
+        [DRG_OC_GET_FIELD]   = &&DRG_OP_GET_FIELD,
+        [DRG_OC_SET_FIELD]   = &&DRG_OP_SET_FIELD,
+        [DRG_OC_GET_ROW_FIELD] = &&DRG_OP_GET_ROW_FIELD,
+        [DRG_OC_SET_ROW_FIELD] = &&DRG_OP_SET_ROW_FIELD,
+        [DRG_OC_POP]         = &&DRG_OP_POP,
+        [DRG_OC_PRINT]       = &&DRG_OP_PRINT,
+        [DRG_OC_POP_LOCAL]   = &&DRG_OP_POP_LOCAL,
+        [DRG_OC_GET_LOCAL_ADD] = &&DRG_OP_GET_LOCAL_ADD,
+        [DRG_OC_LIT_ADD]     = &&DRG_OP_LIT_ADD,
+        [DRG_OC_LIT_SUB]     = &&DRG_OP_LIT_SUB,
+        [DRG_OC_LIT_LT]      = &&DRG_OP_LIT_LT,
+        [DRG_OC_LIT_EQ]      = &&DRG_OP_LIT_EQ,
+        [DRG_OC_R_LOADK]     = &&DRG_OP_R_LOADK,
+        [DRG_OC_R_LOADK_LONG] = &&DRG_OP_R_LOADK_LONG,
+        [DRG_OC_R_LOADTRUE]  = &&DRG_OP_R_LOADTRUE,
+        [DRG_OC_R_LOADFALSE] = &&DRG_OP_R_LOADFALSE,
+        [DRG_OC_R_MOVE]      = &&DRG_OP_R_MOVE,
+        [DRG_OC_R_NEGATE]    = &&DRG_OP_R_NEGATE,
+        [DRG_OC_R_NOT]       = &&DRG_OP_R_NOT,
+        [DRG_OC_R_INT_TO_REAL] = &&DRG_OP_R_INT_TO_REAL,
+        [DRG_OC_R_ADD]       = &&DRG_OP_R_ADD,
+        [DRG_OC_R_SUB]       = &&DRG_OP_R_SUB,
+        [DRG_OC_R_MULT]      = &&DRG_OP_R_MULT,
+        [DRG_OC_R_DIV]       = &&DRG_OP_R_DIV,
+        [DRG_OC_R_EQ]        = &&DRG_OP_R_EQ,
+        [DRG_OC_R_NEQ]       = &&DRG_OP_R_NEQ,
+        [DRG_OC_R_GT]        = &&DRG_OP_R_GT,
+        [DRG_OC_R_GTE]       = &&DRG_OP_R_GTE,
+        [DRG_OC_R_LT]        = &&DRG_OP_R_LT,
+        [DRG_OC_R_LTE]       = &&DRG_OP_R_LTE,
+        [DRG_OC_R_PRINT]     = &&DRG_OP_R_PRINT,
+    };
+    #ifdef DRG_DEBUG
+    // Tracing swaps in a table that sends every op through the
+    // tracer first, so the normal handlers carry no check at all.
+    static void* const traceDispatch[256] = {
+        [0 ... 255] = &&DRG_OP_TRACE
+    };
+    void* const* table = vm.trace ? traceDispatch : dispatch;
+    #else
+    void* const* table = dispatch;
+    #endif
 
-    fseek(file, 0L, SEEK_END);
-    size_t fileSize = ftell(file);
-    rewind(file);
+    #define DRG_VM_CASE(name) DRG_OP_##name:
+    #define DRG_VM_NEXT() goto *table[*ip++]
+    #define DRG_VM_LOOP() DRG_VM_NEXT();
+    #define DRG_VM_END()
+    #else
+    drgByte instruction;
+    #define DRG_VM_CASE(name) case DRG_OC_##name:
+    #define DRG_VM_NEXT() break
+    #ifdef DRG_DEBUG
+    #define DRG_VM_LOOP() \
+        for(;;) {\
+            if(vm.trace) D_TraceInstruction(nugget, ip, sp);\
+            switch(instruction = DRG_READ_BYTE()) {
+    #else
+    #define DRG_VM_LOOP() \
+        for(;;) {\
+            switch(instruction = DRG_READ_BYTE()) {
+    #endif
+    #define DRG_VM_END() \
+                default: goto DRG_OP_UNKNOWN;\
+            }\
+        }
+    #endif
 
-    char* buffer = malloc(fileSize + 1); // remember null terminator
-    if(NULL == buffer) {
-        perror("Could not allocate enough memory to read file!");
-        exit(EXIT_FAILURE);
-    }
+    DRG_VM_LOOP()
+        DRG_VM_CASE(NUM_LIT) {
+            DRG_PUSH(DRG_READ_LIT());
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(NUM_LIT_LONG) {
+            DRG_PUSH(DRG_READ_LIT_LONG());
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(TRUE) {
+            DRG_PUSH(drgValFromBool(true));
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(FALSE) {
+            DRG_PUSH(drgValFromBool(false));
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(NONE) {
+            DRG_PUSH(drgValNone());
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(NEGATE) { DRG_NEGATE(sp[-1], sp[-1]); DRG_VM_NEXT(); }
+        DRG_VM_CASE(NOT)    { DRG_NOT(sp[-1], sp[-1]); DRG_VM_NEXT(); }
+        DRG_VM_CASE(ADD)  { DRG_ADD(sp[-2], sp[-2], sp[-1]); sp--; DRG_VM_NEXT(); }
+        DRG_VM_CASE(SUB)  { DRG_ARITH(sp[-2], sp[-2], sp[-1], -); sp--; DRG_VM_NEXT(); }
+        DRG_VM_CASE(MULT) { DRG_ARITH(sp[-2], sp[-2], sp[-1], *); sp--; DRG_VM_NEXT(); }
+        DRG_VM_CASE(DIV)  { DRG_DIVIDE(sp[-2], sp[-2], sp[-1]); sp--; DRG_VM_NEXT(); }
+        DRG_VM_CASE(EQ)   { DRG_EQUALS(sp[-2], sp[-2], sp[-1], true); sp--; DRG_VM_NEXT(); }
+        DRG_VM_CASE(NEQ)  { DRG_EQUALS(sp[-2], sp[-2], sp[-1], false); sp--; DRG_VM_NEXT(); }
+        DRG_VM_CASE(GT)   { DRG_COMPARE(sp[-2], sp[-2], sp[-1], >); sp--; DRG_VM_NEXT(); }
+        DRG_VM_CASE(GTE)  { DRG_COMPARE(sp[-2], sp[-2], sp[-1], >=); sp--; DRG_VM_NEXT(); }
+        DRG_VM_CASE(LT)   { DRG_COMPARE(sp[-2], sp[-2], sp[-1], <); sp--; DRG_VM_NEXT(); }
+        DRG_VM_CASE(LTE)  { DRG_COMPARE(sp[-2], sp[-2], sp[-1], <=); sp--; DRG_VM_NEXT(); }
+        DRG_VM_CASE(NEGATE_INT) {
+            sp[-1] = drgValFromInt((int64_t)(0 - (uint64_t)drgValAsInt(sp[-1])));
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(NEGATE_REAL) {
+            sp[-1] = drgValFromReal(-drgValAsReal(sp[-1]));
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(ADD_INT)   { DRG_INT_ARITH(+); DRG_VM_NEXT(); }
+        DRG_VM_CASE(ADD_REAL)  { DRG_REAL_ARITH(+); DRG_VM_NEXT(); }
+        DRG_VM_CASE(ADD_STRING) { DRG_CONCAT(sp[-2], sp[-2], sp[-1]); sp--; DRG_VM_NEXT(); }
+        DRG_VM_CASE(SUB_INT)   { DRG_INT_ARITH(-); DRG_VM_NEXT(); }
+        DRG_VM_CASE(SUB_REAL)  { DRG_REAL_ARITH(-); DRG_VM_NEXT(); }
+        DRG_VM_CASE(MULT_INT)  { DRG_INT_ARITH(*); DRG_VM_NEXT(); }
+        DRG_VM_CASE(MULT_REAL) { DRG_REAL_ARITH(*); DRG_VM_NEXT(); }
+        DRG_VM_CASE(DIV_INT) {
+            int64_t divisor = drgValAsInt(sp[-1]);
+            if(0 == divisor) DRG_RUNTIME_ERROR("Division by zero.");
+            sp[-2] = drgValFromInt(drgValAsInt(sp[-2]) / divisor);
+            sp--;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(DIV_REAL)   { DRG_REAL_ARITH(/); DRG_VM_NEXT(); }
+        DRG_VM_CASE(EQ_INT)     { DRG_TYPED_COMPARE(drgValAsInt, ==); DRG_VM_NEXT(); }
+        DRG_VM_CASE(EQ_REAL)    { DRG_TYPED_COMPARE(drgValAsReal, ==); DRG_VM_NEXT(); }
+        DRG_VM_CASE(EQ_STRING)  { DRG_TYPED_COMPARE(drgValToString, ==); DRG_VM_NEXT(); }
+        DRG_VM_CASE(NEQ_INT)    { DRG_TYPED_COMPARE(drgValAsInt, !=); DRG_VM_NEXT(); }
+        DRG_VM_CASE(NEQ_REAL)   { DRG_TYPED_COMPARE(drgValAsReal, !=); DRG_VM_NEXT(); }
+        DRG_VM_CASE(NEQ_STRING) { DRG_TYPED_COMPARE(drgValToString, !=); DRG_VM_NEXT(); }
+        DRG_VM_CASE(GT_INT)     { DRG_TYPED_COMPARE(drgValAsInt, >); DRG_VM_NEXT(); }
+        DRG_VM_CASE(GT_REAL)    { DRG_TYPED_COMPARE(drgValAsReal, >); DRG_VM_NEXT(); }
+        DRG_VM_CASE(GTE_INT)    { DRG_TYPED_COMPARE(drgValAsInt, >=); DRG_VM_NEXT(); }
+        DRG_VM_CASE(GTE_REAL)   { DRG_TYPED_COMPARE(drgValAsReal, >=); DRG_VM_NEXT(); }
+        DRG_VM_CASE(LT_INT)     { DRG_TYPED_COMPARE(drgValAsInt, <); DRG_VM_NEXT(); }
+        DRG_VM_CASE(LT_REAL)    { DRG_TYPED_COMPARE(drgValAsReal, <); DRG_VM_NEXT(); }
+        DRG_VM_CASE(LTE_INT)    { DRG_TYPED_COMPARE(drgValAsInt, <=); DRG_VM_NEXT(); }
+        DRG_VM_CASE(LTE_REAL)   { DRG_TYPED_COMPARE(drgValAsReal, <=); DRG_VM_NEXT(); }
+        DRG_VM_CASE(INT_TO_REAL)       { DRG_INT_TO_REAL(sp[-1], sp[-1]); DRG_VM_NEXT(); }
+        DRG_VM_CASE(INT_TO_REAL_UNDER) { DRG_INT_TO_REAL(sp[-2], sp[-2]); DRG_VM_NEXT(); }
+        DRG_VM_CASE(CHECK_TYPE) {
+            // Where a value the compiler couldn't know meets a
+            // declared type
+            drgType type = (drgType)DRG_READ_BYTE();
+            if(type == DRG_TYPE_REAL && drgValIsInt(sp[-1])) {
+                DRG_INT_TO_REAL(sp[-1], sp[-1]);
+            }
+            else if(!D_HasType(sp[-1], type)) {
+                DRG_RUNTIME_ERROR(D_TypeError(type));
+            }
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(DEFINE_GLOBAL) {
+            int slot = DRG_READ_SHORT();
+            globals[slot] = DRG_POP();
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(GET_GLOBAL) {
+            int slot = DRG_READ_SHORT();
+            DRG_PUSH(globals[slot]);
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(SET_GLOBAL) {
+            int slot = DRG_READ_SHORT();
+            globals[slot] = sp[-1];
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(GET_LOCAL) {
+            DRG_PUSH(fp[DRG_READ_BYTE()]);
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(SET_LOCAL) {
+            fp[DRG_READ_BYTE()] = sp[-1];
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(JUMP) {
+            int offset = DRG_READ_SHORT();
+            ip += offset;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(JUMP_IF_FALSE) {
+            int offset = DRG_READ_SHORT();
+            if(!drgValIsBool(sp[-1])) DRG_RUNTIME_ERROR("Condition must be a bool.");
+            if(!drgValAsBool(sp[-1])) ip += offset;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(LOOP) {
+            int offset = DRG_READ_SHORT();
+            ip -= offset;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(CALL) {
+            int argc = DRG_READ_BYTE();
+            drgVal callee = sp[-1 - argc];
+            if(!drgValIsObjType(callee, DRG_OBJ_FUNCTION)) DRG_RUNTIME_ERROR("Can only call functions.");
+            drgFunction* function = drgValAsFunction(callee);
+            if(argc != function->arity) DRG_RUNTIME_ERROR("Wrong number of arguments.");
+            drgVal* calleeGlobals = globals;
+            if(NULL != function->module) {
+                // Module code is loaded on its first call, and sees
+                // the module's globals rather than the program's
+                if(NULL == function->nugget.bytecode && !drgModuleFault(function)) {
+                    DRG_RUNTIME_ERROR("Could not load the function from its module.");
+                }
+                calleeGlobals = function->module->globals;
+            }
+            // The only capacity check the callee gets: its nugget
+            // says how deep its frame goes.
+            int base = (int)(sp - vm.stack) - argc - 1;
+            if(base + function->nugget.maxStack > vm.stackCapacity || vm.frameCount == vm.frameCapacity) {
+                vm.stackTop = sp;
+                if(!D_ReserveStack(base + function->nugget.maxStack) || !D_ReserveFrames(vm.frameCount + 1)) {
+                    DRG_RUNTIME_ERROR("Stack overflow.");
+                }
+                sp = vm.stackTop;
+            }
+            vm.frames[vm.frameCount - 1].ip = ip;
+            frame = &vm.frames[vm.frameCount++];
+            frame->nugget = &function->nugget;
+            frame->base = base;
+            frame->globals = calleeGlobals;
+            nugget = frame->nugget;
+            ip = nugget->bytecode;
+            fp = vm.stack + base;
+            globals = calleeGlobals;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(ARRAY) {
+            // The compiler made every element fit already, and only
+            // ever makes struct arrays of none with NEW_ARRAY
+            int element = DRG_READ_BYTE();
+            int count = DRG_READ_SHORT();
+            sp -= count;
+            drgArray* array = D_NewArray(element, (count > 0) ? sp[0] : drgValNone(), count);
+            for(int i = 0; i < count; i++) {
+                drgArraySet(array, i, sp[i]);
+            }
+            array->count = count;
+            DRG_PUSH(drgValFromObj(array));
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(NEW_ARRAY) {
+            int element = DRG_READ_BYTE();
+            if(!drgValIsInt(sp[-2])) DRG_RUNTIME_ERROR("Array size must be an int.");
+            int64_t size = drgValAsInt(sp[-2]);
+            if(size < 0) DRG_RUNTIME_ERROR("Array size cannot be negative.");
+            if(size > DRG_ARRAY_MAX) DRG_RUNTIME_ERROR("Array is too large.");
+            drgArray* array = D_NewArray(element, sp[-1], (int)size);
+            drgArrayFill(array, (int)size, sp[-1]);
+            sp[-2] = drgValFromObj(array);
+            sp--;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(GET_INDEX) {
+            if(drgValIsObjType(sp[-2], DRG_OBJ_MAP)) {
+                drgMap* map = drgValAsMap(sp[-2]);
+                DRG_CHECK_KEY(map, sp[-1]);
+                drgVal* value = drgMapGet(map, sp[-1]);
+                DRG_MAP_FOUND(value);
+                sp[-2] = *value;
+                sp--;
+                DRG_VM_NEXT();
+            }
+            drgArray* array;
+            uint64_t index;
+            DRG_CHECK_ARRAY(sp[-2]);
+            DRG_CHECK_INDEX(sp[-1]);
+            DRG_ARRAY_INDEX(array, index, 2);
+            sp[-2] = drgArrayGet(array, (int)index);
+            sp--;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(GET_INDEX_INT) {
+            drgArray* array;
+            uint64_t index;
+            DRG_ARRAY_INDEX(array, index, 2);
+            sp[-2] = drgValFromInt(array->as.ints[index]);
+            sp--;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(GET_INDEX_REAL) {
+            drgArray* array;
+            uint64_t index;
+            DRG_ARRAY_INDEX(array, index, 2);
+            sp[-2] = drgValFromReal(array->as.reals[index]);
+            sp--;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(GET_INDEX_BOOL) {
+            drgArray* array;
+            uint64_t index;
+            DRG_ARRAY_INDEX(array, index, 2);
+            sp[-2] = drgValFromBool((array->as.bits[index >> 6] >> (index & 63)) & 1);
+            sp--;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(SET_INDEX) {
+            if(drgValIsObjType(sp[-3], DRG_OBJ_MAP)) {
+                drgMap* map = drgValAsMap(sp[-3]);
+                DRG_CHECK_KEY(map, sp[-2]);
+                if(!drgMapValueFits(map, sp[-1])) DRG_RUNTIME_ERROR("Wrong type of value for this map.");
+                if(!drgMapSet(map, sp[-2], sp[-1])) DRG_RUNTIME_ERROR("Map is too large.");
+                sp[-3] = sp[-1];
+                sp -= 2;
+                DRG_VM_NEXT();
+            }
+            drgArray* array;
+            uint64_t index;
+            DRG_CHECK_ARRAY(sp[-3]);
+            DRG_CHECK_INDEX(sp[-2]);
+            DRG_ARRAY_INDEX(array, index, 3);
+            if(!drgArrayFits(array, sp[-1])) DRG_RUNTIME_ERROR("Wrong type of element for this array.");
+            drgArraySet(array, (int)index, sp[-1]);
+            sp[-3] = sp[-1];
+            sp -= 2;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(SET_INDEX_INT) {
+            drgArray* array;
+            uint64_t index;
+            DRG_ARRAY_INDEX(array, index, 3);
+            array->as.ints[index] = drgValAsInt(sp[-1]);
+            sp[-3] = sp[-1];
+            sp -= 2;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(SET_INDEX_REAL) {
+            drgArray* array;
+            uint64_t index;
+            DRG_ARRAY_INDEX(array, index, 3);
+            array->as.reals[index] = drgValAsReal(sp[-1]);
+            sp[-3] = sp[-1];
+            sp -= 2;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(SET_INDEX_BOOL) {
+            drgArray* array;
+            uint64_t index;
+            DRG_ARRAY_INDEX(array, index, 3);
+            drgArraySet(array, (int)index, sp[-1]);
+            sp[-3] = sp[-1];
+            sp -= 2;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(ARRAY_ADD) {
+            DRG_CHECK_ARRAY(sp[-2]);
+            drgArray* array = drgValAsArray(sp[-2]);
+            if(!array->isResizable) DRG_RUNTIME_ERROR("Only [*] arrays can be resized.");
+            if(!drgArrayFits(array, sp[-1])) DRG_RUNTIME_ERROR("Wrong type of element for this array.");
+            if(array->count == DRG_ARRAY_MAX) DRG_RUNTIME_ERROR("Array is too large.");
+            drgArrayAdd(array, sp[-1]);
+            sp[-2] = drgValNone();
+            sp--;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(ARRAY_REM) {
+            drgArray* array;
+            uint64_t index;
+            DRG_CHECK_ARRAY(sp[-2]);
+            DRG_CHECK_INDEX(sp[-1]);
+            DRG_ARRAY_INDEX(array, index, 2);
+            if(!array->isResizable) DRG_RUNTIME_ERROR("Only [*] arrays can be resized.");
+            drgArrayRemove(array, (int)index);
+            sp[-2] = drgValNone();
+            sp--;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(ARRAY_LEN) {
+            DRG_CHECK_ARRAY(sp[-1]);
+            sp[-1] = drgValFromInt(drgValAsArray(sp[-1])->count);
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(MAP) {
+            // The compiler made every key and value fit already
+            int type = DRG_READ_BYTE();
+            int count = DRG_READ_SHORT();
+            drgMap* map = drgNewMap((drgType)(type / 4), (drgType)(type % 4), count);
+            sp -= 2 * count;
+            for(int i = 0; i < count; i++) {
+                drgMapSet(map, sp[2 * i], sp[2 * i + 1]);
+            }
+            DRG_PUSH(drgValFromObj(map));
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(GET_MAP_INT) {
+            drgVal* value = drgMapGetInt(drgValAsMap(sp[-2]), drgValAsInt(sp[-1]));
+            DRG_MAP_FOUND(value);
+            sp[-2] = *value;
+            sp--;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(GET_MAP_REAL) {
+            drgVal* value = drgMapGetReal(drgValAsMap(sp[-2]), drgValAsReal(sp[-1]));
+            DRG_MAP_FOUND(value);
+            sp[-2] = *value;
+            sp--;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(GET_MAP_STRING) {
+            drgVal* value = drgMapGetString(drgValAsMap(sp[-2]), drgValToString(sp[-1]));
+            DRG_MAP_FOUND(value);
+            sp[-2] = *value;
+            sp--;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(SET_MAP) {
+            if(!drgMapSet(drgValAsMap(sp[-3]), sp[-2], sp[-1])) DRG_RUNTIME_ERROR("Map is too large.");
+            sp[-3] = sp[-1];
+            sp -= 2;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(MAP_HAS) {
+            DRG_CHECK_MAP(sp[-2]);
+            drgMap* map = drgValAsMap(sp[-2]);
+            DRG_CHECK_KEY(map, sp[-1]);
+            sp[-2] = drgValFromBool(NULL != drgMapGet(map, sp[-1]));
+            sp--;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(MAP_REM) {
+            DRG_CHECK_MAP(sp[-2]);
+            drgMap* map = drgValAsMap(sp[-2]);
+            DRG_CHECK_KEY(map, sp[-1]);
+            drgMapRemove(map, sp[-1]);
+            sp[-2] = drgValNone();
+            sp--;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(MAP_LEN) {
+            DRG_CHECK_MAP(sp[-1]);
+            sp[-1] = drgValFromInt(drgValAsMap(sp[-1])->count);
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(MAP_KEYS) {
+            DRG_CHECK_MAP(sp[-1]);
+            sp[-1] = drgValFromObj(drgMapKeys(drgValAsMap(sp[-1])));
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(MAP_RESERVE) {
+            DRG_CHECK_MAP(sp[-2]);
+            if(!drgValIsInt(sp[-1])) DRG_RUNTIME_ERROR("Map size must be an int.");
+            int64_t count = drgValAsInt(sp[-1]);
+            if(count < 0) DRG_RUNTIME_ERROR("Map size cannot be negative.");
+            if(count > DRG_MAP_MAX) DRG_RUNTIME_ERROR("Map is too large.");
+            drgMapReserve(drgValAsMap(sp[-2]), (int)count);
+            sp[-2] = drgValNone();
+            sp--;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(STRUCT) {
+            // The compiler made every field fit already
+            drgType type = (drgType)DRG_READ_BYTE();
+            int count = DRG_READ_BYTE();
+            sp -= count;
+            drgStruct* s = drgNewStruct(type, sp, count);
+            DRG_PUSH(drgValFromObj(s));
+            DRG_VM_NEXT();
+        }
+        // Only ever on a value the compiler typed as the struct. It
+        // checks every typed declaration, argument and return, a value
+        // it can't type (a call through a module or a 'fun' variable)
+        // gets a DRG_OC_CHECK_TYPE before it can be used as one, and a
+        // typed function can't fall off its end into 'none', so
+        // there's nothing to check
+        DRG_VM_CASE(GET_FIELD) {
+            sp[-1] = drgValAsStruct(sp[-1])->fields[DRG_READ_BYTE()];
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(SET_FIELD) {
+            drgValAsStruct(sp[-2])->fields[DRG_READ_BYTE()] = sp[-1];
+            sp[-2] = sp[-1];
+            sp--;
+            DRG_VM_NEXT();
+        }
+        // The same, on a row of a struct array, which the compiler
+        // knows it is
+        DRG_VM_CASE(GET_ROW_FIELD) {
+            drgArray* array;
+            uint64_t index;
+            DRG_ARRAY_INDEX(array, index, 2);
+            sp[-2] = drgArrayRow(array, (int)index)[DRG_READ_BYTE()];
+            sp--;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(SET_ROW_FIELD) {
+            drgArray* array;
+            uint64_t index;
+            DRG_ARRAY_INDEX(array, index, 3);
+            drgArrayRow(array, (int)index)[DRG_READ_BYTE()] = sp[-1];
+            sp[-3] = sp[-1];
+            sp -= 2;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(POP) {
+            sp--;
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(PRINT) {
+            drgPrintVal(DRG_POP());
+            printf("\n");
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(POP_LOCAL) {
+            fp[DRG_READ_BYTE()] = DRG_POP();
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(GET_LOCAL_ADD) { DRG_ADD(sp[-1], sp[-1], fp[DRG_READ_BYTE()]); DRG_VM_NEXT(); }
+        DRG_VM_CASE(LIT_ADD) { DRG_ADD(sp[-1], sp[-1], DRG_READ_LIT()); DRG_VM_NEXT(); }
+        DRG_VM_CASE(LIT_SUB) { DRG_ARITH(sp[-1], sp[-1], DRG_READ_LIT(), -); DRG_VM_NEXT(); }
+        DRG_VM_CASE(LIT_LT)  { DRG_COMPARE(sp[-1], sp[-1], DRG_READ_LIT(), <); DRG_VM_NEXT(); }
+        DRG_VM_CASE(LIT_EQ)  { DRG_EQUALS(sp[-1], sp[-1], DRG_READ_LIT(), true); DRG_VM_NEXT(); }
+        DRG_VM_CASE(R_LOADK) {
+            int d = DRG_READ_SHORT();
+            R[d] = DRG_READ_LIT();
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(R_LOADK_LONG) {
+            int d = DRG_READ_SHORT();
+            R[d] = DRG_READ_LIT_LONG();
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(R_LOADTRUE) {
+            R[DRG_READ_SHORT()] = drgValFromBool(true);
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(R_LOADFALSE) {
+            R[DRG_READ_SHORT()] = drgValFromBool(false);
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(R_MOVE) {
+            int d = DRG_READ_SHORT();
+            R[d] = R[DRG_READ_SHORT()];
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(R_NEGATE) { DRG_R_UNARY(DRG_NEGATE); DRG_VM_NEXT(); }
+        DRG_VM_CASE(R_NOT)    { DRG_R_UNARY(DRG_NOT); DRG_VM_NEXT(); }
+        DRG_VM_CASE(R_INT_TO_REAL) { DRG_R_UNARY(DRG_INT_TO_REAL); DRG_VM_NEXT(); }
+        DRG_VM_CASE(R_ADD)  { DRG_R_ADD(); DRG_VM_NEXT(); }
+        DRG_VM_CASE(R_SUB)  { DRG_R_BINARY(DRG_ARITH, -); DRG_VM_NEXT(); }
+        DRG_VM_CASE(R_MULT) { DRG_R_BINARY(DRG_ARITH, *); DRG_VM_NEXT(); }
+        DRG_VM_CASE(R_DIV)  { DRG_R_DIVIDE(); DRG_VM_NEXT(); }
+        DRG_VM_CASE(R_EQ)   { DRG_R_BINARY(DRG_EQUALS, true); DRG_VM_NEXT(); }
+        DRG_VM_CASE(R_NEQ)  { DRG_R_BINARY(DRG_EQUALS, false); DRG_VM_NEXT(); }
+        DRG_VM_CASE(R_GT)   { DRG_R_BINARY(DRG_COMPARE, >); DRG_VM_NEXT(); }
+        DRG_VM_CASE(R_GTE)  { DRG_R_BINARY(DRG_COMPARE, >=); DRG_VM_NEXT(); }
+        DRG_VM_CASE(R_LT)   { DRG_R_BINARY(DRG_COMPARE, <); DRG_VM_NEXT(); }
+        DRG_VM_CASE(R_LTE)  { DRG_R_BINARY(DRG_COMPARE, <=); DRG_VM_NEXT(); }
+        DRG_VM_CASE(R_PRINT) {
+            drgPrintVal(R[DRG_READ_SHORT()]);
+            printf("\n");
+            DRG_VM_NEXT();
+        }
+        DRG_VM_CASE(RETURN) {
+            drgVal result = DRG_POP();
+            sp = fp;
+            if(--vm.frameCount == 0) {
+                vm.stackTop = sp;
+                return D_Result_OK;
+            }
+            // The result takes the callee's place
+            DRG_PUSH(result);
+            frame = &vm.frames[vm.frameCount - 1];
+            nugget = frame->nugget;
+            ip = frame->ip;
+            fp = vm.stack + frame->base;
+            globals = frame->globals;
+            DRG_VM_NEXT();
+        }
+    DRG_VM_END()
+
+    #if defined(DRG_VM_COMPUTED_GOTO) && defined(DRG_DEBUG)
+DRG_OP_TRACE:
+    D_TraceInstruction(nugget, ip - 1, sp);
+    goto *dispatch[ip[-1]];
+    #endif
+
+DRG_OP_UNKNOWN:
+    D_LogError("Unknown opcode %d at offset %d.", ip[-1], (int)(ip - 1 - nugget->bytecode));
+    D_ResetStack();
+    return D_Result_RUNTIME_ERROR;
 
-    size_t bytesRead = fread(buffer, sizeof(char), fileSize, file);
-    if(bytesRead < fileSize) {
-        perror("Could not read the entire file!");
-        exit(EXIT_FAILURE);
+DRG_OP_ERROR: {
+    // 'ip' is past the operands read so far, still inside the
+    // instruction that failed
+    int line, column;
+    if(drgNuggetGetPosition(nugget, (int)(ip - 1 - nugget->bytecode), &line, &column)) {
+        D_LogError("[%d:%d] Runtime error: %s", line, column, error);
     }
+    else {
+        D_LogError("Runtime error at offset %d: %s", (int)(ip - 1 - nugget->bytecode), error);
+    }
+    D_ResetStack();
+    return D_Result_RUNTIME_ERROR;
+}
 
-    buffer[bytesRead] = '\0';
-    
-    fclose(file);
-    return buffer;
+    #undef DRG_READ_BYTE
+    #undef DRG_READ_SHORT
+    #undef DRG_READ_LIT
+    #undef DRG_READ_LIT_LONG
+    #undef DRG_PUSH
+    #undef DRG_POP
+    #undef DRG_IS_NUMBER
+    #undef DRG_RUNTIME_ERROR
+    #undef DRG_ARITH
+    #undef DRG_ADD
+    #undef DRG_CONCAT
+    #undef DRG_DIVIDE
+    #undef DRG_COMPARE
+    #undef DRG_EQUALS
+    #undef DRG_NEGATE
+    #undef DRG_NOT
+    #undef DRG_INT_ARITH
+    #undef DRG_REAL_ARITH
+    #undef DRG_TYPED_COMPARE
+    #undef DRG_INT_TO_REAL
+    #undef DRG_ARRAY_INDEX
+    #undef DRG_CHECK_ARRAY
+    #undef DRG_CHECK_INDEX
+    #undef DRG_CHECK_MAP
+    #undef DRG_CHECK_KEY
+    #undef DRG_MAP_FOUND
+    #undef DRG_R_UNARY
+    #undef DRG_R_BINARY
+    #undef DRG_R_DIVIDE
+    #undef DRG_R_ADD
+    #undef DRG_VM_CASE
+    #undef DRG_VM_NEXT
+    #undef DRG_VM_LOOP
+    #undef DRG_VM_END
 }
 
-static drgVMResult drgInterpret(const char* source) {
+/*****************************************************************
+* Public Functions
+*****************************************************************/
 
+void D_InitVirtualMachine(void) {
+    vm.stack = NULL;
+    vm.stackCapacity = 0;
+    vm.frames = NULL;
+    vm.frameCapacity = 0;
+    vm.globals = NULL;
+    vm.globalCapacity = 0;
+    vm.trace = false;
+    vm.compileFlags = D_CompileFlag_NONE;
+    vm.cacheDirectory = NULL;
+    D_ResetStack();
 }
 
-// -----------------------
-
-void drgInitVM(void) {
-    vm.nugget = NULL;
-    vm.ip = NULL;
-    drgResetStack();
+void D_SetCompileFlags(unsigned flags) {
+    vm.compileFlags = flags;
 }
 
-void drgFreeVM(void) {
-    drgNuggetFree(vm.nugget);
-    drgInitVM();
+void D_SetCacheDirectory(const char* directory) {
+    vm.cacheDirectory = directory;
 }
 
-void drgVMRunFile(const char* path) {
-    char* source = drgReadFile(path);
-    drgVMResult result = drgInterpret(source);
-    DRG_MEM_FREE(source);
-    
-    switch(result) {
-        case DRG_VMRES_COMPILE_ERROR: exit(DRG_VMRES_COMPILE_ERROR); break;
-        case DRG_VMRES_RUNTIME_ERROR: exit(DRG_VMRES_RUNTIME_ERROR); break;
-        default: break;
+D_Result D_RunNugget(drgNugget* nugget, int globalCount) {
+    // Growing the stack, frames or globals past the memory limit
+    // lands here rather than exiting.
+    drgMemGuard guard;
+    if(setjmp(guard.env)) {
+        drgMemPopGuard(&guard);
+        D_LogError("Runtime error: Out of memory (limit %zu bytes).", drgMemGetLimit());
+        D_ResetStack();
+        return D_Result_RUNTIME_ERROR;
     }
-}
+    drgMemPushGuard(&guard);
 
-void drgVMRunLine(const char* line) {
-    drgVMResult result = drgInterpret(line);
-    
-    switch(result) {
-        case DRG_VMRES_COMPILE_ERROR: exit(DRG_VMRES_COMPILE_ERROR); break;
-        case DRG_VMRES_RUNTIME_ERROR: exit(DRG_VMRES_RUNTIME_ERROR); break;
-        default: break;
+    D_Result result = D_Result_RUNTIME_ERROR;
+    // Register code keeps its temporaries right after the globals
+    D_ReserveGlobals(globalCount + nugget->registers);
+    D_ResetStack();
+    if(!D_ReserveStack(nugget->maxStack) || !D_ReserveFrames(1)) {
+        D_LogError("Runtime error: Stack overflow.");
+    }
+    else {
+        vm.frames[0].nugget = nugget;
+        vm.frames[0].ip = NULL;
+        vm.frames[0].base = 0;
+        vm.frames[0].globals = vm.globals;
+        vm.frameCount = 1;
+        *vm.stackTop++ = drgValNone(); // slot 0, the top-level code has no callee
+        result = D_Run();
     }
+    drgMemPopGuard(&guard);
+    return result;
 }
 
-drgVMResult drgVMRun(drgNugget* nugget) {
-    #define DRG_READ_BYTE() (*vm.ip++)
-    #define DRG_READ_LIT() (vm.nugget->constantPool.values[DRG_READ_BYTE()])
-    #define DRG_BINARY_OP(op) \
-        do {\
-            double b = drgPopStack();\
-            double a = drgPopStack();\
-            drgPushStack(a op b);\
-        } while(0)
+// Compiles and runs a source, first saving the nugget to
+// 'cachePath' if that isn't NULL.
+static D_Result D_CompileAndRun(const char* const source, size_t length,
+    const char* cachePath, const drgCacheKey* key) {
+    drgNugget nugget;
+    D_GlobalTable globals;
+    drgNuggetInit(&nugget);
+    D_GlobalTableInit(&globals);
 
-    vm.nugget = nugget;
-    vm.ip = vm.nugget->bytecode;
-    drgByte instruction;
-
-    for(;;) {
-        // If we are in debug mode, print the stack
-        // as well as the chunk being interpreted.
+    D_Result result = D_Result_COMPILER_ERROR;
+    if(D_Compile(source, length, &globals, &nugget, vm.compileFlags)) {
+        if(NULL != cachePath) {
+            // Not being able to save it costs the next run, not this one
+            drgCacheWrite(cachePath, key, &nugget, globals.count);
+        }
         #ifdef DRG_DEBUG
-        drgPrintStack();
-        drgDisassembleInstruction(vm.nugget,
-            (int)(vm.ip - vm.nugget->bytecode));
+        if(vm.trace) {
+            drgDisassembleNugget(&nugget, "script");
+        }
         #endif
+        result = D_RunNugget(&nugget, globals.count);
+    }
 
-        // Read an instruction (byte) and
-        // do something depending on what it is
-        switch(instruction = DRG_READ_BYTE()) {
-            case DRG_OC_NUM_LIT:
-                drgVal lit = DRG_READ_LIT();
-                drgPushStack(lit);
-                break;
-            case DRG_OC_NEGATE: drgPushStack(-drgPopStack()); break;
-            case DRG_OC_ADD:  DRG_BINARY_OP(+); break;
-            case DRG_OC_SUB:  DRG_BINARY_OP(-); break;
-            case DRG_OC_MULT: DRG_BINARY_OP(*); break;
-            case DRG_OC_DIV:  DRG_BINARY_OP(/); break;
-            case DRG_OC_RETURN:
-                drgPrintVal(drgPopStack());
-                printf("\n");
-                return DRG_VMRES_OK;
-        }
+    D_GlobalTableFree(&globals);
+    drgNuggetFree(&nugget);
+    return result;
+}
+
+D_Result D_Interpret(const char* const source, size_t length) {
+    return D_CompileAndRun(source, length, NULL, NULL);
+}
+
+D_Result D_InterpretCached(const char* const source, size_t length) {
+    if(NULL == vm.cacheDirectory) {
+        return D_Interpret(source, length);
+    }
+    drgCacheKey key;
+    char name[64];
+    char path[4096];
+    drgCacheMakeKey(source, length, vm.compileFlags, &key);
+    drgCacheFileName(&key, name, sizeof(name));
+    if((size_t)snprintf(path, sizeof(path), "%s/%s", vm.cacheDirectory, name) >= sizeof(path)) {
+        return D_Interpret(source, length);
     }
 
-    #undef DRG_READ_BYTE
-    #undef DRG_READ_LIT
-    #undef DRG_BINARY_OP
+    drgCachedProgram program;
+    if(!drgCacheLoad(path, &key, &program)) {
+        return D_CompileAndRun(source, length, path, &key);
+    }
+    #ifdef DRG_DEBUG
+    if(vm.trace) {
+        drgDisassembleNugget(&program.nugget, "script");
+    }
+    #endif
+    D_Result result = D_RunNugget(&program.nugget, program.globalCount);
+    drgCacheClose(&program);
+    return result;
+}
+
+void D_SessionInit(D_Session* session) {
+    D_GlobalTableInit(&session->globals);
+    session->count = 0;
+    session->capacity = 0;
+    session->nuggets = NULL;
 }
 
-void drgDisassembleNugget(drgNugget* nugget, const char* name) {
-    printf("[%s]\n", name);
-    for(int offset = 0; offset < nugget->count;) {
-        offset = drgDisassembleInstruction(nugget, offset);
+D_Result D_SessionInterpret(D_Session* session, const char* const source, size_t length) {
+    // A nugget per input, so -O and the line table only ever see
+    // the one input, and nothing already run gets compiled again
+    drgNugget nugget;
+    drgNuggetInit(&nugget);
+    D_GlobalMark mark = D_GlobalTableMark(&session->globals);
+    if(!D_Compile(source, length, &session->globals, &nugget, vm.compileFlags)) {
+        D_GlobalTableRollback(&session->globals, mark);
+        drgNuggetFree(&nugget);
+        return D_Result_COMPILER_ERROR;
+    }
+    #ifdef DRG_DEBUG
+    if(vm.trace) {
+        drgDisassembleNugget(&nugget, "input");
+    }
+    #endif
+
+    if(session->capacity < session->count + 1) {
+        int capacity = DRG_MEM_GROW_CAPACITY(session->capacity);
+        session->nuggets = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_BYTECODE, drgNugget, session->nuggets, session->capacity, capacity);
+        session->capacity = capacity;
+    }
+    // Kept even if it fails part way, as what did run may have
+    // stored its functions in older globals
+    session->nuggets[session->count] = nugget;
+    D_Result result = D_RunNugget(&session->nuggets[session->count++], session->globals.count);
+    if(D_Result_OK != result) {
+        // Some of its globals were never defined
+        D_GlobalTableRollback(&session->globals, mark);
     }
+    return result;
 }
 
-int drgDisassembleInstruction(drgNugget* nugget, int offset) {
-    drgByte inst = nugget->bytecode[offset];
-    printf("%04d: ", offset);
-    switch(inst) {
-        case DRG_OC_RETURN: return drgSimpleInst("DRG_OC_RETURN", inst, offset);
-        case DRG_OC_NEGATE: return drgSimpleInst("DRG_OC_NEGATE", inst, offset);
-        case DRG_OC_ADD: return drgSimpleInst("DRG_OC_ADD", inst, offset);
-        case DRG_OC_SUB: return drgSimpleInst("DRG_OC_SUB", inst, offset);
-        case DRG_OC_MULT: return drgSimpleInst("DRG_OC_MULT", inst, offset);
-        case DRG_OC_DIV: return drgSimpleInst("DRG_OC_DIV", inst, offset);
-        case DRG_OC_NUM_LIT: return drgLitInst("DRG_OC_LIT_NUM", inst, nugget, offset);
-        default:
-            printf("!! Unknown opcode %d\n", inst);
-            return offset + 1;
+void D_SessionFree(D_Session* session) {
+    for(int i = 0; i < session->count; i++) {
+        drgNuggetFree(&session->nuggets[i]);
     }
-    return offset + 1; // shouldn't get hit but put it here anyway
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_BYTECODE, drgNugget, session->nuggets, session->capacity);
+    D_GlobalTableFree(&session->globals);
+    D_SessionInit(session);
 }
 
-void drgPrintStack(void) {
-    printf("          ");
-    // Iterate through the stack
-    for(drgVal* s = vm.stack; s < vm.stackTop; s++) {
-        printf("[ ");
-        drgPrintVal(*s);
-        printf(" ]");
+bool D_ExportModule(const char* const source, size_t length, const char* path) {
+    drgNugget nugget;
+    D_GlobalTable globals;
+    drgNuggetInit(&nugget);
+    D_GlobalTableInit(&globals);
+
+    bool ok = false;
+    unsigned flags = D_CompileFlag_MODULE | (vm.compileFlags & D_CompileFlag_OPTIMIZE);
+    if(D_Compile(source, length, &globals, &nugget, flags)) {
+        // A module declares nothing but functions, so its script's
+        // constants are those functions, in the order of their globals
+        drgFunction** functions = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_GENERAL, drgFunction*, NULL, 0, globals.count);
+        bool* exported = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_GENERAL, bool, NULL, 0, globals.count);
+        int count = 0;
+        for(int i = 0; i < nugget.constantPool.count && count < globals.count; i++) {
+            if(drgValIsObjType(nugget.constantPool.values[i], DRG_OBJ_FUNCTION)) {
+                functions[count] = drgValAsFunction(nugget.constantPool.values[i]);
+                exported[count] = globals.symbols[count].isExported;
+                count++;
+            }
+        }
+        char defaultPath[4096];
+        if(NULL == path) {
+            snprintf(defaultPath, sizeof(defaultPath), "%s.dgm", globals.moduleName->chars);
+            path = defaultPath;
+        }
+        ok = drgModuleWrite(path, globals.moduleName, functions, exported, count);
+        if(ok) {
+            D_Log("Exported module '%s' to \"%s\".", globals.moduleName->chars, path);
+        }
+        else {
+            D_LogError("Could not write \"%s\".", path);
+        }
+        DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_GENERAL, drgFunction*, functions, globals.count);
+        DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_GENERAL, bool, exported, globals.count);
     }
-    printf("\n");
-} */
\ No newline at end of file
+
+    D_GlobalTableFree(&globals);
+    drgNuggetFree(&nugget);
+    return ok;
+}
+
+void D_FreeVirtualMachine(void) {
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_VM, drgVal, vm.globals, vm.globalCapacity);
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_VM, drgVal, vm.stack, vm.stackCapacity);
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_VM, D_CallFrame, vm.frames, vm.frameCapacity);
+    drgModuleFreeAll();
+    drgArrayFreeAll();
+    drgMapFreeAll();
+    drgRopeFreeAll();
+    drgStructFreeAll();
+    drgInternFreeAll();
+    D_InitVirtualMachine();
+}
@@ -13,6 +13,12 @@
 #ifndef DRG_H_VM
 #define DRG_H_VM
 
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "drgNugget.h"
+#include "../compiler/Compiler.h"
+
 typedef enum {
     D_Result_OK,
     D_Result_COMPILER_ERROR,
@@ -20,7 +26,77 @@ typedef enum {
 } D_Result;
 
 void D_InitVirtualMachine(void);
-D_Result D_Interpret(const char* const source);
+/// @brief Compiles and runs a source.
+/// @param source Source text, need not be null-terminated.
+/// @param length Number of chars in 'source'.
+/// @return How it went.
+D_Result D_Interpret(const char* const source, size_t length);
 void D_FreeVirtualMachine(void);
 
+/// @brief Sets the D_CompileFlag values D_Interpret() compiles
+/// with, e.g. D_CompileFlag_REGISTERS.
+/// @param flags 
+void D_SetCompileFlags(unsigned flags);
+
+/// @brief Sets the directory D_InterpretCached() keeps .dgc files
+/// in. It must exist, and the string must outlive its use.
+/// @param directory NULL turns the cache off.
+void D_SetCacheDirectory(const char* directory);
+
+/// @brief D_Interpret(), but reuses the compiled nugget from an
+/// earlier run of the same source if there is one, and saves it
+/// for the next run if not.
+/// @param source Source text, need not be null-terminated.
+/// @param length Number of chars in 'source'.
+/// @return How it went.
+D_Result D_InterpretCached(const char* const source, size_t length);
+
+/// @brief Compiles a module source and writes it as a .dgm file,
+/// optimized if the compile flags include D_CompileFlag_OPTIMIZE.
+/// @param source Source text, need not be null-terminated.
+/// @param length Number of chars in 'source'.
+/// @param path Where to write it; NULL is "<module name>.dgm".
+/// @return False if it didn't compile or couldn't be written.
+bool D_ExportModule(const char* const source, size_t length, const char* path);
+
+/// @brief Runs an already compiled nugget.
+/// @param nugget 
+/// @param globalCount Globals the nugget was compiled against.
+/// @return How it went.
+D_Result D_RunNugget(drgNugget* nugget, int globalCount);
+
+/// @brief An interactive session: inputs compiled one after the
+/// other against the same globals, so each one sees what the ones
+/// before it declared. The values of those globals live in the
+/// VM, so only one session can be going at a time.
+typedef struct {
+    D_GlobalTable globals;
+    int count;              // nuggets of the inputs that ran
+    int capacity;
+    drgNugget* nuggets;     // they own the functions they declared
+} D_Session;
+
+/// @brief Starts an empty session.
+/// @param session 
+void D_SessionInit(D_Session* session);
+
+/// @brief Compiles one input against everything the session has
+/// declared so far, and runs it. Declarations of an input that
+/// doesn't compile, or stops with a runtime error, are forgotten.
+/// @param session 
+/// @param source Source text, need not be null-terminated.
+/// @param length Number of chars in 'source'.
+/// @return How it went.
+D_Result D_SessionInterpret(D_Session* session, const char* const source, size_t length);
+
+/// @brief Frees a session's globals and code.
+/// @param session 
+void D_SessionFree(D_Session* session);
+
+/// @brief Prints the stack and each instruction as it runs.
+/// Only available in DRG_DEBUG builds.
+/// @param enabled 
+/// @return False if tracing isn't compiled in.
+bool D_SetTrace(bool enabled);
+
 #endif // DRG_H_VM
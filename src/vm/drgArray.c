@@ -0,0 +1,226 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgArray.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Arrays.
+*
+*****************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "drgArray.h"
+#include "drgMap.h"
+#include "../util/drgMemUtil.h"
+
+static drgArray* arrays; // Every array, newest first.
+
+// Bytes the elements of an array with room for 'capacity' take.
+static size_t drgArrayBytes(const drgArray* array, int capacity) {
+    switch(array->kind) {
+        case DRG_ARRAY_INT:    return sizeof(int64_t) * (size_t)capacity;
+        case DRG_ARRAY_REAL:   return sizeof(double) * (size_t)capacity;
+        case DRG_ARRAY_BOOL:   return sizeof(uint64_t) * (((size_t)capacity + 63) / 64);
+        // A struct of no fields still takes a slot, so its rows are
+        // somewhere
+        case DRG_ARRAY_STRUCT: return sizeof(drgVal) * (size_t)(array->width > 0 ? array->width : 1) * (size_t)capacity;
+        default:               return sizeof(drgVal) * (size_t)capacity;
+    }
+}
+
+static void drgArrayReserve(drgArray* array, int capacity) {
+    if(array->kind == DRG_ARRAY_BOOL && capacity < 64) {
+        capacity = 64; // a whole word anyway
+    }
+    void* data = drgMemReallocate(DRG_MEM_CAT_ARRAYS, array->as.values,
+        drgArrayBytes(array, array->capacity), drgArrayBytes(array, capacity));
+    array->as.values = (drgVal*)data;
+    array->capacity = capacity;
+}
+
+// An array of 'width' values a row when it's of structs.
+static drgArray* drgAllocateArray(drgArrayKind kind, drgType rowType, int width, bool isResizable, int capacity) {
+    drgArray* array = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_ARRAYS, drgArray, NULL, 0, 1);
+    array->obj.type = DRG_OBJ_ARRAY;
+    array->kind = kind;
+    array->isResizable = isResizable;
+    array->count = 0;
+    array->capacity = 0;
+    array->rowType = rowType;
+    array->width = width;
+    array->as.values = NULL;
+    // Listed before anything else is allocated, so it's freed even
+    // if that runs out of memory
+    array->next = arrays;
+    arrays = array;
+    if(capacity > 0) {
+        drgArrayReserve(array, capacity);
+    }
+    return array;
+}
+
+drgArray* drgNewArray(drgArrayKind kind, bool isResizable, int capacity) {
+    return drgAllocateArray(kind, DRG_TYPE_ANY, 1, isResizable, capacity);
+}
+
+drgArray* drgNewStructArray(drgType type, int width, bool isResizable, int capacity) {
+    return drgAllocateArray(DRG_ARRAY_STRUCT, type, width, isResizable, capacity);
+}
+
+// A copy of a value sharing nothing that can change with it: its
+// structs, arrays and maps are copied too.
+static drgVal drgArrayCopyValue(drgVal value) {
+    if(drgValIsObjType(value, DRG_OBJ_STRUCT)) {
+        const drgStruct* s = drgValAsStruct(value);
+        drgStruct* copy = drgNewStruct(s->type, s->fields, s->count);
+        for(int i = 0; i < copy->count; i++) {
+            copy->fields[i] = drgArrayCopyValue(copy->fields[i]);
+        }
+        return drgValFromObj(copy);
+    }
+    if(drgValIsObjType(value, DRG_OBJ_ARRAY)) {
+        const drgArray* array = drgValAsArray(value);
+        drgArray* copy = drgAllocateArray(array->kind, array->rowType, array->width, array->isResizable, array->count);
+        if(array->count > 0) {
+            memcpy(copy->as.values, array->as.values, drgArrayBytes(array, array->count));
+        }
+        copy->count = array->count;
+        if(array->kind == DRG_ARRAY_STRUCT) {
+            size_t fields = (size_t)copy->count * (size_t)copy->width;
+            for(size_t i = 0; i < fields; i++) {
+                copy->as.values[i] = drgArrayCopyValue(copy->as.values[i]);
+            }
+        }
+        return drgValFromObj(copy);
+    }
+    if(drgValIsObjType(value, DRG_OBJ_MAP)) {
+        const drgMap* map = drgValAsMap(value);
+        drgMap* copy = drgNewMap(map->keyType, map->valueType, map->count);
+        for(int i = 0; i < map->entryCount; i++) {
+            if(!drgValIsNone(map->entries[i].key)) {
+                drgMapSet(copy, map->entries[i].key, map->entries[i].value);
+            }
+        }
+        return drgValFromObj(copy);
+    }
+    return value;
+}
+
+void drgArrayFill(drgArray* array, int count, drgVal fill) {
+    if(array->capacity < array->count + count) {
+        drgArrayReserve(array, array->count + count);
+    }
+    int end = array->count + count;
+    switch(array->kind) {
+        case DRG_ARRAY_INT: {
+            int64_t value = drgValAsInt(fill);
+            for(int i = array->count; i < end; i++) array->as.ints[i] = value;
+            break;
+        }
+        case DRG_ARRAY_REAL: {
+            double value = drgValAsNumber(fill);
+            for(int i = array->count; i < end; i++) array->as.reals[i] = value;
+            break;
+        }
+        case DRG_ARRAY_BOOL:
+            for(int i = array->count; i < end; i++) drgArraySet(array, i, fill);
+            break;
+        case DRG_ARRAY_STRUCT:
+            // Every row gets a struct, array or map of its own, as if
+            // each had been made from the default the fill was
+            for(int i = array->count; i < end; i++) {
+                drgArraySet(array, i, fill);
+                if(i > array->count) {
+                    drgVal* row = drgArrayRow(array, i);
+                    for(int f = 0; f < array->width; f++) row[f] = drgArrayCopyValue(row[f]);
+                }
+            }
+            break;
+        default:
+            for(int i = array->count; i < end; i++) array->as.values[i] = fill;
+            break;
+    }
+    array->count = end;
+}
+
+bool drgArrayFits(const drgArray* array, drgVal value) {
+    switch(array->kind) {
+        case DRG_ARRAY_INT:  return drgValIsInt(value);
+        case DRG_ARRAY_REAL: return drgValIsReal(value) || drgValIsInt(value);
+        case DRG_ARRAY_BOOL: return drgValIsBool(value);
+        case DRG_ARRAY_STRUCT:
+            return drgValIsObjType(value, DRG_OBJ_STRUCT) && drgValAsStruct(value)->type == array->rowType;
+        default:             return drgValIsString(value);
+    }
+}
+
+void drgArrayAdd(drgArray* array, drgVal value) {
+    if(array->capacity < array->count + 1) {
+        drgArrayReserve(array, DRG_MEM_GROW_CAPACITY(array->capacity));
+    }
+    drgArraySet(array, array->count++, value);
+}
+
+void drgArrayRemove(drgArray* array, int index) {
+    int after = array->count - index - 1;
+    switch(array->kind) {
+        case DRG_ARRAY_INT:
+            memmove(&array->as.ints[index], &array->as.ints[index + 1], sizeof(int64_t) * (size_t)after);
+            break;
+        case DRG_ARRAY_REAL:
+            memmove(&array->as.reals[index], &array->as.reals[index + 1], sizeof(double) * (size_t)after);
+            break;
+        case DRG_ARRAY_BOOL: {
+            // Shift a word at a time, each taking the lowest bit of
+            // the word after it
+            uint64_t* bits = array->as.bits;
+            int word = index >> 6;
+            int last = (array->count - 1) >> 6;
+            uint64_t below = ((uint64_t)1 << (index & 63)) - 1;
+            bits[word] = (bits[word] & below) | ((bits[word] >> 1) & ~below);
+            for(; word < last; word++) {
+                bits[word] |= bits[word + 1] << 63;
+                bits[word + 1] >>= 1;
+            }
+            break;
+        }
+        case DRG_ARRAY_STRUCT:
+            memmove(drgArrayRow(array, index), drgArrayRow(array, index + 1),
+                sizeof(drgVal) * (size_t)array->width * (size_t)after);
+            break;
+        default:
+            memmove(&array->as.values[index], &array->as.values[index + 1], sizeof(drgVal) * (size_t)after);
+            break;
+    }
+    array->count--;
+}
+
+void drgPrintArray(const drgArray* array) {
+    printf("[");
+    for(int i = 0; i < array->count; i++) {
+        if(i > 0) {
+            printf(",");
+        }
+        // Rows are printed where they are rather than copied out
+        if(array->kind == DRG_ARRAY_STRUCT) {
+            drgPrintFields(drgArrayRow(array, i), array->width);
+        }
+        else {
+            drgPrintVal(drgArrayGet(array, i));
+        }
+    }
+    printf("]");
+}
+
+void drgArrayFreeAll(void) {
+    while(NULL != arrays) {
+        drgArray* array = arrays;
+        arrays = array->next;
+        drgMemReallocate(DRG_MEM_CAT_ARRAYS, array->as.values, drgArrayBytes(array, array->capacity), 0);
+        DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_ARRAYS, drgArray, array, 1);
+    }
+}
@@ -0,0 +1,173 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgArray.h
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Arrays, e.g. int[5], bool[] and int[*]. Elements are stored
+* unboxed and back to back, in the C type of the element type, so
+* an int[*] of a million is 8MB of int64_t and a bool[] of a
+* million is 125KB of bits. Indices are 1-based in Dargon and
+* 0-based here; the VM takes the 1 off as it bounds checks, which
+* the load's addressing folds in for free.
+*
+* An array of structs, e.g. Person[*], holds rows of their fields
+* rather than references to structs. Reading a whole element copies
+* its row out into a new struct and storing one copies it in, while
+* people[i].age is a load or store in the row itself.
+*
+* There is no garbage collector, so arrays live until the VM is
+* freed, with drgArrayFreeAll().
+*
+*****************************************************************/
+
+#ifndef DRG_H_ARRAY
+#define DRG_H_ARRAY
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "drgObject.h"
+#include "drgValue.h"
+#include "drgStruct.h"
+
+/// @brief How an array stores its elements.
+typedef enum {
+    DRG_ARRAY_INT,      // int64_t
+    DRG_ARRAY_REAL,     // double
+    DRG_ARRAY_BOOL,     // one bit each, 64 to a word
+    DRG_ARRAY_VALUE,    // drgVal, for objects (strings)
+    DRG_ARRAY_STRUCT    // rows of 'width' drgVals, a struct's fields
+} drgArrayKind;
+
+/// @brief Or'd into the element type operand of DRG_OC_ARRAY and
+/// DRG_OC_NEW_ARRAY for a [*] array, the only kind arrayAdd() and
+/// arrayRem() can resize.
+#define DRG_ARRAY_RESIZABLE 0x80
+
+/// @brief Most elements an array can hold.
+#define DRG_ARRAY_MAX (1 << 30)
+
+/// @brief An array object.
+typedef struct drgArray {
+    drgObj obj;
+    drgArrayKind kind;
+    bool isResizable;
+    int count;
+    int capacity;       // elements there's room for
+    drgType rowType;    // DRG_ARRAY_STRUCT only, the struct
+    int width;          // and how many fields it has
+    union {
+        int64_t* ints;
+        double* reals;
+        uint64_t* bits;
+        drgVal* values;
+    } as;
+    struct drgArray* next; // every array, for drgArrayFreeAll()
+} drgArray;
+
+/// @brief Allocates an empty array.
+/// @param kind
+/// @param isResizable
+/// @param capacity Elements to make room for.
+/// @return Valid until drgArrayFreeAll().
+drgArray* drgNewArray(drgArrayKind kind, bool isResizable, int capacity);
+
+/// @brief Allocates an empty array of struct rows.
+/// @param type The struct.
+/// @param width Its field count.
+/// @param isResizable
+/// @param capacity Rows to make room for.
+/// @return Valid until drgArrayFreeAll().
+drgArray* drgNewStructArray(drgType type, int width, bool isResizable, int capacity);
+
+/// @brief Appends 'count' copies of 'fill'. Rows of structs after
+/// the first get copies of its structs, arrays and maps as well.
+/// @param array
+/// @param count
+/// @param fill Must fit the array.
+void drgArrayFill(drgArray* array, int count, drgVal fill);
+
+/// @brief Whether a value can be stored in an array, an int in a
+/// real array counting as its real, and a struct in an array of
+/// its type as its fields.
+/// @param array
+/// @param value
+/// @return
+bool drgArrayFits(const drgArray* array, drgVal value);
+
+/// @brief Appends an element, amortized O(1).
+/// @param array
+/// @param value Must fit the array.
+void drgArrayAdd(drgArray* array, drgVal value);
+
+/// @brief Removes an element, moving the ones after it down.
+/// @param array
+/// @param index 0-based, in range.
+void drgArrayRemove(drgArray* array, int index);
+
+/// @brief Prints an array as [a,b,c].
+/// @param array
+void drgPrintArray(const drgArray* array);
+
+/// @brief Frees every array there is.
+void drgArrayFreeAll(void);
+
+/// @brief The fields of the row at 'index' of a struct array.
+/// @param array
+/// @param index 0-based, in range.
+/// @return 'width' values.
+static inline drgVal* drgArrayRow(const drgArray* array, int index) {
+    return &array->as.values[(size_t)index * (size_t)array->width];
+}
+
+/// @brief The element at 'index', boxed; a struct row is copied
+/// out into a new struct.
+/// @param array
+/// @param index 0-based, in range.
+/// @return
+static inline drgVal drgArrayGet(const drgArray* array, int index) {
+    switch(array->kind) {
+        case DRG_ARRAY_INT:    return drgValFromInt(array->as.ints[index]);
+        case DRG_ARRAY_REAL:   return drgValFromReal(array->as.reals[index]);
+        case DRG_ARRAY_BOOL:   return drgValFromBool((array->as.bits[index >> 6] >> (index & 63)) & 1);
+        case DRG_ARRAY_STRUCT: return drgValFromObj(drgNewStruct(array->rowType, drgArrayRow(array, index), array->width));
+        default:               return array->as.values[index];
+    }
+}
+
+/// @brief Stores the element at 'index'.
+/// @param array
+/// @param index 0-based, in range.
+/// @param value Must fit the array.
+static inline void drgArraySet(drgArray* array, int index, drgVal value) {
+    switch(array->kind) {
+        case DRG_ARRAY_INT:
+            array->as.ints[index] = drgValAsInt(value);
+            break;
+        case DRG_ARRAY_REAL:
+            array->as.reals[index] = drgValAsNumber(value);
+            break;
+        case DRG_ARRAY_BOOL: {
+            uint64_t mask = (uint64_t)1 << (index & 63);
+            uint64_t* word = &array->as.bits[index >> 6];
+            *word = drgValAsBool(value) ? (*word | mask) : (*word & ~mask);
+            break;
+        }
+        case DRG_ARRAY_STRUCT:
+            memcpy(drgArrayRow(array, index), drgValAsStruct(value)->fields, sizeof(drgVal) * (size_t)array->width);
+            break;
+        default:
+            array->as.values[index] = value;
+            break;
+    }
+}
+
+static inline drgArray* drgValAsArray(drgVal v) {
+    return (drgArray*)drgValAsObj(v);
+}
+
+#endif // DRG_H_ARRAY
@@ -0,0 +1,437 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgCache.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Compiled nuggets on disk (.dgc files).
+*
+* Layout, every section 8-byte aligned, offsets from the start:
+*   drgCacheHeader
+*   drgCacheNugget[nuggetCount]     0 is the script, then its
+*                                   functions, parents first
+*   drgCacheConstant[], bytecode, line tables and string chars,
+*   wherever the records say
+* Numbers are in the writer's byte order; a reader with another
+* one rejects the file.
+*
+*****************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <process.h>
+#else
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+#include "drgCache.h"
+#include "drgIntern.h"
+#include "drgObject.h"
+#include "../util/Version.h"
+#include "../util/drgMemUtil.h"
+
+// Bump when the layout changes
+#define DRG_CACHE_FORMAT 1
+#define DRG_CACHE_ORDER 0x01020304u
+
+typedef struct {
+    char magic[4];          // "DGC\0"
+    uint32_t order;         // DRG_CACHE_ORDER
+    uint64_t build;         // drgCacheBuild()
+    uint64_t sourceHash;
+    uint64_t sourceLength;
+    uint32_t flags;
+    int32_t globalCount;
+    uint32_t nuggetCount;
+    uint32_t pad;
+} drgCacheHeader;
+
+typedef struct {
+    uint32_t code;          // offset and length of the bytecode
+    uint32_t codeLength;
+    uint32_t lines;         // ...of the line table
+    uint32_t linesLength;
+    uint32_t constants;     // ...of its drgCacheConstant array
+    uint32_t constantCount;
+    int32_t registers;
+    int32_t maxStack;
+    int32_t arity;          // functions only
+    uint32_t name;          // functions only, offset of the chars
+    uint32_t nameLength;
+    uint32_t pad;
+} drgCacheNugget;
+
+#define DRG_CACHE_ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+static uint64_t drgCacheHashBytes(uint64_t hash, const void* data, size_t length) {
+    // FNV-1a, 64-bit
+    const uint8_t* bytes = (const uint8_t*)data;
+    for(size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+uint64_t drgCacheBuild(void) {
+    uint32_t parts[] = { DRG_CACHE_FORMAT, DRG_OC_Count, (uint32_t)sizeof(drgCacheNugget) };
+    uint64_t hash = drgCacheHashBytes(UINT64_C(14695981039346656037), D_SoftwareVersion, strlen(D_SoftwareVersion));
+    return drgCacheHashBytes(hash, parts, sizeof(parts));
+}
+
+uint64_t drgCacheHashSource(const char* source, size_t length) {
+    return drgCacheHashBytes(UINT64_C(14695981039346656037), source, length);
+}
+
+void drgCacheMakeKey(const char* source, size_t length, unsigned flags, drgCacheKey* key) {
+    key->sourceHash = drgCacheHashSource(source, length);
+    key->sourceLength = length;
+    key->flags = flags;
+}
+
+void drgCacheFileName(const drgCacheKey* key, char* name, size_t size) {
+    snprintf(name, size, "%016llx-%llx-%u.dgc", (unsigned long long)key->sourceHash,
+        (unsigned long long)key->sourceLength, key->flags);
+}
+
+/*****************************************************************
+* Files
+*****************************************************************/
+
+size_t drgCacheAppend(drgCacheBuffer* buffer, const void* bytes, size_t size) {
+    size_t at = DRG_CACHE_ALIGN(buffer->length);
+    if(buffer->capacity < at + size) {
+        size_t capacity = (buffer->capacity < 4096) ? 4096 : buffer->capacity;
+        while(capacity < at + size) {
+            capacity *= 2;
+        }
+        buffer->data = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_GENERAL, uint8_t, buffer->data, buffer->capacity, capacity);
+        buffer->capacity = capacity;
+    }
+    memset(buffer->data + buffer->length, 0, at - buffer->length);
+    if(NULL == bytes) {
+        memset(buffer->data + at, 0, size);
+    }
+    else if(size > 0) {
+        memcpy(buffer->data + at, bytes, size);
+    }
+    buffer->length = at + size;
+    return at;
+}
+
+void drgCacheEncode(drgCacheBuffer* buffer, drgVal value, drgCacheConstant* constant) {
+    constant->length = 0;
+    if(drgValIsInt(value)) {
+        constant->kind = DRG_CACHE_INT;
+        constant->value = (uint64_t)drgValAsInt(value);
+    }
+    else if(drgValIsReal(value)) {
+        double real = drgValAsReal(value);
+        constant->kind = DRG_CACHE_REAL;
+        memcpy(&constant->value, &real, sizeof(real));
+    }
+    else if(drgValIsBool(value)) {
+        constant->kind = DRG_CACHE_BOOL;
+        constant->value = drgValAsBool(value);
+    }
+    else if(drgValIsObjType(value, DRG_OBJ_STRING)) {
+        drgString* string = drgValAsString(value);
+        constant->kind = DRG_CACHE_STRING;
+        constant->length = (uint32_t)string->length;
+        constant->value = drgCacheAppend(buffer, string->chars, (size_t)string->length);
+    }
+    else {
+        constant->kind = DRG_CACHE_NONE;
+        constant->value = 0;
+    }
+}
+
+bool drgCacheDecode(const D_SourceBuffer* file, const drgCacheConstant* constant, drgVal* value) {
+    switch(constant->kind) {
+        case DRG_CACHE_INT:
+            *value = drgValFromInt((int64_t)constant->value);
+            return true;
+        case DRG_CACHE_REAL: {
+            double real;
+            memcpy(&real, &constant->value, sizeof(real));
+            *value = drgValFromReal(real);
+            return true;
+        }
+        case DRG_CACHE_BOOL:
+            *value = drgValFromBool(constant->value != 0);
+            return true;
+        case DRG_CACHE_NONE:
+            *value = drgValNone();
+            return true;
+        case DRG_CACHE_STRING:
+            if(!drgCacheInside(file, constant->value, constant->length)) {
+                return false;
+            }
+            *value = drgValFromObj(drgIntern(file->data + constant->value, (int)constant->length));
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool drgCacheInside(const D_SourceBuffer* file, uint64_t offset, uint64_t length) {
+    return offset <= file->length && length <= file->length - offset;
+}
+
+// Opens a temp file next to 'path' that no other writer has, since
+// cron-style runs of one script may well save the same cache at once
+static FILE* drgCacheOpenTemp(const char* path, char* temp, size_t size) {
+    #if defined(_WIN32) || defined(_WIN64)
+    static unsigned counter;
+    if((size_t)snprintf(temp, size, "%s.%d.%u.tmp", path, _getpid(), counter++) >= size) {
+        return NULL;
+    }
+    return fopen(temp, "wb");
+    #else
+    if((size_t)snprintf(temp, size, "%s.XXXXXX", path) >= size) {
+        return NULL;
+    }
+    int fd = mkstemp(temp);
+    if(fd < 0) {
+        return NULL;
+    }
+    FILE* file = fdopen(fd, "wb");
+    if(NULL == file) {
+        close(fd);
+        remove(temp);
+    }
+    return file;
+    #endif
+}
+
+bool drgCacheSave(const char* path, const drgCacheBuffer* buffer) {
+    char temp[4096];
+    if(buffer->length > UINT32_MAX) {
+        return false;
+    }
+    FILE* file = drgCacheOpenTemp(path, temp, sizeof(temp));
+    if(NULL == file) {
+        return false;
+    }
+    bool ok = fwrite(buffer->data, 1, buffer->length, file) == buffer->length;
+    ok = (0 == fclose(file)) && ok;
+    ok = ok && 0 == rename(temp, path);
+    if(!ok) {
+        remove(temp);
+    }
+    return ok;
+}
+
+void drgCacheBufferFree(drgCacheBuffer* buffer) {
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_GENERAL, uint8_t, buffer->data, buffer->capacity);
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+/*****************************************************************
+* Writing
+*****************************************************************/
+
+typedef struct {
+    drgCacheBuffer buffer;
+    const drgNugget** nuggets; // in record order
+    int nuggetCount;
+    int nuggetCapacity;
+    bool portable;      // false once a module's function turns up
+} drgCacheWriter;
+
+static int drgCacheAddNugget(drgCacheWriter* w, const drgNugget* nugget) {
+    if(w->nuggetCount == w->nuggetCapacity) {
+        int capacity = DRG_MEM_GROW_CAPACITY(w->nuggetCapacity);
+        w->nuggets = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_GENERAL, const drgNugget*, w->nuggets, w->nuggetCapacity, capacity);
+        w->nuggetCapacity = capacity;
+    }
+    w->nuggets[w->nuggetCount] = nugget;
+    return w->nuggetCount++;
+}
+
+// Gives every function a record number, parents before children.
+// Functions from a .dgm can't be written, they're only valid
+// while it's loaded.
+static void drgCacheCollect(drgCacheWriter* w, const drgNugget* nugget) {
+    drgCacheAddNugget(w, nugget);
+    for(int i = 0; i < nugget->constantPool.count; i++) {
+        drgVal constant = nugget->constantPool.values[i];
+        if(drgValIsObjType(constant, DRG_OBJ_FUNCTION)) {
+            if(NULL != drgValAsFunction(constant)->module) {
+                w->portable = false;
+                continue;
+            }
+            drgCacheCollect(w, &drgValAsFunction(constant)->nugget);
+        }
+    }
+}
+
+static int drgCacheIndexOf(const drgCacheWriter* w, const drgNugget* nugget) {
+    for(int i = 0; i < w->nuggetCount; i++) {
+        if(w->nuggets[i] == nugget) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void drgCacheWriteNugget(drgCacheWriter* w, size_t recordAt, int index) {
+    drgCacheBuffer* buffer = &w->buffer;
+    const drgNugget* nugget = w->nuggets[index];
+    drgCacheNugget record = { 0 };
+    record.codeLength = (uint32_t)nugget->count;
+    record.code = (uint32_t)drgCacheAppend(buffer, nugget->bytecode, (size_t)nugget->count);
+    record.linesLength = (uint32_t)nugget->lines.count;
+    record.lines = (uint32_t)drgCacheAppend(buffer, nugget->lines.data, (size_t)nugget->lines.count);
+    record.registers = nugget->registers;
+    record.maxStack = nugget->maxStack;
+
+    // Strings first, the constant array can't move once placed
+    const drgValArray* pool = &nugget->constantPool;
+    record.constantCount = (uint32_t)pool->count;
+    drgCacheConstant* constants = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_GENERAL, drgCacheConstant, NULL, 0, pool->count);
+    for(int i = 0; i < pool->count; i++) {
+        drgVal value = pool->values[i];
+        if(drgValIsObjType(value, DRG_OBJ_FUNCTION)) {
+            constants[i].kind = DRG_CACHE_FUNCTION;
+            constants[i].length = 0;
+            constants[i].value = (uint64_t)drgCacheIndexOf(w, &drgValAsFunction(value)->nugget);
+        }
+        else {
+            drgCacheEncode(buffer, value, &constants[i]);
+        }
+    }
+    record.constants = (uint32_t)drgCacheAppend(buffer, constants, sizeof(drgCacheConstant) * (size_t)pool->count);
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_GENERAL, drgCacheConstant, constants, pool->count);
+
+    // A function's name and arity live with its parent's constant,
+    // which is easier to get at from the child's record
+    for(int parent = 0; parent < index; parent++) {
+        const drgValArray* parentPool = &w->nuggets[parent]->constantPool;
+        for(int i = 0; i < parentPool->count; i++) {
+            drgVal value = parentPool->values[i];
+            if(drgValIsObjType(value, DRG_OBJ_FUNCTION) && &drgValAsFunction(value)->nugget == nugget) {
+                drgFunction* function = drgValAsFunction(value);
+                record.arity = function->arity;
+                record.nameLength = (uint32_t)function->name->length;
+                record.name = (uint32_t)drgCacheAppend(buffer, function->name->chars, (size_t)function->name->length);
+            }
+        }
+    }
+    memcpy(buffer->data + recordAt + sizeof(drgCacheNugget) * (size_t)index, &record, sizeof(record));
+}
+
+bool drgCacheWrite(const char* path, const drgCacheKey* key, const drgNugget* nugget, int globalCount) {
+    drgCacheWriter w = { 0 };
+    w.portable = true;
+    drgCacheCollect(&w, nugget);
+    bool ok = w.portable;
+    if(ok) {
+        drgCacheHeader header = { { 'D', 'G', 'C', '\0' }, DRG_CACHE_ORDER, drgCacheBuild(),
+            key->sourceHash, key->sourceLength, key->flags, globalCount, (uint32_t)w.nuggetCount, 0 };
+        drgCacheAppend(&w.buffer, &header, sizeof(header));
+        size_t recordAt = drgCacheAppend(&w.buffer, NULL, sizeof(drgCacheNugget) * (size_t)w.nuggetCount);
+        for(int i = 0; i < w.nuggetCount; i++) {
+            drgCacheWriteNugget(&w, recordAt, i);
+        }
+        ok = drgCacheSave(path, &w.buffer);
+    }
+    drgCacheBufferFree(&w.buffer);
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_GENERAL, const drgNugget*, w.nuggets, w.nuggetCapacity);
+    return ok;
+}
+
+/*****************************************************************
+* Loading
+*****************************************************************/
+
+static bool drgCacheLoadNugget(const D_SourceBuffer* file, uint32_t index, drgNugget* nugget) {
+    const uint8_t* base = (const uint8_t*)file->data;
+    const drgCacheHeader* header = (const drgCacheHeader*)base;
+    const drgCacheNugget* record = (const drgCacheNugget*)(base + DRG_CACHE_ALIGN(sizeof(drgCacheHeader))) + index;
+    if(!drgCacheInside(file, record->code, record->codeLength) ||
+        !drgCacheInside(file, record->lines, record->linesLength) ||
+        !drgCacheInside(file, record->constants, sizeof(drgCacheConstant) * (uint64_t)record->constantCount) ||
+        record->constants % 8 != 0) {
+        return false;
+    }
+
+    // Borrowed straight from the mapping, see drgNuggetFree()
+    nugget->bytecode = (drgByte*)(base + record->code);
+    nugget->count = (int)record->codeLength;
+    nugget->lines.data = (drgByte*)(base + record->lines);
+    nugget->lines.count = (int)record->linesLength;
+    nugget->registers = record->registers;
+    nugget->maxStack = record->maxStack;
+
+    const drgCacheConstant* constants = (const drgCacheConstant*)(base + record->constants);
+    for(uint32_t i = 0; i < record->constantCount; i++) {
+        const drgCacheConstant* constant = &constants[i];
+        if(constant->kind != DRG_CACHE_FUNCTION) {
+            drgVal value;
+            if(!drgCacheDecode(file, constant, &value)) {
+                return false;
+            }
+            drgValArrayAdd(&nugget->constantPool, value);
+            continue;
+        }
+        // Children come after their parent, so this can't loop
+        uint64_t child = constant->value;
+        if(child <= index || child >= header->nuggetCount) {
+            return false;
+        }
+        const drgCacheNugget* childRecord = (const drgCacheNugget*)
+            (base + DRG_CACHE_ALIGN(sizeof(drgCacheHeader))) + child;
+        if(!drgCacheInside(file, childRecord->name, childRecord->nameLength)) {
+            return false;
+        }
+        // In the pool first, so it's freed with it if loading fails
+        drgFunction* function = drgNewFunction();
+        drgValArrayAdd(&nugget->constantPool, drgValFromObj(function));
+        function->arity = childRecord->arity;
+        function->name = drgIntern((const char*)base + childRecord->name, (int)childRecord->nameLength);
+        if(!drgCacheLoadNugget(file, (uint32_t)child, &function->nugget)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool drgCacheLoad(const char* path, const drgCacheKey* key, drgCachedProgram* program) {
+    drgNuggetInit(&program->nugget);
+    program->globalCount = 0;
+    if(!D_SourceOpen(path, &program->file)) {
+        return false;
+    }
+    const D_SourceBuffer* file = &program->file;
+    const drgCacheHeader* header = (const drgCacheHeader*)file->data;
+    bool ok = file->length >= sizeof(drgCacheHeader) &&
+        0 == memcmp(header->magic, "DGC", 4) &&
+        header->order == DRG_CACHE_ORDER &&
+        header->build == drgCacheBuild() &&
+        header->sourceHash == key->sourceHash &&
+        header->sourceLength == key->sourceLength &&
+        header->flags == key->flags &&
+        header->nuggetCount > 0 &&
+        drgCacheInside(file, DRG_CACHE_ALIGN(sizeof(drgCacheHeader)),
+            sizeof(drgCacheNugget) * (uint64_t)header->nuggetCount);
+    ok = ok && drgCacheLoadNugget(file, 0, &program->nugget);
+    if(!ok) {
+        drgCacheClose(program);
+        return false;
+    }
+    program->globalCount = header->globalCount;
+    return true;
+}
+
+void drgCacheClose(drgCachedProgram* program) {
+    drgNuggetFree(&program->nugget);
+    D_SourceClose(&program->file);
+}
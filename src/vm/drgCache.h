@@ -0,0 +1,157 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgCache.h
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Compiled nuggets on disk (.dgc files), so an unchanged script
+* can skip the front end. A file holds the bytecode, line tables
+* and constant pools of a script and its functions, and is loaded
+* by mapping it: the bytecode and line tables are used where they
+* lie, and only the constant pools are rebuilt (strings have to be
+* interned). A file is only ever used for the exact source, flags
+* and interpreter build it was written by.
+*
+*****************************************************************/
+
+#ifndef DRG_H_CACHE
+#define DRG_H_CACHE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "drgNugget.h"
+#include "../util/File.h"
+
+/// @brief What a .dgc file must have been compiled from.
+typedef struct {
+    uint64_t sourceHash;    // drgCacheHashSource()
+    uint64_t sourceLength;
+    uint32_t flags;         // D_CompileFlag
+} drgCacheKey;
+
+/// @brief A loaded .dgc file. The nugget borrows from the mapping,
+/// so both go with drgCacheClose().
+typedef struct {
+    D_SourceBuffer file;
+    drgNugget nugget;
+    int globalCount;        // globals the nugget was compiled against
+} drgCachedProgram;
+
+/// @brief Hash of a source, for drgCacheKey.
+/// @param source
+/// @param length
+/// @return
+uint64_t drgCacheHashSource(const char* source, size_t length);
+
+/// @brief Makes a key for a source compiled with 'flags'.
+/// @param source
+/// @param length
+/// @param flags
+/// @param key Output.
+void drgCacheMakeKey(const char* source, size_t length, unsigned flags, drgCacheKey* key);
+
+/// @brief The file name (no directory) a key is cached under.
+/// @param key
+/// @param name Output.
+/// @param size Size of 'name'.
+void drgCacheFileName(const drgCacheKey* key, char* name, size_t size);
+
+/// @brief Writes a compiled nugget. The file is written next to
+/// 'path' and renamed into place, so readers never see half of it.
+/// @param path
+/// @param key What 'nugget' was compiled from.
+/// @param nugget
+/// @param globalCount Globals it was compiled against.
+/// @return False if the file couldn't be written.
+bool drgCacheWrite(const char* path, const drgCacheKey* key, const drgNugget* nugget, int globalCount);
+
+/// @brief Loads a .dgc file, if it exists and was written for 'key'
+/// by this build.
+/// @param path
+/// @param key
+/// @param program Output, release with drgCacheClose().
+/// @return False if there's no usable file.
+bool drgCacheLoad(const char* path, const drgCacheKey* key, drgCachedProgram* program);
+
+/// @brief Frees a loaded program and unmaps its file.
+/// @param program
+void drgCacheClose(drgCachedProgram* program);
+
+/*****************************************************************
+* Shared with drgModule
+*****************************************************************/
+
+/// @brief Kinds of drgCacheConstant.
+typedef enum {
+    DRG_CACHE_INT,
+    DRG_CACHE_REAL,
+    DRG_CACHE_BOOL,
+    DRG_CACHE_NONE,
+    DRG_CACHE_STRING,       // 'value' is the offset of the chars
+    DRG_CACHE_FUNCTION      // 'value' is its nugget record's index
+} drgCacheKind;
+
+/// @brief A constant as it's stored in a file.
+typedef struct {
+    uint32_t kind;          // drgCacheKind
+    uint32_t length;        // strings only
+    uint64_t value;
+} drgCacheConstant;
+
+/// @brief A file being built in memory. Start it zeroed.
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+} drgCacheBuffer;
+
+/// @brief Identifies the interpreter build, anything that changes
+/// what bytecode means changes it.
+/// @return
+uint64_t drgCacheBuild(void);
+
+/// @brief Appends bytes at the next 8-byte boundary.
+/// @param buffer
+/// @param bytes NULL appends zeroes.
+/// @param size
+/// @return Their offset.
+size_t drgCacheAppend(drgCacheBuffer* buffer, const void* bytes, size_t size);
+
+/// @brief Encodes any constant but a function, appending the chars
+/// of a string.
+/// @param buffer
+/// @param value
+/// @param constant Output.
+void drgCacheEncode(drgCacheBuffer* buffer, drgVal value, drgCacheConstant* constant);
+
+/// @brief Decodes any constant but a function, interning strings.
+/// @param file Where 'constant' came from.
+/// @param constant
+/// @param value Output.
+/// @return False if it's a function or out of bounds.
+bool drgCacheDecode(const D_SourceBuffer* file, const drgCacheConstant* constant, drgVal* value);
+
+/// @brief Whether [offset, offset + length) lies within a file.
+/// @param file
+/// @param offset
+/// @param length
+/// @return
+bool drgCacheInside(const D_SourceBuffer* file, uint64_t offset, uint64_t length);
+
+/// @brief Writes a built file to a temp file of its own next to
+/// 'path' and renames it into place, so readers never see half of
+/// it, even with other processes saving the same path.
+/// @param path
+/// @param buffer
+/// @return False if it couldn't be written.
+bool drgCacheSave(const char* path, const drgCacheBuffer* buffer);
+
+/// @brief Frees a buffer's memory.
+/// @param buffer
+void drgCacheBufferFree(drgCacheBuffer* buffer);
+
+#endif // DRG_H_CACHE
@@ -0,0 +1,232 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgDebug.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Bytecode disassembler, for debugging the compiler and VM.
+*
+*****************************************************************/
+
+#include <stdio.h>
+
+#include "drgDebug.h"
+#include "drgObject.h"
+
+static int drgSimpleInst(const char* name, drgByte inst, int offset) {
+    printf("%-18s (0x%02X)\n", name, inst);
+    return offset + 1;
+}
+
+static int drgShortInst(const char* name, drgByte inst, drgNugget* nug, int offset) {
+    int operand = (nug->bytecode[offset + 1] << 8) | nug->bytecode[offset + 2];
+    printf("%-18s (0x%02X) %2d\n", name, inst, operand);
+    return offset + 3;
+}
+
+// Register instructions: 'slots' 16-bit operands, then the
+// constant index for LOADK and LOADK_LONG.
+static int drgRegInst(const char* name, drgByte inst, drgNugget* nug, int offset, int slots) {
+    printf("%-18s (0x%02X)", name, inst);
+    int at = offset + 1;
+    for(int i = 0; i < slots; i++, at += 2) {
+        printf(" r%d", (nug->bytecode[at] << 8) | nug->bytecode[at + 1]);
+    }
+    if(inst == DRG_OC_R_LOADK || inst == DRG_OC_R_LOADK_LONG) {
+        int lit = nug->bytecode[at++];
+        if(inst == DRG_OC_R_LOADK_LONG) {
+            lit = (lit << 16) | (nug->bytecode[at] << 8) | nug->bytecode[at + 1];
+            at += 2;
+        }
+        printf(" %2d' ", lit);
+        drgPrintVal(nug->constantPool.values[lit]);
+        printf("'");
+    }
+    printf("\n");
+    return at;
+}
+
+// [element8, count16], or [type8, count16] for DRG_OC_MAP
+static int drgArrayInst(const char* name, drgByte inst, drgNugget* nug, int offset) {
+    const drgByte* code = nug->bytecode + offset;
+    printf("%-18s (0x%02X) %2d x%d\n", name, inst, code[1], (code[2] << 8) | code[3]);
+    return offset + 4;
+}
+
+// [type8, count8]
+static int drgStructInst(const char* name, drgByte inst, drgNugget* nug, int offset) {
+    const drgByte* code = nug->bytecode + offset;
+    printf("%-18s (0x%02X) %2d x%d\n", name, inst, code[1], code[2]);
+    return offset + 3;
+}
+
+static int drgByteInst(const char* name, drgByte inst, drgNugget* nug, int offset) {
+    printf("%-18s (0x%02X) %2d\n", name, inst, nug->bytecode[offset + 1]);
+    return offset + 2;
+}
+
+// Jumps print where they land, 'sign' is -1 for LOOP.
+static int drgJumpInst(const char* name, drgByte inst, drgNugget* nug, int offset, int sign) {
+    int jump = (nug->bytecode[offset + 1] << 8) | nug->bytecode[offset + 2];
+    printf("%-18s (0x%02X) -> %04d\n", name, inst, offset + 3 + sign * jump);
+    return offset + 3;
+}
+
+static int drgLitInst(const char* name, drgByte inst, drgNugget* nug, int offset) {
+    drgByte lit = nug->bytecode[offset + 1];
+    printf("%-18s (0x%02X) %2d' ", name, inst, lit);
+    drgPrintVal(nug->constantPool.values[lit]);
+    printf("'\n");
+    return offset + 2; // Consumes 2 spaces
+}
+
+static int drgLitLongInst(const char* name, drgByte inst, drgNugget* nug, int offset) {
+    const drgByte* code = nug->bytecode + offset;
+    int lit = (code[1] << 16) | (code[2] << 8) | code[3];
+    printf("%-18s (0x%02X) %2d' ", name, inst, lit);
+    drgPrintVal(nug->constantPool.values[lit]);
+    printf("'\n");
+    return offset + 4;
+}
+
+void drgDisassembleNugget(drgNugget* nugget, const char* name) {
+    printf("[%s]\n", name);
+    for(int offset = 0; offset < nugget->count;) {
+        offset = drgDisassembleInstruction(nugget, offset);
+    }
+    // Then the functions declared in it
+    for(int i = 0; i < nugget->constantPool.count; i++) {
+        drgVal constant = nugget->constantPool.values[i];
+        if(drgValIsObjType(constant, DRG_OBJ_FUNCTION)) {
+            drgFunction* function = drgValAsFunction(constant);
+            drgDisassembleNugget(&function->nugget, function->name->chars);
+        }
+    }
+}
+
+int drgDisassembleInstruction(drgNugget* nugget, int offset) {
+    drgByte inst = nugget->bytecode[offset];
+    int line, column;
+    if(drgNuggetGetPosition(nugget, offset, &line, &column)) {
+        printf("%4d:%-3d ", line, column);
+    }
+    printf("%04d: ", offset);
+    switch(inst) {
+        case DRG_OC_RETURN: return drgSimpleInst("DRG_OC_RETURN", inst, offset);
+        case DRG_OC_TRUE: return drgSimpleInst("DRG_OC_TRUE", inst, offset);
+        case DRG_OC_FALSE: return drgSimpleInst("DRG_OC_FALSE", inst, offset);
+        case DRG_OC_NONE: return drgSimpleInst("DRG_OC_NONE", inst, offset);
+        case DRG_OC_NEGATE: return drgSimpleInst("DRG_OC_NEGATE", inst, offset);
+        case DRG_OC_NOT: return drgSimpleInst("DRG_OC_NOT", inst, offset);
+        case DRG_OC_ADD: return drgSimpleInst("DRG_OC_ADD", inst, offset);
+        case DRG_OC_SUB: return drgSimpleInst("DRG_OC_SUB", inst, offset);
+        case DRG_OC_MULT: return drgSimpleInst("DRG_OC_MULT", inst, offset);
+        case DRG_OC_DIV: return drgSimpleInst("DRG_OC_DIV", inst, offset);
+        case DRG_OC_EQ: return drgSimpleInst("DRG_OC_EQ", inst, offset);
+        case DRG_OC_NEQ: return drgSimpleInst("DRG_OC_NEQ", inst, offset);
+        case DRG_OC_GT: return drgSimpleInst("DRG_OC_GT", inst, offset);
+        case DRG_OC_GTE: return drgSimpleInst("DRG_OC_GTE", inst, offset);
+        case DRG_OC_LT: return drgSimpleInst("DRG_OC_LT", inst, offset);
+        case DRG_OC_LTE: return drgSimpleInst("DRG_OC_LTE", inst, offset);
+        case DRG_OC_NEGATE_INT: return drgSimpleInst("DRG_OC_NEGATE_INT", inst, offset);
+        case DRG_OC_NEGATE_REAL: return drgSimpleInst("DRG_OC_NEGATE_REAL", inst, offset);
+        case DRG_OC_ADD_INT: return drgSimpleInst("DRG_OC_ADD_INT", inst, offset);
+        case DRG_OC_ADD_REAL: return drgSimpleInst("DRG_OC_ADD_REAL", inst, offset);
+        case DRG_OC_ADD_STRING: return drgSimpleInst("DRG_OC_ADD_STRING", inst, offset);
+        case DRG_OC_SUB_INT: return drgSimpleInst("DRG_OC_SUB_INT", inst, offset);
+        case DRG_OC_SUB_REAL: return drgSimpleInst("DRG_OC_SUB_REAL", inst, offset);
+        case DRG_OC_MULT_INT: return drgSimpleInst("DRG_OC_MULT_INT", inst, offset);
+        case DRG_OC_MULT_REAL: return drgSimpleInst("DRG_OC_MULT_REAL", inst, offset);
+        case DRG_OC_DIV_INT: return drgSimpleInst("DRG_OC_DIV_INT", inst, offset);
+        case DRG_OC_DIV_REAL: return drgSimpleInst("DRG_OC_DIV_REAL", inst, offset);
+        case DRG_OC_EQ_INT: return drgSimpleInst("DRG_OC_EQ_INT", inst, offset);
+        case DRG_OC_EQ_REAL: return drgSimpleInst("DRG_OC_EQ_REAL", inst, offset);
+        case DRG_OC_EQ_STRING: return drgSimpleInst("DRG_OC_EQ_STRING", inst, offset);
+        case DRG_OC_NEQ_INT: return drgSimpleInst("DRG_OC_NEQ_INT", inst, offset);
+        case DRG_OC_NEQ_REAL: return drgSimpleInst("DRG_OC_NEQ_REAL", inst, offset);
+        case DRG_OC_NEQ_STRING: return drgSimpleInst("DRG_OC_NEQ_STRING", inst, offset);
+        case DRG_OC_GT_INT: return drgSimpleInst("DRG_OC_GT_INT", inst, offset);
+        case DRG_OC_GT_REAL: return drgSimpleInst("DRG_OC_GT_REAL", inst, offset);
+        case DRG_OC_GTE_INT: return drgSimpleInst("DRG_OC_GTE_INT", inst, offset);
+        case DRG_OC_GTE_REAL: return drgSimpleInst("DRG_OC_GTE_REAL", inst, offset);
+        case DRG_OC_LT_INT: return drgSimpleInst("DRG_OC_LT_INT", inst, offset);
+        case DRG_OC_LT_REAL: return drgSimpleInst("DRG_OC_LT_REAL", inst, offset);
+        case DRG_OC_LTE_INT: return drgSimpleInst("DRG_OC_LTE_INT", inst, offset);
+        case DRG_OC_LTE_REAL: return drgSimpleInst("DRG_OC_LTE_REAL", inst, offset);
+        case DRG_OC_INT_TO_REAL: return drgSimpleInst("DRG_OC_INT_TO_REAL", inst, offset);
+        case DRG_OC_INT_TO_REAL_UNDER: return drgSimpleInst("DRG_OC_INT_TO_REAL_UNDER", inst, offset);
+        case DRG_OC_CHECK_TYPE: return drgByteInst("DRG_OC_CHECK_TYPE", inst, nugget, offset);
+        case DRG_OC_NUM_LIT: return drgLitInst("DRG_OC_LIT_NUM", inst, nugget, offset);
+        case DRG_OC_NUM_LIT_LONG: return drgLitLongInst("DRG_OC_LIT_NUM_LONG", inst, nugget, offset);
+        case DRG_OC_DEFINE_GLOBAL: return drgShortInst("DRG_OC_DEF_GLOBAL", inst, nugget, offset);
+        case DRG_OC_GET_GLOBAL: return drgShortInst("DRG_OC_GET_GLOBAL", inst, nugget, offset);
+        case DRG_OC_SET_GLOBAL: return drgShortInst("DRG_OC_SET_GLOBAL", inst, nugget, offset);
+        case DRG_OC_GET_LOCAL: return drgByteInst("DRG_OC_GET_LOCAL", inst, nugget, offset);
+        case DRG_OC_SET_LOCAL: return drgByteInst("DRG_OC_SET_LOCAL", inst, nugget, offset);
+        case DRG_OC_JUMP: return drgJumpInst("DRG_OC_JUMP", inst, nugget, offset, 1);
+        case DRG_OC_JUMP_IF_FALSE: return drgJumpInst("DRG_OC_JUMP_FALSE", inst, nugget, offset, 1);
+        case DRG_OC_LOOP: return drgJumpInst("DRG_OC_LOOP", inst, nugget, offset, -1);
+        case DRG_OC_CALL: return drgByteInst("DRG_OC_CALL", inst, nugget, offset);
+        case DRG_OC_ARRAY: return drgArrayInst("DRG_OC_ARRAY", inst, nugget, offset);
+        case DRG_OC_NEW_ARRAY: return drgByteInst("DRG_OC_NEW_ARRAY", inst, nugget, offset);
+        case DRG_OC_GET_INDEX: return drgSimpleInst("DRG_OC_GET_INDEX", inst, offset);
+        case DRG_OC_GET_INDEX_INT: return drgSimpleInst("DRG_OC_GET_INDEX_INT", inst, offset);
+        case DRG_OC_GET_INDEX_REAL: return drgSimpleInst("DRG_OC_GET_INDEX_REAL", inst, offset);
+        case DRG_OC_GET_INDEX_BOOL: return drgSimpleInst("DRG_OC_GET_INDEX_BOOL", inst, offset);
+        case DRG_OC_SET_INDEX: return drgSimpleInst("DRG_OC_SET_INDEX", inst, offset);
+        case DRG_OC_SET_INDEX_INT: return drgSimpleInst("DRG_OC_SET_INDEX_INT", inst, offset);
+        case DRG_OC_SET_INDEX_REAL: return drgSimpleInst("DRG_OC_SET_INDEX_REAL", inst, offset);
+        case DRG_OC_SET_INDEX_BOOL: return drgSimpleInst("DRG_OC_SET_INDEX_BOOL", inst, offset);
+        case DRG_OC_ARRAY_ADD: return drgSimpleInst("DRG_OC_ARRAY_ADD", inst, offset);
+        case DRG_OC_ARRAY_REM: return drgSimpleInst("DRG_OC_ARRAY_REM", inst, offset);
+        case DRG_OC_ARRAY_LEN: return drgSimpleInst("DRG_OC_ARRAY_LEN", inst, offset);
+        case DRG_OC_MAP: return drgArrayInst("DRG_OC_MAP", inst, nugget, offset);
+        case DRG_OC_GET_MAP_INT: return drgSimpleInst("DRG_OC_GET_MAP_INT", inst, offset);
+        case DRG_OC_GET_MAP_REAL: return drgSimpleInst("DRG_OC_GET_MAP_REAL", inst, offset);
+        case DRG_OC_GET_MAP_STRING: return drgSimpleInst("DRG_OC_GET_MAP_STRING", inst, offset);
+        case DRG_OC_SET_MAP: return drgSimpleInst("DRG_OC_SET_MAP", inst, offset);
+        case DRG_OC_MAP_HAS: return drgSimpleInst("DRG_OC_MAP_HAS", inst, offset);
+        case DRG_OC_MAP_REM: return drgSimpleInst("DRG_OC_MAP_REM", inst, offset);
+        case DRG_OC_MAP_LEN: return drgSimpleInst("DRG_OC_MAP_LEN", inst, offset);
+        case DRG_OC_MAP_KEYS: return drgSimpleInst("DRG_OC_MAP_KEYS", inst, offset);
+        case DRG_OC_MAP_RESERVE: return drgSimpleInst("DRG_OC_MAP_RESERVE", inst, offset);
+        case DRG_OC_STRUCT: return drgStructInst("DRG_OC_STRUCT", inst, nugget, offset);
+        case DRG_OC_GET_FIELD: return drgByteInst("DRG_OC_GET_FIELD", inst, nugget, offset);
+        case DRG_OC_SET_FIELD: return drgByteInst("DRG_OC_SET_FIELD", inst, nugget, offset);
+        case DRG_OC_GET_ROW_FIELD: return drgByteInst("DRG_OC_GET_ROW_FIELD", inst, nugget, offset);
+        case DRG_OC_SET_ROW_FIELD: return drgByteInst("DRG_OC_SET_ROW_FIELD", inst, nugget, offset);
+        case DRG_OC_POP: return drgSimpleInst("DRG_OC_POP", inst, offset);
+        case DRG_OC_PRINT: return drgSimpleInst("DRG_OC_PRINT", inst, offset);
+        case DRG_OC_POP_LOCAL: return drgByteInst("DRG_OC_POP_LOCAL", inst, nugget, offset);
+        case DRG_OC_GET_LOCAL_ADD: return drgByteInst("DRG_OC_GET_LOCAL_ADD", inst, nugget, offset);
+        case DRG_OC_LIT_ADD: return drgLitInst("DRG_OC_LIT_ADD", inst, nugget, offset);
+        case DRG_OC_LIT_SUB: return drgLitInst("DRG_OC_LIT_SUB", inst, nugget, offset);
+        case DRG_OC_LIT_LT: return drgLitInst("DRG_OC_LIT_LT", inst, nugget, offset);
+        case DRG_OC_LIT_EQ: return drgLitInst("DRG_OC_LIT_EQ", inst, nugget, offset);
+        case DRG_OC_R_LOADK: return drgRegInst("DRG_OC_R_LOADK", inst, nugget, offset, 1);
+        case DRG_OC_R_LOADK_LONG: return drgRegInst("DRG_OC_R_LOADK_LONG", inst, nugget, offset, 1);
+        case DRG_OC_R_LOADTRUE: return drgRegInst("DRG_OC_R_LOADTRUE", inst, nugget, offset, 1);
+        case DRG_OC_R_LOADFALSE: return drgRegInst("DRG_OC_R_LOADFALSE", inst, nugget, offset, 1);
+        case DRG_OC_R_MOVE: return drgRegInst("DRG_OC_R_MOVE", inst, nugget, offset, 2);
+        case DRG_OC_R_NEGATE: return drgRegInst("DRG_OC_R_NEGATE", inst, nugget, offset, 2);
+        case DRG_OC_R_NOT: return drgRegInst("DRG_OC_R_NOT", inst, nugget, offset, 2);
+        case DRG_OC_R_INT_TO_REAL: return drgRegInst("DRG_OC_R_INT_TO_REAL", inst, nugget, offset, 2);
+        case DRG_OC_R_ADD: return drgRegInst("DRG_OC_R_ADD", inst, nugget, offset, 3);
+        case DRG_OC_R_SUB: return drgRegInst("DRG_OC_R_SUB", inst, nugget, offset, 3);
+        case DRG_OC_R_MULT: return drgRegInst("DRG_OC_R_MULT", inst, nugget, offset, 3);
+        case DRG_OC_R_DIV: return drgRegInst("DRG_OC_R_DIV", inst, nugget, offset, 3);
+        case DRG_OC_R_EQ: return drgRegInst("DRG_OC_R_EQ", inst, nugget, offset, 3);
+        case DRG_OC_R_NEQ: return drgRegInst("DRG_OC_R_NEQ", inst, nugget, offset, 3);
+        case DRG_OC_R_GT: return drgRegInst("DRG_OC_R_GT", inst, nugget, offset, 3);
+        case DRG_OC_R_GTE: return drgRegInst("DRG_OC_R_GTE", inst, nugget, offset, 3);
+        case DRG_OC_R_LT: return drgRegInst("DRG_OC_R_LT", inst, nugget, offset, 3);
+        case DRG_OC_R_LTE: return drgRegInst("DRG_OC_R_LTE", inst, nugget, offset, 3);
+        case DRG_OC_R_PRINT: return drgRegInst("DRG_OC_R_PRINT", inst, nugget, offset, 1);
+        default:
+            printf("!! Unknown opcode %d\n", inst);
+            return offset + 1;
+    }
+    return offset + 1; // shouldn't get hit but put it here anyway
+}
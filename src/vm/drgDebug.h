@@ -0,0 +1,29 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgDebug.h
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Bytecode disassembler, for debugging the compiler and VM.
+*
+*****************************************************************/
+
+#ifndef DRG_H_DEBUG
+#define DRG_H_DEBUG
+
+#include "drgNugget.h"
+
+/// @brief Prints every instruction of a nugget to stdout.
+/// @param nugget 
+/// @param name Printed as a header.
+void drgDisassembleNugget(drgNugget* nugget, const char* name);
+
+/// @brief Prints the instruction at 'offset' to stdout.
+/// @param nugget 
+/// @param offset 
+/// @return Offset of the next instruction.
+int drgDisassembleInstruction(drgNugget* nugget, int offset);
+
+#endif // DRG_H_DEBUG
@@ -0,0 +1,150 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgIntern.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* The string interning table.
+*
+*****************************************************************/
+
+#include <string.h>
+
+#include "drgIntern.h"
+#include "../util/drgMemUtil.h"
+
+// Open addressing, never more than half full, NULL is empty.
+// Strings are never removed one at a time, so there are no
+// tombstones.
+typedef struct {
+    int count;
+    int capacity;       // power of two
+    drgString** entries;
+} drgInternTable;
+
+static drgInternTable strings; // The single table.
+
+uint32_t drgHashChars(const char* chars, int length) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for(int i = 0; i < length; i++) {
+        hash ^= (uint8_t)chars[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Where 'hash' goes in 'entries', which has a free slot.
+static int drgInternSlot(drgString** entries, int capacity, uint32_t hash) {
+    uint32_t mask = (uint32_t)capacity - 1;
+    uint32_t i = hash & mask;
+    while(entries[i] != NULL) {
+        i = (i + 1) & mask;
+    }
+    return (int)i;
+}
+
+static void drgInternGrow(void) {
+    int capacity = (strings.capacity < 64) ? 64 : strings.capacity * 2;
+    drgString** entries = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_STRINGS, drgString*, NULL, 0, capacity);
+    memset(entries, 0, sizeof(drgString*) * (size_t)capacity);
+    for(int i = 0; i < strings.capacity; i++) {
+        drgString* string = strings.entries[i];
+        if(string != NULL) {
+            entries[drgInternSlot(entries, capacity, string->hash)] = string;
+        }
+    }
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_STRINGS, drgString*, strings.entries, strings.capacity);
+    strings.entries = entries;
+    strings.capacity = capacity;
+}
+
+drgString* drgIntern(const char* chars, int length) {
+    return drgInternHashed(chars, length, drgHashChars(chars, length));
+}
+
+// The interned string with these contents, or NULL.
+static drgString* drgInternFind(const char* chars, int length, uint32_t hash) {
+    if(strings.capacity > 0) {
+        uint32_t mask = (uint32_t)strings.capacity - 1;
+        for(uint32_t i = hash & mask; strings.entries[i] != NULL; i = (i + 1) & mask) {
+            drgString* string = strings.entries[i];
+            if(string->hash == hash && string->length == length &&
+                0 == memcmp(string->chars, chars, (size_t)length)) {
+                return string;
+            }
+        }
+    }
+    return NULL;
+}
+
+drgString* drgInternHashed(const char* chars, int length, uint32_t hash) {
+    drgString* string = drgInternFind(chars, length, hash);
+    if(NULL != string) {
+        return string;
+    }
+    string = drgInternBegin(length);
+    memcpy(string->chars, chars, (size_t)length);
+    string->hash = hash;
+    strings.entries[drgInternSlot(strings.entries, strings.capacity, hash)] = string;
+    strings.count++;
+    return string;
+}
+
+drgString* drgInternBegin(int length) {
+    // Room first, so a failed allocation leaves the table as it
+    // was, and drgInternEnd() can't fail
+    if(strings.capacity < (strings.count + 1) * 2) {
+        drgInternGrow();
+    }
+    drgString* string = (drgString*)drgMemReallocate(DRG_MEM_CAT_STRINGS, NULL, 0,
+        sizeof(drgString) + (size_t)length + 1);
+    string->obj.type = DRG_OBJ_STRING;
+    string->length = length;
+    string->hash = 0;
+    string->chars[length] = '\0';
+    return string;
+}
+
+drgString* drgInternEnd(drgString* string) {
+    uint32_t hash = drgHashChars(string->chars, string->length);
+    drgString* found = drgInternFind(string->chars, string->length, hash);
+    if(NULL != found) {
+        drgFreeObject(&string->obj);
+        return found;
+    }
+    string->hash = hash;
+    strings.entries[drgInternSlot(strings.entries, strings.capacity, hash)] = string;
+    strings.count++;
+    return string;
+}
+
+drgString* drgInternConcat(const drgString* a, const drgString* b) {
+    int length = a->length + b->length;
+    // Short ones are put together on the C stack, so one that's
+    // interned already costs no allocation at all
+    if(length <= DRG_STRING_SHORT) {
+        char chars[DRG_STRING_SHORT];
+        memcpy(chars, a->chars, (size_t)a->length);
+        memcpy(chars + a->length, b->chars, (size_t)b->length);
+        return drgIntern(chars, length);
+    }
+    drgString* string = drgInternBegin(length);
+    memcpy(string->chars, a->chars, (size_t)a->length);
+    memcpy(string->chars + a->length, b->chars, (size_t)b->length);
+    return drgInternEnd(string);
+}
+
+void drgInternFreeAll(void) {
+    for(int i = 0; i < strings.capacity; i++) {
+        if(strings.entries[i] != NULL) {
+            drgFreeObject(&strings.entries[i]->obj);
+        }
+    }
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_STRINGS, drgString*, strings.entries, strings.capacity);
+    strings.count = 0;
+    strings.capacity = 0;
+    strings.entries = NULL;
+}
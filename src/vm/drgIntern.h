@@ -0,0 +1,67 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgIntern.h
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* The string interning table. Every name and string literal the
+* compiler sees is looked up here once, so from then on the same
+* text is always the same drgString and comparing two is just
+* comparing pointers. There is one table for the process; it's
+* not thread-safe, and only the compiler and VM use it.
+*
+*****************************************************************/
+
+#ifndef DRG_H_INTERN
+#define DRG_H_INTERN
+
+#include <stdint.h>
+
+#include "drgObject.h"
+
+/// @brief Hash of a string as the table computes it (FNV-1a),
+/// for callers that want to hash once and look up many times.
+/// @param chars
+/// @param length
+/// @return
+uint32_t drgHashChars(const char* chars, int length);
+
+/// @brief The interned string with these contents, created the
+/// first time it's asked for.
+/// @param chars Need not be null-terminated.
+/// @param length
+/// @return Valid until drgInternFreeAll().
+drgString* drgIntern(const char* chars, int length);
+
+/// @brief drgIntern() with the hash already computed.
+/// @param chars
+/// @param length
+/// @param hash drgHashChars(chars, length).
+/// @return
+drgString* drgInternHashed(const char* chars, int length, uint32_t hash);
+
+/// @brief Allocates a string to be filled in and then interned
+/// with drgInternEnd(), for building one in place. Nothing else
+/// may be interned in between.
+/// @param length
+/// @return Its chars are uninitialized, bar the null terminator.
+drgString* drgInternBegin(int length);
+
+/// @brief Interns a string from drgInternBegin(), once its chars
+/// are filled in.
+/// @param string Freed if the same text is interned already.
+/// @return The interned string.
+drgString* drgInternEnd(drgString* string);
+
+/// @brief The interned string of one followed by another.
+/// @param a
+/// @param b
+/// @return
+drgString* drgInternConcat(const drgString* a, const drgString* b);
+
+/// @brief Frees every interned string, and the table.
+void drgInternFreeAll(void);
+
+#endif // DRG_H_INTERN
@@ -0,0 +1,418 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgMap.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Maps.
+*
+*****************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "drgMap.h"
+#include "drgRope.h"
+#include "../util/drgMemUtil.h"
+
+#if !defined(DRG_MAP_FORCE_SCALAR) && (defined(__x86_64__) || defined(_M_X64))
+#define DRG_MAP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+static inline int drgMapCtz(uint32_t mask) {
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+}
+#else
+#define drgMapCtz(mask) __builtin_ctz(mask)
+#endif
+
+static drgMap* maps; // Every map, newest first.
+
+/*****************************************************************
+* Hashing
+*****************************************************************/
+
+// Spreads every bit of 'x' over all of them, as the slot comes
+// from the high bits and the control byte from the low ones.
+static inline uint64_t drgMapMix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+static inline uint64_t drgMapHashInt(int64_t key) {
+    return drgMapMix((uint64_t)key);
+}
+
+static inline uint64_t drgMapHashReal(double key) {
+    // -0.0 == 0.0, so they hash alike
+    uint64_t bits = 0;
+    if(key != 0.0) {
+        memcpy(&bits, &key, sizeof(bits));
+    }
+    return drgMapMix(bits);
+}
+
+static inline uint64_t drgMapHashString(const drgString* key) {
+    return drgMapMix(key->hash);
+}
+
+static uint64_t drgMapHash(const drgMap* map, drgVal key) {
+    switch(map->keyType) {
+        case DRG_TYPE_INT:  return drgMapHashInt(drgValAsInt(key));
+        case DRG_TYPE_REAL: return drgMapHashReal(drgValAsReal(key));
+        default:            return drgMapHashString(drgValAsString(key));
+    }
+}
+
+/*****************************************************************
+* Control Bytes
+*****************************************************************/
+
+// Bit i set if the control byte of slot i of the group is 'byte'
+static inline uint32_t drgMapMatch(const uint8_t* group, uint8_t byte) {
+    #ifdef DRG_MAP_SSE2
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)byte)));
+    #else
+    uint32_t mask = 0;
+    for(int i = 0; i < DRG_MAP_GROUP; i++) {
+        mask |= (uint32_t)(group[i] == byte) << i;
+    }
+    return mask;
+    #endif
+}
+
+// Bit i set if slot i of the group is empty, the only control
+// bytes with the high bit set
+static inline uint32_t drgMapMatchEmpty(const uint8_t* group) {
+    #ifdef DRG_MAP_SSE2
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+    #else
+    uint32_t mask = 0;
+    for(int i = 0; i < DRG_MAP_GROUP; i++) {
+        mask |= (uint32_t)(group[i] >> 7) << i;
+    }
+    return mask;
+    #endif
+}
+
+static inline void drgMapSetCtrl(drgMap* map, size_t slot, uint8_t ctrl) {
+    map->ctrl[slot] = ctrl;
+    if(slot < DRG_MAP_GROUP - 1) {
+        map->ctrl[(size_t)map->capacity + slot] = ctrl;
+    }
+}
+
+// The slots and control bytes share an allocation, the slots
+// first.
+static size_t drgMapTableBytes(int capacity) {
+    if(0 == capacity) {
+        return 0;
+    }
+    return sizeof(uint32_t) * (size_t)capacity + (size_t)capacity + DRG_MAP_GROUP - 1;
+}
+
+/*****************************************************************
+* Lookup
+*****************************************************************/
+
+// Returns the slot the key is in from the function it's expanded
+// in, or -1. 'EQUALS' tests an entry's key.
+#define DRG_MAP_PROBE(map, hash, EQUALS) \
+    do {\
+        if(0 == (map)->count) return -1;\
+        size_t mask = (size_t)(map)->capacity - 1;\
+        size_t pos = (size_t)((hash) >> 7) & mask;\
+        uint8_t h2 = (uint8_t)((hash) & 0x7F);\
+        for(;;) {\
+            const uint8_t* group = (map)->ctrl + pos;\
+            for(uint32_t match = drgMapMatch(group, h2); 0 != match; match &= match - 1) {\
+                size_t slot = (pos + (size_t)drgMapCtz(match)) & mask;\
+                drgVal found = (map)->entries[(map)->slots[slot]].key;\
+                if(EQUALS(found)) return (long)slot;\
+            }\
+            if(0 != drgMapMatchEmpty(group)) return -1;\
+            pos = (pos + DRG_MAP_GROUP) & mask;\
+        }\
+    } while(0)
+
+static long drgMapSlotInt(const drgMap* map, int64_t key) {
+    #define DRG_EQUALS(found) (drgValAsInt(found) == key)
+    DRG_MAP_PROBE(map, drgMapHashInt(key), DRG_EQUALS);
+    #undef DRG_EQUALS
+}
+
+static long drgMapSlotReal(const drgMap* map, double key) {
+    #define DRG_EQUALS(found) (drgValAsReal(found) == key)
+    DRG_MAP_PROBE(map, drgMapHashReal(key), DRG_EQUALS);
+    #undef DRG_EQUALS
+}
+
+static long drgMapSlotString(const drgMap* map, const drgString* key) {
+    #define DRG_EQUALS(found) (drgValAsString(found) == key)
+    DRG_MAP_PROBE(map, drgMapHashString(key), DRG_EQUALS);
+    #undef DRG_EQUALS
+}
+
+#undef DRG_MAP_PROBE
+
+// Real keyed maps hold their keys as reals, whatever they're
+// looked up with, and string keyed ones as flat strings.
+static long drgMapSlot(const drgMap* map, drgVal key) {
+    switch(map->keyType) {
+        case DRG_TYPE_INT:  return drgMapSlotInt(map, drgValAsInt(key));
+        case DRG_TYPE_REAL: return drgMapSlotReal(map, drgValAsNumber(key));
+        default:            return drgMapSlotString(map, drgValToString(key));
+    }
+}
+
+static inline drgVal* drgMapValueAt(const drgMap* map, long slot) {
+    return (slot < 0) ? NULL : &map->entries[map->slots[slot]].value;
+}
+
+drgVal* drgMapGetInt(const drgMap* map, int64_t key) {
+    return drgMapValueAt(map, drgMapSlotInt(map, key));
+}
+
+drgVal* drgMapGetReal(const drgMap* map, double key) {
+    return drgMapValueAt(map, drgMapSlotReal(map, key));
+}
+
+drgVal* drgMapGetString(const drgMap* map, const drgString* key) {
+    return drgMapValueAt(map, drgMapSlotString(map, key));
+}
+
+drgVal* drgMapGet(const drgMap* map, drgVal key) {
+    return drgMapValueAt(map, drgMapSlot(map, key));
+}
+
+/*****************************************************************
+* Growth
+*****************************************************************/
+
+// Puts an entry in the first empty slot from its home one.
+static void drgMapPlace(drgMap* map, uint64_t hash, uint32_t entry) {
+    size_t mask = (size_t)map->capacity - 1;
+    size_t pos = (size_t)(hash >> 7) & mask;
+    for(;;) {
+        uint32_t empty = drgMapMatchEmpty(map->ctrl + pos);
+        if(0 != empty) {
+            size_t slot = (pos + (size_t)drgMapCtz(empty)) & mask;
+            drgMapSetCtrl(map, slot, (uint8_t)(hash & 0x7F));
+            map->slots[slot] = entry;
+            return;
+        }
+        pos = (pos + DRG_MAP_GROUP) & mask;
+    }
+}
+
+// Rebuilds the table with 'capacity' slots, dropping removed
+// entries on the way.
+static void drgMapRehash(drgMap* map, int capacity) {
+    uint32_t* slots = (uint32_t*)drgMemReallocate(DRG_MEM_CAT_MAPS, NULL, 0, drgMapTableBytes(capacity));
+    drgMemReallocate(DRG_MEM_CAT_MAPS, map->slots, drgMapTableBytes(map->capacity), 0);
+    map->slots = slots;
+    map->ctrl = (uint8_t*)(slots + capacity);
+    map->capacity = capacity;
+    memset(map->ctrl, DRG_MAP_EMPTY, (size_t)capacity + DRG_MAP_GROUP - 1);
+
+    int count = 0;
+    for(int i = 0; i < map->entryCount; i++) {
+        if(drgValIsNone(map->entries[i].key)) continue;
+        map->entries[count] = map->entries[i];
+        drgMapPlace(map, drgMapHash(map, map->entries[count].key), (uint32_t)count);
+        count++;
+    }
+    map->entryCount = count;
+}
+
+// Fewest slots 'count' entries fit in, at most 7/8 full.
+static int drgMapCapacityFor(int count) {
+    int capacity = DRG_MAP_GROUP;
+    while((int64_t)capacity * 7 < (int64_t)count * 8) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+static void drgMapReserveEntries(drgMap* map, int capacity) {
+    map->entries = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_MAPS, drgMapEntry, map->entries,
+        map->entryCapacity, capacity);
+    map->entryCapacity = capacity;
+}
+
+drgMap* drgNewMap(drgType keyType, drgType valueType, int capacity) {
+    drgMap* map = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_MAPS, drgMap, NULL, 0, 1);
+    map->obj.type = DRG_OBJ_MAP;
+    map->keyType = keyType;
+    map->valueType = valueType;
+    map->count = 0;
+    map->capacity = 0;
+    map->ctrl = NULL;
+    map->slots = NULL;
+    map->entries = NULL;
+    map->entryCount = 0;
+    map->entryCapacity = 0;
+    // Listed before anything else is allocated, so it's freed even
+    // if that runs out of memory
+    map->next = maps;
+    maps = map;
+    if(capacity > 0) {
+        drgMapReserve(map, capacity);
+    }
+    return map;
+}
+
+void drgMapReserve(drgMap* map, int count) {
+    int capacity = drgMapCapacityFor(count);
+    if(capacity > map->capacity) {
+        drgMapRehash(map, capacity);
+    }
+    if(count > map->entryCapacity) {
+        drgMapReserveEntries(map, count);
+    }
+}
+
+/*****************************************************************
+* Changes
+*****************************************************************/
+
+bool drgMapKeyFits(const drgMap* map, drgVal key) {
+    switch(map->keyType) {
+        case DRG_TYPE_INT:  return drgValIsInt(key);
+        case DRG_TYPE_REAL: return drgValIsReal(key) || drgValIsInt(key);
+        default:            return drgValIsString(key);
+    }
+}
+
+bool drgMapValueFits(const drgMap* map, drgVal value) {
+    switch(map->valueType) {
+        case DRG_TYPE_INT:  return drgValIsInt(value);
+        case DRG_TYPE_REAL: return drgValIsReal(value) || drgValIsInt(value);
+        case DRG_TYPE_BOOL: return drgValIsBool(value);
+        default:            return drgValIsString(value);
+    }
+}
+
+bool drgMapSet(drgMap* map, drgVal key, drgVal value) {
+    if(map->keyType == DRG_TYPE_REAL) {
+        key = drgValFromReal(drgValAsNumber(key));
+    }
+    else if(map->keyType == DRG_TYPE_STRING) {
+        key = drgValFromObj(drgValToString(key));
+    }
+    if(map->valueType == DRG_TYPE_REAL) {
+        value = drgValFromReal(drgValAsNumber(value));
+    }
+    drgVal* found = drgMapGet(map, key);
+    if(NULL != found) {
+        *found = value;
+        return true;
+    }
+    if(map->count == DRG_MAP_MAX) {
+        return false;
+    }
+    if((int64_t)(map->count + 1) * 8 > (int64_t)map->capacity * 7) {
+        drgMapRehash(map, drgMapCapacityFor(map->count + 1));
+    }
+    if(map->entryCount == map->entryCapacity) {
+        // Squeezing the removed entries out is cheaper than growing
+        // if there are enough of them
+        if(map->entryCount - map->count >= map->entryCount / 4 && map->entryCount > map->count) {
+            drgMapRehash(map, map->capacity);
+        }
+        else {
+            drgMapReserveEntries(map, DRG_MEM_GROW_CAPACITY(map->entryCapacity));
+        }
+    }
+    uint32_t entry = (uint32_t)map->entryCount++;
+    map->entries[entry].key = key;
+    map->entries[entry].value = value;
+    drgMapPlace(map, drgMapHash(map, key), entry);
+    map->count++;
+    return true;
+}
+
+bool drgMapRemove(drgMap* map, drgVal key) {
+    long found = drgMapSlot(map, key);
+    if(found < 0) {
+        return false;
+    }
+    drgMapEntry* entry = &map->entries[map->slots[found]];
+    entry->key = drgValNone();
+    entry->value = drgValNone();
+    map->count--;
+    while(map->entryCount > 0 && drgValIsNone(map->entries[map->entryCount - 1].key)) {
+        map->entryCount--;
+    }
+
+    // Every full slot after the hole, up to an empty one, moves
+    // back into it unless that would put it before its home slot
+    size_t mask = (size_t)map->capacity - 1;
+    size_t hole = (size_t)found;
+    for(size_t next = (hole + 1) & mask; map->ctrl[next] != DRG_MAP_EMPTY; next = (next + 1) & mask) {
+        uint64_t hash = drgMapHash(map, map->entries[map->slots[next]].key);
+        size_t home = (size_t)(hash >> 7) & mask;
+        if(((next - home) & mask) < ((next - hole) & mask)) {
+            continue; // home is after the hole
+        }
+        drgMapSetCtrl(map, hole, map->ctrl[next]);
+        map->slots[hole] = map->slots[next];
+        hole = next;
+    }
+    drgMapSetCtrl(map, hole, DRG_MAP_EMPTY);
+    return true;
+}
+
+/*****************************************************************
+* Everything Else
+*****************************************************************/
+
+drgArray* drgMapKeys(const drgMap* map) {
+    // Array kinds are in the order of the element types
+    drgArray* keys = drgNewArray((drgArrayKind)map->keyType, true, map->count);
+    for(int i = 0; i < map->entryCount; i++) {
+        if(!drgValIsNone(map->entries[i].key)) {
+            drgArrayAdd(keys, map->entries[i].key);
+        }
+    }
+    return keys;
+}
+
+void drgPrintMap(const drgMap* map) {
+    printf("[");
+    bool first = true;
+    for(int i = 0; i < map->entryCount; i++) {
+        const drgMapEntry* entry = &map->entries[i];
+        if(drgValIsNone(entry->key)) continue;
+        if(!first) {
+            printf(",");
+        }
+        first = false;
+        drgPrintVal(entry->key);
+        printf(":");
+        drgPrintVal(entry->value);
+    }
+    printf("]");
+}
+
+void drgMapFreeAll(void) {
+    while(NULL != maps) {
+        drgMap* map = maps;
+        maps = map->next;
+        drgMemReallocate(DRG_MEM_CAT_MAPS, map->slots, drgMapTableBytes(map->capacity), 0);
+        DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_MAPS, drgMapEntry, map->entries, map->entryCapacity);
+        DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_MAPS, drgMap, map, 1);
+    }
+}
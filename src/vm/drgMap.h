@@ -0,0 +1,146 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgMap.h
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Maps, e.g. [string:int]. The entries are kept back to back in
+* the order they were added, and found through a table of slots
+* with a control byte each: the low 7 bits of the key's hash if
+* the slot is full, DRG_MAP_EMPTY if not. A lookup compares the
+* control bytes of 16 slots at a time (with SSE2 on x86-64) and
+* only looks at the keys whose 7 bits match, so most misses never
+* touch an entry at all.
+*
+* Probing is linear, one slot at a time, which lets a removal
+* shift the slots after it back instead of leaving a tombstone:
+* the table never fills up with dead slots, and never needs
+* rebuilding because of them. The control bytes of the first
+* slots are mirrored past the end, so the 16 starting at any slot
+* can be loaded at once.
+*
+* Keys are ints, reals or strings, each with its own lookup.
+* Strings are interned, so theirs compares pointers and reuses the
+* hash every string already has.
+*
+* Like arrays, maps live until the VM is freed, with
+* drgMapFreeAll().
+*
+*****************************************************************/
+
+#ifndef DRG_H_MAP
+#define DRG_H_MAP
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "drgArray.h"
+#include "drgObject.h"
+#include "drgValue.h"
+
+/// @brief Slots whose control bytes are compared at once.
+#define DRG_MAP_GROUP 16
+
+/// @brief Control byte of an empty slot. Full ones have the high
+/// bit clear.
+#define DRG_MAP_EMPTY 0x80
+
+/// @brief Most entries a map can hold.
+#define DRG_MAP_MAX (1 << 28)
+
+/// @brief A key and its value, or a removed one with a key of
+/// none.
+typedef struct {
+    drgVal key;
+    drgVal value;
+} drgMapEntry;
+
+/// @brief A map object.
+typedef struct drgMap {
+    drgObj obj;
+    drgType keyType;    // DRG_TYPE_INT, DRG_TYPE_REAL or DRG_TYPE_STRING
+    drgType valueType;  // DRG_TYPE_INT through DRG_TYPE_STRING
+    int count;          // entries, not counting removed ones
+    int capacity;       // slots, a power of two (0 until needed)
+    uint32_t* slots;    // the entry in each full slot
+    uint8_t* ctrl;      // a control byte per slot, then the mirror
+    drgMapEntry* entries; // in the order they were added
+    int entryCount;     // counting removed ones
+    int entryCapacity;
+    struct drgMap* next; // every map, for drgMapFreeAll()
+} drgMap;
+
+/// @brief Allocates an empty map.
+/// @param keyType
+/// @param valueType
+/// @param capacity Entries to make room for.
+/// @return Valid until drgMapFreeAll().
+drgMap* drgNewMap(drgType keyType, drgType valueType, int capacity);
+
+/// @brief Makes room for 'count' entries, so adding that many
+/// never grows the map.
+/// @param map
+/// @param count At most DRG_MAP_MAX.
+void drgMapReserve(drgMap* map, int count);
+
+/// @brief Whether a key can be looked up in a map, an int in a
+/// real keyed one counting as its real.
+/// @param map
+/// @param key
+/// @return
+bool drgMapKeyFits(const drgMap* map, drgVal key);
+
+/// @brief Whether a value can be stored in a map.
+/// @param map
+/// @param value
+/// @return
+bool drgMapValueFits(const drgMap* map, drgVal value);
+
+/// @brief Lookups, one per type of key.
+/// @param map Keyed by that type.
+/// @param key
+/// @return Where the key's value is, or NULL if it isn't there.
+/// Valid until the map is next changed.
+drgVal* drgMapGetInt(const drgMap* map, int64_t key);
+drgVal* drgMapGetReal(const drgMap* map, double key);
+drgVal* drgMapGetString(const drgMap* map, const drgString* key);
+
+/// @brief Looks up a key of any type.
+/// @param map
+/// @param key Must fit the map.
+/// @return As drgMapGetInt().
+drgVal* drgMapGet(const drgMap* map, drgVal key);
+
+/// @brief Adds a key, or changes its value if it's already there.
+/// @param map
+/// @param key Must fit the map.
+/// @param value Must fit the map.
+/// @return False if the key is new and the map already holds
+/// DRG_MAP_MAX entries.
+bool drgMapSet(drgMap* map, drgVal key, drgVal value);
+
+/// @brief Removes a key, the entries after it keeping their order.
+/// @param map
+/// @param key Must fit the map.
+/// @return False if it wasn't there.
+bool drgMapRemove(drgMap* map, drgVal key);
+
+/// @brief The keys, in the order they were added.
+/// @param map
+/// @return A new [*] array.
+drgArray* drgMapKeys(const drgMap* map);
+
+/// @brief Prints a map as [k:v,k:v].
+/// @param map
+void drgPrintMap(const drgMap* map);
+
+/// @brief Frees every map there is.
+void drgMapFreeAll(void);
+
+static inline drgMap* drgValAsMap(drgVal v) {
+    return (drgMap*)drgValAsObj(v);
+}
+
+#endif // DRG_H_MAP
@@ -0,0 +1,351 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgModule.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Dargon modules (.dgm files).
+*
+* Layout, every section 8-byte aligned, offsets from the start:
+*   drgModuleHeader
+*   drgModuleExport[exportCount]      sorted by name
+*   drgModuleFunction[functionCount]  in global slot order
+*   drgCacheConstant[constantCount]   shared by every function
+*   then bytecode, line tables, each function's uint32 indices
+*   into the shared constants, and names and string chars
+* Numbers are in the writer's byte order, as with .dgc files.
+*
+*****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "drgModule.h"
+#include "drgCache.h"
+#include "drgIntern.h"
+#include "../util/drgMemUtil.h"
+
+#define DRG_MODULE_ORDER 0x01020304u
+
+#if defined(_WIN32) || defined(_WIN64)
+#define DRG_MODULE_PATH_SEPARATOR ';'
+#else
+#define DRG_MODULE_PATH_SEPARATOR ':'
+#endif
+
+typedef struct {
+    char magic[4];          // "DGM\0"
+    uint32_t order;         // DRG_MODULE_ORDER
+    uint64_t build;         // drgCacheBuild()
+    uint32_t name;          // offset and length of the module name
+    uint32_t nameLength;
+    uint32_t functionCount;
+    uint32_t exportCount;
+    uint32_t exports;       // offsets of the sections
+    uint32_t functions;
+    uint32_t constants;
+    uint32_t constantCount;
+} drgModuleHeader;
+
+typedef struct {
+    uint32_t name;
+    uint32_t nameLength;
+    uint32_t function;      // index into the function records
+    uint32_t pad;
+} drgModuleExport;
+
+typedef struct {
+    uint32_t code;          // offset and length of the bytecode
+    uint32_t codeLength;
+    uint32_t lines;         // ...of the line table
+    uint32_t linesLength;
+    uint32_t constants;     // ...of its constant indices
+    uint32_t constantCount;
+    uint32_t name;
+    uint32_t nameLength;
+    int32_t arity;
+    int32_t maxStack;
+} drgModuleFunction;
+
+static const char* searchPath = NULL;
+static drgModule* loaded = NULL; // newest first
+
+void drgModuleSetPath(const char* path) {
+    searchPath = path;
+}
+
+static const drgModuleHeader* drgModuleGetHeader(const drgModule* module) {
+    return (const drgModuleHeader*)module->file.data;
+}
+
+/*****************************************************************
+* Loading
+*****************************************************************/
+
+// Orders names as the export index is sorted.
+static int drgModuleCompare(const char* a, int aLength, const char* b, int bLength) {
+    int shorter = (aLength < bLength) ? aLength : bLength;
+    int order = memcmp(a, b, (size_t)shorter);
+    return (0 != order) ? order : aLength - bLength;
+}
+
+// Checks everything that the stubs are made from; a function's
+// own sections are only checked when it's faulted in.
+static bool drgModuleValidate(const D_SourceBuffer* file, const char* name, int length) {
+    const drgModuleHeader* header = (const drgModuleHeader*)file->data;
+    if(file->length < sizeof(drgModuleHeader) ||
+        0 != memcmp(header->magic, "DGM", 4) ||
+        header->order != DRG_MODULE_ORDER ||
+        header->build != drgCacheBuild() ||
+        !drgCacheInside(file, header->name, header->nameLength) ||
+        0 != drgModuleCompare(file->data + header->name, (int)header->nameLength, name, length) ||
+        header->exports % 8 != 0 || header->functions % 8 != 0 || header->constants % 8 != 0 ||
+        !drgCacheInside(file, header->exports, sizeof(drgModuleExport) * (uint64_t)header->exportCount) ||
+        !drgCacheInside(file, header->functions, sizeof(drgModuleFunction) * (uint64_t)header->functionCount) ||
+        !drgCacheInside(file, header->constants, sizeof(drgCacheConstant) * (uint64_t)header->constantCount)) {
+        return false;
+    }
+    const drgModuleExport* exports = (const drgModuleExport*)(file->data + header->exports);
+    for(uint32_t i = 0; i < header->exportCount; i++) {
+        if(exports[i].function >= header->functionCount ||
+            !drgCacheInside(file, exports[i].name, exports[i].nameLength)) {
+            return false;
+        }
+    }
+    const drgModuleFunction* functions = (const drgModuleFunction*)(file->data + header->functions);
+    for(uint32_t i = 0; i < header->functionCount; i++) {
+        if(!drgCacheInside(file, functions[i].name, functions[i].nameLength) ||
+            functions[i].arity < 0 || functions[i].maxStack < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static drgModule* drgModuleOpen(const char* path, const char* name, int length) {
+    D_SourceBuffer file;
+    if(!D_SourceOpen(path, &file)) {
+        return NULL;
+    }
+    if(!drgModuleValidate(&file, name, length)) {
+        D_SourceClose(&file);
+        return NULL;
+    }
+    drgModule* module = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_BYTECODE, drgModule, NULL, 0, 1);
+    module->file = file;
+    module->name = drgIntern(name, length);
+    module->functionCount = 0;
+    module->functions = NULL;
+    module->globals = NULL;
+    module->next = loaded;
+    loaded = module;
+
+    // Just the stubs: a name and an arity each
+    const drgModuleHeader* header = drgModuleGetHeader(module);
+    const drgModuleFunction* records = (const drgModuleFunction*)(file.data + header->functions);
+    int count = (int)header->functionCount;
+    module->functions = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_BYTECODE, drgFunction, NULL, 0, count);
+    module->globals = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_BYTECODE, drgVal, NULL, 0, count);
+    for(int i = 0; i < count; i++) {
+        drgFunction* function = &module->functions[i];
+        function->obj.type = DRG_OBJ_FUNCTION;
+        function->arity = records[i].arity;
+        drgNuggetInit(&function->nugget);
+        function->name = drgIntern(file.data + records[i].name, (int)records[i].nameLength);
+        function->module = module;
+        module->globals[i] = drgValFromObj(function);
+        module->functionCount++;
+    }
+    return module;
+}
+
+drgModule* drgModuleInclude(const char* name, int length) {
+    for(drgModule* module = loaded; module != NULL; module = module->next) {
+        if(module->name->length == length && 0 == memcmp(module->name->chars, name, (size_t)length)) {
+            return module;
+        }
+    }
+    const char* directory = (NULL == searchPath) ? "" : searchPath;
+    for(;;) {
+        const char* end = strchr(directory, DRG_MODULE_PATH_SEPARATOR);
+        int directoryLength = (NULL == end) ? (int)strlen(directory) : (int)(end - directory);
+        char path[4096];
+        int written = (0 == directoryLength)
+            ? snprintf(path, sizeof(path), "%.*s.dgm", length, name)
+            : snprintf(path, sizeof(path), "%.*s/%.*s.dgm", directoryLength, directory, length, name);
+        if(written > 0 && (size_t)written < sizeof(path)) {
+            drgModule* module = drgModuleOpen(path, name, length);
+            if(NULL != module) {
+                return module;
+            }
+        }
+        if(NULL == end) {
+            return NULL;
+        }
+        directory = end + 1;
+    }
+}
+
+drgFunction* drgModuleFind(const drgModule* module, const char* name, int length) {
+    const drgModuleHeader* header = drgModuleGetHeader(module);
+    const drgModuleExport* exports = (const drgModuleExport*)(module->file.data + header->exports);
+    int low = 0;
+    int high = (int)header->exportCount - 1;
+    while(low <= high) {
+        int middle = low + (high - low) / 2;
+        const drgModuleExport* entry = &exports[middle];
+        int order = drgModuleCompare(module->file.data + entry->name, (int)entry->nameLength, name, length);
+        if(order == 0) {
+            return &module->functions[entry->function];
+        }
+        if(order < 0) {
+            low = middle + 1;
+        }
+        else {
+            high = middle - 1;
+        }
+    }
+    return NULL;
+}
+
+bool drgModuleFault(drgFunction* function) {
+    const drgModule* module = function->module;
+    const D_SourceBuffer* file = &module->file;
+    const drgModuleHeader* header = drgModuleGetHeader(module);
+    const drgModuleFunction* record = (const drgModuleFunction*)(file->data + header->functions) +
+        (function - module->functions);
+    if(!drgCacheInside(file, record->code, record->codeLength) || 0 == record->codeLength ||
+        !drgCacheInside(file, record->lines, record->linesLength) ||
+        !drgCacheInside(file, record->constants, sizeof(uint32_t) * (uint64_t)record->constantCount) ||
+        record->constants % 4 != 0) {
+        return false;
+    }
+
+    // Anything left by a fault that ran out of memory goes first
+    drgNugget* nugget = &function->nugget;
+    drgNuggetFree(nugget);
+    const drgCacheConstant* shared = (const drgCacheConstant*)(file->data + header->constants);
+    const uint32_t* indices = (const uint32_t*)(file->data + record->constants);
+    for(uint32_t i = 0; i < record->constantCount; i++) {
+        drgVal value;
+        if(indices[i] >= header->constantCount || !drgCacheDecode(file, &shared[indices[i]], &value)) {
+            drgNuggetFree(nugget);
+            return false;
+        }
+        drgValArrayAdd(&nugget->constantPool, value);
+    }
+    // Borrowed from the mapping, see drgNuggetFree(). Setting the
+    // bytecode last marks the function as loaded.
+    nugget->lines.data = (drgByte*)(file->data + record->lines);
+    nugget->lines.count = (int)record->linesLength;
+    nugget->maxStack = record->maxStack;
+    nugget->count = (int)record->codeLength;
+    nugget->bytecode = (drgByte*)(file->data + record->code);
+    return true;
+}
+
+void drgModuleFreeAll(void) {
+    while(NULL != loaded) {
+        drgModule* module = loaded;
+        loaded = module->next;
+        for(int i = 0; i < module->functionCount; i++) {
+            drgNuggetFree(&module->functions[i].nugget);
+        }
+        DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_BYTECODE, drgFunction, module->functions, module->functionCount);
+        DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_BYTECODE, drgVal, module->globals, module->functionCount);
+        D_SourceClose(&module->file);
+        DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_BYTECODE, drgModule, module, 1);
+    }
+}
+
+/*****************************************************************
+* Writing
+*****************************************************************/
+
+// For qsort(), which has no context argument.
+static const drgCacheBuffer* sortBuffer;
+
+static int drgModuleCompareExports(const void* a, const void* b) {
+    const drgModuleExport* x = (const drgModuleExport*)a;
+    const drgModuleExport* y = (const drgModuleExport*)b;
+    const char* chars = (const char*)sortBuffer->data;
+    return drgModuleCompare(chars + x->name, (int)x->nameLength, chars + y->name, (int)y->nameLength);
+}
+
+bool drgModuleWrite(const char* path, const drgString* name, drgFunction* const* functions,
+    const bool* exported, int count) {
+    drgCacheBuffer buffer = { 0 };
+    drgModuleHeader header = { { 'D', 'G', 'M', '\0' }, DRG_MODULE_ORDER, drgCacheBuild(),
+        0, (uint32_t)name->length, (uint32_t)count, 0, 0, 0, 0, 0 };
+    for(int i = 0; i < count; i++) {
+        header.exportCount += exported[i] ? 1 : 0;
+    }
+    drgCacheAppend(&buffer, NULL, sizeof(header));
+    header.exports = (uint32_t)drgCacheAppend(&buffer, NULL, sizeof(drgModuleExport) * header.exportCount);
+    header.functions = (uint32_t)drgCacheAppend(&buffer, NULL, sizeof(drgModuleFunction) * (size_t)count);
+    header.name = (uint32_t)drgCacheAppend(&buffer, name->chars, (size_t)name->length);
+
+    // Identical constants are stored once for the whole module; a
+    // scratch nugget's constant pool does the deduplicating.
+    drgNugget shared;
+    drgNuggetInit(&shared);
+    bool ok = true;
+    int exportCount = 0;
+    for(int i = 0; i < count && ok; i++) {
+        const drgFunction* function = functions[i];
+        const drgNugget* nugget = &function->nugget;
+        drgModuleFunction record = { 0 };
+        record.codeLength = (uint32_t)nugget->count;
+        record.code = (uint32_t)drgCacheAppend(&buffer, nugget->bytecode, (size_t)nugget->count);
+        record.linesLength = (uint32_t)nugget->lines.count;
+        record.lines = (uint32_t)drgCacheAppend(&buffer, nugget->lines.data, (size_t)nugget->lines.count);
+        record.nameLength = (uint32_t)function->name->length;
+        record.name = (uint32_t)drgCacheAppend(&buffer, function->name->chars, (size_t)function->name->length);
+        record.arity = function->arity;
+        record.maxStack = nugget->maxStack;
+
+        record.constantCount = (uint32_t)nugget->constantPool.count;
+        record.constants = (uint32_t)drgCacheAppend(&buffer, NULL, sizeof(uint32_t) * record.constantCount);
+        for(int k = 0; k < nugget->constantPool.count; k++) {
+            drgVal value = nugget->constantPool.values[k];
+            // Module code only reaches functions through its globals
+            if(drgValIsObjType(value, DRG_OBJ_FUNCTION)) {
+                ok = false;
+                break;
+            }
+            uint32_t index = (uint32_t)drgNuggetAddLiteral(&shared, value);
+            memcpy(buffer.data + record.constants + sizeof(uint32_t) * (size_t)k, &index, sizeof(index));
+        }
+        memcpy(buffer.data + header.functions + sizeof(record) * (size_t)i, &record, sizeof(record));
+
+        if(exported[i]) {
+            drgModuleExport entry = { record.name, record.nameLength, (uint32_t)i, 0 };
+            memcpy(buffer.data + header.exports + sizeof(entry) * (size_t)exportCount++, &entry, sizeof(entry));
+        }
+    }
+
+    if(ok) {
+        // Strings first, the constant array can't move once placed
+        header.constantCount = (uint32_t)shared.constantPool.count;
+        drgCacheConstant* constants = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_GENERAL, drgCacheConstant,
+            NULL, 0, shared.constantPool.count);
+        for(int i = 0; i < shared.constantPool.count; i++) {
+            drgCacheEncode(&buffer, shared.constantPool.values[i], &constants[i]);
+        }
+        header.constants = (uint32_t)drgCacheAppend(&buffer, constants,
+            sizeof(drgCacheConstant) * (size_t)shared.constantPool.count);
+        DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_GENERAL, drgCacheConstant, constants, shared.constantPool.count);
+
+        sortBuffer = &buffer;
+        qsort(buffer.data + header.exports, header.exportCount, sizeof(drgModuleExport), drgModuleCompareExports);
+        sortBuffer = NULL;
+        memcpy(buffer.data, &header, sizeof(header));
+        ok = drgCacheSave(path, &buffer);
+    }
+    drgNuggetFree(&shared);
+    drgCacheBufferFree(&buffer);
+    return ok;
+}
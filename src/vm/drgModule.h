@@ -0,0 +1,79 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgModule.h
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Dargon modules (.dgm files), as written by 'dargon export' and
+* read by 'include'. A module is mapped rather than read, and
+* nothing in it is loaded up front but a sorted index of what it
+* exports and a stub per function: a function's bytecode and line
+* table are used where they lie in the mapping, and its constants
+* are only decoded the first time it's called. A program that uses
+* two functions of a large module pays for those two, and the
+* pages are shared between every process that maps the file.
+*
+*****************************************************************/
+
+#ifndef DRG_H_MODULE
+#define DRG_H_MODULE
+
+#include <stdbool.h>
+
+#include "drgObject.h"
+#include "../util/File.h"
+
+/// @brief A loaded module. Loaded modules live until
+/// drgModuleFreeAll(), so their functions can be used as
+/// constants anywhere.
+typedef struct drgModule {
+    D_SourceBuffer file;
+    drgString* name;        // e.g. "math.graph"
+    int functionCount;
+    drgFunction* functions; // in declaration order; a function's
+                            // bytecode is NULL until first called
+    drgVal* globals;        // what the module's own code sees as its
+                            // globals: the same functions
+    struct drgModule* next; // the module loaded before it
+} drgModule;
+
+/// @brief Sets where drgModuleInclude() looks for .dgm files.
+/// @param path Directories separated by ':' (';' on Windows),
+/// must outlive its use. NULL or "" is the working directory.
+void drgModuleSetPath(const char* path);
+
+/// @brief Loads a module by name, or finds it if it's loaded.
+/// @param name e.g. "math.graph", found as "math.graph.dgm".
+/// @param length
+/// @return NULL if there's no usable file for it.
+drgModule* drgModuleInclude(const char* name, int length);
+
+/// @brief Looks up an exported function.
+/// @param module
+/// @param name
+/// @param length
+/// @return NULL if the module exports no such function.
+drgFunction* drgModuleFind(const drgModule* module, const char* name, int length);
+
+/// @brief Loads a module function's code on its first call.
+/// @param function One of module->functions.
+/// @return False if the file is damaged.
+bool drgModuleFault(drgFunction* function);
+
+/// @brief Writes a module.
+/// @param path
+/// @param name The module's name.
+/// @param functions Its functions, in the order their globals were
+/// declared.
+/// @param exported Which of them are exported.
+/// @param count
+/// @return False if it couldn't be written.
+bool drgModuleWrite(const char* path, const drgString* name, drgFunction* const* functions,
+    const bool* exported, int count);
+
+/// @brief Unloads every module, and frees their functions.
+void drgModuleFreeAll(void);
+
+#endif // DRG_H_MODULE
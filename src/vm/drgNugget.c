@@ -10,33 +10,391 @@
 *
 *****************************************************************/
 
-/* #include "drgNugget.h"
-#include "drgMemUtil.h"
+#include <string.h>
+
+#include "drgNugget.h"
+#include "drgObject.h"
+#include "../util/drgMemUtil.h"
 
 void drgNuggetInit(drgNugget* nugget) {
     nugget->count = 0;
     nugget->capacity = 0;
     nugget->bytecode = NULL;
     drgValArrayInit(&nugget->constantPool);
+    nugget->literalIndex = NULL;
+    nugget->literalIndexCapacity = 0;
+    nugget->lines.count = 0;
+    nugget->lines.capacity = 0;
+    nugget->lines.data = NULL;
+    nugget->lines.offset = 0;
+    nugget->lines.line = 0;
+    nugget->lines.column = 0;
+    nugget->registers = 0;
+    nugget->maxStack = 0;
 }
 
 void drgNuggetAdd(drgNugget* nugget, drgByte byte) {
     if(nugget->capacity < nugget->count + 1) {
-        int prevCapacity = nugget->capacity;
-        nugget->capacity = DRG_MEM_GROW_CAPACITY(prevCapacity);
-        nugget->bytecode = DRG_MEM_GROW_ARRAY(drgByte, nugget->bytecode, prevCapacity, nugget->capacity);
+        // The capacity is only updated once the memory is there
+        int capacity = DRG_MEM_GROW_CAPACITY(nugget->capacity);
+        nugget->bytecode = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_BYTECODE, drgByte, nugget->bytecode, nugget->capacity, capacity);
+        nugget->capacity = capacity;
     }
     nugget->bytecode[nugget->count] = byte;
     nugget->count++;
 }
 
+static inline int drgLiteralHash(drgVal constant, int mask) {
+    // Fibonacci hashing, the high bits are the best mixed
+    return (int)((drgValBits(constant) * UINT64_C(0x9E3779B97F4A7C15)) >> 32) & mask;
+}
+
+// Puts constant 'index' into the index, which has room.
+static void drgLiteralIndexInsert(drgNugget* nugget, int index) {
+    int mask = nugget->literalIndexCapacity - 1;
+    int i = drgLiteralHash(nugget->constantPool.values[index], mask);
+    while(nugget->literalIndex[i] >= 0) {
+        i = (i + 1) & mask;
+    }
+    nugget->literalIndex[i] = index;
+}
+
 int drgNuggetAddLiteral(drgNugget* nugget, drgVal constant) {
+    drgValArray* pool = &nugget->constantPool;
+    if(nugget->literalIndexCapacity > 0) {
+        int mask = nugget->literalIndexCapacity - 1;
+        uint64_t bits = drgValBits(constant);
+        for(int i = drgLiteralHash(constant, mask); nugget->literalIndex[i] >= 0; i = (i + 1) & mask) {
+            int index = nugget->literalIndex[i];
+            if(drgValBits(pool->values[index]) == bits) {
+                return index;
+            }
+        }
+    }
+    int index = drgNuggetAppendLiteral(nugget, constant);
+
+    // Keep the index at most half full
+    if(nugget->literalIndexCapacity < pool->count * 2) {
+        int capacity = (nugget->literalIndexCapacity < 16) ? 16 : nugget->literalIndexCapacity * 2;
+        nugget->literalIndex = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_CONSTANTS, int, nugget->literalIndex,
+            nugget->literalIndexCapacity, capacity);
+        nugget->literalIndexCapacity = capacity;
+        memset(nugget->literalIndex, -1, sizeof(int) * (size_t)capacity);
+        for(int i = 0; i < pool->count; i++) {
+            drgLiteralIndexInsert(nugget, i);
+        }
+    }
+    else {
+        drgLiteralIndexInsert(nugget, index);
+    }
+    return index;
+}
+
+int drgNuggetAppendLiteral(drgNugget* nugget, drgVal constant) {
     drgValArrayAdd(&nugget->constantPool, constant);
     return nugget->constantPool.count - 1;
 }
 
+/*
+* Line table entries, from the most common:
+*   0ccccc oo             same line, column +-ccccc, offset +oo
+*   10ll oooo [column]    line +ll+1, offset +oooo, a new column
+*   11000000 [offset] [line] [column]   anything else
+* Offsets are deltas from the entry before, and so are lines and
+* short columns. A delta that can go either way is zigzag encoded
+* (0, -1, 1, -2, ...): the line can step back to an operator whose
+* right operand was on the next one. Numbers in [brackets] are
+* varints, 7 bits a byte, low bits first, the top bit set on all
+* but the last.
+*/
+#define DRG_LINES_NEXT_LINE 0x80
+#define DRG_LINES_LONG 0xC0
+
+static inline unsigned drgZigzag(int value) {
+    return (value < 0) ? ((unsigned)-value << 1) - 1 : (unsigned)value << 1;
+}
+
+static inline int drgUnzigzag(unsigned value) {
+    return (value & 1) ? -(int)((value + 1) >> 1) : (int)(value >> 1);
+}
+
+static void drgLineTableAdd(drgLineTable* lines, drgByte byte) {
+    if(lines->capacity < lines->count + 1) {
+        int capacity = DRG_MEM_GROW_CAPACITY(lines->capacity);
+        lines->data = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_BYTECODE, drgByte, lines->data, lines->capacity, capacity);
+        lines->capacity = capacity;
+    }
+    lines->data[lines->count++] = byte;
+}
+
+static void drgLineTableAddVarint(drgLineTable* lines, unsigned value) {
+    while(value >= 0x80) {
+        drgLineTableAdd(lines, (drgByte)(0x80 | (value & 0x7F)));
+        value >>= 7;
+    }
+    drgLineTableAdd(lines, (drgByte)value);
+}
+
+static unsigned drgLineTableReadVarint(const drgByte** at) {
+    unsigned value = 0;
+    for(int shift = 0;; shift += 7) {
+        drgByte byte = *(*at)++;
+        value |= (unsigned)(byte & 0x7F) << shift;
+        if(!(byte & 0x80)) {
+            return value;
+        }
+    }
+}
+
+void drgLineTableMark(drgLineTable* lines, int offset, int line, int column) {
+    if(lines->count > 0 && line == lines->line && column == lines->column) {
+        return;
+    }
+    int offsetDelta = offset - lines->offset;
+    int lineDelta = line - lines->line;
+    unsigned columnDelta = drgZigzag(column - lines->column);
+    if(lines->count > 0 && 0 == lineDelta && offsetDelta < 4 && columnDelta < 32) {
+        drgLineTableAdd(lines, (drgByte)((columnDelta << 2) | (unsigned)offsetDelta));
+    }
+    else if(lines->count > 0 && lineDelta >= 1 && lineDelta <= 4 && offsetDelta < 16) {
+        drgLineTableAdd(lines, (drgByte)(DRG_LINES_NEXT_LINE | ((lineDelta - 1) << 4) | offsetDelta));
+        drgLineTableAddVarint(lines, (unsigned)column);
+    }
+    else {
+        drgLineTableAdd(lines, DRG_LINES_LONG);
+        drgLineTableAddVarint(lines, (unsigned)offsetDelta);
+        drgLineTableAddVarint(lines, drgZigzag(lineDelta));
+        drgLineTableAddVarint(lines, (unsigned)column);
+    }
+    lines->offset = offset;
+    lines->line = line;
+    lines->column = column;
+}
+
+void drgNuggetAddPosition(drgNugget* nugget, int line, int column) {
+    drgLineTableMark(&nugget->lines, nugget->count, line, column);
+}
+
+// Decodes one entry, adding its deltas to the position so far.
+static void drgLineTableNext(const drgByte** at, int* offset, int* line, int* column) {
+    drgByte byte = *(*at)++;
+    if(byte == DRG_LINES_LONG) {
+        *offset += (int)drgLineTableReadVarint(at);
+        *line += drgUnzigzag(drgLineTableReadVarint(at));
+        *column = (int)drgLineTableReadVarint(at);
+    }
+    else if(byte & DRG_LINES_NEXT_LINE) {
+        *offset += byte & 0x0F;
+        *line += ((byte >> 4) & 0x03) + 1;
+        *column = (int)drgLineTableReadVarint(at);
+    }
+    else {
+        *offset += byte & 0x03;
+        *column += drgUnzigzag(byte >> 2);
+    }
+}
+
+void drgNuggetGetPositions(const drgNugget* nugget, int* line, int* column) {
+    const drgByte* at = nugget->lines.data;
+    const drgByte* end = nugget->lines.data + nugget->lines.count;
+    // 'next' is the first entry past the byte being filled in
+    int nextOffset = 0;
+    int nextLine = 0;
+    int nextColumn = 0;
+    bool hasNext = at < end;
+    if(hasNext) {
+        drgLineTableNext(&at, &nextOffset, &nextLine, &nextColumn);
+    }
+    int entryLine = 0;
+    int entryColumn = 0;
+    for(int offset = 0; offset < nugget->count; offset++) {
+        while(hasNext && nextOffset <= offset) {
+            entryLine = nextLine;
+            entryColumn = nextColumn;
+            hasNext = at < end;
+            if(hasNext) {
+                drgLineTableNext(&at, &nextOffset, &nextLine, &nextColumn);
+            }
+        }
+        line[offset] = entryLine;
+        column[offset] = entryColumn;
+    }
+}
+
+bool drgNuggetGetPosition(const drgNugget* nugget, int offset, int* line, int* column) {
+    const drgLineTable* lines = &nugget->lines;
+    if(0 == lines->count) {
+        return false;
+    }
+    const drgByte* at = lines->data;
+    const drgByte* end = lines->data + lines->count;
+    int entryOffset = 0;
+    int entryLine = 0;
+    int entryColumn = 0;
+    *line = 0;
+    *column = 0;
+    while(at < end) {
+        drgLineTableNext(&at, &entryOffset, &entryLine, &entryColumn);
+        // The last entry at or before 'offset' covers it
+        if(entryOffset > offset) {
+            break;
+        }
+        *line = entryLine;
+        *column = entryColumn;
+    }
+    return true;
+}
+
 void drgNuggetFree(drgNugget* nugget) {
-    DRG_MEM_FREE_ARRAY(drgByte, nugget->bytecode, nugget->capacity);
+    // No capacity means the bytes are borrowed (see drgCache.h)
+    if(nugget->capacity > 0) {
+        DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_BYTECODE, drgByte, nugget->bytecode, nugget->capacity);
+    }
+    for(int i = 0; i < nugget->constantPool.count; i++) {
+        drgVal constant = nugget->constantPool.values[i];
+        // Strings belong to the intern table, and functions from a
+        // .dgm to their module
+        if(drgValIsObjType(constant, DRG_OBJ_FUNCTION) && NULL != drgValAsFunction(constant)->module) {
+            continue;
+        }
+        if(drgValIsObj(constant) && !drgValIsObjType(constant, DRG_OBJ_STRING)) {
+            drgFreeObject((drgObj*)drgValAsObj(constant));
+        }
+    }
     drgValArrayFree(&nugget->constantPool);
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_CONSTANTS, int, nugget->literalIndex, nugget->literalIndexCapacity);
+    if(nugget->lines.capacity > 0) {
+        DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_BYTECODE, drgByte, nugget->lines.data, nugget->lines.capacity);
+    }
     drgNuggetInit(nugget);
-} */
\ No newline at end of file
+}
+
+int drgInstructionLength(drgByte op) {
+    switch(op) {
+        case DRG_OC_NUM_LIT:
+        case DRG_OC_GET_LOCAL:
+        case DRG_OC_SET_LOCAL:
+        case DRG_OC_CALL:
+        case DRG_OC_POP_LOCAL:
+        case DRG_OC_GET_LOCAL_ADD:
+        case DRG_OC_LIT_ADD:
+        case DRG_OC_LIT_SUB:
+        case DRG_OC_LIT_LT:
+        case DRG_OC_LIT_EQ:
+        case DRG_OC_CHECK_TYPE:
+        case DRG_OC_NEW_ARRAY:
+        case DRG_OC_GET_FIELD:
+        case DRG_OC_SET_FIELD:
+        case DRG_OC_GET_ROW_FIELD:
+        case DRG_OC_SET_ROW_FIELD:
+            return 2;
+        case DRG_OC_DEFINE_GLOBAL:
+        case DRG_OC_GET_GLOBAL:
+        case DRG_OC_SET_GLOBAL:
+        case DRG_OC_JUMP:
+        case DRG_OC_JUMP_IF_FALSE:
+        case DRG_OC_LOOP:
+        case DRG_OC_R_LOADTRUE:
+        case DRG_OC_R_LOADFALSE:
+        case DRG_OC_R_PRINT:
+        case DRG_OC_STRUCT:
+            return 3;
+        case DRG_OC_NUM_LIT_LONG:
+        case DRG_OC_R_LOADK:
+        case DRG_OC_ARRAY:
+        case DRG_OC_MAP:
+            return 4;
+        case DRG_OC_R_MOVE:
+        case DRG_OC_R_NEGATE:
+        case DRG_OC_R_NOT:
+        case DRG_OC_R_INT_TO_REAL:
+            return 5;
+        case DRG_OC_R_LOADK_LONG:
+            return 6;
+        case DRG_OC_R_ADD:
+        case DRG_OC_R_SUB:
+        case DRG_OC_R_MULT:
+        case DRG_OC_R_DIV:
+        case DRG_OC_R_EQ:
+        case DRG_OC_R_NEQ:
+        case DRG_OC_R_GT:
+        case DRG_OC_R_GTE:
+        case DRG_OC_R_LT:
+        case DRG_OC_R_LTE:
+            return 7;
+        default:
+            return 1;
+    }
+}
+
+int drgStackEffect(drgByte op, int operand) {
+    switch(op) {
+        case DRG_OC_NUM_LIT:
+        case DRG_OC_NUM_LIT_LONG:
+        case DRG_OC_TRUE:
+        case DRG_OC_FALSE:
+        case DRG_OC_NONE:
+        case DRG_OC_GET_GLOBAL:
+        case DRG_OC_GET_LOCAL:
+            return 1;
+        case DRG_OC_RETURN:
+        case DRG_OC_ADD:
+        case DRG_OC_SUB:
+        case DRG_OC_MULT:
+        case DRG_OC_DIV:
+        case DRG_OC_EQ:
+        case DRG_OC_NEQ:
+        case DRG_OC_GT:
+        case DRG_OC_GTE:
+        case DRG_OC_LT:
+        case DRG_OC_LTE:
+        case DRG_OC_ADD_INT: case DRG_OC_ADD_REAL: case DRG_OC_ADD_STRING:
+        case DRG_OC_SUB_INT: case DRG_OC_SUB_REAL:
+        case DRG_OC_MULT_INT: case DRG_OC_MULT_REAL:
+        case DRG_OC_DIV_INT: case DRG_OC_DIV_REAL:
+        case DRG_OC_EQ_INT: case DRG_OC_EQ_REAL: case DRG_OC_EQ_STRING:
+        case DRG_OC_NEQ_INT: case DRG_OC_NEQ_REAL: case DRG_OC_NEQ_STRING:
+        case DRG_OC_GT_INT: case DRG_OC_GT_REAL:
+        case DRG_OC_GTE_INT: case DRG_OC_GTE_REAL:
+        case DRG_OC_LT_INT: case DRG_OC_LT_REAL:
+        case DRG_OC_LTE_INT: case DRG_OC_LTE_REAL:
+        case DRG_OC_DEFINE_GLOBAL:
+        case DRG_OC_POP:
+        case DRG_OC_PRINT:
+        case DRG_OC_POP_LOCAL:
+        case DRG_OC_NEW_ARRAY:
+        case DRG_OC_GET_INDEX:
+        case DRG_OC_GET_INDEX_INT:
+        case DRG_OC_GET_INDEX_REAL:
+        case DRG_OC_GET_INDEX_BOOL:
+        case DRG_OC_ARRAY_ADD:
+        case DRG_OC_ARRAY_REM:
+        case DRG_OC_GET_MAP_INT:
+        case DRG_OC_GET_MAP_REAL:
+        case DRG_OC_GET_MAP_STRING:
+        case DRG_OC_MAP_HAS:
+        case DRG_OC_MAP_REM:
+        case DRG_OC_MAP_RESERVE:
+        case DRG_OC_SET_FIELD:
+        case DRG_OC_GET_ROW_FIELD:
+            return -1;
+        case DRG_OC_SET_INDEX:
+        case DRG_OC_SET_INDEX_INT:
+        case DRG_OC_SET_INDEX_REAL:
+        case DRG_OC_SET_INDEX_BOOL:
+        case DRG_OC_SET_MAP:
+        case DRG_OC_SET_ROW_FIELD:
+            return -2;
+        case DRG_OC_CALL:
+            // The arguments and the callee make way for the result
+            return -operand;
+        case DRG_OC_ARRAY:
+            return 1 - operand;
+        case DRG_OC_MAP:
+            return 1 - 2 * operand;
+        case DRG_OC_STRUCT:
+            return 1 - operand;
+        default:
+            return 0;
+    }
+}
@@ -13,9 +13,10 @@
 #ifndef DRG_H_NUGGET
 #define DRG_H_NUGGET
 
+#include <stdbool.h>
 #include <stdint.h>
 
-/* #include <drgValue.h>
+#include "drgValue.h"
 
 /// @brief Byte typedef.
 typedef uint8_t drgByte;
@@ -25,16 +26,180 @@ typedef uint8_t drgByte;
 typedef enum {
     DRG_OC_RETURN,
     // Literals
-    DRG_OC_NUM_LIT,
+    DRG_OC_NUM_LIT,     // [index] push constant
+    DRG_OC_NUM_LIT_LONG, // [index24] push constant
+    DRG_OC_TRUE,
+    DRG_OC_FALSE,
+    DRG_OC_NONE,
     // Unary operators
     DRG_OC_NEGATE,
+    DRG_OC_NOT,
     // Binary operators
     DRG_OC_ADD,
     DRG_OC_SUB,
     DRG_OC_MULT,
-    DRG_OC_DIV
+    DRG_OC_DIV,
+    DRG_OC_EQ,
+    DRG_OC_NEQ,
+    DRG_OC_GT,
+    DRG_OC_GTE,
+    DRG_OC_LT,
+    DRG_OC_LTE,
+    // Typed operators, for operands whose types the compiler knows,
+    // so the VM has nothing to check
+    DRG_OC_NEGATE_INT,
+    DRG_OC_NEGATE_REAL,
+    DRG_OC_ADD_INT,
+    DRG_OC_ADD_REAL,
+    DRG_OC_ADD_STRING,  // joins them, see drgRope.h
+    DRG_OC_SUB_INT,
+    DRG_OC_SUB_REAL,
+    DRG_OC_MULT_INT,
+    DRG_OC_MULT_REAL,
+    DRG_OC_DIV_INT,     // still checks for zero
+    DRG_OC_DIV_REAL,
+    DRG_OC_EQ_INT,
+    DRG_OC_EQ_REAL,
+    DRG_OC_EQ_STRING,
+    DRG_OC_NEQ_INT,
+    DRG_OC_NEQ_REAL,
+    DRG_OC_NEQ_STRING,
+    DRG_OC_GT_INT,
+    DRG_OC_GT_REAL,
+    DRG_OC_GTE_INT,
+    DRG_OC_GTE_REAL,
+    DRG_OC_LT_INT,
+    DRG_OC_LT_REAL,
+    DRG_OC_LTE_INT,
+    DRG_OC_LTE_REAL,
+    // Conversions
+    DRG_OC_INT_TO_REAL, // top int becomes a real
+    DRG_OC_INT_TO_REAL_UNDER, // the int below the top becomes a real
+    DRG_OC_CHECK_TYPE,  // [type8] top must be a drgType, an int
+                        // becoming a real if that's the type
+    // Variables
+    DRG_OC_DEFINE_GLOBAL, // [index16] pop into a new global
+    DRG_OC_GET_GLOBAL,  // [index16] push global
+    DRG_OC_SET_GLOBAL,  // [index16] store top into global, keep it
+    DRG_OC_GET_LOCAL,   // [slot8] push frame slot
+    DRG_OC_SET_LOCAL,   // [slot8] store top into frame slot, keep it
+    // Control flow
+    DRG_OC_JUMP,        // [offset16] forward
+    DRG_OC_JUMP_IF_FALSE, // [offset16] forward if top is false, keep it
+    DRG_OC_LOOP,        // [offset16] backward
+    DRG_OC_CALL,        // [argc8] call the value below the arguments
+    // Arrays (see drgArray.h), indices 1-based
+    DRG_OC_ARRAY,       // [element8, count16] pop 'count' elements into a new array
+    DRG_OC_NEW_ARRAY,   // [element8] pop a fill and a size, push that many fills
+    DRG_OC_GET_INDEX,   // pop index and array, push the element
+    DRG_OC_GET_INDEX_INT, // array known to be an int array
+    DRG_OC_GET_INDEX_REAL,
+    DRG_OC_GET_INDEX_BOOL,
+    DRG_OC_SET_INDEX,   // pop value, index and array, store, push the value
+    DRG_OC_SET_INDEX_INT, // array known to be an int array, value an int
+    DRG_OC_SET_INDEX_REAL,
+    DRG_OC_SET_INDEX_BOOL,
+    DRG_OC_ARRAY_ADD,   // pop value and [*] array, append, push none
+    DRG_OC_ARRAY_REM,   // pop index and [*] array, remove, push none
+    DRG_OC_ARRAY_LEN,   // array becomes its length
+    DRG_OC_MAP,         // [type8, count16] pop 'count' keys and values into a new map
+    DRG_OC_GET_MAP_INT, // pop key and map, push the value; map known to be int keyed
+    DRG_OC_GET_MAP_REAL,
+    DRG_OC_GET_MAP_STRING,
+    DRG_OC_SET_MAP,     // pop value, key and map, store, push the value
+    DRG_OC_MAP_HAS,     // pop key and map, push whether it's there
+    DRG_OC_MAP_REM,     // pop key and map, remove it, push none
+    DRG_OC_MAP_LEN,     // map becomes its count
+    DRG_OC_MAP_KEYS,    // map becomes an array of its keys
+    DRG_OC_MAP_RESERVE, // pop count and map, make room, push none
+    // Structs (see drgStruct.h)
+    DRG_OC_STRUCT,      // [type8, count8] pop 'count' fields into a new struct
+    DRG_OC_GET_FIELD,   // [offset8] struct becomes the field at 'offset'
+    DRG_OC_SET_FIELD,   // [offset8] pop value and struct, store, push the value
+    DRG_OC_GET_ROW_FIELD, // [offset8] pop index and struct array, push the row's field
+    DRG_OC_SET_ROW_FIELD, // [offset8] pop value, index and struct array, store, push the value
+    // Statements
+    DRG_OC_POP,
+    DRG_OC_PRINT,       // pop and print
+    // Superinstructions, written by D_Optimize() in place of the
+    // pair in (brackets)
+    DRG_OC_POP_LOCAL,   // [slot8] pop into frame slot (SET_LOCAL, POP)
+    DRG_OC_GET_LOCAL_ADD, // [slot8] add frame slot to top (GET_LOCAL, ADD)
+    DRG_OC_LIT_ADD,     // [index8] add constant to top (NUM_LIT, ADD)
+    DRG_OC_LIT_SUB,     // [index8] (NUM_LIT, SUB)
+    DRG_OC_LIT_LT,      // [index8] (NUM_LIT, LT)
+    DRG_OC_LIT_EQ,      // [index8] (NUM_LIT, EQ)
+    // Register form (D_CompileFlag_REGISTERS). Operands are
+    // 16-bit frame slots: the globals, then the temporaries.
+    DRG_OC_R_LOADK,     // [dst, index8] dst = constant
+    DRG_OC_R_LOADK_LONG, // [dst, index24]
+    DRG_OC_R_LOADTRUE,  // [dst]
+    DRG_OC_R_LOADFALSE, // [dst]
+    DRG_OC_R_MOVE,      // [dst, src]
+    DRG_OC_R_NEGATE,    // [dst, a]
+    DRG_OC_R_NOT,       // [dst, a]
+    DRG_OC_R_INT_TO_REAL, // [dst, a]
+    DRG_OC_R_ADD,       // [dst, a, b] dst = a + b
+    DRG_OC_R_SUB,
+    DRG_OC_R_MULT,
+    DRG_OC_R_DIV,
+    DRG_OC_R_EQ,
+    DRG_OC_R_NEQ,
+    DRG_OC_R_GT,
+    DRG_OC_R_GTE,
+    DRG_OC_R_LT,
+    DRG_OC_R_LTE,
+    DRG_OC_R_PRINT,     // [src]
+    // Count
+    DRG_OC_Count
 } drgOpcode;
 
+/// @brief How many struct declarations there's room for among the
+/// types, few enough that a struct's type still leaves the top bit
+/// of an array's element operand for DRG_ARRAY_RESIZABLE.
+#define DRG_STRUCT_TYPES 100
+
+/// @brief What the compiler knows of a value's type, and the
+/// operand of DRG_OC_CHECK_TYPE.
+typedef enum {
+    DRG_TYPE_INT,
+    DRG_TYPE_REAL,
+    DRG_TYPE_BOOL,
+    DRG_TYPE_STRING,
+    DRG_TYPE_FUN,
+    DRG_TYPE_NONE,
+    DRG_TYPE_ANY,       // not known until runtime
+    // Arrays, in the order of their element types
+    DRG_TYPE_INT_ARRAY,
+    DRG_TYPE_REAL_ARRAY,
+    DRG_TYPE_BOOL_ARRAY,
+    DRG_TYPE_STRING_ARRAY,
+    // Maps, DRG_TYPE_MAP + key * 4 + value, the key and value being
+    // DRG_TYPE_INT through DRG_TYPE_STRING
+    DRG_TYPE_MAP,
+    // Structs, DRG_TYPE_STRUCT + the order they were declared in
+    DRG_TYPE_STRUCT = DRG_TYPE_MAP + 16,
+    // Arrays of them, DRG_TYPE_STRUCT_ARRAY + the same
+    DRG_TYPE_STRUCT_ARRAY = DRG_TYPE_STRUCT + DRG_STRUCT_TYPES
+} drgType;
+
+/// @brief Most constants a nugget can hold, the *_LONG
+/// instructions take a 24-bit index.
+#define DRG_NUGGET_LITERALS_MAX (1 << 24)
+
+/// @brief Where a nugget's bytecode came from in the source.
+/// An entry is only written where the position changes, as
+/// deltas from the entry before it, and it's only ever decoded
+/// to report an error or trace; the VM never touches it.
+typedef struct {
+    int count;          // bytes of 'data'
+    int capacity;
+    drgByte* data;
+    int offset;         // the newest entry, for the next delta
+    int line;
+    int column;
+} drgLineTable;
+
 /// @brief A "Nugget" is a dynamic array of
 /// bytecode.
 typedef struct {
@@ -42,19 +207,66 @@ typedef struct {
     int capacity;
     drgByte* bytecode;
     drgValArray constantPool;
+    int* literalIndex;  // open-addressed, constant indices or -1
+    int literalIndexCapacity;
+    drgLineTable lines;
+    int registers;      // temporaries the register form needs
+    int maxStack;       // deepest the stack gets in one frame
 } drgNugget;
 
+/// @brief Size of an instruction, operands included.
+/// @param op 
+/// @return Number of bytes, 1 for unknown opcodes.
+int drgInstructionLength(drgByte op);
+
+/// @brief Net number of values an instruction pushes (negative
+/// if it pops more than it pushes).
+/// @param op 
+/// @param operand The count operand, only used by DRG_OC_CALL,
+/// DRG_OC_ARRAY, DRG_OC_MAP and DRG_OC_STRUCT.
+/// @return 
+int drgStackEffect(drgByte op, int operand);
+
 // Initializes a nugget (bytecode chunk).
 void drgNuggetInit(drgNugget* nugget);
 
 // Adds a new byte to a nugget.
 void drgNuggetAdd(drgNugget* nugget, drgByte byte);
 
-/// @brief Adds a new constant to a nugget.
-/// @return The index where the constant was appended to.
+/// @brief Adds a constant to a nugget, unless an identical one
+/// (same bits) is already there.
+/// @return The index of the constant.
 int drgNuggetAddLiteral(drgNugget* nugget, drgVal constant);
 
-// Frees a nugget's dynamic memory.
-void drgNuggetFree(drgNugget* nugget); */
+/// @brief Adds a constant with a slot of its own, which is never
+/// shared, e.g. one to overwrite with an object once allocated.
+/// @return The index where the constant was appended to.
+int drgNuggetAppendLiteral(drgNugget* nugget, drgVal constant);
+
+/// @brief Notes that the bytecode added from now on comes from
+/// 'line' and 'column' (until the next call).
+void drgNuggetAddPosition(drgNugget* nugget, int line, int column);
+
+/// @brief Notes that the bytecode from 'offset' on comes from
+/// 'line' and 'column'. Offsets must be marked in order.
+void drgLineTableMark(drgLineTable* lines, int offset, int line, int column);
+
+/// @brief Decodes the position of every byte of a nugget at once.
+/// @param nugget
+/// @param line Output, 'nugget->count' entries.
+/// @param column Output, 'nugget->count' entries.
+void drgNuggetGetPositions(const drgNugget* nugget, int* line, int* column);
+
+/// @brief Decodes the source position of the byte at 'offset'.
+/// @param nugget
+/// @param offset
+/// @param line Output.
+/// @param column Output.
+/// @return False if the nugget has no positions.
+bool drgNuggetGetPosition(const drgNugget* nugget, int offset, int* line, int* column);
+
+// Frees a nugget's dynamic memory, and the objects
+// in its constant pool (other than strings).
+void drgNuggetFree(drgNugget* nugget);
 
 #endif // DRG_H_NUGGET
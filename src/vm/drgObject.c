@@ -0,0 +1,76 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgObject.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Heap-allocated values.
+*
+*****************************************************************/
+
+#include <stdio.h>
+
+#include "drgObject.h"
+#include "drgArray.h"
+#include "drgMap.h"
+#include "drgRope.h"
+#include "drgStruct.h"
+#include "../util/drgMemUtil.h"
+
+drgFunction* drgNewFunction(void) {
+    drgFunction* function = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_BYTECODE, drgFunction, NULL, 0, 1);
+    function->obj.type = DRG_OBJ_FUNCTION;
+    function->arity = 0;
+    drgNuggetInit(&function->nugget);
+    function->name = NULL;
+    function->module = NULL;
+    return function;
+}
+
+void drgFreeObject(drgObj* obj) {
+    switch(obj->type) {
+        case DRG_OBJ_FUNCTION: {
+            drgFunction* function = (drgFunction*)obj;
+            drgNuggetFree(&function->nugget);
+            DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_BYTECODE, drgFunction, function, 1);
+            break;
+        }
+        case DRG_OBJ_STRING: {
+            drgString* string = (drgString*)obj;
+            drgMemReallocate(DRG_MEM_CAT_STRINGS, string, sizeof(drgString) + (size_t)string->length + 1, 0);
+            break;
+        }
+        case DRG_OBJ_ARRAY:
+        case DRG_OBJ_MAP:
+        case DRG_OBJ_ROPE:
+        case DRG_OBJ_STRUCT:
+            break;
+    }
+}
+
+void drgPrintObject(drgObj* obj) {
+    switch(obj->type) {
+        case DRG_OBJ_FUNCTION: {
+            drgFunction* function = (drgFunction*)obj;
+            printf("<fun %s>", function->name->chars);
+            break;
+        }
+        case DRG_OBJ_STRING:
+            printf("%s", ((drgString*)obj)->chars);
+            break;
+        case DRG_OBJ_ARRAY:
+            drgPrintArray((drgArray*)obj);
+            break;
+        case DRG_OBJ_MAP:
+            drgPrintMap((drgMap*)obj);
+            break;
+        case DRG_OBJ_ROPE:
+            printf("%s", drgRopeFlatten((drgRope*)obj)->chars);
+            break;
+        case DRG_OBJ_STRUCT:
+            drgPrintStruct((drgStruct*)obj);
+            break;
+    }
+}
@@ -0,0 +1,105 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgObject.h
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Heap-allocated values. A drgVal holding an object points at a
+* struct that starts with a drgObj header saying which kind it is.
+*
+*****************************************************************/
+
+#ifndef DRG_H_OBJECT
+#define DRG_H_OBJECT
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "drgNugget.h"
+#include "drgValue.h"
+
+/// @brief Kinds of heap object.
+typedef enum {
+    DRG_OBJ_FUNCTION,
+    DRG_OBJ_STRING,
+    DRG_OBJ_ARRAY,      // see drgArray.h
+    DRG_OBJ_MAP,        // see drgMap.h
+    DRG_OBJ_ROPE,       // a string, see drgRope.h
+    DRG_OBJ_STRUCT      // see drgStruct.h
+} drgObjType;
+
+/// @brief Header shared by every object.
+typedef struct {
+    drgObjType type;
+} drgObj;
+
+/// @brief An immutable string. Every one is interned (see
+/// drgIntern.h), so two strings are equal only if they're the
+/// same object.
+typedef struct {
+    drgObj obj;
+    int length;
+    uint32_t hash;
+    char chars[];       // null-terminated
+} drgString;
+
+/// @brief Longest string '+' puts together straight away. Longer
+/// results are ropes, see drgRope.h.
+#define DRG_STRING_SHORT 22
+
+/// @brief Longest a string can be.
+#define DRG_STRING_MAX (1 << 30)
+
+struct drgModule;
+
+/// @brief A compiled function: its own nugget, run in a fresh
+/// call frame.
+typedef struct {
+    drgObj obj;
+    int arity;
+    drgNugget nugget;
+    drgString* name;
+    struct drgModule* module; // the .dgm it's from, which owns it,
+                              // or NULL (see drgModule.h)
+} drgFunction;
+
+/// @brief Allocates an empty function.
+/// @return Owned by whichever nugget's constant pool it ends up
+/// in, and freed along with it.
+drgFunction* drgNewFunction(void);
+
+/// @brief Frees an object and everything it owns. Strings are
+/// only freed by their intern table, arrays by drgArrayFreeAll(),
+/// maps by drgMapFreeAll(), ropes by drgRopeFreeAll() and structs
+/// by drgStructFreeAll().
+/// @param obj
+void drgFreeObject(drgObj* obj);
+
+/// @brief Prints an object, as drgPrintVal() would.
+/// @param obj
+void drgPrintObject(drgObj* obj);
+
+static inline bool drgValIsObjType(drgVal v, drgObjType type) {
+    return drgValIsObj(v) && ((drgObj*)drgValAsObj(v))->type == type;
+}
+
+static inline drgFunction* drgValAsFunction(drgVal v) {
+    return (drgFunction*)drgValAsObj(v);
+}
+
+/// @brief Only for strings known not to be ropes; see
+/// drgValToString() otherwise.
+static inline drgString* drgValAsString(drgVal v) {
+    return (drgString*)drgValAsObj(v);
+}
+
+/// @brief Whether a value is a string, a rope included.
+static inline bool drgValIsString(drgVal v) {
+    if(!drgValIsObj(v)) return false;
+    drgObjType type = ((drgObj*)drgValAsObj(v))->type;
+    return type == DRG_OBJ_STRING || type == DRG_OBJ_ROPE;
+}
+
+#endif // DRG_H_OBJECT
@@ -0,0 +1,87 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgRope.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Ropes.
+*
+*****************************************************************/
+
+#include <string.h>
+
+#include "drgRope.h"
+#include "drgIntern.h"
+#include "../util/drgMemUtil.h"
+
+static drgRope* ropes; // Every rope, newest first.
+
+static int drgObjLength(const drgObj* obj) {
+    return (obj->type == DRG_OBJ_STRING) ? ((const drgString*)obj)->length : ((const drgRope*)obj)->length;
+}
+
+drgVal drgConcat(drgVal a, drgVal b) {
+    int length = drgStringLength(a) + drgStringLength(b);
+    if(length <= DRG_STRING_SHORT) {
+        return drgValFromObj(drgInternConcat(drgValToString(a), drgValToString(b)));
+    }
+    if(0 == drgStringLength(a)) return b;
+    if(0 == drgStringLength(b)) return a;
+    drgRope* rope = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_STRINGS, drgRope, NULL, 0, 1);
+    rope->obj.type = DRG_OBJ_ROPE;
+    rope->length = length;
+    rope->left = (drgObj*)drgValAsObj(a);
+    rope->right = (drgObj*)drgValAsObj(b);
+    rope->flat = NULL;
+    rope->next = ropes;
+    ropes = rope;
+    return drgValFromObj(rope);
+}
+
+// Copies the text of 'obj' to 'dst'. It recurses into the shorter
+// half and loops on the longer, so however lopsided a rope gets
+// (and one built in a loop is all on one side) it recurses no
+// deeper than the log of its length.
+static void drgRopeCopy(const drgObj* obj, char* dst) {
+    for(;;) {
+        if(obj->type == DRG_OBJ_STRING) {
+            const drgString* string = (const drgString*)obj;
+            memcpy(dst, string->chars, (size_t)string->length);
+            return;
+        }
+        const drgRope* rope = (const drgRope*)obj;
+        if(NULL != rope->flat) {
+            obj = &rope->flat->obj;
+            continue;
+        }
+        int leftLength = drgObjLength(rope->left);
+        if(leftLength <= rope->length - leftLength) {
+            drgRopeCopy(rope->left, dst);
+            dst += leftLength;
+            obj = rope->right;
+        }
+        else {
+            drgRopeCopy(rope->right, dst + leftLength);
+            obj = rope->left;
+        }
+    }
+}
+
+drgString* drgRopeFlatten(drgRope* rope) {
+    if(NULL == rope->flat) {
+        drgString* string = drgInternBegin(rope->length);
+        drgRopeCopy(&rope->obj, string->chars);
+        rope->flat = drgInternEnd(string);
+    }
+    return rope->flat;
+}
+
+void drgRopeFreeAll(void) {
+    while(NULL != ropes) {
+        drgRope* rope = ropes;
+        ropes = rope->next;
+        DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_STRINGS, drgRope, rope, 1);
+    }
+}
@@ -0,0 +1,81 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgRope.h
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Ropes: the strings '+' makes when the result is longer than
+* DRG_STRING_SHORT. A rope just points at its two halves, so
+* building a string a piece at a time in a loop is linear rather
+* than quadratic. It's copied out into an interned drgString the
+* first time something needs the text (printing, comparing, or a
+* map key), and keeps that for next time.
+*
+* Short results are interned straight away instead, as copying a
+* few bytes is cheaper than a rope, and so the strings that are
+* compared and looked up most never need flattening.
+*
+* Like arrays, ropes live until the VM is freed, with
+* drgRopeFreeAll().
+*
+*****************************************************************/
+
+#ifndef DRG_H_ROPE
+#define DRG_H_ROPE
+
+#include <stdbool.h>
+
+#include "drgObject.h"
+#include "drgValue.h"
+
+/// @brief A string that's two others end to end.
+typedef struct drgRope {
+    drgObj obj;
+    int length;         // of the whole text
+    drgObj* left;       // a drgString or a drgRope
+    drgObj* right;
+    drgString* flat;    // the text, once it's been needed
+    struct drgRope* next; // every rope, for drgRopeFreeAll()
+} drgRope;
+
+/// @brief One string followed by another.
+/// @param a A string or a rope.
+/// @param b A string or a rope.
+/// @return A rope if it's longer than DRG_STRING_SHORT, otherwise
+/// an interned string. The caller keeps it to DRG_STRING_MAX.
+drgVal drgConcat(drgVal a, drgVal b);
+
+/// @brief The text of a rope, as an interned string.
+/// @param rope
+/// @return
+drgString* drgRopeFlatten(drgRope* rope);
+
+/// @brief Frees every rope there is.
+void drgRopeFreeAll(void);
+
+/// @brief The text of a string or rope.
+/// @param v A string or a rope.
+/// @return
+static inline drgString* drgValToString(drgVal v) {
+    drgObj* obj = (drgObj*)drgValAsObj(v);
+    return (obj->type == DRG_OBJ_STRING) ? (drgString*)obj : drgRopeFlatten((drgRope*)obj);
+}
+
+/// @brief A value with any rope flattened, for comparing.
+/// @param v
+/// @return
+static inline drgVal drgValFlat(drgVal v) {
+    return drgValIsObjType(v, DRG_OBJ_ROPE) ? drgValFromObj(drgRopeFlatten(drgValAsObj(v))) : v;
+}
+
+/// @brief Length of a string or rope.
+/// @param v A string or a rope.
+/// @return
+static inline int drgStringLength(drgVal v) {
+    drgObj* obj = (drgObj*)drgValAsObj(v);
+    return (obj->type == DRG_OBJ_STRING) ? ((drgString*)obj)->length : ((drgRope*)obj)->length;
+}
+
+#endif // DRG_H_ROPE
@@ -0,0 +1,59 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgStruct.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Struct instances.
+*
+*****************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "drgStruct.h"
+#include "../util/drgMemUtil.h"
+
+static drgStruct* structs; // Every struct, newest first.
+
+static size_t drgStructBytes(int count) {
+    return sizeof(drgStruct) + sizeof(drgVal) * (size_t)count;
+}
+
+drgStruct* drgNewStruct(drgType type, const drgVal* fields, int count) {
+    // The fields are in the same allocation, so there's just the
+    // one to fail
+    drgStruct* s = (drgStruct*)drgMemReallocate(DRG_MEM_CAT_STRUCTS, NULL, 0, drgStructBytes(count));
+    s->obj.type = DRG_OBJ_STRUCT;
+    s->type = type;
+    s->count = count;
+    memcpy(s->fields, fields, sizeof(drgVal) * (size_t)count);
+    s->next = structs;
+    structs = s;
+    return s;
+}
+
+void drgPrintStruct(const drgStruct* s) {
+    drgPrintFields(s->fields, s->count);
+}
+
+void drgPrintFields(const drgVal* fields, int count) {
+    printf("{");
+    for(int i = 0; i < count; i++) {
+        if(i > 0) {
+            printf(",");
+        }
+        drgPrintVal(fields[i]);
+    }
+    printf("}");
+}
+
+void drgStructFreeAll(void) {
+    while(NULL != structs) {
+        drgStruct* s = structs;
+        structs = s->next;
+        drgMemReallocate(DRG_MEM_CAT_STRUCTS, s, drgStructBytes(s->count), 0);
+    }
+}
@@ -0,0 +1,67 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file drgStruct.h
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Struct instances, e.g. of 'struct Person { string name }'. The
+* fields are one flat record of drgVals inside the object, in the
+* order they're declared, so each is at an offset the compiler
+* works out: DRG_OC_GET_FIELD and DRG_OC_SET_FIELD take it as an
+* operand, and a field is a single load or store, never a lookup
+* by name. Nothing of the declaration is kept at runtime but the
+* struct's drgType, which DRG_OC_CHECK_TYPE compares; 'readonly'
+* and 'private' are only ever checked by the compiler.
+*
+* Like arrays, structs live until the VM is freed, with
+* drgStructFreeAll().
+*
+*****************************************************************/
+
+#ifndef DRG_H_STRUCT
+#define DRG_H_STRUCT
+
+#include <stdint.h>
+
+#include "drgObject.h"
+#include "drgValue.h"
+#include "drgNugget.h"
+
+/// @brief Most fields a struct can have, as offsets are a byte.
+#define DRG_STRUCT_FIELDS_MAX UINT8_MAX
+
+/// @brief A struct instance.
+typedef struct drgStruct {
+    drgObj obj;
+    drgType type;       // DRG_TYPE_STRUCT and up, see drgNugget.h
+    int count;          // fields
+    struct drgStruct* next; // every struct, for drgStructFreeAll()
+    drgVal fields[];    // at the offsets the compiler gave them
+} drgStruct;
+
+/// @brief Allocates a struct.
+/// @param type
+/// @param fields 'count' values, copied in as they are.
+/// @param count At most DRG_STRUCT_FIELDS_MAX.
+/// @return Valid until drgStructFreeAll().
+drgStruct* drgNewStruct(drgType type, const drgVal* fields, int count);
+
+/// @brief Prints a struct's fields as {a,b,c}.
+/// @param s
+void drgPrintStruct(const drgStruct* s);
+
+/// @brief Prints fields as {a,b,c}, wherever they're stored.
+/// @param fields
+/// @param count
+void drgPrintFields(const drgVal* fields, int count);
+
+/// @brief Frees every struct there is.
+void drgStructFreeAll(void);
+
+static inline drgStruct* drgValAsStruct(drgVal v) {
+    return (drgStruct*)drgValAsObj(v);
+}
+
+#endif // DRG_H_STRUCT
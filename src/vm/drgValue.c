@@ -12,7 +12,8 @@
 
 #include <stdio.h>
 
-/* #include "drgValue.h"
+#include "drgValue.h"
+#include "drgObject.h"
 
 void drgValArrayInit(drgValArray* arr) {
     arr->capacity = 0;
@@ -22,19 +23,33 @@ void drgValArrayInit(drgValArray* arr) {
 
 void drgValArrayAdd(drgValArray* arr, drgVal val) {
     if(arr->capacity < arr->count + 1) {
-        int prevCapacity = arr->capacity;
-        arr->capacity = DRG_MEM_GROW_CAPACITY(prevCapacity);
-        arr->values = DRG_MEM_GROW_ARRAY(drgVal, arr->values, prevCapacity, arr->capacity);
+        int capacity = DRG_MEM_GROW_CAPACITY(arr->capacity);
+        arr->values = DRG_MEM_GROW_ARRAY(DRG_MEM_CAT_CONSTANTS, drgVal, arr->values, arr->capacity, capacity);
+        arr->capacity = capacity;
     }
     arr->values[arr->count] = val;
     arr->count++;
 }
 
 void drgValArrayFree(drgValArray* arr) {
-    DRG_MEM_FREE_ARRAY(drgVal, arr->values, arr->capacity);
+    DRG_MEM_FREE_ARRAY(DRG_MEM_CAT_CONSTANTS, drgVal, arr->values, arr->capacity);
     drgValArrayInit(arr);
 }
 
 void drgPrintVal(drgVal val) {
-    printf("%g", val);
-} */
\ No newline at end of file
+    if(drgValIsReal(val)) {
+        printf("%g", drgValAsReal(val));
+    }
+    else if(drgValIsInt(val)) {
+        printf("%lld", (long long)drgValAsInt(val));
+    }
+    else if(drgValIsBool(val)) {
+        printf(drgValAsBool(val) ? "true" : "false");
+    }
+    else if(drgValIsNone(val)) {
+        printf("none");
+    }
+    else {
+        drgPrintObject((drgObj*)drgValAsObj(val));
+    }
+}
@@ -8,17 +8,190 @@
 * @section Description
 * The virtual machine representation for values.
 *
+* Every value is one 64-bit word ("NaN-boxing"). A real is stored
+* as its own bits; everything else hides in the payload of a quiet
+* NaN that no arithmetic produces:
+*
+*   real    any double (NaNs are stored as one canonical NaN)
+*   int     0 11111111111 11 01 [48-bit two's complement]
+*   bool    0 11111111111 11 10 [0 or 1]
+*   none    0 11111111111 11 11 [0]
+*   object  1 11111111111 11 00 [48-bit pointer]
+*
+* Build with DRG_VALUE_TAGGED for a plain tagged struct instead,
+* which is easier to look at in a debugger. Code should only go
+* through the helpers below, which work with either.
+*
 *****************************************************************/
 
 #ifndef DRG_H_VALUE
 #define DRG_H_VALUE
 
-/* #include <stddef.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../util/drgMemUtil.h"
+
+// Ints are 48 bits wide, and wrap around at these bounds.
+#define DRG_INT_MAX ((int64_t)0x00007FFFFFFFFFFF)
+#define DRG_INT_MIN (-DRG_INT_MAX - 1)
+
+#ifdef DRG_VALUE_TAGGED
 
-#include <drgMemUtil.h>
+typedef enum {
+    DRG_VAL_REAL,
+    DRG_VAL_INT,
+    DRG_VAL_BOOL,
+    DRG_VAL_NONE,
+    DRG_VAL_OBJ
+} drgValType;
 
 /// @brief A value within Dargon's virtual machine
-typedef double drgVal;
+typedef struct {
+    drgValType type;
+    union {
+        double real;
+        int64_t integer;
+        bool boolean;
+        void* obj;
+    } as;
+} drgVal;
+
+static inline bool drgValIsReal(drgVal v) { return v.type == DRG_VAL_REAL; }
+static inline bool drgValIsInt(drgVal v)  { return v.type == DRG_VAL_INT; }
+static inline bool drgValIsBool(drgVal v) { return v.type == DRG_VAL_BOOL; }
+static inline bool drgValIsNone(drgVal v) { return v.type == DRG_VAL_NONE; }
+static inline bool drgValIsObj(drgVal v)  { return v.type == DRG_VAL_OBJ; }
+
+static inline double drgValAsReal(drgVal v)  { return v.as.real; }
+static inline int64_t drgValAsInt(drgVal v)  { return v.as.integer; }
+static inline bool drgValAsBool(drgVal v)    { return v.as.boolean; }
+static inline void* drgValAsObj(drgVal v)    { return v.as.obj; }
+
+static inline drgVal drgValFromReal(double r) {
+    drgVal v = { DRG_VAL_REAL, { .real = r } };
+    return v;
+}
+static inline drgVal drgValFromInt(int64_t i) {
+    // Same 48-bit wraparound as the boxed form
+    drgVal v = { DRG_VAL_INT, { .integer = (int64_t)((uint64_t)i << 16) >> 16 } };
+    return v;
+}
+static inline drgVal drgValFromBool(bool b) {
+    drgVal v = { DRG_VAL_BOOL, { .boolean = b } };
+    return v;
+}
+static inline drgVal drgValNone(void) {
+    drgVal v = { DRG_VAL_NONE, { .integer = 0 } };
+    return v;
+}
+static inline drgVal drgValFromObj(void* obj) {
+    drgVal v = { DRG_VAL_OBJ, { .obj = obj } };
+    return v;
+}
+
+/// @brief Identity of two values: same type and same contents
+/// (reals compare by value, so NaN isn't equal to itself).
+static inline bool drgValEquals(drgVal a, drgVal b) {
+    if(a.type != b.type) return false;
+    switch(a.type) {
+        case DRG_VAL_REAL: return a.as.real == b.as.real;
+        case DRG_VAL_INT:  return a.as.integer == b.as.integer;
+        case DRG_VAL_BOOL: return a.as.boolean == b.as.boolean;
+        case DRG_VAL_NONE: return true;
+        case DRG_VAL_OBJ:  return a.as.obj == b.as.obj;
+    }
+    return false;
+}
+
+/// @brief Raw bits of a value, e.g. for hashing. Values with
+/// the same bits are interchangeable (0.0 and -0.0 are not).
+static inline uint64_t drgValBits(drgVal v) {
+    uint64_t bits = 0;
+    switch(v.type) {
+        case DRG_VAL_REAL: memcpy(&bits, &v.as.real, sizeof(bits)); break;
+        case DRG_VAL_INT:  bits = (uint64_t)v.as.integer; break;
+        case DRG_VAL_BOOL: bits = v.as.boolean; break;
+        case DRG_VAL_NONE: bits = 0; break;
+        case DRG_VAL_OBJ:  bits = (uint64_t)(uintptr_t)v.as.obj; break;
+    }
+    return bits ^ ((uint64_t)v.type << 56);
+}
+
+#else
+
+/// @brief A value within Dargon's virtual machine
+typedef uint64_t drgVal;
+
+#define DRG_VAL_QNAN       ((uint64_t)0x7FFC000000000000)
+#define DRG_VAL_SIGN       ((uint64_t)0x8000000000000000)
+#define DRG_VAL_PAYLOAD    ((uint64_t)0x0000FFFFFFFFFFFF)
+#define DRG_VAL_TAG_INT    ((uint64_t)1 << 48)
+#define DRG_VAL_TAG_BOOL   ((uint64_t)2 << 48)
+#define DRG_VAL_TAG_NONE   ((uint64_t)3 << 48)
+#define DRG_VAL_TAG_MASK   (DRG_VAL_SIGN | DRG_VAL_QNAN | ((uint64_t)3 << 48))
+#define DRG_VAL_CANON_NAN  ((uint64_t)0x7FF8000000000000)
+
+static inline bool drgValIsReal(drgVal v) { return (v & DRG_VAL_QNAN) != DRG_VAL_QNAN; }
+static inline bool drgValIsInt(drgVal v)  { return (v & DRG_VAL_TAG_MASK) == (DRG_VAL_QNAN | DRG_VAL_TAG_INT); }
+static inline bool drgValIsBool(drgVal v) { return (v & DRG_VAL_TAG_MASK) == (DRG_VAL_QNAN | DRG_VAL_TAG_BOOL); }
+static inline bool drgValIsNone(drgVal v) { return v == (DRG_VAL_QNAN | DRG_VAL_TAG_NONE); }
+static inline bool drgValIsObj(drgVal v)  { return (v & DRG_VAL_TAG_MASK) == (DRG_VAL_SIGN | DRG_VAL_QNAN); }
+
+static inline double drgValAsReal(drgVal v) {
+    double r;
+    memcpy(&r, &v, sizeof(r));
+    return r;
+}
+static inline int64_t drgValAsInt(drgVal v) {
+    // Sign-extend the 48-bit payload
+    return (int64_t)(v << 16) >> 16;
+}
+static inline bool drgValAsBool(drgVal v) { return (v & 1) != 0; }
+static inline void* drgValAsObj(drgVal v) { return (void*)(uintptr_t)(v & DRG_VAL_PAYLOAD); }
+
+static inline drgVal drgValFromReal(double r) {
+    drgVal v;
+    memcpy(&v, &r, sizeof(v));
+    // A NaN could otherwise alias a tagged value
+    return (r != r) ? DRG_VAL_CANON_NAN : v;
+}
+static inline drgVal drgValFromInt(int64_t i) {
+    return DRG_VAL_QNAN | DRG_VAL_TAG_INT | ((uint64_t)i & DRG_VAL_PAYLOAD);
+}
+static inline drgVal drgValFromBool(bool b) {
+    return DRG_VAL_QNAN | DRG_VAL_TAG_BOOL | (b ? 1 : 0);
+}
+static inline drgVal drgValNone(void) {
+    return DRG_VAL_QNAN | DRG_VAL_TAG_NONE;
+}
+static inline drgVal drgValFromObj(void* obj) {
+    return DRG_VAL_SIGN | DRG_VAL_QNAN | ((uint64_t)(uintptr_t)obj & DRG_VAL_PAYLOAD);
+}
+
+/// @brief Identity of two values: same type and same contents
+/// (reals compare by value, so NaN isn't equal to itself).
+static inline bool drgValEquals(drgVal a, drgVal b) {
+    if(drgValIsReal(a) && drgValIsReal(b)) {
+        return drgValAsReal(a) == drgValAsReal(b);
+    }
+    return a == b;
+}
+
+/// @brief Raw bits of a value, e.g. for hashing. Values with
+/// the same bits are interchangeable (0.0 and -0.0 are not).
+static inline uint64_t drgValBits(drgVal v) {
+    return v;
+}
+
+#endif // DRG_VALUE_TAGGED
+
+/// @brief Either kind of number, as a real.
+static inline double drgValAsNumber(drgVal v) {
+    return drgValIsInt(v) ? (double)drgValAsInt(v) : drgValAsReal(v);
+}
 
 /// @brief Dynamic array of Dargon values.
 typedef struct {
@@ -42,6 +215,6 @@ void drgValArrayFree(drgValArray* arr);
 
 /// @brief Prints a value to stdout.
 /// @param val 
-void drgPrintVal(drgVal val); */
+void drgPrintVal(drgVal val);
 
 #endif // DRG_H_VALUE
@@ -0,0 +1,283 @@
+/*****************************************************************
+* Dargon Programming Language
+* (C) Kyle Morris 2025 - See LICENSE.txt for license information.
+*
+* @file genKeywords.c
+* @author Kyle Morris
+* @since v0.1
+* @section Description
+* Build tool. Reads every D_TokenType_KW_<word> out of Token.h
+* and writes KeywordTable.h, a minimal perfect hash from
+* (length, first char, last char) to the keyword's token type.
+*
+* The hash is "hash and displace": a key first picks a bucket,
+* and the bucket's displacement moves it to a free slot. Buckets
+* are placed largest-first, and the seeds are re-rolled until
+* every bucket finds a home.
+*
+* Usage: genKeywords <Token.h> <KeywordTable.h>
+*
+*****************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DRG_KW_PREFIX "D_TokenType_KW_"
+#define DRG_KW_MAX 250
+#define DRG_KW_MAX_LENGTH 32
+
+typedef struct {
+    char word[DRG_KW_MAX_LENGTH];
+    int length;
+} Keyword;
+
+static Keyword keywords[DRG_KW_MAX];
+static int keywordCount = 0;
+
+/*****************************************************************
+* Hash (must match the lookup emitted below)
+*****************************************************************/
+
+typedef struct {
+    uint32_t a, b, c, d, e;   // multipliers
+    int buckets;              // number of buckets
+    int slots;                // table size (== keywordCount)
+} Seeds;
+
+static uint32_t bucketOf(const Seeds* s, int len, unsigned char first, unsigned char last) {
+    return (first * s->a + last * s->b + (uint32_t)len) % (uint32_t)s->buckets;
+}
+
+static uint32_t baseOf(const Seeds* s, int len, unsigned char first, unsigned char last) {
+    return first * s->c + last * s->d + (uint32_t)len * s->e;
+}
+
+/*****************************************************************
+* Search
+*****************************************************************/
+
+static uint32_t rngState = 0x2545F491u;
+static uint32_t nextRandom(void) {
+    // xorshift32, fixed seed so the output is reproducible
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static int bucketSizes[DRG_KW_MAX];
+static int compareBuckets(const void* a, const void* b) {
+    return bucketSizes[*(const int*)b] - bucketSizes[*(const int*)a];
+}
+
+// Tries to place every key with the given seeds.
+static bool tryPlace(const Seeds* s, int* displacement, int* slotOf) {
+    int order[DRG_KW_MAX];
+    bool used[DRG_KW_MAX] = { false };
+    memset(bucketSizes, 0, sizeof(bucketSizes));
+    for(int i = 0; i < keywordCount; i++) {
+        const Keyword* k = &keywords[i];
+        bucketSizes[bucketOf(s, k->length, k->word[0], k->word[k->length - 1])]++;
+    }
+    for(int b = 0; b < s->buckets; b++) order[b] = b;
+    qsort(order, (size_t)s->buckets, sizeof(int), compareBuckets);
+
+    for(int o = 0; o < s->buckets && bucketSizes[order[o]] > 0; o++) {
+        int bucket = order[o];
+        bool placed = false;
+        for(int d = 0; d < s->slots && !placed; d++) {
+            int taken[DRG_KW_MAX];
+            int takenCount = 0;
+            placed = true;
+            for(int i = 0; i < keywordCount; i++) {
+                const Keyword* k = &keywords[i];
+                unsigned char first = (unsigned char)k->word[0];
+                unsigned char last = (unsigned char)k->word[k->length - 1];
+                if((int)bucketOf(s, k->length, first, last) != bucket) continue;
+                int slot = (int)((baseOf(s, k->length, first, last) + (uint32_t)d) % (uint32_t)s->slots);
+                bool clash = used[slot];
+                for(int t = 0; t < takenCount && !clash; t++) {
+                    clash = slotOf[taken[t]] == slot;
+                }
+                if(clash) {
+                    placed = false;
+                    break;
+                }
+                slotOf[i] = slot;
+                taken[takenCount++] = i;
+            }
+            if(placed) {
+                displacement[bucket] = d;
+                for(int t = 0; t < takenCount; t++) used[slotOf[taken[t]]] = true;
+            }
+        }
+        if(!placed) return false;
+    }
+    return true;
+}
+
+/*****************************************************************
+* Input
+*****************************************************************/
+
+static bool readKeywords(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if(NULL == file) {
+        fprintf(stderr, "genKeywords: could not open \"%s\"\n", path);
+        return false;
+    }
+    char line[512];
+    while(fgets(line, sizeof(line), file)) {
+        const char* at = strstr(line, DRG_KW_PREFIX);
+        if(NULL == at) continue;
+        at += strlen(DRG_KW_PREFIX);
+        Keyword* k = &keywords[keywordCount];
+        k->length = 0;
+        while((*at >= 'a' && *at <= 'z') || (*at >= 'A' && *at <= 'Z') ||
+            (*at >= '0' && *at <= '9') || *at == '_') {
+            if(k->length + 1 >= DRG_KW_MAX_LENGTH) {
+                fprintf(stderr, "genKeywords: keyword too long in \"%s\"\n", line);
+                fclose(file);
+                return false;
+            }
+            k->word[k->length++] = *at++;
+        }
+        k->word[k->length] = '\0';
+        if(k->length > 0 && ++keywordCount >= DRG_KW_MAX) {
+            fprintf(stderr, "genKeywords: too many keywords\n");
+            fclose(file);
+            return false;
+        }
+    }
+    fclose(file);
+
+    // The hash only looks at (length, first, last), so those must
+    // tell every keyword apart.
+    for(int i = 0; i < keywordCount; i++) {
+        for(int j = i + 1; j < keywordCount; j++) {
+            const Keyword* a = &keywords[i];
+            const Keyword* b = &keywords[j];
+            if(a->length == b->length && a->word[0] == b->word[0] &&
+                a->word[a->length - 1] == b->word[b->length - 1]) {
+                fprintf(stderr, "genKeywords: '%s' and '%s' share length, first and last "
+                    "char; extend the hash key\n", a->word, b->word);
+                return false;
+            }
+        }
+    }
+    return keywordCount > 0;
+}
+
+/*****************************************************************
+* Output
+*****************************************************************/
+
+static bool writeTable(const char* path, const Seeds* s, const int* displacement, const int* slotOf) {
+    FILE* out = fopen(path, "wb");
+    if(NULL == out) {
+        fprintf(stderr, "genKeywords: could not write \"%s\"\n", path);
+        return false;
+    }
+    int minLength = DRG_KW_MAX_LENGTH, maxLength = 0;
+    for(int i = 0; i < keywordCount; i++) {
+        if(keywords[i].length < minLength) minLength = keywords[i].length;
+        if(keywords[i].length > maxLength) maxLength = keywords[i].length;
+    }
+    int keywordAt[DRG_KW_MAX];
+    for(int i = 0; i < keywordCount; i++) keywordAt[slotOf[i]] = i;
+
+    fprintf(out,
+        "/*****************************************************************\n"
+        "* Dargon Programming Language\n"
+        "* (C) Kyle Morris 2025 - See LICENSE.txt for license information.\n"
+        "*\n"
+        "* @file KeywordTable.h\n"
+        "* @section Description\n"
+        "* GENERATED by tools/genKeywords.c from Token.h - do not edit.\n"
+        "* Minimal perfect hash of the %d keywords.\n"
+        "*\n"
+        "*****************************************************************/\n\n"
+        "#ifndef DRG_H_KEYWORD_TABLE\n"
+        "#define DRG_H_KEYWORD_TABLE\n\n"
+        "#include <stdint.h>\n"
+        "#include <string.h>\n\n"
+        "#include \"scanner/Token.h\"\n\n",
+        keywordCount);
+    fprintf(out, "#define DRG_KW_COUNT %d\n", keywordCount);
+    fprintf(out, "#define DRG_KW_MIN_LENGTH %d\n", minLength);
+    fprintf(out, "#define DRG_KW_MAX_LENGTH %d\n\n", maxLength);
+
+    fprintf(out, "typedef struct {\n    const char* text;\n    int length;\n    D_TokenType type;\n} D_KeywordEntry;\n\n");
+    fprintf(out, "static const uint8_t D_KeywordDisplacement[%d] = {", s->buckets);
+    for(int b = 0; b < s->buckets; b++) {
+        fprintf(out, "%s%s%d", b ? "," : "", (b % 16) ? " " : "\n    ", displacement[b]);
+    }
+    fprintf(out, "\n};\n\n");
+    fprintf(out, "static const D_KeywordEntry D_KeywordTable[DRG_KW_COUNT] = {\n");
+    for(int slot = 0; slot < keywordCount; slot++) {
+        const Keyword* k = &keywords[keywordAt[slot]];
+        fprintf(out, "    { \"%s\", %d, D_TokenType_KW_%s },\n", k->word, k->length, k->word);
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out,
+        "/// @brief Maps a lexeme to its keyword token type.\n"
+        "/// @param start First char of the lexeme.\n"
+        "/// @param length Length of the lexeme, at least 1.\n"
+        "/// @return The keyword's type, or D_TokenType_IDENTIFIER.\n"
+        "static inline D_TokenType D_LookupKeyword(const char* start, int length) {\n"
+        "    if(length < DRG_KW_MIN_LENGTH || length > DRG_KW_MAX_LENGTH) {\n"
+        "        return D_TokenType_IDENTIFIER;\n"
+        "    }\n"
+        "    uint32_t first = (unsigned char)start[0];\n"
+        "    uint32_t last = (unsigned char)start[length - 1];\n"
+        "    uint32_t bucket = (first * %uu + last * %uu + (uint32_t)length) %% %uu;\n"
+        "    uint32_t slot = (first * %uu + last * %uu + (uint32_t)length * %uu\n"
+        "        + D_KeywordDisplacement[bucket]) %% %uu;\n"
+        "    const D_KeywordEntry* entry = &D_KeywordTable[slot];\n"
+        "    if(entry->length == length && 0 == memcmp(entry->text, start, (size_t)length)) {\n"
+        "        return entry->type;\n"
+        "    }\n"
+        "    return D_TokenType_IDENTIFIER;\n"
+        "}\n\n"
+        "#endif // DRG_H_KEYWORD_TABLE\n",
+        s->a, s->b, (unsigned)s->buckets, s->c, s->d, s->e, (unsigned)s->slots);
+    fclose(out);
+    return true;
+}
+
+int main(int argc, const char* argv[]) {
+    if(argc != 3) {
+        fprintf(stderr, "Usage: genKeywords <Token.h> <KeywordTable.h>\n");
+        return EXIT_FAILURE;
+    }
+    if(!readKeywords(argv[1])) {
+        return EXIT_FAILURE;
+    }
+
+    Seeds seeds;
+    seeds.slots = keywordCount;
+    int displacement[DRG_KW_MAX];
+    int slotOf[DRG_KW_MAX];
+    // Fewer buckets means a smaller displacement table, but harder
+    // placement; start small and widen if the seeds keep failing.
+    for(seeds.buckets = (keywordCount + 1) / 2; seeds.buckets <= keywordCount; seeds.buckets++) {
+        for(int attempt = 0; attempt < 20000; attempt++) {
+            // Keep the multipliers small so 'first * a' can't overflow
+            seeds.a = nextRandom() % 251 + 1;
+            seeds.b = nextRandom() % 251 + 1;
+            seeds.c = nextRandom() % 251 + 1;
+            seeds.d = nextRandom() % 251 + 1;
+            seeds.e = nextRandom() % 251 + 1;
+            memset(displacement, 0, sizeof(displacement));
+            if(tryPlace(&seeds, displacement, slotOf)) {
+                return writeTable(argv[2], &seeds, displacement, slotOf) ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
+        }
+    }
+    fprintf(stderr, "genKeywords: no perfect hash found\n");
+    return EXIT_FAILURE;
+}